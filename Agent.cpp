@@ -0,0 +1,295 @@
+#include "Agent.h"
+#include "Config.h"
+#include "PtyHelperProtocol.h"
+#include <glib.h>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace Agent {
+
+namespace {
+
+// Carries a saved passphrase from ngTerm to the askpass helper through ssh-add's environment
+const char* SECRET_VARIABLE = "NGTERM_ASKPASS_SECRET";
+
+// Runs the command once the marker file ($0) is gone, or after 10 s
+const char* WAIT_SCRIPT = "i=0; while [ -e \"$0\" ] && [ $i -lt 100 ]; do sleep 0.1; i=$((i+1)); done; exec \"$@\"";
+
+// A key this close to the end of its lifetime is added again, so it does not expire while a
+// new session is still authenticating
+const gint64 EXPIRY_MARGIN_US = 30 * G_USEC_PER_SEC;
+
+struct Key {
+    bool adding = false; // ssh-add queued or running
+    gint64 expires = 0;  // Monotonic time the agent drops the key, 0 for never
+};
+
+// Work for the agent thread: reusing or starting the agent first, then ssh-add per key
+struct Task {
+    std::vector<std::string> args;
+    char** env = nullptr;  // Built on the GTK thread, freed by the agent thread
+    std::string key_path;  // Empty for starting the agent
+    std::string marker;    // Exists until the key is added
+    gint64 expires = 0;
+};
+
+std::string socket_dir;
+std::string socket_path; // Empty while no agent is in use
+GPid agent_pid = 0;      // Set when this run started the agent
+bool started = false;
+
+std::thread agent_thread;
+std::mutex agent_mutex;  // Guards the state below, shared with the agent thread
+std::condition_variable task_cv;
+std::deque<Task> tasks;
+std::map<std::string, Key> keys; // Added, or being added, by key path
+bool agent_failed = false;
+bool stopping = false;
+
+// ssh-add must not fall back to the terminal ngTerm may have been started from
+void detach_terminal(gpointer) {
+    setsid();
+}
+
+// Run a command to completion and return its exit code, -1 if it could not run
+int run(const std::vector<std::string>& args, char** env, std::string* output = nullptr) {
+    std::vector<char*> argv;
+    for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    gchar* standard_output = nullptr;
+    gint status = 0;
+    GError* error = nullptr;
+    GSpawnFlags flags = GSpawnFlags(G_SPAWN_SEARCH_PATH | (output ? 0 : G_SPAWN_STDOUT_TO_DEV_NULL));
+    if (!g_spawn_sync(nullptr, argv.data(), env, flags, detach_terminal, nullptr,
+                      output ? &standard_output : nullptr, nullptr, &status, &error)) {
+        std::cerr << "Agent: Failed to run " << args[0] << ": " << error->message << std::endl;
+        g_error_free(error);
+        return -1;
+    }
+    if (output && standard_output) {
+        *output = standard_output;
+    }
+    g_free(standard_output);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+char** agent_environment(const std::string& path) {
+    char** env = g_get_environ();
+    return g_environ_setenv(env, "SSH_AUTH_SOCK", path.c_str(), TRUE);
+}
+
+void add_lifetime(std::vector<std::string>& args) {
+    int minutes = Config::get_ssh_agent_key_lifetime();
+    if (minutes > 0) {
+        args.push_back("-t");
+        args.push_back(std::to_string(minutes * 60));
+    }
+}
+
+std::string marker_path(const std::string& key_path) {
+    return socket_dir + "/agent-adding-" + std::to_string(std::hash<std::string>()(key_path));
+}
+
+// ssh-add -l exits 0 or 1 when it reached an agent, so one from an earlier run is reused.
+// Only a socket of this user counts; the directory was checked in start().
+bool start_agent(const Task& task) {
+    struct stat info;
+    if (lstat(socket_path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode) && info.st_uid == getuid()) {
+        int status = run({"ssh-add", "-l"}, task.env);
+        if (status == 0 || status == 1) return true;
+    }
+
+    unlink(socket_path.c_str()); // Left behind by an agent that is gone
+    std::string output;
+    if (run(task.args, task.env, &output) != 0) {
+        std::cerr << "Agent: ssh-agent could not be started" << std::endl;
+        return false;
+    }
+    size_t pid_at = output.find("SSH_AGENT_PID=");
+    if (pid_at != std::string::npos) {
+        agent_pid = atoi(output.c_str() + pid_at + strlen("SSH_AGENT_PID="));
+    }
+    return true;
+}
+
+void run_tasks() {
+    std::unique_lock<std::mutex> lock(agent_mutex);
+    while (true) {
+        task_cv.wait(lock, []() { return stopping || !tasks.empty(); });
+        if (stopping) return;
+        Task task = std::move(tasks.front());
+        tasks.pop_front();
+        bool failed_before = agent_failed;
+        lock.unlock();
+
+        bool ok = false;
+        if (task.key_path.empty()) {
+            ok = start_agent(task);
+        } else if (!failed_before) {
+            ok = run(task.args, task.env) == 0;
+            if (!ok) {
+                std::cerr << "Agent: Could not add " << task.key_path << std::endl;
+            }
+        }
+        g_strfreev(task.env);
+
+        lock.lock();
+        if (task.key_path.empty()) {
+            agent_failed = !ok;
+        } else if (ok) {
+            keys[task.key_path] = Key{false, task.expires};
+        } else {
+            keys.erase(task.key_path); // Tried again by the next session that uses the key
+        }
+        if (!task.marker.empty()) {
+            unlink(task.marker.c_str());
+        }
+    }
+}
+
+// Queue ssh-add for the connection's key unless the agent holds it, or is about to. A key
+// whose passphrase is not saved is left to the first ssh that uses it, which asks in its tab
+// and adds it (AddKeysToAgent).
+void load_key(const ConnectionInfo& conn) {
+    std::string key_path = conn.ssh_key_path;
+    gint64 now = g_get_monotonic_time();
+    std::lock_guard<std::mutex> lock(agent_mutex);
+    auto it = keys.find(key_path);
+    if (it != keys.end() &&
+        (it->second.adding || it->second.expires == 0 || it->second.expires - EXPIRY_MARGIN_US > now)) {
+        return;
+    }
+
+    Task task;
+    task.key_path = key_path;
+    task.env = agent_environment(socket_path);
+    if (!conn.ssh_key_passphrase.empty()) {
+        gchar* self = g_file_read_link("/proc/self/exe", nullptr);
+        if (self) {
+            task.env = g_environ_setenv(task.env, "SSH_ASKPASS", self, TRUE);
+            task.env = g_environ_setenv(task.env, "SSH_ASKPASS_REQUIRE", "force", TRUE);
+            task.env = g_environ_setenv(task.env, "DISPLAY", ":0", FALSE); // Older ssh-add only asks with a display
+            task.env = g_environ_setenv(task.env, SECRET_VARIABLE, conn.ssh_key_passphrase.c_str(), TRUE);
+            g_free(self);
+        }
+    } else {
+        task.env = g_environ_setenv(task.env, "SSH_ASKPASS_REQUIRE", "never", TRUE);
+    }
+    task.args = {"ssh-add"};
+    add_lifetime(task.args);
+    task.args.push_back(key_path);
+    int minutes = Config::get_ssh_agent_key_lifetime();
+    task.expires = (minutes > 0) ? now + static_cast<gint64>(minutes) * 60 * G_USEC_PER_SEC : 0;
+    task.marker = marker_path(key_path);
+    g_file_set_contents(task.marker.c_str(), "", 0, nullptr);
+
+    keys[key_path] = Key{true, 0};
+    tasks.push_back(std::move(task));
+    task_cv.notify_one();
+}
+
+} // namespace
+
+bool answer_askpass(int argc, char* argv[]) {
+    const char* secret = getenv(SECRET_VARIABLE);
+    if (!secret) return false;
+    // A wrong passphrase would be asked for again forever; an empty answer ends ssh-add
+    bool retry = argc > 1 && strncmp(argv[1], "Bad passphrase", 14) == 0;
+    printf("%s\n", retry ? "" : secret);
+    return true;
+}
+
+void start() {
+    if (started) return;
+    started = true;
+    if (!Config::get_ssh_agent()) return;
+
+    // Keys go to whatever answers in this directory, so it must be ours alone
+    std::string error;
+    socket_dir = PtyHelperProtocol::prepare_socket_dir(error);
+    if (socket_dir.empty()) {
+        std::cerr << "Agent: " << error << "; not using ngTerm's agent" << std::endl;
+        return;
+    }
+    socket_path = socket_dir + "/agent.sock";
+
+    // Reusing or starting the agent runs first on the agent thread; keys queued meanwhile
+    // are added after it
+    Task task;
+    task.env = agent_environment(socket_path);
+    task.args = {"ssh-agent", "-s", "-a", socket_path};
+    add_lifetime(task.args);
+    tasks.push_back(std::move(task));
+    agent_thread = std::thread(run_tasks);
+
+    // Everything ngTerm starts inherits the agent, unless the desktop runs one already. Key
+    // connections always name this agent explicitly (IdentityAgent).
+    const char* existing = g_getenv("SSH_AUTH_SOCK");
+    if (!existing || !*existing) {
+        g_setenv("SSH_AUTH_SOCK", socket_path.c_str(), TRUE);
+    }
+}
+
+void shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(agent_mutex);
+        stopping = true;
+    }
+    task_cv.notify_all();
+    if (agent_thread.joinable()) {
+        agent_thread.join();
+    }
+    for (Task& task : tasks) {
+        g_strfreev(task.env);
+        if (!task.marker.empty()) {
+            unlink(task.marker.c_str());
+        }
+    }
+    tasks.clear();
+
+    // Sessions kept by the PTY helper may reconnect later, so they keep the agent
+    if (agent_pid > 0 && !Config::get_pty_helper()) {
+        kill(agent_pid, SIGTERM);
+        unlink(socket_path.c_str());
+    }
+    agent_pid = 0;
+    socket_path.clear();
+}
+
+std::vector<std::string> get_ssh_options(const ConnectionInfo& conn) {
+    if (socket_path.empty() || conn.auth_method != "SSHKey" || conn.ssh_key_path.empty()) {
+        return {};
+    }
+    {
+        std::lock_guard<std::mutex> lock(agent_mutex);
+        if (agent_failed) return {};
+    }
+    load_key(conn);
+    return {"-o", "IdentityAgent=" + socket_path, "-o", "AddKeysToAgent=yes"};
+}
+
+std::vector<std::string> get_wait_prefix(const ConnectionInfo& conn) {
+    if (socket_path.empty() || conn.auth_method != "SSHKey" || conn.ssh_key_path.empty()) {
+        return {};
+    }
+    std::lock_guard<std::mutex> lock(agent_mutex);
+    auto it = keys.find(conn.ssh_key_path);
+    if (it == keys.end() || !it->second.adding) return {};
+    return {"sh", "-c", WAIT_SCRIPT, marker_path(conn.ssh_key_path)};
+}
+
+} // namespace Agent
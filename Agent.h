@@ -0,0 +1,35 @@
+#ifndef AGENT_H
+#define AGENT_H
+
+#include "Connections.h"
+#include <string>
+#include <vector>
+
+// ssh-agent run by ngTerm, so a key's passphrase is needed once instead of in every tab
+namespace Agent {
+
+// Answer the passphrase request of an ssh-add started by ngTerm, when this process is that
+// askpass helper. Called first in main(); true means the process should exit.
+bool answer_askpass(int argc, char* argv[]);
+
+// Reuse or start ngTerm's agent in a background thread and hand its socket to the processes
+// ngTerm starts, unless the desktop already provides an agent. Does nothing when disabled in
+// Preferences.
+void start();
+
+// Stop the background thread, and the agent started by this run unless the PTY helper keeps
+// sessions that may need it
+void shutdown();
+
+// ssh options that make a key connection use ngTerm's agent. The connection's key is added
+// (with its saved passphrase) in the background on first use, and again once its lifetime
+// ran out. Empty for connections that use no key.
+std::vector<std::string> get_ssh_options(const ConnectionInfo& conn);
+
+// Words to put in front of a key connection's command, after get_ssh_options(), so it starts
+// once the key is in the agent. Empty when no ssh-add for the key is pending.
+std::vector<std::string> get_wait_prefix(const ConnectionInfo& conn);
+
+} // namespace Agent
+
+#endif // AGENT_H
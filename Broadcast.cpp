@@ -0,0 +1,153 @@
+#include "Broadcast.h"
+#include "Sessions.h"
+#include <unordered_map>
+#include <vector>
+
+namespace Broadcast {
+
+namespace {
+
+// Broadcast group kept as a dense vector for fast fan-out, with an index map for O(1) removal
+std::vector<VteTerminal*> targets;
+std::unordered_map<VteTerminal*, std::size_t> target_index;
+
+// vte_terminal_feed_child() emits "commit" on the receiving terminal, so guard re-entry
+bool fanning_out = false;
+
+// VTE also commits its own replies to terminal queries (device attributes, cursor position),
+// which only make sense in the tab that asked. Commits count as user input while a key is
+// down, or once after a paste was requested since the text arrives from the clipboard later.
+struct InputWindow {
+    gint64 typing_until = 0;
+    gint64 paste_until = 0;
+};
+
+// Input methods may commit shortly after the key press was handled; key release ends it
+const gint64 TYPING_WINDOW_US = 250 * 1000;
+const gint64 PASTE_WINDOW_US = 2 * G_USEC_PER_SEC;
+
+std::unordered_map<VteTerminal*, InputWindow> input_windows;
+
+void update_tab_label(VteTerminal* terminal) {
+    if (Session* session = SessionRegistry::find_by_terminal(terminal)) {
+        SessionRegistry::refresh_tab_label(*session);
+    }
+}
+
+bool is_user_input(VteTerminal* source) {
+    auto it = input_windows.find(source);
+    if (it == input_windows.end()) return false;
+    gint64 now = g_get_monotonic_time();
+    if (now < it->second.typing_until) return true;
+    if (now < it->second.paste_until) {
+        it->second.paste_until = 0;
+        return true;
+    }
+    return false;
+}
+
+gboolean on_key_press(GtkWidget* widget, GdkEventKey* /* event */, gpointer /* user_data */) {
+    input_windows[VTE_TERMINAL(widget)].typing_until = g_get_monotonic_time() + TYPING_WINDOW_US;
+    return FALSE;
+}
+
+gboolean on_key_release(GtkWidget* widget, GdkEventKey* /* event */, gpointer /* user_data */) {
+    input_windows[VTE_TERMINAL(widget)].typing_until = 0;
+    return FALSE;
+}
+
+void expect_paste(VteTerminal* terminal) {
+    input_windows[terminal].paste_until = g_get_monotonic_time() + PASTE_WINDOW_US;
+}
+
+// Shift+Insert and the "paste-clipboard" action
+void on_paste_clipboard(VteTerminal* terminal, gpointer /* user_data */) {
+    expect_paste(terminal);
+}
+
+// Middle click pastes the primary selection
+gboolean on_button_press(GtkWidget* widget, GdkEventButton* event, gpointer /* user_data */) {
+    if (event->type == GDK_BUTTON_PRESS && event->button == 2) {
+        expect_paste(VTE_TERMINAL(widget));
+    }
+    return FALSE;
+}
+
+// Forward input typed or pasted into a group member to every other member
+void on_commit(VteTerminal* source, gchar* text, guint size, gpointer /* user_data */) {
+    if (fanning_out || size == 0 || !is_target(source) || !is_user_input(source)) return;
+
+    fanning_out = true;
+    for (VteTerminal* target : targets) {
+        if (target != source) {
+            vte_terminal_feed_child(target, text, size);
+        }
+    }
+    fanning_out = false;
+}
+
+void on_terminal_destroy(GtkWidget* widget, gpointer /* user_data */) {
+    remove_target(VTE_TERMINAL(widget));
+    input_windows.erase(VTE_TERMINAL(widget));
+}
+
+} // namespace
+
+void attach_terminal(VteTerminal* terminal) {
+    if (!terminal) return;
+    g_signal_connect(terminal, "commit", G_CALLBACK(on_commit), nullptr);
+    g_signal_connect(terminal, "key-press-event", G_CALLBACK(on_key_press), nullptr);
+    g_signal_connect(terminal, "key-release-event", G_CALLBACK(on_key_release), nullptr);
+    g_signal_connect(terminal, "paste-clipboard", G_CALLBACK(on_paste_clipboard), nullptr);
+    g_signal_connect(terminal, "button-press-event", G_CALLBACK(on_button_press), nullptr);
+    g_signal_connect(terminal, "destroy", G_CALLBACK(on_terminal_destroy), nullptr);
+}
+
+void add_target(VteTerminal* terminal) {
+    if (!terminal || is_target(terminal)) return;
+    target_index[terminal] = targets.size();
+    targets.push_back(terminal);
+    update_tab_label(terminal);
+}
+
+void remove_target(VteTerminal* terminal) {
+    auto it = target_index.find(terminal);
+    if (it == target_index.end()) return;
+
+    // Swap the last element into the vacated slot to keep removal O(1)
+    std::size_t slot = it->second;
+    VteTerminal* last = targets.back();
+    targets[slot] = last;
+    target_index[last] = slot;
+    targets.pop_back();
+    target_index.erase(terminal);
+
+    update_tab_label(terminal);
+}
+
+void toggle_target(VteTerminal* terminal) {
+    if (is_target(terminal)) {
+        remove_target(terminal);
+    } else {
+        add_target(terminal);
+    }
+}
+
+bool is_target(VteTerminal* terminal) {
+    return target_index.count(terminal) != 0;
+}
+
+std::size_t target_count() {
+    return targets.size();
+}
+
+void clear() {
+    std::vector<VteTerminal*> previous;
+    previous.swap(targets);
+    target_index.clear();
+    for (VteTerminal* terminal : previous) {
+        update_tab_label(terminal);
+    }
+}
+
+} // namespace Broadcast
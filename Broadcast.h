@@ -0,0 +1,26 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <vte/vte.h>
+#include <cstddef>
+
+namespace Broadcast {
+
+// Register a terminal so its typed and pasted input can be fanned out while it is in the group
+void attach_terminal(VteTerminal* terminal);
+
+// Add or remove a terminal from the broadcast group (O(1))
+void add_target(VteTerminal* terminal);
+void remove_target(VteTerminal* terminal);
+void toggle_target(VteTerminal* terminal);
+
+// Query the broadcast group
+bool is_target(VteTerminal* terminal);
+std::size_t target_count();
+
+// Remove every terminal from the broadcast group
+void clear();
+
+} // namespace Broadcast
+
+#endif // BROADCAST_H
@@ -1,4 +1,5 @@
 #include "Config.h"
+#include "Tools.h"
 
 // Initialize static member
 json Config::config;
@@ -25,6 +26,54 @@ bool Config::get_save_window_coords() {
     return config.value("save_window_coords", true);
 }
 
+bool Config::get_restore_sessions() {
+    return config.value("restore_sessions", true);
+}
+
+int Config::get_restore_concurrency() {
+    return config.value("restore_concurrency", 2);
+}
+
+int Config::get_scrollback_lines() {
+    return config.value("scrollback_lines", 10000);
+}
+
+long Config::get_scrollback_budget_lines() {
+    return config.value("scrollback_budget_lines", 200000L);
+}
+
+long Config::get_scrollback_idle_lines() {
+    return config.value("scrollback_idle_lines", 1000L);
+}
+
+int Config::get_reconnect_max_attempts() {
+    return config.value("reconnect_max_attempts", 10);
+}
+
+bool Config::get_record_sessions() {
+    return config.value("record_sessions", false);
+}
+
+std::string Config::get_recording_dir() {
+    return config.value("recording_dir", "");
+}
+
+int Config::get_silence_seconds() {
+    return config.value("silence_seconds", 30);
+}
+
+bool Config::get_pty_helper() {
+    return config.value("pty_helper", false);
+}
+
+bool Config::get_ssh_agent() {
+    return config.value("ssh_agent", true);
+}
+
+int Config::get_ssh_agent_key_lifetime() {
+    return config.value("ssh_agent_key_lifetime", 0);
+}
+
 void Config::ensure_config_dir() {
     auto config_path = get_config_path();
     if (!std::filesystem::exists(config_path.parent_path())) {
@@ -49,7 +98,19 @@ void Config::load_config() {
         {"window_height", 768},
         {"always_new_connection", false},
         {"save_window_coords", true},
-        {"left_frame_width", 250}
+        {"left_frame_width", 250},
+        {"restore_sessions", true},
+        {"restore_concurrency", 2},
+        {"scrollback_lines", 10000},
+        {"scrollback_budget_lines", 200000},
+        {"scrollback_idle_lines", 1000},
+        {"reconnect_max_attempts", 10},
+        {"record_sessions", false},
+        {"recording_dir", ""},
+        {"silence_seconds", 30},
+        {"pty_helper", false},
+        {"ssh_agent", true},
+        {"ssh_agent_key_lifetime", 0}
     };
 
     // Load existing configuration if it exists
@@ -146,6 +207,180 @@ bool Config::show_preferences_dialog(Gtk::Window& parent_window) {
     window_frame.add(window_box);
     content_area->pack_start(window_frame, Gtk::PACK_SHRINK);
 
+    // Session Restore
+    Gtk::Frame restore_frame;
+    restore_frame.set_label("Session Restore");
+    Gtk::Box restore_box(Gtk::ORIENTATION_VERTICAL, 6);
+    restore_box.set_margin_start(12);
+    restore_box.set_margin_end(12);
+    restore_box.set_margin_top(6);
+    restore_box.set_margin_bottom(6);
+
+    Gtk::CheckButton restore_check("Reopen previous tabs on startup");
+    restore_check.set_active(get_restore_sessions());
+
+    Gtk::Box concurrency_box(Gtk::ORIENTATION_HORIZONTAL, 6);
+    Gtk::Label concurrency_label("Connect in background, at most:");
+    Gtk::SpinButton concurrency_spin;
+    concurrency_spin.set_range(0, 16);
+    concurrency_spin.set_increments(1, 4);
+    concurrency_spin.set_value(get_restore_concurrency());
+    concurrency_spin.set_tooltip_text("Number of restored tabs connecting at once. 0 connects a tab only when it is selected.");
+    concurrency_box.pack_start(concurrency_label, Gtk::PACK_SHRINK);
+    concurrency_box.pack_start(concurrency_spin, Gtk::PACK_SHRINK);
+
+    Gtk::CheckButton pty_helper_check("Keep sessions running when ngTerm exits or crashes");
+    pty_helper_check.set_active(get_pty_helper());
+    pty_helper_check.set_tooltip_text("Terminal sessions of saved connections run in a background helper (ngterm-ptyd). "
+                                      "On the next start their tabs come back with their recent output. "
+                                      "Applies to sessions started after the change.");
+
+    restore_box.pack_start(restore_check, Gtk::PACK_SHRINK);
+    restore_box.pack_start(concurrency_box, Gtk::PACK_SHRINK);
+    restore_box.pack_start(pty_helper_check, Gtk::PACK_SHRINK);
+    restore_frame.add(restore_box);
+    content_area->pack_start(restore_frame, Gtk::PACK_SHRINK);
+
+    // SSH agent
+    Gtk::Frame agent_frame;
+    agent_frame.set_label("SSH Keys");
+    Gtk::Box agent_box(Gtk::ORIENTATION_VERTICAL, 6);
+    agent_box.set_margin_start(12);
+    agent_box.set_margin_end(12);
+    agent_box.set_margin_top(6);
+    agent_box.set_margin_bottom(6);
+
+    Gtk::CheckButton agent_check("Unlock connection keys once in ngTerm's ssh-agent");
+    agent_check.set_active(get_ssh_agent());
+    agent_check.set_tooltip_text("Keys of SSH connections are added to an agent with their saved passphrase, "
+                                 "so new tabs do not decrypt or ask again. Applies after restarting ngTerm.");
+
+    Gtk::Box lifetime_box(Gtk::ORIENTATION_HORIZONTAL, 6);
+    Gtk::Label lifetime_label("Forget keys after (minutes):");
+    Gtk::SpinButton lifetime_spin;
+    lifetime_spin.set_range(0, 10080);
+    lifetime_spin.set_increments(15, 60);
+    lifetime_spin.set_value(get_ssh_agent_key_lifetime());
+    lifetime_spin.set_tooltip_text("0 keeps keys until the agent stops");
+    lifetime_box.pack_start(lifetime_label, Gtk::PACK_SHRINK);
+    lifetime_box.pack_start(lifetime_spin, Gtk::PACK_SHRINK);
+
+    agent_box.pack_start(agent_check, Gtk::PACK_SHRINK);
+    agent_box.pack_start(lifetime_box, Gtk::PACK_SHRINK);
+    agent_frame.add(agent_box);
+    content_area->pack_start(agent_frame, Gtk::PACK_SHRINK);
+
+    // Scrollback
+    Gtk::Frame scrollback_frame;
+    scrollback_frame.set_label("Scrollback");
+    Gtk::Grid scrollback_grid;
+    scrollback_grid.set_row_spacing(6);
+    scrollback_grid.set_column_spacing(6);
+    scrollback_grid.set_margin_start(12);
+    scrollback_grid.set_margin_end(12);
+    scrollback_grid.set_margin_top(6);
+    scrollback_grid.set_margin_bottom(6);
+
+    Gtk::Label scrollback_lines_label("Lines per terminal:", Gtk::ALIGN_START);
+    Gtk::SpinButton scrollback_lines_spin;
+    scrollback_lines_spin.set_range(100, 1000000);
+    scrollback_lines_spin.set_increments(1000, 10000);
+    scrollback_lines_spin.set_value(get_scrollback_lines());
+
+    Gtk::Label scrollback_budget_label("Total lines for all terminals:", Gtk::ALIGN_START);
+    Gtk::SpinButton scrollback_budget_spin;
+    scrollback_budget_spin.set_range(1000, 100000000);
+    scrollback_budget_spin.set_increments(10000, 100000);
+    scrollback_budget_spin.set_value(get_scrollback_budget_lines());
+    scrollback_budget_spin.set_tooltip_text("Recently used tabs keep their full scrollback. "
+                                            "Other tabs are trimmed once the total is exceeded; "
+                                            "the trimmed lines are saved compressed on disk.");
+
+    scrollback_grid.attach(scrollback_lines_label, 0, 0, 1, 1);
+    scrollback_grid.attach(scrollback_lines_spin, 1, 0, 1, 1);
+    scrollback_grid.attach(scrollback_budget_label, 0, 1, 1, 1);
+    scrollback_grid.attach(scrollback_budget_spin, 1, 1, 1, 1);
+    scrollback_frame.add(scrollback_grid);
+    content_area->pack_start(scrollback_frame, Gtk::PACK_SHRINK);
+
+    // Recording
+    Gtk::Frame recording_frame;
+    recording_frame.set_label("Session Recording");
+    Gtk::Grid recording_grid;
+    recording_grid.set_row_spacing(6);
+    recording_grid.set_column_spacing(6);
+    recording_grid.set_margin_start(12);
+    recording_grid.set_margin_end(12);
+    recording_grid.set_margin_top(6);
+    recording_grid.set_margin_bottom(6);
+
+    Gtk::CheckButton record_check("Record all terminal sessions");
+    record_check.set_active(get_record_sessions());
+    record_check.set_tooltip_text("Sessions can also be recorded per connection or from the Session menu");
+
+    Gtk::Label recording_dir_label("Recordings folder:", Gtk::ALIGN_START);
+    Gtk::FileChooserButton recording_dir_button("Select Recordings Folder", Gtk::FILE_CHOOSER_ACTION_SELECT_FOLDER);
+    recording_dir_button.set_hexpand(true);
+    if (!get_recording_dir().empty()) {
+        recording_dir_button.set_filename(get_recording_dir());
+    }
+    recording_dir_button.set_tooltip_text("Defaults to ~/.local/share/ngTerm/recordings");
+
+    recording_grid.attach(record_check, 0, 0, 2, 1);
+    recording_grid.attach(recording_dir_label, 0, 1, 1, 1);
+    recording_grid.attach(recording_dir_button, 1, 1, 1, 1);
+    recording_frame.add(recording_grid);
+    content_area->pack_start(recording_frame, Gtk::PACK_SHRINK);
+
+    // Tab monitoring
+    Gtk::Frame monitor_frame;
+    monitor_frame.set_label("Tab Monitoring");
+    Gtk::Box monitor_box(Gtk::ORIENTATION_HORIZONTAL, 6);
+    monitor_box.set_margin_start(12);
+    monitor_box.set_margin_end(12);
+    monitor_box.set_margin_top(6);
+    monitor_box.set_margin_bottom(6);
+
+    Gtk::Label silence_label("Silence after (seconds):", Gtk::ALIGN_START);
+    Gtk::SpinButton silence_spin;
+    silence_spin.set_range(1, 86400);
+    silence_spin.set_increments(5, 60);
+    silence_spin.set_value(get_silence_seconds());
+    silence_spin.set_tooltip_text("Tabs monitored for silence are marked when they print nothing for this long");
+
+    monitor_box.pack_start(silence_label, Gtk::PACK_SHRINK);
+    monitor_box.pack_start(silence_spin, Gtk::PACK_SHRINK);
+    monitor_frame.add(monitor_box);
+    content_area->pack_start(monitor_frame, Gtk::PACK_SHRINK);
+
+    // External tools found at startup
+    Gtk::Frame tools_frame;
+    tools_frame.set_label("External Tools");
+    Gtk::Grid tools_grid;
+    tools_grid.set_row_spacing(6);
+    tools_grid.set_column_spacing(12);
+    tools_grid.set_margin_start(12);
+    tools_grid.set_margin_end(12);
+    tools_grid.set_margin_top(6);
+    tools_grid.set_margin_bottom(6);
+
+    int tool_row = 0;
+    for (const auto& tool : Tools::get_all()) {
+        Gtk::Label* name_label = Gtk::manage(new Gtk::Label(tool.name, Gtk::ALIGN_START));
+        Gtk::Label* state_label = Gtk::manage(new Gtk::Label("", Gtk::ALIGN_START));
+        if (tool.path.empty()) {
+            state_label->set_markup("<b>Not found</b> - needed for " + Glib::Markup::escape_text(tool.purpose));
+        } else {
+            state_label->set_text(tool.version.empty() ? tool.path : tool.path + " (" + tool.version + ")");
+        }
+        state_label->set_selectable(true);
+        tools_grid.attach(*name_label, 0, tool_row, 1, 1);
+        tools_grid.attach(*state_label, 1, tool_row, 1, 1);
+        tool_row++;
+    }
+    tools_frame.add(tools_grid);
+    content_area->pack_start(tools_frame, Gtk::PACK_SHRINK);
+
     dialog.show_all();
     int result = dialog.run();
 
@@ -164,6 +399,57 @@ bool Config::show_preferences_dialog(Gtk::Window& parent_window) {
             config_changed = true;
         }
 
+        if (new_config.value("restore_sessions", true) != restore_check.get_active()) {
+            new_config["restore_sessions"] = restore_check.get_active();
+            config_changed = true;
+        }
+
+        if (new_config.value("restore_concurrency", 2) != concurrency_spin.get_value_as_int()) {
+            new_config["restore_concurrency"] = concurrency_spin.get_value_as_int();
+            config_changed = true;
+        }
+
+        if (new_config.value("pty_helper", false) != pty_helper_check.get_active()) {
+            new_config["pty_helper"] = pty_helper_check.get_active();
+            config_changed = true;
+        }
+
+        if (new_config.value("ssh_agent", true) != agent_check.get_active()) {
+            new_config["ssh_agent"] = agent_check.get_active();
+            config_changed = true;
+        }
+
+        if (new_config.value("ssh_agent_key_lifetime", 0) != lifetime_spin.get_value_as_int()) {
+            new_config["ssh_agent_key_lifetime"] = lifetime_spin.get_value_as_int();
+            config_changed = true;
+        }
+
+        if (new_config.value("scrollback_lines", 10000) != scrollback_lines_spin.get_value_as_int()) {
+            new_config["scrollback_lines"] = scrollback_lines_spin.get_value_as_int();
+            config_changed = true;
+        }
+
+        if (new_config.value("scrollback_budget_lines", 200000L) != static_cast<long>(scrollback_budget_spin.get_value())) {
+            new_config["scrollback_budget_lines"] = static_cast<long>(scrollback_budget_spin.get_value());
+            config_changed = true;
+        }
+
+        if (new_config.value("silence_seconds", 30) != silence_spin.get_value_as_int()) {
+            new_config["silence_seconds"] = silence_spin.get_value_as_int();
+            config_changed = true;
+        }
+
+        if (new_config.value("record_sessions", false) != record_check.get_active()) {
+            new_config["record_sessions"] = record_check.get_active();
+            config_changed = true;
+        }
+
+        std::string recording_dir = recording_dir_button.get_filename();
+        if (!recording_dir.empty() && new_config.value("recording_dir", "") != recording_dir) {
+            new_config["recording_dir"] = recording_dir;
+            config_changed = true;
+        }
+
         // If save_window_coords is disabled, remove window coordinates
         if (!save_coords_check.get_active()) {
             if (new_config.contains("window_width") || new_config.contains("window_height")) {
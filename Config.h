@@ -26,6 +26,18 @@ public:
     // Configuration getters with default values
     static bool get_always_new_connection();
     static bool get_save_window_coords();
+    static bool get_restore_sessions();
+    static int get_restore_concurrency();
+    static int get_scrollback_lines();
+    static long get_scrollback_budget_lines();
+    static long get_scrollback_idle_lines();
+    static int get_reconnect_max_attempts();
+    static bool get_record_sessions();
+    static std::string get_recording_dir();
+    static int get_silence_seconds();
+    static bool get_pty_helper();
+    static bool get_ssh_agent();
+    static int get_ssh_agent_key_lifetime();
 
     // Function to show and handle the preferences dialog
     // Returns true if configuration was changed, false otherwise
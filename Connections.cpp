@@ -4,6 +4,8 @@
 #include <iostream>
 #include <uuid/uuid.h>
 #include <algorithm>
+#include <map>
+#include <set>
 #include <nlohmann/json.hpp>
 
 std::filesystem::path ConnectionManager::get_connections_dir() {
@@ -47,106 +49,205 @@ Glib::ustring ConnectionManager::generate_folder_id() {
     return Glib::ustring(uuid_str);
 }
 
-bool ConnectionManager::save_connection(const ConnectionInfo& connection) {
-    std::vector<ConnectionInfo> connections = load_connections();
+json ConnectionManager::connection_to_json(const ConnectionInfo& connection) {
+    json json_conn;
+    json_conn["id"] = connection.id.raw();
+    json_conn["name"] = connection.name.raw();
+    json_conn["host"] = connection.host.raw();
+    json_conn["port"] = connection.port;
+    json_conn["username"] = connection.username.raw();
+    json_conn["connection_type"] = connection.connection_type.raw();
+    json_conn["folder_id"] = connection.folder_id.raw();
+    if (connection.connection_type == "SSH" || connection.connection_type == "Mosh") {
+        json_conn["auth_method"] = connection.auth_method.raw();
+        if (connection.auth_method == "Password") {
+            json_conn["password"] = connection.password.raw();
+            json_conn["ssh_key_path"] = "";
+            json_conn["ssh_key_passphrase"] = "";
+        } else if (connection.auth_method == "SSHKey") {
+            json_conn["password"] = "";
+            json_conn["ssh_key_path"] = connection.ssh_key_path.raw();
+            json_conn["ssh_key_passphrase"] = connection.ssh_key_passphrase.raw();
+        }
+        json_conn["additional_ssh_options"] = connection.additional_ssh_options.raw();
+        if (!connection.jump_host_id.empty()) {
+            json_conn["jump_host_id"] = connection.jump_host_id.raw();
+        }
+        if (!connection.network_profile.empty()) {
+            json_conn["network_profile"] = connection.network_profile.raw();
+        }
+    }
+    if (connection.connection_type == "SSH" && !connection.tmux_session.empty()) {
+        json_conn["tmux_session"] = connection.tmux_session.raw();
+    }
+    if (connection.connection_type == "SSH" && !connection.tunnels.empty()) {
+        json tunnels = json::array();
+        for (const auto& tunnel : connection.tunnels) {
+            json j_tunnel = {
+                {"type", tunnel.type.raw()},
+                {"bind_address", tunnel.bind_address.raw()},
+                {"listen_port", tunnel.listen_port},
+                {"auto_start", tunnel.auto_start}
+            };
+            if (tunnel.type == "Local") {
+                j_tunnel["target_host"] = tunnel.target_host.raw();
+                j_tunnel["target_port"] = tunnel.target_port;
+            }
+            tunnels.push_back(j_tunnel);
+        }
+        json_conn["tunnels"] = tunnels;
+    }
+    if (connection.connection_type == "Mosh") {
+        if (!connection.mosh_port.empty()) {
+            json_conn["mosh_port"] = connection.mosh_port.raw();
+        }
+        if (!connection.mosh_server.empty()) {
+            json_conn["mosh_server"] = connection.mosh_server.raw();
+        }
+    }
+    if (connection.connection_type == "RDP") {
+        json_conn["domain"] = connection.domain.raw();
+        json_conn["password"] = connection.password.raw();
+    }
+    if (connection.scrollback_lines > 0) {
+        json_conn["scrollback_lines"] = connection.scrollback_lines;
+    }
+    if (!connection.reconnect_policy.empty()) {
+        json_conn["reconnect_policy"] = connection.reconnect_policy.raw();
+    }
+    if (connection.record_session) {
+        json_conn["record_session"] = true;
+    }
+    if (connection.local_echo) {
+        json_conn["local_echo"] = true;
+    }
+    return json_conn;
+}
+
+ConnectionInfo ConnectionManager::connection_from_json(const json& j_conn) {
+    ConnectionInfo conn;
+    conn.id = Glib::ustring(j_conn.value("id", ""));
+    conn.name = Glib::ustring(j_conn.value("name", ""));
+    conn.host = Glib::ustring(j_conn.value("host", ""));
+    conn.port = j_conn.value("port", 0);
+    conn.username = Glib::ustring(j_conn.value("username", ""));
+    conn.connection_type = Glib::ustring(j_conn.value("connection_type", ""));
+    conn.folder_id = Glib::ustring(j_conn.value("folder_id", ""));
+    if (conn.connection_type == "SSH" || conn.connection_type == "Mosh") {
+        conn.auth_method = Glib::ustring(j_conn.value("auth_method", ""));
+        conn.password = Glib::ustring(j_conn.value("password", ""));
+        conn.ssh_key_path = Glib::ustring(j_conn.value("ssh_key_path", ""));
+        conn.ssh_key_passphrase = Glib::ustring(j_conn.value("ssh_key_passphrase", ""));
+        conn.additional_ssh_options = Glib::ustring(j_conn.value("additional_ssh_options", ""));
+        conn.jump_host_id = Glib::ustring(j_conn.value("jump_host_id", ""));
+        conn.network_profile = Glib::ustring(j_conn.value("network_profile", ""));
+    }
+    if (conn.connection_type == "SSH") {
+        conn.tmux_session = Glib::ustring(j_conn.value("tmux_session", ""));
+        if (j_conn.contains("tunnels") && j_conn["tunnels"].is_array()) {
+            for (const auto& j_tunnel : j_conn["tunnels"]) {
+                if (!j_tunnel.is_object()) continue;
+                TunnelInfo tunnel;
+                tunnel.type = Glib::ustring(j_tunnel.value("type", "Local"));
+                tunnel.bind_address = Glib::ustring(j_tunnel.value("bind_address", "127.0.0.1"));
+                tunnel.listen_port = j_tunnel.value("listen_port", 0);
+                tunnel.target_host = Glib::ustring(j_tunnel.value("target_host", ""));
+                tunnel.target_port = j_tunnel.value("target_port", 0);
+                tunnel.auto_start = j_tunnel.value("auto_start", false);
+                conn.tunnels.push_back(tunnel);
+            }
+        }
+    }
+    if (conn.connection_type == "Mosh") {
+        conn.mosh_port = Glib::ustring(j_conn.value("mosh_port", ""));
+        conn.mosh_server = Glib::ustring(j_conn.value("mosh_server", ""));
+    }
+    if (conn.connection_type == "RDP") {
+        conn.domain = Glib::ustring(j_conn.value("domain", ""));
+        conn.password = Glib::ustring(j_conn.value("password", ""));
+    }
+    conn.scrollback_lines = j_conn.value("scrollback_lines", 0);
+    conn.reconnect_policy = Glib::ustring(j_conn.value("reconnect_policy", ""));
+    conn.record_session = j_conn.value("record_session", false);
+    conn.local_echo = j_conn.value("local_echo", false);
+    return conn;
+}
+
+bool ConnectionManager::write_connections(const std::vector<ConnectionInfo>& connections) {
     std::filesystem::path file_path = get_connections_file();
     std::filesystem::create_directories(file_path.parent_path());
 
     json json_array = json::array();
-    bool found = false;
     for (const auto& conn : connections) {
-        json json_conn;
-        if (conn.id == connection.id) {
-            // Update existing connection
-            json_conn["id"] = connection.id.raw();
-            json_conn["name"] = connection.name.raw();
-            json_conn["host"] = connection.host.raw();
-            json_conn["port"] = connection.port;
-            json_conn["username"] = connection.username.raw();
-            json_conn["connection_type"] = connection.connection_type.raw();
-            json_conn["folder_id"] = connection.folder_id.raw();
-            if (connection.connection_type == "SSH") {
-                json_conn["auth_method"] = connection.auth_method.raw();
-                if (connection.auth_method == "Password") {
-                    json_conn["password"] = connection.password.raw();
-                    json_conn["ssh_key_path"] = "";
-                    json_conn["ssh_key_passphrase"] = "";
-                } else if (connection.auth_method == "SSHKey") {
-                    json_conn["password"] = "";
-                    json_conn["ssh_key_path"] = connection.ssh_key_path.raw();
-                    json_conn["ssh_key_passphrase"] = connection.ssh_key_passphrase.raw();
-                }
-                json_conn["additional_ssh_options"] = connection.additional_ssh_options.raw();
-            }
-            if (connection.connection_type == "RDP") {
-                json_conn["domain"] = connection.domain.raw();
-                json_conn["password"] = connection.password.raw();
-            }
-            json_array.push_back(json_conn);
-            found = true;
-        } else {
-            // Add other connections back
-            json_conn["id"] = conn.id.raw();
-            json_conn["name"] = conn.name.raw();
-            json_conn["host"] = conn.host.raw();
-            json_conn["port"] = conn.port;
-            json_conn["username"] = conn.username.raw();
-            json_conn["connection_type"] = conn.connection_type.raw();
-            json_conn["folder_id"] = conn.folder_id.raw();
-            if (conn.connection_type == "SSH") {
-                json_conn["auth_method"] = conn.auth_method.raw();
-                if (conn.auth_method == "Password") {
-                    json_conn["password"] = conn.password.raw();
-                    json_conn["ssh_key_path"] = "";
-                    json_conn["ssh_key_passphrase"] = "";
-                } else if (conn.auth_method == "SSHKey") {
-                    json_conn["password"] = "";
-                    json_conn["ssh_key_path"] = conn.ssh_key_path.raw();
-                    json_conn["ssh_key_passphrase"] = conn.ssh_key_passphrase.raw();
-                }
-                json_conn["additional_ssh_options"] = conn.additional_ssh_options.raw();
-            }
-            if (conn.connection_type == "RDP") {
-                json_conn["domain"] = conn.domain.raw();
-                json_conn["password"] = conn.password.raw();
-            }
-            json_array.push_back(json_conn);
-        }
+        json_array.push_back(connection_to_json(conn));
+    }
+
+    std::ofstream file(file_path);
+    if (file.is_open()) {
+        file << json_array.dump(4);
+        file.close();
+        return true;
     }
+    return false;
+}
+
+bool ConnectionManager::save_connection(const ConnectionInfo& connection) {
+    std::vector<ConnectionInfo> connections = load_connections();
 
-    if (!found) {
+    auto it = std::find_if(connections.begin(), connections.end(),
+        [&connection](const ConnectionInfo& conn) { return conn.id == connection.id; });
+    if (it != connections.end()) {
+        // Update existing connection
+        *it = connection;
+    } else {
         // Add new connection
-        json json_conn;
-        json_conn["id"] = connection.id.raw();
-        json_conn["name"] = connection.name.raw();
-        json_conn["host"] = connection.host.raw();
-        json_conn["port"] = connection.port;
-        json_conn["username"] = connection.username.raw();
-        json_conn["connection_type"] = connection.connection_type.raw();
-        json_conn["folder_id"] = connection.folder_id.raw();
-        if (connection.connection_type == "SSH") {
-            json_conn["auth_method"] = connection.auth_method.raw();
-            if (connection.auth_method == "Password") {
-                json_conn["password"] = connection.password.raw();
-                json_conn["ssh_key_path"] = "";
-                json_conn["ssh_key_passphrase"] = "";
-            } else if (connection.auth_method == "SSHKey") {
-                json_conn["password"] = "";
-                json_conn["ssh_key_path"] = connection.ssh_key_path.raw();
-                json_conn["ssh_key_passphrase"] = connection.ssh_key_passphrase.raw();
-            }
-            json_conn["additional_ssh_options"] = connection.additional_ssh_options.raw();
-        }
-        if (connection.connection_type == "RDP") {
-            json_conn["domain"] = connection.domain.raw();
-            json_conn["password"] = connection.password.raw();
-        }
-        json_array.push_back(json_conn);
+        connections.push_back(connection);
+    }
+
+    return write_connections(connections);
+}
+
+json ConnectionManager::folder_to_json(const FolderInfo& folder) {
+    json j_folder = {
+        {"id", folder.id.raw()},
+        {"name", folder.name.raw()},
+        {"parent_id", folder.parent_id.raw()}
+    };
+    if (!folder.reconnect_policy.empty()) {
+        j_folder["reconnect_policy"] = folder.reconnect_policy.raw();
+    }
+    if (!folder.jump_host_id.empty()) {
+        j_folder["jump_host_id"] = folder.jump_host_id.raw();
+    }
+    if (!folder.network_profile.empty()) {
+        j_folder["network_profile"] = folder.network_profile.raw();
+    }
+    return j_folder;
+}
+
+FolderInfo ConnectionManager::folder_from_json(const json& j_folder) {
+    FolderInfo folder;
+    folder.id = Glib::ustring(j_folder.value("id", ""));
+    folder.name = Glib::ustring(j_folder.value("name", ""));
+    folder.parent_id = Glib::ustring(j_folder.value("parent_id", ""));
+    folder.reconnect_policy = Glib::ustring(j_folder.value("reconnect_policy", ""));
+    folder.jump_host_id = Glib::ustring(j_folder.value("jump_host_id", ""));
+    folder.network_profile = Glib::ustring(j_folder.value("network_profile", ""));
+    return folder;
+}
+
+bool ConnectionManager::write_folders(const std::vector<FolderInfo>& folders) {
+    std::filesystem::path file_path = get_folders_file();
+    ConnectionManager::ensure_parent_directory_exists(file_path);
+
+    json j_folders = json::array();
+    for (const auto& f : folders) {
+        j_folders.push_back(folder_to_json(f));
     }
 
     std::ofstream file(file_path);
     if (file.is_open()) {
-        file << json_array.dump(4);
+        file << j_folders.dump(4);
         file.close();
         return true;
     }
@@ -170,24 +271,7 @@ bool ConnectionManager::save_folder(const FolderInfo& folder) {
         }
 
         // Write the updated list back to the file
-        std::filesystem::path file_path = get_folders_file();
-        ConnectionManager::ensure_parent_directory_exists(file_path);
-        json j_folders = json::array();
-        for (const auto& f : folders) {
-            j_folders.push_back({
-                {"id", f.id.raw()},
-                {"name", f.name.raw()},
-                {"parent_id", f.parent_id.raw()}
-            });
-        }
-
-        std::ofstream file(file_path);
-        if (file.is_open()) {
-            file << j_folders.dump(4);
-            file.close();
-            return true;
-        }
-        return false;
+        return write_folders(folders);
     } catch (const std::exception& e) {
         std::cerr << "Error saving folder: " << e.what() << std::endl;
         return false;
@@ -209,25 +293,7 @@ std::vector<ConnectionInfo> ConnectionManager::load_connections() {
             file >> json_array;
             if (json_array.is_array()) {
                 for (const auto& j_conn : json_array) {
-                    ConnectionInfo conn;
-                    conn.id = Glib::ustring(j_conn.value("id", ""));
-                    conn.name = Glib::ustring(j_conn.value("name", ""));
-                    conn.host = Glib::ustring(j_conn.value("host", ""));
-                    conn.port = j_conn.value("port", 0);
-                    conn.username = Glib::ustring(j_conn.value("username", ""));
-                    conn.connection_type = Glib::ustring(j_conn.value("connection_type", ""));
-                    conn.folder_id = Glib::ustring(j_conn.value("folder_id", ""));
-                    if (conn.connection_type == "SSH") {
-                        conn.auth_method = Glib::ustring(j_conn.value("auth_method", ""));
-                        conn.password = Glib::ustring(j_conn.value("password", ""));
-                        conn.ssh_key_path = Glib::ustring(j_conn.value("ssh_key_path", ""));
-                        conn.ssh_key_passphrase = Glib::ustring(j_conn.value("ssh_key_passphrase", ""));
-                        conn.additional_ssh_options = Glib::ustring(j_conn.value("additional_ssh_options", ""));
-                    }
-                    if (conn.connection_type == "RDP") {
-                        conn.domain = Glib::ustring(j_conn.value("domain", ""));
-                        conn.password = Glib::ustring(j_conn.value("password", ""));
-                    }
+                    ConnectionInfo conn = connection_from_json(j_conn);
                     connections.push_back(conn);
                 }
             }
@@ -254,11 +320,7 @@ std::vector<FolderInfo> ConnectionManager::load_folders() {
         file >> j_folders;
 
         for (const auto& j_folder : j_folders) {
-            FolderInfo folder;
-            folder.id = Glib::ustring(j_folder.value("id", ""));
-            folder.name = Glib::ustring(j_folder.value("name", ""));
-            folder.parent_id = Glib::ustring(j_folder.value("parent_id", ""));
-            folders.push_back(folder);
+            folders.push_back(folder_from_json(j_folder));
         }
     } catch (const json::parse_error& e) {
         std::cerr << "Error parsing folders.json: " << e.what() << std::endl;
@@ -278,32 +340,7 @@ bool ConnectionManager::delete_connection(const Glib::ustring& connection_id) {
             connections.end());
 
         // Save the modified list back to the file
-        std::filesystem::path file_path = get_connections_file();
-        json j_connections = json::array();
-        for (const auto& conn : connections) {
-            json json_conn;
-            json_conn["id"] = conn.id.raw();
-            json_conn["name"] = conn.name.raw();
-            json_conn["host"] = conn.host.raw();
-            json_conn["port"] = conn.port;
-            json_conn["username"] = conn.username.raw();
-            json_conn["connection_type"] = conn.connection_type.raw();
-            json_conn["folder_id"] = conn.folder_id.raw();
-
-            if (conn.connection_type == "SSH") {
-                json_conn["auth_method"] = conn.auth_method.raw();
-                json_conn["password"] = conn.password.raw();
-                json_conn["ssh_key_path"] = conn.ssh_key_path.raw();
-                json_conn["ssh_key_passphrase"] = conn.ssh_key_passphrase.raw();
-                json_conn["additional_ssh_options"] = conn.additional_ssh_options.raw();
-            }
-            j_connections.push_back(json_conn);
-        }
-
-        std::ofstream file(file_path);
-        if (file.is_open()) {
-            file << j_connections.dump(4);
-            file.close();
+        if (write_connections(connections)) {
             return true;
         }
         return false; // Failed to save after deletion
@@ -355,46 +392,10 @@ bool ConnectionManager::delete_folder(const Glib::ustring& folder_id) {
 
         if (all_folders.size() < initial_folders_size) { // Check if any folder was actually removed
             // Save the modified folders list
-            std::filesystem::path folders_file_path = get_folders_file();
-            json folders_json_array = json::array();
-            for (const auto& folder : all_folders) {
-                folders_json_array.push_back({
-                    {"id", folder.id.raw()},
-                    {"name", folder.name.raw()},
-                    {"parent_id", folder.parent_id.raw()}
-                });
-            }
-            std::ofstream folders_file(folders_file_path);
-            if (!folders_file.is_open()) return false; // Failed to open folders file
-            folders_file << folders_json_array.dump(4);
-            folders_file.close();
+            if (!write_folders(all_folders)) return false; // Failed to open folders file
 
             // Save the modified connections list (as connections might have been deleted)
-            std::filesystem::path connections_file_path = get_connections_file();
-            json connections_json_array = json::array();
-            for (const auto& conn : all_connections) {
-                json json_conn;
-                json_conn["id"] = conn.id.raw();
-                json_conn["name"] = conn.name.raw();
-                json_conn["host"] = conn.host.raw();
-                json_conn["port"] = conn.port;
-                json_conn["username"] = conn.username.raw();
-                json_conn["connection_type"] = conn.connection_type.raw();
-                json_conn["folder_id"] = conn.folder_id.raw();
-
-                if (conn.connection_type == "SSH") {
-                    json_conn["auth_method"] = conn.auth_method.raw();
-                    json_conn["password"] = conn.password.raw();
-                    json_conn["ssh_key_path"] = conn.ssh_key_path.raw();
-                    json_conn["ssh_key_passphrase"] = conn.ssh_key_passphrase.raw();
-                    json_conn["additional_ssh_options"] = conn.additional_ssh_options.raw();
-                }
-                connections_json_array.push_back(json_conn);
-            }
-            std::ofstream connections_file(connections_file_path);
-            if (!connections_file.is_open()) return false; // Failed to open connections file
-            connections_file << connections_json_array.dump(4);
-            connections_file.close();
+            if (!write_connections(all_connections)) return false; // Failed to open connections file
 
             return true;
         }
@@ -416,6 +417,72 @@ ConnectionInfo ConnectionManager::get_connection_by_id(const Glib::ustring& conn
     return ConnectionInfo(); // Return an empty/default ConnectionInfo if not found
 }
 
+// Get a folder by its ID
+FolderInfo ConnectionManager::get_folder_by_id(const Glib::ustring& folder_id) {
+    std::vector<FolderInfo> folders = load_folders();
+    auto it = std::find_if(folders.begin(), folders.end(),
+        [&folder_id](const FolderInfo& f) { return f.id == folder_id; });
+    return (it != folders.end()) ? *it : FolderInfo();
+}
+
+Glib::ustring ConnectionManager::resolve_folder_setting(const Glib::ustring& folder_id,
+                                                       const std::function<Glib::ustring(const FolderInfo&)>& getter) {
+    std::vector<FolderInfo> folders = load_folders();
+    std::map<Glib::ustring, const FolderInfo*> folders_by_id;
+    for (const auto& folder : folders) {
+        folders_by_id[folder.id] = &folder;
+    }
+
+    // Bound the walk by the folder count so a parent cycle cannot loop forever
+    Glib::ustring current_id = folder_id;
+    for (size_t depth = 0; !current_id.empty() && depth <= folders.size(); ++depth) {
+        auto it = folders_by_id.find(current_id);
+        if (it == folders_by_id.end()) break;
+        Glib::ustring value = getter(*it->second);
+        if (!value.empty()) return value;
+        current_id = it->second->parent_id;
+    }
+    return "";
+}
+
+bool ConnectionManager::get_auto_reconnect(const ConnectionInfo& connection) {
+    Glib::ustring policy = connection.reconnect_policy;
+    if (policy.empty()) {
+        policy = resolve_folder_setting(connection.folder_id,
+            [](const FolderInfo& folder) { return folder.reconnect_policy; });
+    }
+    return policy == "Always";
+}
+
+std::vector<ConnectionInfo> ConnectionManager::resolve_jump_chain(const ConnectionInfo& connection) {
+    auto get_jump_host_id = [](const ConnectionInfo& conn) {
+        Glib::ustring jump_host_id = conn.jump_host_id;
+        if (jump_host_id.empty()) {
+            jump_host_id = resolve_folder_setting(conn.folder_id,
+                [](const FolderInfo& folder) { return folder.jump_host_id; });
+        }
+        return (jump_host_id == "None") ? Glib::ustring() : jump_host_id;
+    };
+
+    std::vector<ConnectionInfo> all_connections = load_connections();
+    std::vector<ConnectionInfo> chain;
+    std::set<Glib::ustring> visited = {connection.id};
+
+    // A bastion that inherits its own folder's jump host setting is reached directly
+    Glib::ustring next_id = get_jump_host_id(connection);
+    while (!next_id.empty() && visited.insert(next_id).second) {
+        auto it = std::find_if(all_connections.begin(), all_connections.end(),
+            [&next_id](const ConnectionInfo& conn) { return conn.id == next_id; });
+        if (it == all_connections.end() || it->connection_type != "SSH") {
+            std::cerr << "Jump host " << next_id << " is not a saved SSH connection, ignoring it" << std::endl;
+            break;
+        }
+        chain.insert(chain.begin(), *it);
+        next_id = get_jump_host_id(*it);
+    }
+    return chain;
+}
+
 std::filesystem::path ConnectionManager::get_connections_directory() {
     return get_connections_dir();
 }
\ No newline at end of file
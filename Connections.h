@@ -10,6 +10,7 @@
 #include <sstream>
 #include <chrono>
 #include <glibmm.h>
+#include <functional>
 
 using json = nlohmann::json;
 
@@ -18,6 +19,19 @@ struct FolderInfo {
     Glib::ustring id;        // Unique identifier for the folder
     Glib::ustring name;      // Display name of the folder
     Glib::ustring parent_id; // ID of the parent folder, empty for root
+    Glib::ustring reconnect_policy; // "Always", "Never", or empty to inherit from the parent folder
+    Glib::ustring jump_host_id;     // Jump host connection ID, "None" for direct, or empty to inherit from the parent folder
+    Glib::ustring network_profile;  // Network profile name, "Default" for none, or empty to inherit from the parent folder
+};
+
+// Port forward defined on an SSH connection and run by the tunnel manager
+struct TunnelInfo {
+    Glib::ustring type = "Local";             // "Local" (like ssh -L) or "Dynamic" (SOCKS, like ssh -D)
+    Glib::ustring bind_address = "127.0.0.1"; // Local address to listen on
+    int listen_port = 0;
+    Glib::ustring target_host;                // Destination as seen from the SSH server (Local only)
+    int target_port = 0;
+    bool auto_start = false;                  // Start when ngTerm starts
 };
 
 // Struct to represent connection details
@@ -28,13 +42,23 @@ struct ConnectionInfo {
     int port;
     Glib::ustring username;
     Glib::ustring domain; // Domain for RDP connections
-    Glib::ustring connection_type; // "SSH", "Telnet", "RDP", etc.
+    Glib::ustring connection_type; // "SSH", "Mosh", "Telnet", "RDP", etc.
     Glib::ustring folder_id; // ID of the parent folder, or empty if top-level
     Glib::ustring auth_method;          // "Password" or "SSHKey"
     Glib::ustring password;             // SSH password (NOTE: Storing plain text is insecure)
     Glib::ustring ssh_key_path;         // Path to SSH private key file
     Glib::ustring ssh_key_passphrase;   // Passphrase for the SSH private key (if encrypted)
     Glib::ustring additional_ssh_options; // e.g., "-o StrictHostKeyChecking=no"
+    Glib::ustring mosh_port;            // Mosh UDP port or "first:last" range, empty lets mosh-server pick
+    Glib::ustring mosh_server;          // Remote mosh-server command, empty uses "mosh-server" from PATH
+    int scrollback_lines = 0;           // Scrollback override for this connection, 0 uses the global default
+    Glib::ustring reconnect_policy;     // "Always", "Never", or empty to inherit from the folder
+    bool record_session = false;        // Record terminal output of this connection's sessions
+    Glib::ustring tmux_session;         // Remote tmux session to attach in control mode (SSH), empty for a shell
+    bool local_echo = false;            // Show typed characters before the remote side echoes them (SSH)
+    Glib::ustring jump_host_id;         // Saved SSH connection to hop through, "None" for direct, empty to inherit from the folder
+    Glib::ustring network_profile;      // "LAN", "WAN", "Satellite", "Default" for none, empty to inherit from the folder (SSH)
+    std::vector<TunnelInfo> tunnels;    // Port forwards run by the tunnel manager (SSH)
     bool is_folder = false; // Helper to distinguish in combined lists, not directly saved if representing a pure folder.
     Glib::ustring parent_id_col; // Only used by TreeView model logic
     ConnectionInfo() : port(0), is_folder(false) {}
@@ -63,6 +87,21 @@ public:
     // Get a connection by its ID
     static ConnectionInfo get_connection_by_id(const Glib::ustring& connection_id);
 
+    // Get a folder by its ID
+    static FolderInfo get_folder_by_id(const Glib::ustring& folder_id);
+
+    // Walk up the folder hierarchy starting at folder_id and return the first non-empty
+    // value of a folder setting, or an empty string if no folder sets it
+    static Glib::ustring resolve_folder_setting(const Glib::ustring& folder_id,
+                                                const std::function<Glib::ustring(const FolderInfo&)>& getter);
+
+    // Whether a connection's sessions reconnect automatically (connection setting, then folders)
+    static bool get_auto_reconnect(const ConnectionInfo& connection);
+
+    // Jump hosts a connection is reached through, the one reached directly first. A jump
+    // host's own jump host setting extends the chain; a cycle ends it.
+    static std::vector<ConnectionInfo> resolve_jump_chain(const ConnectionInfo& connection);
+
     // Delete a connection by ID
     static bool delete_connection(const Glib::ustring& connection_id);
 
@@ -119,6 +158,16 @@ private:
     static std::filesystem::path get_folders_file();
     // Helper function to ensure parent directory exists
     static void ensure_parent_directory_exists(const std::filesystem::path& file_path);
+    // Helpers to convert a connection to and from its JSON representation
+    static json connection_to_json(const ConnectionInfo& connection);
+    static ConnectionInfo connection_from_json(const json& j_conn);
+    // Write the full connection list to the connections file
+    static bool write_connections(const std::vector<ConnectionInfo>& connections);
+    // Helpers to convert a folder to and from its JSON representation
+    static json folder_to_json(const FolderInfo& folder);
+    static FolderInfo folder_from_json(const json& j_folder);
+    // Write the full folder list to the folders file
+    static bool write_folders(const std::vector<FolderInfo>& folders);
     // Helper for recursive folder deletion
     static void delete_folder_recursive(const Glib::ustring& folder_id_to_delete, std::vector<FolderInfo>& all_folders, std::vector<ConnectionInfo>& all_connections);
 };
@@ -0,0 +1,480 @@
+#include "Exec.h"
+#include "Fleet.h"
+#include <gtkmm/box.h>
+#include <gtkmm/button.h>
+#include <gtkmm/checkbutton.h>
+#include <gtkmm/entry.h>
+#include <gtkmm/grid.h>
+#include <gtkmm/label.h>
+#include <gtkmm/liststore.h>
+#include <gtkmm/paned.h>
+#include <gtkmm/scrolledwindow.h>
+#include <gtkmm/spinbutton.h>
+#include <gtkmm/textview.h>
+#include <gtkmm/treeview.h>
+#include <glibmm/main.h>
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <set>
+
+namespace Exec {
+
+namespace {
+
+// Output kept per host; the rest is dropped so a runaway command cannot exhaust memory
+const size_t MAX_OUTPUT = 64 * 1024;
+
+// Rows changed by streaming output are redrawn together at this interval
+const unsigned int REFRESH_MS = 200;
+
+struct Host {
+    enum class State { Queued, Running, Done, TimedOut, Failed, Cancelled };
+
+    ConnectionInfo conn;
+    State state = State::Queued;
+    std::string output;
+    bool truncated = false;
+    int exit_status = -1;
+    gint64 started_at = 0;
+    gint64 finished_at = 0;
+    std::string digest; // Of output and exit status, set when the host finished
+};
+
+Glib::ustring first_line(const std::string& text) {
+    size_t end = text.find('\n');
+    std::string line = text.substr(0, end);
+    if (!Glib::ustring(line).validate()) {
+        return "(binary output)";
+    }
+    return (end != std::string::npos && end + 1 < text.size()) ? line + " …" : line;
+}
+
+class HostColumns : public Gtk::TreeModel::ColumnRecord {
+public:
+    HostColumns() {
+        add(index);
+        add(host);
+        add(status);
+        add(duration);
+        add(output);
+    }
+    Gtk::TreeModelColumn<int> index;
+    Gtk::TreeModelColumn<Glib::ustring> host;
+    Gtk::TreeModelColumn<Glib::ustring> status;
+    Gtk::TreeModelColumn<Glib::ustring> duration;
+    Gtk::TreeModelColumn<Glib::ustring> output;
+};
+
+class GroupColumns : public Gtk::TreeModel::ColumnRecord {
+public:
+    GroupColumns() {
+        add(digest);
+        add(count);
+        add(hosts);
+        add(status);
+        add(output);
+    }
+    Gtk::TreeModelColumn<std::string> digest;
+    Gtk::TreeModelColumn<int> count;
+    Gtk::TreeModelColumn<Glib::ustring> hosts;
+    Gtk::TreeModelColumn<Glib::ustring> status;
+    Gtk::TreeModelColumn<Glib::ustring> output;
+};
+
+class ExecWindow : public Gtk::Window {
+public:
+    explicit ExecWindow(Gtk::Window& parent) : box(Gtk::ORIENTATION_VERTICAL, 6), paned(Gtk::ORIENTATION_VERTICAL),
+                                               action_box(Gtk::ORIENTATION_HORIZONTAL, 6),
+                                               selection_button("Use Tree Selection"), run_button("Run"),
+                                               cancel_button("Cancel"), group_check("Group identical output") {
+        set_title("Run Command");
+        set_transient_for(parent);
+        set_default_size(860, 600);
+        set_border_width(8);
+
+        Gtk::Grid* grid = Gtk::manage(new Gtk::Grid());
+        grid->set_row_spacing(6);
+        grid->set_column_spacing(12);
+
+        hosts_label.set_halign(Gtk::ALIGN_START);
+        hosts_label.set_hexpand(true);
+        selection_button.set_tooltip_text("Run on the connection or folder selected in the connection tree");
+        selection_button.signal_clicked().connect(sigc::mem_fun(*this, &ExecWindow::load_selection));
+        grid->attach(*Gtk::manage(new Gtk::Label("Hosts:", Gtk::ALIGN_START)), 0, 0, 1, 1);
+        grid->attach(hosts_label, 1, 0, 3, 1);
+        grid->attach(selection_button, 4, 0, 1, 1);
+
+        command_entry.set_placeholder_text("uptime");
+        command_entry.signal_activate().connect(sigc::mem_fun(*this, &ExecWindow::on_run));
+        grid->attach(*Gtk::manage(new Gtk::Label("Command:", Gtk::ALIGN_START)), 0, 1, 1, 1);
+        grid->attach(command_entry, 1, 1, 4, 1);
+
+        parallel_spin.set_range(1, 512);
+        parallel_spin.set_increments(1, 16);
+        parallel_spin.set_value(32);
+        parallel_spin.set_tooltip_text("Hosts the command runs on at the same time");
+        timeout_spin.set_range(1, 3600);
+        timeout_spin.set_increments(1, 10);
+        timeout_spin.set_value(30);
+        timeout_spin.set_tooltip_text("Seconds before the command is stopped on a host");
+        grid->attach(*Gtk::manage(new Gtk::Label("Parallel Hosts:", Gtk::ALIGN_START)), 0, 2, 1, 1);
+        grid->attach(parallel_spin, 1, 2, 1, 1);
+        grid->attach(*Gtk::manage(new Gtk::Label("Timeout (s):", Gtk::ALIGN_START)), 2, 2, 1, 1);
+        grid->attach(timeout_spin, 3, 2, 1, 1);
+
+        run_button.signal_clicked().connect(sigc::mem_fun(*this, &ExecWindow::on_run));
+        cancel_button.signal_clicked().connect(sigc::mem_fun(*this, &ExecWindow::on_cancel));
+        cancel_button.set_sensitive(false);
+        group_check.signal_toggled().connect(sigc::mem_fun(*this, &ExecWindow::on_group_toggled));
+        summary_label.set_halign(Gtk::ALIGN_START);
+        action_box.pack_start(group_check, Gtk::PACK_SHRINK);
+        action_box.pack_start(summary_label, Gtk::PACK_EXPAND_WIDGET);
+        action_box.pack_end(cancel_button, Gtk::PACK_SHRINK);
+        action_box.pack_end(run_button, Gtk::PACK_SHRINK);
+
+        host_store = Gtk::ListStore::create(host_columns);
+        group_store = Gtk::ListStore::create(group_columns);
+        show_hosts();
+        results_view.get_selection()->signal_changed().connect(sigc::mem_fun(*this, &ExecWindow::show_details));
+        results_scrolled.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+        results_scrolled.add(results_view);
+
+        details_view.set_editable(false);
+        details_view.set_monospace(true);
+        details_scrolled.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+        details_scrolled.add(details_view);
+        paned.pack1(results_scrolled, true, false);
+        paned.pack2(details_scrolled, false, false);
+        paned.set_position(320);
+
+        box.pack_start(*grid, Gtk::PACK_SHRINK);
+        box.pack_start(action_box, Gtk::PACK_SHRINK);
+        box.pack_start(paned, Gtk::PACK_EXPAND_WIDGET);
+        add(box);
+        show_all_children();
+    }
+
+    ~ExecWindow() override {
+        refresh_timer.disconnect();
+    }
+
+    bool is_busy() const {
+        return pool.get_running() > 0 || pool.get_queued() > 0;
+    }
+
+    void load_selection() {
+        if (is_busy()) return;
+        Glib::ustring description;
+        std::vector<ConnectionInfo> selected = Fleet::get_selected_hosts(description);
+        hosts.clear();
+        host_store->clear();
+        group_store->clear();
+        for (const auto& conn : selected) {
+            auto host = std::make_unique<Host>();
+            host->conn = conn;
+            Gtk::TreeModel::Row row = *host_store->append();
+            row[host_columns.index] = hosts.size();
+            row[host_columns.host] = conn.name;
+            hosts.push_back(std::move(host));
+        }
+        host_rows.clear();
+        for (const auto& row : host_store->children()) {
+            host_rows.push_back(row);
+        }
+        hosts_label.set_text(description + " (" + std::to_string(hosts.size()) + " SSH hosts)");
+        summary_label.set_text("");
+        details_view.get_buffer()->set_text("");
+        run_button.set_sensitive(!hosts.empty());
+    }
+
+private:
+    void show_hosts() {
+        results_view.remove_all_columns();
+        results_view.set_model(host_store);
+        results_view.append_column("Host", host_columns.host);
+        results_view.append_column("Status", host_columns.status);
+        results_view.append_column("Time", host_columns.duration);
+        results_view.append_column("Output", host_columns.output);
+    }
+
+    void show_groups() {
+        results_view.remove_all_columns();
+        results_view.set_model(group_store);
+        results_view.append_column("Hosts", group_columns.count);
+        results_view.append_column("Status", group_columns.status);
+        results_view.append_column("Output", group_columns.output);
+        results_view.append_column("Host Names", group_columns.hosts);
+    }
+
+    void on_group_toggled() {
+        if (group_check.get_active()) {
+            show_groups();
+            rebuild_groups();
+        } else {
+            show_hosts();
+        }
+        details_view.get_buffer()->set_text("");
+    }
+
+    void on_run() {
+        std::string command = command_entry.get_text();
+        if (is_busy() || hosts.empty() || command.empty()) return;
+
+        int timeout = timeout_spin.get_value_as_int();
+        pool.set_max_running(parallel_spin.get_value_as_int());
+        for (size_t i = 0; i < hosts.size(); ++i) {
+            Host& host = *hosts[i];
+            host.state = Host::State::Queued;
+            host.output.clear();
+            host.truncated = false;
+            host.exit_status = -1;
+            host.started_at = 0;
+            host.finished_at = 0;
+            host.digest.clear();
+            dirty.insert(i);
+
+            Fleet::Job job;
+            job.argv = Fleet::ssh_command(host.conn, command);
+            job.timeout_seconds = timeout;
+            job.on_start = [this, i]() {
+                hosts[i]->state = Host::State::Running;
+                hosts[i]->started_at = g_get_monotonic_time();
+                mark_dirty(i);
+            };
+            job.on_output = [this, i](const std::string& data, bool /* is_stderr */) {
+                // stdout and stderr are merged, like a terminal would show them
+                Host& host = *hosts[i];
+                if (host.output.size() < MAX_OUTPUT) {
+                    host.output += data.substr(0, MAX_OUTPUT - host.output.size());
+                }
+                host.truncated = host.truncated || host.output.size() >= MAX_OUTPUT;
+                mark_dirty(i);
+            };
+            job.on_done = [this, i](const Fleet::Result& result) {
+                Host& host = *hosts[i];
+                host.finished_at = g_get_monotonic_time();
+                host.exit_status = result.exit_status;
+                if (!result.error.empty()) {
+                    host.state = Host::State::Failed;
+                    host.output = result.error;
+                } else if (result.timed_out) {
+                    host.state = Host::State::TimedOut;
+                } else if (result.exit_status == 255) {
+                    host.state = Host::State::Failed; // ssh could not connect or lost the connection
+                } else {
+                    host.state = Host::State::Done;
+                }
+                std::string key = std::to_string(static_cast<int>(host.state)) + ":" +
+                                  std::to_string(host.exit_status) + ":" + host.output;
+                gchar* digest = g_compute_checksum_for_string(G_CHECKSUM_SHA256, key.data(), key.size());
+                host.digest = digest;
+                g_free(digest);
+                groups_changed = true;
+                mark_dirty(i);
+            };
+            pool.add(std::move(job));
+        }
+        run_button.set_sensitive(false);
+        selection_button.set_sensitive(false);
+        cancel_button.set_sensitive(true);
+        flush();
+    }
+
+    void on_cancel() {
+        pool.cancel();
+        for (size_t i = 0; i < hosts.size(); ++i) {
+            if (hosts[i]->state == Host::State::Queued || hosts[i]->state == Host::State::Running) {
+                hosts[i]->state = Host::State::Cancelled;
+                dirty.insert(i);
+            }
+        }
+        flush();
+    }
+
+    // Stream updates are batched so a thousand chatty hosts do not redraw on every read
+    void mark_dirty(size_t index) {
+        dirty.insert(index);
+        if (!refresh_timer.connected()) {
+            refresh_timer = Glib::signal_timeout().connect([this]() {
+                flush();
+                return false;
+            }, REFRESH_MS);
+        }
+    }
+
+    void flush() {
+        refresh_timer.disconnect();
+        for (size_t index : dirty) {
+            update_row(index);
+        }
+        dirty.clear();
+        if (groups_changed && group_check.get_active()) {
+            rebuild_groups();
+        }
+        update_summary();
+        if (!is_busy()) {
+            run_button.set_sensitive(!hosts.empty());
+            selection_button.set_sensitive(true);
+            cancel_button.set_sensitive(false);
+        }
+    }
+
+    Glib::ustring describe_status(const Host& host) {
+        switch (host.state) {
+            case Host::State::Queued: return "Queued";
+            case Host::State::Running: return "Running";
+            case Host::State::Done: return host.exit_status == 0 ? "OK" : "Exit " + std::to_string(host.exit_status);
+            case Host::State::TimedOut: return "Timed out";
+            case Host::State::Failed: return "Connection failed";
+            case Host::State::Cancelled: return "Cancelled";
+        }
+        return "";
+    }
+
+    void update_row(size_t index) {
+        const Host& host = *hosts[index];
+        Gtk::TreeModel::Row& row = host_rows[index];
+        row[host_columns.status] = describe_status(host);
+        if (host.started_at > 0 && host.state != Host::State::Queued) {
+            gint64 end = host.finished_at >= host.started_at ? host.finished_at : g_get_monotonic_time();
+            char text[32];
+            snprintf(text, sizeof(text), "%.1fs", double(end - host.started_at) / G_USEC_PER_SEC);
+            row[host_columns.duration] = text;
+        } else {
+            row[host_columns.duration] = "";
+        }
+        row[host_columns.output] = first_line(host.output);
+    }
+
+    // Collapse finished hosts by the digest of their output and exit status (like clush -b)
+    void rebuild_groups() {
+        groups_changed = false;
+        std::map<std::string, std::vector<size_t>> groups;
+        for (size_t i = 0; i < hosts.size(); ++i) {
+            if (!hosts[i]->digest.empty()) {
+                groups[hosts[i]->digest].push_back(i);
+            }
+        }
+
+        std::vector<std::pair<std::string, std::vector<size_t>>> ordered(groups.begin(), groups.end());
+        std::sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) {
+            return a.second.size() > b.second.size();
+        });
+
+        std::string selected;
+        Gtk::TreeModel::iterator iter = results_view.get_selection()->get_selected();
+        if (iter && group_check.get_active()) selected = static_cast<std::string>((*iter)[group_columns.digest]);
+
+        group_store->clear();
+        for (const auto& group : ordered) {
+            const Host& sample = *hosts[group.second.front()];
+            Glib::ustring names;
+            for (size_t i = 0; i < group.second.size() && i < 50; ++i) {
+                if (i > 0) names += ", ";
+                names += hosts[group.second[i]]->conn.name;
+            }
+            if (group.second.size() > 50) {
+                names += ", … " + std::to_string(group.second.size() - 50) + " more";
+            }
+            Gtk::TreeModel::Row row = *group_store->append();
+            row[group_columns.digest] = group.first;
+            row[group_columns.count] = group.second.size();
+            row[group_columns.hosts] = names;
+            row[group_columns.status] = describe_status(sample);
+            row[group_columns.output] = first_line(sample.output);
+            if (group.first == selected) results_view.get_selection()->select(row);
+        }
+    }
+
+    void update_summary() {
+        int ok = 0, failed = 0, running = 0, queued = 0;
+        for (const auto& host : hosts) {
+            switch (host->state) {
+                case Host::State::Queued: queued++; break;
+                case Host::State::Running: running++; break;
+                case Host::State::Done: (host->exit_status == 0 ? ok : failed)++; break;
+                case Host::State::TimedOut:
+                case Host::State::Failed: failed++; break;
+                case Host::State::Cancelled: break;
+            }
+        }
+        Glib::ustring summary = std::to_string(ok) + " OK, " + std::to_string(failed) + " failed";
+        if (running + queued > 0) {
+            summary += ", " + std::to_string(running) + " running, " + std::to_string(queued) + " queued";
+        }
+        summary_label.set_text(summary);
+    }
+
+    void show_details() {
+        Gtk::TreeModel::iterator iter = results_view.get_selection()->get_selected();
+        if (!iter) return;
+
+        std::string text;
+        if (group_check.get_active()) {
+            std::string digest = (*iter)[group_columns.digest];
+            std::string names;
+            const Host* sample = nullptr;
+            for (const auto& host : hosts) {
+                if (host->digest != digest) continue;
+                if (!sample) sample = host.get();
+                names += (names.empty() ? "" : ", ") + host->conn.name.raw();
+            }
+            if (!sample) return;
+            text = names + "\n" + std::string(40, '-') + "\n" + sample->output;
+            if (sample->truncated) text += "\n[output truncated]";
+        } else {
+            int index = (*iter)[host_columns.index];
+            const Host& host = *hosts[index];
+            text = host.output;
+            if (host.truncated) text += "\n[output truncated]";
+        }
+        if (!Glib::ustring(text).validate()) {
+            text = "(binary output)";
+        }
+        details_view.get_buffer()->set_text(text);
+    }
+
+    Gtk::Box box;
+    Gtk::Paned paned;
+    Gtk::Box action_box;
+    Gtk::Label hosts_label;
+    Gtk::Button selection_button;
+    Gtk::Entry command_entry;
+    Gtk::SpinButton parallel_spin;
+    Gtk::SpinButton timeout_spin;
+    Gtk::Button run_button;
+    Gtk::Button cancel_button;
+    Gtk::CheckButton group_check;
+    Gtk::Label summary_label;
+    Gtk::ScrolledWindow results_scrolled;
+    Gtk::TreeView results_view;
+    Gtk::ScrolledWindow details_scrolled;
+    Gtk::TextView details_view;
+    HostColumns host_columns;
+    GroupColumns group_columns;
+    Glib::RefPtr<Gtk::ListStore> host_store;
+    Glib::RefPtr<Gtk::ListStore> group_store;
+    std::vector<Gtk::TreeModel::Row> host_rows; // By host index, for O(1) row updates
+
+    std::vector<std::unique_ptr<Host>> hosts;
+    std::set<size_t> dirty;
+    bool groups_changed = false;
+    sigc::connection refresh_timer;
+    Fleet::Pool pool;
+};
+
+ExecWindow* exec_window = nullptr;
+
+} // namespace
+
+void show_window(Gtk::Window& parent) {
+    if (!exec_window) {
+        exec_window = new ExecWindow(parent);
+    }
+    exec_window->load_selection();
+    exec_window->present();
+}
+
+} // namespace Exec
@@ -0,0 +1,15 @@
+#ifndef EXEC_H
+#define EXEC_H
+
+#include <gtkmm/window.h>
+
+namespace Exec {
+
+// Show the window that runs a command on every SSH host of the tree selection at once,
+// without opening tabs. Output streams into a per-host table; identical outputs can be
+// collapsed into one row listing the hosts that produced them.
+void show_window(Gtk::Window& parent);
+
+} // namespace Exec
+
+#endif // EXEC_H
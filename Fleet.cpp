@@ -0,0 +1,317 @@
+#include "Fleet.h"
+#include "main.h"
+#include "NetworkProfiles.h"
+#include "Ssh.h"
+#include <glib-unix.h>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <set>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace Fleet {
+
+std::vector<ConnectionInfo> get_selected_hosts(Glib::ustring& description) {
+    std::vector<ConnectionInfo> hosts;
+    description = "Nothing selected";
+    if (!connections_treeview) return hosts;
+    Gtk::TreeModel::iterator iter = connections_treeview->get_selection()->get_selected();
+    if (!iter) return hosts;
+
+    Glib::ustring id = (*iter)[connection_columns.id];
+    if (!(*iter)[connection_columns.is_folder]) {
+        ConnectionInfo conn = ConnectionManager::get_connection_by_id(id);
+        if (conn.connection_type == "SSH") {
+            hosts.push_back(conn);
+        }
+        description = conn.name;
+        return hosts;
+    }
+
+    // The folder and everything below it
+    std::set<Glib::ustring> folder_ids = {id};
+    std::vector<FolderInfo> folders = ConnectionManager::load_folders();
+    bool grew = true;
+    while (grew) {
+        grew = false;
+        for (const auto& folder : folders) {
+            if (!folder_ids.count(folder.id) && folder_ids.count(folder.parent_id)) {
+                folder_ids.insert(folder.id);
+                grew = true;
+            }
+        }
+    }
+    for (const auto& conn : ConnectionManager::load_connections()) {
+        if (conn.connection_type == "SSH" && folder_ids.count(conn.folder_id)) {
+            hosts.push_back(conn);
+        }
+    }
+    description = "Folder " + ConnectionManager::get_folder_name(id);
+    return hosts;
+}
+
+std::vector<std::string> ssh_command(const ConnectionInfo& conn, const std::string& remote_command) {
+    std::string control_persist = NetworkProfiles::get_control_persist(NetworkProfiles::resolve(conn), "60");
+    std::vector<std::string> args = Ssh::generate_background_command_args(conn, {
+        "-o", "ControlMaster=auto", "-o", "ControlPersist=" + control_persist, "-o", "ConnectTimeout=15"
+    });
+    args.push_back(remote_command);
+    return args;
+}
+
+// ---- Pool ----
+
+struct Pool::Process {
+    Pool* pool = nullptr;
+    Job job;
+    GPid pid = 0;
+    int in_fd = -1;
+    int out_fd = -1;
+    int err_fd = -1;
+    int file_fd = -1;
+    guint in_source = 0;
+    guint out_source = 0;
+    guint err_source = 0;
+    guint timeout_source = 0;
+    guint child_source = 0;
+    std::string input;
+    size_t input_offset = 0;
+    bool exited = false;
+    Result result;
+};
+
+namespace {
+
+void remove_source(guint& source) {
+    if (source) {
+        g_source_remove(source);
+        source = 0;
+    }
+}
+
+void close_fd(int& fd) {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+void reap_in_background(GPid pid) {
+    g_child_watch_add(pid, [](GPid child, gint, gpointer) { g_spawn_close_pid(child); }, nullptr);
+}
+
+} // namespace
+
+Pool::~Pool() {
+    cancel();
+}
+
+void Pool::set_max_running(int count) {
+    max_running = std::max(1, count);
+    start_next();
+}
+
+void Pool::add(Job job) {
+    queued.push_back(std::move(job));
+    start_next();
+}
+
+void Pool::cancel() {
+    queued.clear();
+    for (auto& process : running) {
+        for (guint* source : {&process->in_source, &process->out_source, &process->err_source,
+                              &process->timeout_source, &process->child_source}) {
+            remove_source(*source);
+        }
+        for (int* fd : {&process->in_fd, &process->out_fd, &process->err_fd, &process->file_fd}) {
+            close_fd(*fd);
+        }
+        if (!process->exited) {
+            kill(process->pid, SIGTERM);
+            reap_in_background(process->pid);
+        }
+    }
+    running.clear();
+}
+
+void Pool::start_next() {
+    while (static_cast<int>(running.size()) < max_running && !queued.empty()) {
+        Job job = std::move(queued.front());
+        queued.pop_front();
+        start(std::move(job));
+    }
+}
+
+void Pool::start(Job job) {
+    auto process = std::make_unique<Process>();
+    process->pool = this;
+    process->job = std::move(job);
+    Job& spec = process->job;
+
+    if (!spec.input_path.empty()) {
+        process->file_fd = open(spec.input_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (process->file_fd < 0) {
+            Result result;
+            result.error = spec.input_path + ": " + g_strerror(errno);
+            if (spec.on_done) spec.on_done(result);
+            return;
+        }
+    }
+    bool has_input = !spec.input.empty() || process->file_fd >= 0;
+    process->input = spec.input;
+
+    std::vector<char*> argv;
+    for (auto& arg : spec.argv) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    GError* error = nullptr;
+    if (!g_spawn_async_with_pipes(nullptr, argv.data(), nullptr,
+                                  GSpawnFlags(G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD),
+                                  nullptr, nullptr, &process->pid,
+                                  has_input ? &process->in_fd : nullptr, &process->out_fd, &process->err_fd, &error)) {
+        Result result;
+        result.error = error->message;
+        g_error_free(error);
+        close_fd(process->file_fd);
+        if (spec.on_done) spec.on_done(result);
+        return;
+    }
+
+    Process* raw = process.get();
+    running.push_back(std::move(process));
+    for (int fd : {raw->in_fd, raw->out_fd, raw->err_fd}) {
+        if (fd >= 0) g_unix_set_fd_nonblocking(fd, TRUE, nullptr);
+    }
+    raw->out_source = g_unix_fd_add(raw->out_fd, GIOCondition(G_IO_IN | G_IO_HUP | G_IO_ERR), on_output, raw);
+    raw->err_source = g_unix_fd_add(raw->err_fd, GIOCondition(G_IO_IN | G_IO_HUP | G_IO_ERR), on_output, raw);
+    raw->child_source = g_child_watch_add(raw->pid, on_exit, raw);
+    if (spec.timeout_seconds > 0) {
+        raw->timeout_source = g_timeout_add_seconds(spec.timeout_seconds, on_timeout, raw);
+    }
+    if (has_input) {
+        feed_input(raw);
+    }
+    if (spec.on_start) spec.on_start();
+}
+
+// Write pending input; refill it from the input file; close stdin at the end
+void Pool::feed_input(Process* process) {
+    while (process->in_fd >= 0) {
+        if (process->input_offset >= process->input.size()) {
+            process->input.clear();
+            process->input_offset = 0;
+            if (process->file_fd >= 0) {
+                char buffer[65536];
+                ssize_t length = read(process->file_fd, buffer, sizeof(buffer));
+                if (length > 0) {
+                    process->input.assign(buffer, length);
+                    continue;
+                }
+                close_fd(process->file_fd);
+            }
+            close_fd(process->in_fd);
+            return;
+        }
+
+        ssize_t written = write(process->in_fd, process->input.data() + process->input_offset,
+                                process->input.size() - process->input_offset);
+        if (written > 0) {
+            process->input_offset += written;
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written < 0 && errno == EAGAIN) {
+            if (!process->in_source) {
+                process->in_source = g_unix_fd_add(process->in_fd, G_IO_OUT, on_input_writable, process);
+            }
+            return;
+        } else {
+            // The remote side stopped reading; its exit status tells the rest
+            close_fd(process->file_fd);
+            close_fd(process->in_fd);
+            return;
+        }
+    }
+}
+
+void Pool::finish(Process* process) {
+    if (!process->exited || process->out_fd >= 0 || process->err_fd >= 0) return;
+
+    remove_source(process->in_source);
+    remove_source(process->timeout_source);
+    close_fd(process->in_fd);
+    close_fd(process->file_fd);
+
+    Pool* pool = process->pool;
+    auto it = std::find_if(pool->running.begin(), pool->running.end(),
+                           [process](const std::unique_ptr<Process>& item) { return item.get() == process; });
+    if (it == pool->running.end()) return;
+    std::unique_ptr<Process> done = std::move(*it);
+    pool->running.erase(it);
+
+    // The callback may add jobs, so the pool is consistent before it runs
+    if (done->job.on_done) done->job.on_done(done->result);
+    pool->start_next();
+}
+
+gboolean Pool::on_output(gint fd, GIOCondition /* condition */, gpointer user_data) {
+    Process* process = static_cast<Process*>(user_data);
+    bool is_stderr = (fd == process->err_fd);
+    char buffer[16384];
+    ssize_t length = read(fd, buffer, sizeof(buffer));
+    if (length < 0 && (errno == EAGAIN || errno == EINTR)) return G_SOURCE_CONTINUE;
+    if (length > 0) {
+        if (process->job.on_output) process->job.on_output(std::string(buffer, length), is_stderr);
+        return G_SOURCE_CONTINUE;
+    }
+
+    if (is_stderr) {
+        process->err_source = 0;
+        close_fd(process->err_fd);
+    } else {
+        process->out_source = 0;
+        close_fd(process->out_fd);
+    }
+    process->pool->finish(process);
+    return G_SOURCE_REMOVE;
+}
+
+gboolean Pool::on_input_writable(gint /* fd */, GIOCondition /* condition */, gpointer user_data) {
+    Process* process = static_cast<Process*>(user_data);
+    process->in_source = 0;
+    process->pool->feed_input(process);
+    return G_SOURCE_REMOVE;
+}
+
+gboolean Pool::on_timeout(gpointer user_data) {
+    Process* process = static_cast<Process*>(user_data);
+    process->timeout_source = 0;
+    process->result.timed_out = true;
+    if (!process->exited) {
+        kill(process->pid, SIGTERM);
+        return G_SOURCE_REMOVE;
+    }
+
+    // The pid was reaped and may belong to another process by now; what keeps the job open
+    // is a background child still holding its output, so stop reading that instead
+    remove_source(process->out_source);
+    remove_source(process->err_source);
+    close_fd(process->out_fd);
+    close_fd(process->err_fd);
+    process->pool->finish(process);
+    return G_SOURCE_REMOVE;
+}
+
+void Pool::on_exit(GPid pid, gint status, gpointer user_data) {
+    Process* process = static_cast<Process*>(user_data);
+    g_spawn_close_pid(pid);
+    process->child_source = 0;
+    process->exited = true;
+    process->result.exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    process->pool->finish(process);
+}
+
+} // namespace Fleet
@@ -0,0 +1,80 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include "Connections.h"
+#include <glib.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Shared plumbing of the actions that run against many hosts at once
+namespace Fleet {
+
+// SSH connections picked in the connection tree: the selected connection, or every SSH
+// connection in the selected folder and its subfolders. description names the selection.
+std::vector<ConnectionInfo> get_selected_hosts(Glib::ustring& description);
+
+// ssh command running remote_command on a host without a terminal. The first command to a
+// host becomes a multiplexed master that stays up for a minute (or as long as its network
+// profile says), so the commands of one action share a single login per host.
+std::vector<std::string> ssh_command(const ConnectionInfo& conn, const std::string& remote_command);
+
+// How a job ended
+struct Result {
+    int exit_status = -1;   // Exit code, -1 when killed or not started
+    bool timed_out = false;
+    std::string error;      // Why the job could not start
+};
+
+struct Job {
+    std::vector<std::string> argv;
+    std::string input;       // Written to stdin before it is closed...
+    std::string input_path;  // ...or this file is streamed to stdin instead
+    int timeout_seconds = 0; // 0 for no limit
+    std::function<void()> on_start; // When the job leaves the queue and its process runs
+    std::function<void(const std::string& data, bool is_stderr)> on_output;
+    std::function<void(const Result& result)> on_done;
+};
+
+// Runs jobs on the main loop with at most max_running processes at a time; the rest wait
+// in order. Output is delivered as it arrives, and a job past its timeout is killed.
+class Pool {
+public:
+    explicit Pool(int max_running = 16) : max_running(max_running) {}
+    ~Pool();
+
+    void set_max_running(int count);
+    void add(Job job);
+
+    // Drop the queued jobs and kill the running ones; their on_done is not called
+    void cancel();
+
+    size_t get_running() const { return running.size(); }
+    size_t get_queued() const { return queued.size(); }
+
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+
+private:
+    struct Process;
+
+    void start_next();
+    void start(Job job);
+    void finish(Process* process);
+    void feed_input(Process* process);
+
+    static gboolean on_output(gint fd, GIOCondition condition, gpointer user_data);
+    static gboolean on_input_writable(gint fd, GIOCondition condition, gpointer user_data);
+    static gboolean on_timeout(gpointer user_data);
+    static void on_exit(GPid pid, gint status, gpointer user_data);
+
+    int max_running;
+    std::deque<Job> queued;
+    std::vector<std::unique_ptr<Process>> running;
+};
+
+} // namespace Fleet
+
+#endif // FLEET_H
@@ -1,6 +1,7 @@
 #include "Folders.h"
 #include "Connections.h"      // For ConnectionManager and FolderInfo/ConnectionInfo structs
 #include "TreeModelColumns.h" // For ConnectionColumns (though passed as Gtk::TreeModel::ColumnRecord)
+#include "NetworkProfiles.h"
 
 #include <gtkmm/dialog.h>
 #include <gtkmm/grid.h>
@@ -11,6 +12,32 @@
 
 namespace FolderOps {
 
+// Jump host choices for a folder: inherit, direct, or any saved SSH connection
+static void fill_jump_host_combo(Gtk::ComboBoxText& combo) {
+    combo.set_hexpand(true);
+    combo.set_tooltip_text("Reach the hosts in this folder through a saved SSH connection, "
+                           "unless a connection sets its own jump host.");
+    combo.append("", "Inherit from Parent");
+    combo.append("None", "None (Direct)");
+    for (const auto& connection : ConnectionManager::load_connections()) {
+        if (connection.connection_type == "SSH") {
+            combo.append(connection.id, connection.name);
+        }
+    }
+}
+
+// Network profile choices for a folder: inherit, none, or a built-in profile
+static void fill_network_profile_combo(Gtk::ComboBoxText& combo) {
+    combo.set_hexpand(true);
+    combo.set_tooltip_text("Tune ssh for the link to the hosts in this folder, "
+                           "unless a connection sets its own network profile.");
+    combo.append("", "Inherit from Parent");
+    combo.append("Default", "Default (ssh settings)");
+    for (const auto& profile : NetworkProfiles::get_all()) {
+        combo.append(profile.name, profile.name);
+    }
+}
+
 void add_folder(Gtk::Window& parent_window,
                 Gtk::TreeView& connections_treeview,
                 Glib::RefPtr<Gtk::TreeStore>& connections_liststore,
@@ -75,11 +102,38 @@ void add_folder(Gtk::Window& parent_window,
         parent_combo.set_active_id("root_placeholder_id"); // Default to (Root Level)
     }
 
+    // Auto Reconnect policy for connections in this folder
+    Gtk::Label reconnect_label("Auto Reconnect:", Gtk::ALIGN_START);
+    Gtk::ComboBoxText reconnect_combo;
+    reconnect_combo.set_hexpand(true);
+    reconnect_combo.append("", "Inherit from Parent");
+    reconnect_combo.append("Always", "Always");
+    reconnect_combo.append("Never", "Never");
+    reconnect_combo.set_active_id("");
+
+    // Jump host for SSH connections in this folder
+    Gtk::Label jump_host_label("Jump Host:", Gtk::ALIGN_START);
+    Gtk::ComboBoxText jump_host_combo;
+    fill_jump_host_combo(jump_host_combo);
+    jump_host_combo.set_active_id("");
+
+    // Network profile for SSH connections in this folder
+    Gtk::Label network_profile_label("Network Profile:", Gtk::ALIGN_START);
+    Gtk::ComboBoxText network_profile_combo;
+    fill_network_profile_combo(network_profile_combo);
+    network_profile_combo.set_active_id("");
+
     // Attach to grid
     grid->attach(name_label,   0, 0, 1, 1);
     grid->attach(name_entry,   1, 0, 1, 1);
     grid->attach(parent_label, 0, 1, 1, 1);
     grid->attach(parent_combo, 1, 1, 1, 1);
+    grid->attach(reconnect_label, 0, 2, 1, 1);
+    grid->attach(reconnect_combo, 1, 2, 1, 1);
+    grid->attach(jump_host_label, 0, 3, 1, 1);
+    grid->attach(jump_host_combo, 1, 3, 1, 1);
+    grid->attach(network_profile_label, 0, 4, 1, 1);
+    grid->attach(network_profile_combo, 1, 4, 1, 1);
 
     dialog.add_button("Cancel", Gtk::RESPONSE_CANCEL);
     dialog.add_button("Add", Gtk::RESPONSE_OK);
@@ -91,6 +145,9 @@ void add_folder(Gtk::Window& parent_window,
         new_folder.name = name_entry.get_text();
         std::string parent_id_selected = parent_combo.get_active_id();
         new_folder.parent_id = (parent_id_selected == "root_placeholder_id") ? "" : parent_id_selected;
+        new_folder.reconnect_policy = reconnect_combo.get_active_id();
+        new_folder.jump_host_id = jump_host_combo.get_active_id();
+        new_folder.network_profile = network_profile_combo.get_active_id();
 
         // Generate ID using ConnectionManager
         new_folder.id = ConnectionManager::generate_folder_id();
@@ -130,7 +187,8 @@ void edit_folder(Gtk::Window& parent_window,
         return;
     }
 
-    FolderInfo current_folder;
+    // Start from the stored folder so settings not shown in the tree are preserved
+    FolderInfo current_folder = ConnectionManager::get_folder_by_id(static_cast<Glib::ustring>(row[columns.id]));
     current_folder.id = static_cast<Glib::ustring>(row[columns.id]);
     current_folder.name = static_cast<Glib::ustring>(row[columns.name]);
     current_folder.parent_id = static_cast<Glib::ustring>(row[columns.parent_id_col]);
@@ -178,10 +236,37 @@ void edit_folder(Gtk::Window& parent_window,
     }
     parent_folder_combo.set_active(active_idx);
 
+    // Auto Reconnect policy for connections in this folder
+    Gtk::Label reconnect_label("Auto Reconnect:", Gtk::ALIGN_START);
+    Gtk::ComboBoxText reconnect_combo;
+    reconnect_combo.set_hexpand(true);
+    reconnect_combo.append("", "Inherit from Parent");
+    reconnect_combo.append("Always", "Always");
+    reconnect_combo.append("Never", "Never");
+    reconnect_combo.set_active_id(current_folder.reconnect_policy);
+
+    // Jump host for SSH connections in this folder
+    Gtk::Label jump_host_label("Jump Host:", Gtk::ALIGN_START);
+    Gtk::ComboBoxText jump_host_combo;
+    fill_jump_host_combo(jump_host_combo);
+    jump_host_combo.set_active_id(current_folder.jump_host_id);
+
+    // Network profile for SSH connections in this folder
+    Gtk::Label network_profile_label("Network Profile:", Gtk::ALIGN_START);
+    Gtk::ComboBoxText network_profile_combo;
+    fill_network_profile_combo(network_profile_combo);
+    network_profile_combo.set_active_id(current_folder.network_profile);
+
     grid->attach(name_label, 0, 0, 1, 1);
     grid->attach(name_entry, 1, 0, 1, 1);
     grid->attach(parent_folder_label, 0, 1, 1, 1);
     grid->attach(parent_folder_combo, 1, 1, 1, 1);
+    grid->attach(reconnect_label, 0, 2, 1, 1);
+    grid->attach(reconnect_combo, 1, 2, 1, 1);
+    grid->attach(jump_host_label, 0, 3, 1, 1);
+    grid->attach(jump_host_combo, 1, 3, 1, 1);
+    grid->attach(network_profile_label, 0, 4, 1, 1);
+    grid->attach(network_profile_combo, 1, 4, 1, 1);
 
     dialog.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
     Gtk::Button* save_button = dialog.add_button("_Save", Gtk::RESPONSE_OK);
@@ -202,6 +287,9 @@ void edit_folder(Gtk::Window& parent_window,
         FolderInfo updated_folder = current_folder; // Keep original ID
         updated_folder.name = new_folder_name;
         updated_folder.parent_id = parent_folder_combo.get_active_id();
+        updated_folder.reconnect_policy = reconnect_combo.get_active_id();
+        updated_folder.jump_host_id = jump_host_combo.get_active_id();
+        updated_folder.network_profile = network_profile_combo.get_active_id();
 
         if (updated_folder.id == updated_folder.parent_id) {
             Gtk::MessageDialog error_dialog(parent_window, "Invalid Parent", false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
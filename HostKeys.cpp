@@ -0,0 +1,575 @@
+#include "HostKeys.h"
+#include "Fleet.h"
+#include <gtkmm/box.h>
+#include <gtkmm/button.h>
+#include <gtkmm/grid.h>
+#include <gtkmm/label.h>
+#include <gtkmm/liststore.h>
+#include <gtkmm/messagedialog.h>
+#include <gtkmm/scrolledwindow.h>
+#include <gtkmm/spinbutton.h>
+#include <gtkmm/treeview.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+#include <map>
+#include <memory>
+#include <sstream>
+
+namespace HostKeys {
+
+namespace {
+
+struct Key {
+    std::string type;
+    std::string blob; // Base64 as written in known_hosts
+    bool operator==(const Key& other) const { return type == other.type && blob == other.blob; }
+};
+
+// A host:port to scan; connections to the same address share one
+struct Target {
+    enum class State { Waiting, Scanning, Known, New, Changed, NoResponse, Skipped, Cancelled };
+
+    std::string host;
+    int port = 22;
+    std::string name; // How known_hosts names the host: "host" or "[host]:port"
+    Glib::ustring connections;
+    State state = State::Waiting;
+    std::vector<Key> scanned;
+    std::vector<Key> known;
+    std::string errors;
+    std::string detail;
+};
+
+std::string known_hosts_path() {
+    return Glib::build_filename(Glib::get_home_dir(), ".ssh", "known_hosts");
+}
+
+std::string known_hosts_name(const std::string& host, int port) {
+    gchar* lower = g_ascii_strdown(host.c_str(), -1);
+    std::string name = lower;
+    g_free(lower);
+    return port == 22 ? name : "[" + name + "]:" + std::to_string(port);
+}
+
+// Whether the host field of a known_hosts line names the host. Handles hashed names
+// (|1|salt|hash, HMAC-SHA1 of the name) and comma separated patterns with * ? and !.
+bool host_matches(const std::string& field, const std::string& name) {
+    if (field.compare(0, 3, "|1|") == 0) {
+        size_t separator = field.find('|', 3);
+        if (separator == std::string::npos) return false;
+        gsize salt_length = 0;
+        guchar* salt = g_base64_decode(field.substr(3, separator - 3).c_str(), &salt_length);
+        GHmac* hmac = g_hmac_new(G_CHECKSUM_SHA1, salt, salt_length);
+        g_hmac_update(hmac, reinterpret_cast<const guchar*>(name.data()), name.size());
+        guint8 digest[20];
+        gsize digest_length = sizeof(digest);
+        g_hmac_get_digest(hmac, digest, &digest_length);
+        g_hmac_unref(hmac);
+        g_free(salt);
+        gchar* encoded = g_base64_encode(digest, digest_length);
+        bool matches = field.substr(separator + 1) == encoded;
+        g_free(encoded);
+        return matches;
+    }
+
+    bool matched = false;
+    std::istringstream patterns(field);
+    std::string pattern;
+    while (std::getline(patterns, pattern, ',')) {
+        bool negated = !pattern.empty() && pattern[0] == '!';
+        if (negated) pattern.erase(0, 1);
+        gchar* lower = g_ascii_strdown(pattern.c_str(), -1);
+        bool hit = g_pattern_match_simple(lower, name.c_str());
+        g_free(lower);
+        if (hit && negated) return false;
+        matched = matched || hit;
+    }
+    return matched;
+}
+
+// Splits a known_hosts or ssh-keyscan line into host field and key; false for comments,
+// markers (@revoked, @cert-authority) and malformed lines
+bool parse_line(const std::string& line, std::string& hosts, Key& key) {
+    std::istringstream fields(line);
+    if (!(fields >> hosts) || hosts[0] == '#' || hosts[0] == '@') return false;
+    return static_cast<bool>(fields >> key.type >> key.blob);
+}
+
+std::string fingerprint(const Key& key) {
+    gsize length = 0;
+    guchar* blob = g_base64_decode(key.blob.c_str(), &length);
+    GChecksum* checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    g_checksum_update(checksum, blob, length);
+    guint8 digest[32];
+    gsize digest_length = sizeof(digest);
+    g_checksum_get_digest(checksum, digest, &digest_length);
+    g_checksum_free(checksum);
+    g_free(blob);
+    gchar* encoded = g_base64_encode(digest, digest_length);
+    std::string text = encoded;
+    g_free(encoded);
+    while (!text.empty() && text.back() == '=') text.pop_back();
+    return "SHA256:" + text;
+}
+
+std::vector<std::string> read_lines(const std::string& path) {
+    std::vector<std::string> lines;
+    std::string contents;
+    try {
+        contents = Glib::file_get_contents(path);
+    } catch (const Glib::FileError&) {
+        return lines; // No known_hosts yet
+    }
+    std::istringstream stream(contents);
+    std::string line;
+    while (std::getline(stream, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+class KeyColumns : public Gtk::TreeModel::ColumnRecord {
+public:
+    KeyColumns() {
+        add(index);
+        add(accept);
+        add(connections);
+        add(address);
+        add(status);
+        add(fingerprints);
+    }
+    Gtk::TreeModelColumn<int> index;
+    Gtk::TreeModelColumn<bool> accept;
+    Gtk::TreeModelColumn<Glib::ustring> connections;
+    Gtk::TreeModelColumn<Glib::ustring> address;
+    Gtk::TreeModelColumn<Glib::ustring> status;
+    Gtk::TreeModelColumn<Glib::ustring> fingerprints;
+};
+
+class HostKeysWindow : public Gtk::Window {
+public:
+    explicit HostKeysWindow(Gtk::Window& parent) : box(Gtk::ORIENTATION_VERTICAL, 6),
+                                                   action_box(Gtk::ORIENTATION_HORIZONTAL, 6),
+                                                   selection_button("Use Tree Selection"),
+                                                   all_button("All Connections"), scan_button("Scan"),
+                                                   cancel_button("Cancel"), write_button("Write Accepted Keys") {
+        set_title("Host Keys");
+        set_transient_for(parent);
+        set_default_size(860, 480);
+        set_border_width(8);
+
+        Gtk::Grid* grid = Gtk::manage(new Gtk::Grid());
+        grid->set_row_spacing(6);
+        grid->set_column_spacing(12);
+
+        hosts_label.set_halign(Gtk::ALIGN_START);
+        hosts_label.set_hexpand(true);
+        selection_button.set_tooltip_text("Scan the connection or folder selected in the connection tree");
+        selection_button.signal_clicked().connect(sigc::mem_fun(*this, &HostKeysWindow::load_selection));
+        all_button.set_tooltip_text("Scan every saved SSH connection");
+        all_button.signal_clicked().connect(sigc::mem_fun(*this, &HostKeysWindow::load_all));
+        grid->attach(*Gtk::manage(new Gtk::Label("Hosts:", Gtk::ALIGN_START)), 0, 0, 1, 1);
+        grid->attach(hosts_label, 1, 0, 3, 1);
+        grid->attach(selection_button, 4, 0, 1, 1);
+        grid->attach(all_button, 5, 0, 1, 1);
+
+        parallel_spin.set_range(1, 256);
+        parallel_spin.set_increments(1, 16);
+        parallel_spin.set_value(32);
+        parallel_spin.set_tooltip_text("Hosts scanned at the same time");
+        timeout_spin.set_range(1, 120);
+        timeout_spin.set_increments(1, 5);
+        timeout_spin.set_value(5);
+        timeout_spin.set_tooltip_text("Seconds to wait for a host to answer");
+        grid->attach(*Gtk::manage(new Gtk::Label("Parallel Hosts:", Gtk::ALIGN_START)), 0, 1, 1, 1);
+        grid->attach(parallel_spin, 1, 1, 1, 1);
+        grid->attach(*Gtk::manage(new Gtk::Label("Timeout (s):", Gtk::ALIGN_START)), 2, 1, 1, 1);
+        grid->attach(timeout_spin, 3, 1, 1, 1);
+
+        store = Gtk::ListStore::create(columns);
+        view.set_model(store);
+        view.append_column_editable("Accept", columns.accept);
+        view.append_column("Connections", columns.connections);
+        view.append_column("Address", columns.address);
+        view.append_column("Status", columns.status);
+        view.append_column("Fingerprints", columns.fingerprints);
+        view.get_column(1)->set_expand(true);
+        view.set_tooltip_text("New keys are accepted by default. Changed keys replace the ones in known_hosts "
+                              "only when accepted; check the fingerprints with the host's administrator first.");
+        scrolled.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+        scrolled.add(view);
+
+        scan_button.signal_clicked().connect(sigc::mem_fun(*this, &HostKeysWindow::on_scan));
+        cancel_button.signal_clicked().connect(sigc::mem_fun(*this, &HostKeysWindow::on_cancel));
+        write_button.signal_clicked().connect(sigc::mem_fun(*this, &HostKeysWindow::on_write));
+        cancel_button.set_sensitive(false);
+        write_button.set_sensitive(false);
+        summary_label.set_halign(Gtk::ALIGN_START);
+        action_box.pack_start(summary_label, Gtk::PACK_EXPAND_WIDGET);
+        action_box.pack_end(write_button, Gtk::PACK_SHRINK);
+        action_box.pack_end(cancel_button, Gtk::PACK_SHRINK);
+        action_box.pack_end(scan_button, Gtk::PACK_SHRINK);
+
+        box.pack_start(*grid, Gtk::PACK_SHRINK);
+        box.pack_start(scrolled, Gtk::PACK_EXPAND_WIDGET);
+        box.pack_start(action_box, Gtk::PACK_SHRINK);
+        add(box);
+        show_all_children();
+    }
+
+    bool is_busy() const {
+        return pool.get_running() > 0 || pool.get_queued() > 0;
+    }
+
+    void load_selection() {
+        Glib::ustring description;
+        std::vector<ConnectionInfo> hosts = Fleet::get_selected_hosts(description);
+        load_hosts(hosts, description);
+    }
+
+private:
+    void load_all() {
+        std::vector<ConnectionInfo> hosts;
+        for (const auto& conn : ConnectionManager::load_connections()) {
+            if (conn.connection_type == "SSH") {
+                hosts.push_back(conn);
+            }
+        }
+        load_hosts(hosts, "All connections");
+    }
+
+    void load_hosts(const std::vector<ConnectionInfo>& hosts, const Glib::ustring& description) {
+        if (is_busy()) return;
+        targets.clear();
+        store->clear();
+        std::map<std::string, size_t> by_name;
+        for (const auto& conn : hosts) {
+            if (conn.host.empty()) continue;
+            int port = conn.port > 0 ? conn.port : 22;
+            std::string name = known_hosts_name(conn.host, port);
+            auto found = by_name.find(name);
+            if (found != by_name.end()) {
+                targets[found->second]->connections += ", " + conn.name;
+                continue;
+            }
+            auto target = std::make_unique<Target>();
+            target->host = conn.host;
+            target->port = port;
+            target->name = name;
+            target->connections = conn.name;
+            // ssh-keyscan connects directly, so hosts behind a bastion cannot be reached
+            if (!ConnectionManager::resolve_jump_chain(conn).empty()) {
+                target->state = Target::State::Skipped;
+                target->detail = "Reached through a jump host";
+            }
+            by_name[name] = targets.size();
+            targets.push_back(std::move(target));
+        }
+        rows.clear();
+        for (size_t i = 0; i < targets.size(); ++i) {
+            Gtk::TreeModel::Row row = *store->append();
+            row[columns.index] = i;
+            row[columns.address] = targets[i]->host + ":" + std::to_string(targets[i]->port);
+            rows.push_back(row);
+            update_row(i);
+        }
+        hosts_label.set_text(description + " (" + std::to_string(targets.size()) + " addresses)");
+        summary_label.set_text("");
+        update_buttons();
+    }
+
+    void on_scan() {
+        if (is_busy() || targets.empty()) return;
+
+        // The keys on record for each host, read once per scan
+        std::vector<std::pair<std::string, Key>> entries;
+        for (const auto& line : read_lines(known_hosts_path())) {
+            std::string hosts;
+            Key key;
+            if (parse_line(line, hosts, key)) {
+                entries.emplace_back(hosts, key);
+            }
+        }
+
+        int timeout = timeout_spin.get_value_as_int();
+        pool.set_max_running(parallel_spin.get_value_as_int());
+        for (size_t i = 0; i < targets.size(); ++i) {
+            Target& target = *targets[i];
+            if (target.state == Target::State::Skipped) continue;
+            target.state = Target::State::Waiting;
+            target.scanned.clear();
+            target.known.clear();
+            target.errors.clear();
+            target.detail.clear();
+            for (const auto& entry : entries) {
+                if (host_matches(entry.first, target.name)) {
+                    target.known.push_back(entry.second);
+                }
+            }
+            update_row(i);
+
+            auto output = std::make_shared<std::string>();
+            Fleet::Job job;
+            job.argv = {"ssh-keyscan", "-T", std::to_string(timeout), "-p", std::to_string(target.port), target.host};
+            job.timeout_seconds = timeout * 3 + 5; // ssh-keyscan's own timeout applies per step
+            job.on_start = [this, i]() {
+                targets[i]->state = Target::State::Scanning;
+                update_row(i);
+            };
+            job.on_output = [this, i, output](const std::string& data, bool is_stderr) {
+                if (is_stderr) {
+                    targets[i]->errors += data;
+                } else {
+                    *output += data;
+                }
+            };
+            job.on_done = [this, i, output](const Fleet::Result& result) {
+                finish_target(i, *output, result);
+            };
+            pool.add(std::move(job));
+        }
+        update_buttons();
+        update_summary();
+    }
+
+    void on_cancel() {
+        pool.cancel();
+        for (size_t i = 0; i < targets.size(); ++i) {
+            if (targets[i]->state == Target::State::Waiting || targets[i]->state == Target::State::Scanning) {
+                targets[i]->state = Target::State::Cancelled;
+                update_row(i);
+            }
+        }
+        update_buttons();
+        update_summary();
+    }
+
+    void finish_target(size_t index, const std::string& output, const Fleet::Result& result) {
+        Target& target = *targets[index];
+        std::istringstream lines(output);
+        std::string line;
+        while (std::getline(lines, line)) {
+            std::string hosts;
+            Key key;
+            if (parse_line(line, hosts, key)) {
+                target.scanned.push_back(key);
+            }
+        }
+
+        if (target.scanned.empty()) {
+            target.state = Target::State::NoResponse;
+            if (!result.error.empty()) {
+                target.detail = result.error;
+            } else if (result.timed_out) {
+                target.detail = "Timed out";
+            } else {
+                // The last message that is not one of the "# host:port SSH-2.0-..." banners
+                std::istringstream errors(target.errors);
+                while (std::getline(errors, line)) {
+                    if (!line.empty() && line[0] != '#') target.detail = line;
+                }
+            }
+        } else {
+            bool is_new = false, changed = false;
+            for (const auto& key : target.scanned) {
+                if (is_known(target, key)) continue;
+                bool same_type = false;
+                for (const auto& known : target.known) {
+                    same_type = same_type || known.type == key.type;
+                }
+                (same_type ? changed : is_new) = true;
+            }
+            target.state = changed ? Target::State::Changed : is_new ? Target::State::New : Target::State::Known;
+        }
+        rows[index][columns.accept] = target.state == Target::State::New;
+        update_row(index);
+        update_buttons();
+        update_summary();
+    }
+
+    static bool is_known(const Target& target, const Key& key) {
+        for (const auto& known : target.known) {
+            if (known == key) return true;
+        }
+        return false;
+    }
+
+    // Keys of the host that are not on record yet
+    static std::vector<Key> unknown_keys(const Target& target) {
+        std::vector<Key> keys;
+        for (const auto& key : target.scanned) {
+            if (!is_known(target, key)) keys.push_back(key);
+        }
+        return keys;
+    }
+
+    void on_write() {
+        if (is_busy()) return;
+
+        // Changed hosts lose every line that names them, like ssh-keygen -R, and get the
+        // scanned keys instead; new hosts only get the keys that are missing
+        std::vector<size_t> accepted;
+        std::vector<std::string> replaced;
+        for (size_t i = 0; i < targets.size(); ++i) {
+            const Target& target = *targets[i];
+            bool accept = rows[i][columns.accept];
+            if (!accept) continue;
+            if (target.state == Target::State::New || target.state == Target::State::Changed) {
+                accepted.push_back(i);
+            }
+            if (target.state == Target::State::Changed) {
+                replaced.push_back(target.name);
+            }
+        }
+        if (accepted.empty()) return;
+
+        std::string path = known_hosts_path();
+        std::vector<std::string> lines = read_lines(path);
+        std::string original, contents;
+        int removed = 0;
+        for (const auto& line : lines) {
+            original += line + "\n";
+            std::string hosts;
+            Key key;
+            bool drop = false;
+            if (parse_line(line, hosts, key)) {
+                for (const auto& name : replaced) {
+                    drop = drop || host_matches(hosts, name);
+                }
+            }
+            if (drop) {
+                removed++;
+            } else {
+                contents += line + "\n";
+            }
+        }
+        int added = 0;
+        for (size_t index : accepted) {
+            const Target& target = *targets[index];
+            std::vector<Key> keys = target.state == Target::State::Changed ? target.scanned : unknown_keys(target);
+            for (const auto& key : keys) {
+                contents += target.name + " " + key.type + " " + key.blob + "\n";
+                added++;
+            }
+        }
+
+        try {
+            g_mkdir_with_parents(Glib::path_get_dirname(path).c_str(), 0700);
+            if (removed > 0) {
+                Glib::file_set_contents(path + ".old", original);
+            }
+            Glib::file_set_contents(path, contents);
+        } catch (const Glib::FileError& e) {
+            Gtk::MessageDialog dialog(*this, "Cannot Write known_hosts", false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
+            dialog.set_secondary_text(e.what());
+            dialog.run();
+            return;
+        }
+
+        for (size_t index : accepted) {
+            Target& target = *targets[index];
+            target.known = target.scanned;
+            target.state = Target::State::Known;
+            rows[index][columns.accept] = false;
+            update_row(index);
+        }
+        update_buttons();
+        summary_label.set_text("Wrote " + std::to_string(added) + " keys for " + std::to_string(accepted.size()) +
+                               " hosts to " + path + (removed > 0 ? " (previous file kept as known_hosts.old)" : ""));
+    }
+
+    void update_row(size_t index) {
+        const Target& target = *targets[index];
+        Gtk::TreeModel::Row& row = rows[index];
+        row[columns.connections] = target.connections;
+
+        Glib::ustring status;
+        switch (target.state) {
+            case Target::State::Waiting: status = "Waiting"; break;
+            case Target::State::Scanning: status = "Scanning"; break;
+            case Target::State::Known: status = "Known"; break;
+            case Target::State::New: status = "New"; break;
+            case Target::State::Changed: status = "CHANGED"; break;
+            case Target::State::NoResponse: status = "No response"; break;
+            case Target::State::Skipped: status = "Skipped"; break;
+            case Target::State::Cancelled: status = "Cancelled"; break;
+        }
+        if (!target.detail.empty()) status += ": " + target.detail;
+        row[columns.status] = status;
+
+        std::string fingerprints;
+        for (const auto& key : target.state == Target::State::Known ? target.scanned : unknown_keys(target)) {
+            if (!fingerprints.empty()) fingerprints += "\n";
+            fingerprints += key.type + " " + fingerprint(key);
+        }
+        row[columns.fingerprints] = fingerprints;
+    }
+
+    void update_buttons() {
+        bool busy = is_busy();
+        bool pending = false;
+        for (const auto& target : targets) {
+            pending = pending || target->state == Target::State::New || target->state == Target::State::Changed;
+        }
+        scan_button.set_sensitive(!busy && !targets.empty());
+        selection_button.set_sensitive(!busy);
+        all_button.set_sensitive(!busy);
+        cancel_button.set_sensitive(busy);
+        write_button.set_sensitive(!busy && pending);
+    }
+
+    void update_summary() {
+        int known = 0, is_new = 0, changed = 0, failed = 0;
+        for (const auto& target : targets) {
+            switch (target->state) {
+                case Target::State::Known: known++; break;
+                case Target::State::New: is_new++; break;
+                case Target::State::Changed: changed++; break;
+                case Target::State::NoResponse: failed++; break;
+                default: break;
+            }
+        }
+        Glib::ustring summary = std::to_string(is_new) + " new, " + std::to_string(changed) + " changed, " +
+                                std::to_string(known) + " known, " + std::to_string(failed) + " no response";
+        if (is_busy()) {
+            summary += ", " + std::to_string(pool.get_running() + pool.get_queued()) + " to go";
+        }
+        summary_label.set_text(summary);
+    }
+
+    Gtk::Box box;
+    Gtk::Box action_box;
+    Gtk::Label hosts_label;
+    Gtk::Button selection_button;
+    Gtk::Button all_button;
+    Gtk::SpinButton parallel_spin;
+    Gtk::SpinButton timeout_spin;
+    Gtk::ScrolledWindow scrolled;
+    Gtk::TreeView view;
+    Gtk::Label summary_label;
+    Gtk::Button scan_button;
+    Gtk::Button cancel_button;
+    Gtk::Button write_button;
+    KeyColumns columns;
+    Glib::RefPtr<Gtk::ListStore> store;
+    std::vector<Gtk::TreeModel::Row> rows; // By target index
+
+    std::vector<std::unique_ptr<Target>> targets;
+    Fleet::Pool pool;
+};
+
+HostKeysWindow* host_keys_window = nullptr;
+
+} // namespace
+
+void show_window(Gtk::Window& parent) {
+    if (!host_keys_window) {
+        host_keys_window = new HostKeysWindow(parent);
+    }
+    if (!host_keys_window->is_busy()) {
+        host_keys_window->load_selection();
+    }
+    host_keys_window->present();
+}
+
+} // namespace HostKeys
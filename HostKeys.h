@@ -0,0 +1,15 @@
+#ifndef HOSTKEYS_H
+#define HOSTKEYS_H
+
+#include <gtkmm/window.h>
+
+namespace HostKeys {
+
+// Show the window that fetches the host keys of the tree selection or of every saved SSH
+// connection in parallel, compares them with ~/.ssh/known_hosts and writes the accepted
+// new or changed keys in one go, so first connections do not stop at the host key prompt.
+void show_window(Gtk::Window& parent);
+
+} // namespace HostKeys
+
+#endif // HOSTKEYS_H
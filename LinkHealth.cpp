@@ -0,0 +1,368 @@
+#include "LinkHealth.h"
+#include "Fleet.h"
+#include "PtyRelay.h"
+#include "Ssh.h"
+#include "Tools.h"
+#include <glibmm/main.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/inet_diag.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace LinkHealth {
+
+namespace {
+
+struct Entry {
+    Status status;
+    unsigned long inode = 0;       // Socket the status was read from
+    guint32 total_retrans = 0;     // Its retransmit counter at the previous probe
+    bool jump_resolved = false;    // jump_master was looked up
+    std::string jump_master;       // Key of the jump host master in masters, empty if direct
+};
+
+// Shared master of the first jump host. It runs detached from the tabs behind it and holds
+// their TCP connection; the tabs themselves only talk to it over a Unix socket.
+struct Master {
+    std::vector<std::string> args; // Its control socket, for ssh -O check
+    GPid pid = 0;                  // From the last check, 0 if unknown
+    bool checking = false;
+    gint64 checked_at = 0;         // Monotonic time of the last check
+};
+
+struct Socket {
+    tcp_info info;
+    bool loopback = false;         // Forwarded connections to local clients, not the link
+};
+
+const unsigned int PROBE_INTERVAL_MS = 2000;
+const int SLOW_RTT_MS = 300;
+const guint32 STALL_MS = 5000;    // Sent data unacknowledged this long means the link is gone
+const int MAX_DEPTH = 4;          // sshpass -> ssh -> ProxyCommand ssh -> ...
+const gint64 MASTER_RECHECK_US = 10 * G_USEC_PER_SEC;
+const int MASTER_CHECK_TIMEOUT_S = 10;
+
+std::unordered_map<GtkWidget*, Entry> entries_by_page;
+std::map<std::string, Master> masters;
+Fleet::Pool master_checks(4);
+sigc::signal<void> updated_signal;
+
+bool is_probed(const Session& session) {
+    return session.connection_type == "SSH" && session.terminal && session.page &&
+           !session.placeholder && !session.child_exited;
+}
+
+// Socket inodes held by a process and its descendants, the process's own first. The children
+// file needs CONFIG_PROC_CHILDREN, which distribution kernels enable.
+void collect_socket_inodes(GPid pid, int depth, std::vector<unsigned long>& inodes) {
+    std::string proc = "/proc/" + std::to_string(pid);
+    std::string fd_dir = proc + "/fd";
+    if (GDir* dir = g_dir_open(fd_dir.c_str(), 0, nullptr)) {
+        while (const gchar* name = g_dir_read_name(dir)) {
+            std::string link = fd_dir + "/" + name;
+            gchar* target = g_file_read_link(link.c_str(), nullptr);
+            unsigned long inode = 0;
+            if (target && sscanf(target, "socket:[%lu]", &inode) == 1) {
+                inodes.push_back(inode);
+            }
+            g_free(target);
+        }
+        g_dir_close(dir);
+    }
+    if (depth >= MAX_DEPTH) return;
+
+    std::ifstream children(proc + "/task/" + std::to_string(pid) + "/children");
+    GPid child = 0;
+    while (children >> child) {
+        collect_socket_inodes(child, depth + 1, inodes);
+    }
+}
+
+// Look up the jump host master of a tab once; the chain comes from the saved connections
+const std::string& get_jump_master(const Session& session, Entry& entry) {
+    if (!entry.jump_resolved) {
+        entry.jump_resolved = true;
+        if (!session.connection_id.empty()) {
+            ConnectionInfo conn = ConnectionManager::get_connection_by_id(session.connection_id);
+            std::vector<std::string> args = Ssh::get_jump_master_args(conn);
+            if (!args.empty()) {
+                for (const auto& arg : args) {
+                    entry.jump_master += arg + '\n';
+                }
+                masters[entry.jump_master].args = args;
+            }
+        }
+    }
+    return entry.jump_master;
+}
+
+// "ssh -O check" answers "Master running (pid=N)" on stderr. It runs in the background, so
+// the pid is there from a later probe on.
+void check_master(const std::string& key) {
+    Master& master = masters[key];
+    gint64 now = g_get_monotonic_time();
+    if (master.checking || (master.checked_at && now - master.checked_at < MASTER_RECHECK_US)) return;
+    std::string ssh = Tools::get_path("ssh");
+    if (ssh.empty()) return;
+
+    master.checking = true;
+    master.checked_at = now;
+    auto output = std::make_shared<std::string>();
+    Fleet::Job job;
+    job.argv = {ssh, "-O", "check"};
+    job.argv.insert(job.argv.end(), master.args.begin(), master.args.end());
+    job.timeout_seconds = MASTER_CHECK_TIMEOUT_S;
+    job.on_output = [output](const std::string& data, bool) { *output += data; };
+    job.on_done = [key, output](const Fleet::Result& result) {
+        Master& master = masters[key];
+        master.checking = false;
+        master.pid = 0;
+        size_t at = output->find("(pid=");
+        if (result.exit_status == 0 && at != std::string::npos) {
+            master.pid = static_cast<GPid>(atoi(output->c_str() + at + 5));
+        }
+    };
+    master_checks.add(std::move(job));
+}
+
+bool is_loopback(const inet_diag_msg& diag) {
+    const unsigned char* address = reinterpret_cast<const unsigned char*>(diag.id.idiag_dst);
+    if (diag.idiag_family == AF_INET) {
+        return address[0] == 127;
+    }
+    static const unsigned char V6_LOOPBACK[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+    static const unsigned char V4_MAPPED[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+    return memcmp(address, V6_LOOPBACK, 16) == 0 ||
+           (memcmp(address, V4_MAPPED, 12) == 0 && address[12] == 127);
+}
+
+// One sock_diag dump per address family covers every established TCP socket on the machine;
+// only the ones held by SSH tabs are kept
+std::unordered_map<unsigned long, Socket> query_sockets(const std::unordered_set<unsigned long>& wanted) {
+    std::unordered_map<unsigned long, Socket> found;
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+    if (fd < 0) return found;
+
+    for (int family : {AF_INET, AF_INET6}) {
+        struct {
+            nlmsghdr header;
+            inet_diag_req_v2 request;
+        } message = {};
+        message.header.nlmsg_len = sizeof(message);
+        message.header.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+        message.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+        message.request.sdiag_family = family;
+        message.request.sdiag_protocol = IPPROTO_TCP;
+        message.request.idiag_states = 1 << TCP_ESTABLISHED;
+        message.request.idiag_ext = 1 << (INET_DIAG_INFO - 1);
+        if (send(fd, &message, sizeof(message), 0) < 0) break;
+
+        alignas(nlmsghdr) char buffer[32768];
+        bool done = false;
+        while (!done) {
+            ssize_t length = recv(fd, buffer, sizeof(buffer), 0);
+            if (length <= 0) break;
+            for (nlmsghdr* header = reinterpret_cast<nlmsghdr*>(buffer); NLMSG_OK(header, length);
+                 header = NLMSG_NEXT(header, length)) {
+                if (header->nlmsg_type == NLMSG_DONE || header->nlmsg_type == NLMSG_ERROR) {
+                    done = true;
+                    break;
+                }
+                const inet_diag_msg* diag = static_cast<const inet_diag_msg*>(NLMSG_DATA(header));
+                if (!wanted.count(diag->idiag_inode)) continue;
+
+                Socket socket_info;
+                memset(&socket_info.info, 0, sizeof(socket_info.info));
+                socket_info.loopback = is_loopback(*diag);
+                int attributes_length = static_cast<int>(header->nlmsg_len - NLMSG_LENGTH(sizeof(*diag)));
+                for (rtattr* attribute = reinterpret_cast<rtattr*>(const_cast<inet_diag_msg*>(diag + 1));
+                     RTA_OK(attribute, attributes_length); attribute = RTA_NEXT(attribute, attributes_length)) {
+                    if (attribute->rta_type == INET_DIAG_INFO) {
+                        // Older kernels send a shorter struct, the missing fields stay zero
+                        memcpy(&socket_info.info, RTA_DATA(attribute),
+                               std::min<size_t>(RTA_PAYLOAD(attribute), sizeof(socket_info.info)));
+                    }
+                }
+                found[diag->idiag_inode] = socket_info;
+            }
+        }
+    }
+    ::close(fd);
+    return found;
+}
+
+// The ssh connection is the first socket that does not stay on this machine; a tab connected
+// to localhost has only loopback sockets and falls back to the first of those
+const unsigned long* pick_socket(const std::vector<unsigned long>& inodes,
+                                 const std::unordered_map<unsigned long, Socket>& sockets) {
+    const unsigned long* fallback = nullptr;
+    for (const auto& inode : inodes) {
+        auto it = sockets.find(inode);
+        if (it == sockets.end()) continue;
+        if (!it->second.loopback) return &inode;
+        if (!fallback) fallback = &inode;
+    }
+    return fallback;
+}
+
+Status evaluate(const tcp_info& info, guint32 new_retransmits) {
+    Status status;
+    status.rtt_ms = static_cast<int>(info.tcpi_rtt / 1000);
+    guint32 quiet_ms = std::min(info.tcpi_last_data_recv, info.tcpi_last_ack_recv);
+    status.last_seen = g_get_real_time() - static_cast<gint64>(quiet_ms) * 1000;
+
+    // ServerAlive probes make sure there is something in flight on an idle session. Data that
+    // went out after a long quiet spell has an old last ACK too, so it only counts once the
+    // retransmit timer fired for it.
+    guint32 stall_ms = std::max<guint32>(STALL_MS, 4 * info.tcpi_rtt / 1000);
+    bool stalled = info.tcpi_unacked > 0 && info.tcpi_retransmits > 0 && info.tcpi_last_ack_recv >= stall_ms;
+    if (stalled || info.tcpi_backoff >= 3) {
+        status.state = State::Down;
+    } else if (new_retransmits > 0 || info.tcpi_retransmits > 0 || status.rtt_ms >= SLOW_RTT_MS) {
+        status.state = State::Slow;
+    } else {
+        status.state = State::Good;
+    }
+    return status;
+}
+
+// Only a changed state or a clearly different round trip is worth relaying out the tab bar
+bool is_visible_change(const Status& before, const Status& after) {
+    if (before.state != after.state) return true;
+    int delta = std::abs(after.rtt_ms - before.rtt_ms);
+    return delta >= 5 && delta * 5 >= before.rtt_ms;
+}
+
+struct Probe {
+    Session* session;
+    std::vector<unsigned long> inodes;        // Of the tab's own processes
+    std::vector<unsigned long> master_inodes; // Of its jump host master
+};
+
+bool on_probe() {
+    std::vector<Probe> probes;
+    std::unordered_set<unsigned long> wanted;
+    for (Session* session : SessionRegistry::all()) {
+        GtkWidget* page = session->page ? GTK_WIDGET(session->page->gobj()) : nullptr;
+        if (!is_probed(*session)) {
+            auto it = entries_by_page.find(page);
+            if (it != entries_by_page.end()) {
+                entries_by_page.erase(it);
+                SessionRegistry::refresh_tab_label(*session);
+            }
+            continue;
+        }
+        Probe probe = {session, {}, {}};
+        PtyRelay* relay = PtyRelay::get(session->terminal);
+        if (relay && relay->is_running()) {
+            collect_socket_inodes(relay->get_child_pid(), 0, probe.inodes);
+        }
+        const std::string& jump_master = get_jump_master(*session, entries_by_page[page]);
+        if (!jump_master.empty() && masters[jump_master].pid > 0) {
+            collect_socket_inodes(masters[jump_master].pid, MAX_DEPTH, probe.master_inodes);
+        }
+        wanted.insert(probe.inodes.begin(), probe.inodes.end());
+        wanted.insert(probe.master_inodes.begin(), probe.master_inodes.end());
+        probes.push_back(std::move(probe));
+    }
+
+    std::unordered_map<unsigned long, Socket> sockets;
+    if (!wanted.empty()) {
+        sockets = query_sockets(wanted);
+    }
+
+    for (auto& probe : probes) {
+        Session* session = probe.session;
+        Entry& entry = entries_by_page[GTK_WIDGET(session->page->gobj())];
+        Status before = entry.status;
+
+        // Behind a jump host the tab has no TCP socket of its own
+        const unsigned long* inode = pick_socket(probe.inodes, sockets);
+        bool via_bastion = false;
+        if (!inode && !entry.jump_master.empty()) {
+            inode = pick_socket(probe.master_inodes, sockets);
+            via_bastion = inode != nullptr;
+            if (!inode) check_master(entry.jump_master);
+        }
+        if (inode) {
+            const tcp_info& info = sockets[*inode].info;
+            // A reconnect brings a new socket whose counter starts over
+            guint32 new_retransmits = (entry.inode == *inode && info.tcpi_total_retrans > entry.total_retrans)
+                ? info.tcpi_total_retrans - entry.total_retrans : 0;
+            entry.status = evaluate(info, new_retransmits);
+            entry.status.via_bastion = via_bastion;
+            entry.inode = *inode;
+            entry.total_retrans = info.tcpi_total_retrans;
+        } else {
+            entry.status = Status();
+            entry.inode = 0;
+            entry.total_retrans = 0;
+        }
+
+        if (is_visible_change(before, entry.status)) {
+            SessionRegistry::refresh_tab_label(*session);
+        }
+    }
+    updated_signal.emit();
+    return true;
+}
+
+} // namespace
+
+void track(Gtk::Notebook& notebook) {
+    notebook.signal_page_removed().connect([](Gtk::Widget* page, guint) {
+        if (!page) return;
+        entries_by_page.erase(GTK_WIDGET(page->gobj()));
+    });
+    Glib::signal_timeout().connect(sigc::ptr_fun(&on_probe), PROBE_INTERVAL_MS);
+}
+
+Status get_status(const Session& session) {
+    if (!session.page) return Status();
+    auto it = entries_by_page.find(GTK_WIDGET(session.page->gobj()));
+    return (it != entries_by_page.end()) ? it->second.status : Status();
+}
+
+Glib::ustring describe(const Status& status) {
+    Glib::ustring rtt = "RTT " + std::to_string(status.rtt_ms) + " ms";
+    Glib::ustring link = status.via_bastion ? " (link to the jump host)" : "";
+    switch (status.state) {
+        case State::Good:
+            return "Good, " + rtt + link;
+        case State::Slow:
+            return "Slow, " + rtt + link;
+        case State::Down:
+            return "Not responding" + link;
+        case State::Unknown:
+            break;
+    }
+    return "";
+}
+
+Glib::ustring describe_last_seen(const Status& status) {
+    if (status.state == State::Unknown || status.last_seen == 0) return "";
+    gint64 seconds = std::max<gint64>(0, (g_get_real_time() - status.last_seen) / G_USEC_PER_SEC);
+    if (seconds < 1) return "just now";
+    if (seconds < 120) return std::to_string(seconds) + " s ago";
+    return std::to_string(seconds / 60) + " min ago";
+}
+
+sigc::signal<void>& signal_updated() {
+    return updated_signal;
+}
+
+} // namespace LinkHealth
@@ -0,0 +1,40 @@
+#ifndef LINKHEALTH_H
+#define LINKHEALTH_H
+
+#include <gtkmm/notebook.h>
+#include <glibmm/ustring.h>
+#include <sigc++/signal.h>
+#include "Sessions.h"
+
+// Health of the TCP connection behind each SSH tab, read from the kernel's view of the
+// ssh socket (round trip time, unacknowledged data, retransmits) every few seconds. A tab
+// behind a jump host shows the connection of the jump host's shared master.
+namespace LinkHealth {
+
+enum class State { Unknown, Good, Slow, Down };
+
+struct Status {
+    State state = State::Unknown; // Unknown while no TCP socket of the session was found
+    int rtt_ms = -1;              // Smoothed round trip time, -1 if unknown
+    gint64 last_seen = 0;         // Real time (us) the server last sent anything, 0 if unknown
+    bool via_bastion = false;     // Read from the jump host master, not from the tab's own ssh
+};
+
+// Probe the SSH tabs of the notebook and forget closed tabs
+void track(Gtk::Notebook& notebook);
+
+// Last probe result for a tab
+Status get_status(const Session& session);
+
+// "Good", "Slow" or "Not responding" with the round trip time, empty when unknown
+Glib::ustring describe(const Status& status);
+
+// "3 s ago", empty when unknown
+Glib::ustring describe_last_seen(const Status& status);
+
+// Emitted after every probe round, for views that show the numbers
+sigc::signal<void>& signal_updated();
+
+} // namespace LinkHealth
+
+#endif // LINKHEALTH_H
@@ -0,0 +1,285 @@
+#include "LocalEcho.h"
+#include "PtyRelay.h"
+#include <glibmm/main.h>
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace LocalEcho {
+
+namespace {
+
+// Predictions the remote side has not echoed by then are taken back, and no more are
+// shown until Enter: the line is probably not echoed (a password prompt we did not spot)
+const unsigned int ECHO_TIMEOUT_MS = 1500;
+
+// Predictions are typed characters drawn underlined right after the cursor. They are
+// always the last thing fed to the terminal: real output first erases them, and the
+// ones still unconfirmed are drawn again after it. Only printable ASCII is predicted,
+// so one byte is one cell, and never past the end of the line.
+struct Entry {
+    VteTerminal* terminal = nullptr;
+    bool enabled = false;
+    std::string predicted;          // Typed characters not echoed yet
+    long displayed = 0;             // Cells drawn for them right now
+    bool paused = false;            // Other input was typed, wait for output
+    bool suspended = false;         // No echo came; wait for Enter
+    bool alternate_screen = false;  // A full-screen application is running
+
+    // Scanner for the alternate screen mode switches in the output
+    enum class Scan { Ground, Escape, Csi } scan = Scan::Ground;
+    std::string csi_params;
+
+    sigc::connection echo_timer;
+    std::vector<sigc::connection> connections;
+};
+
+std::unordered_map<GtkWidget*, Entry> entries_by_page;
+
+void erase(Entry& entry) {
+    if (entry.displayed == 0 || !entry.terminal) return;
+    // Back to where the predictions start, then blank them without moving the cursor
+    std::string sequence = "\033[" + std::to_string(entry.displayed) + "D\033[" +
+                           std::to_string(entry.displayed) + "X";
+    vte_terminal_feed(entry.terminal, sequence.data(), sequence.size());
+    entry.displayed = 0;
+}
+
+void clear(Entry& entry) {
+    erase(entry);
+    entry.predicted.clear();
+    entry.echo_timer.disconnect();
+}
+
+// Draw the predictions not shown yet, as far as the line allows
+void draw(Entry& entry) {
+    if (!entry.terminal || entry.alternate_screen) return;
+    long pending = static_cast<long>(entry.predicted.size()) - entry.displayed;
+    if (pending <= 0) return;
+
+    glong column = 0;
+    vte_terminal_get_cursor_position(entry.terminal, &column, nullptr);
+    long room = vte_terminal_get_column_count(entry.terminal) - 1 - column;
+    long count = std::min(pending, room);
+    if (count <= 0) return;
+
+    // Underline on and off again; this only disturbs an application's own underline
+    std::string sequence = "\033[4m" + entry.predicted.substr(entry.displayed, count) + "\033[24m";
+    vte_terminal_feed(entry.terminal, sequence.data(), sequence.size());
+    entry.displayed += count;
+}
+
+// Password and passphrase prompts are not echoed, never show what is typed into them
+bool at_password_prompt(Entry& entry) {
+    glong column = 0;
+    glong row = 0;
+    vte_terminal_get_cursor_position(entry.terminal, &column, &row);
+    char* text = vte_terminal_get_text_range(entry.terminal, row, 0, row, column,
+                                             nullptr, nullptr, nullptr);
+    if (!text) return false;
+    std::string line(text);
+    g_free(text);
+    std::transform(line.begin(), line.end(), line.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return line.find("password") != std::string::npos ||
+           line.find("passphrase") != std::string::npos ||
+           line.find("pin:") != std::string::npos;
+}
+
+void restart_echo_timer(GtkWidget* page, Entry& entry) {
+    entry.echo_timer.disconnect();
+    if (entry.predicted.empty()) return;
+    entry.echo_timer = Glib::signal_timeout().connect([page]() {
+        auto it = entries_by_page.find(page);
+        if (it != entries_by_page.end()) {
+            clear(it->second);
+            it->second.suspended = true;
+        }
+        return false;
+    }, ECHO_TIMEOUT_MS);
+}
+
+void on_input(GtkWidget* page, const char* text, gsize size) {
+    auto it = entries_by_page.find(page);
+    if (it == entries_by_page.end() || !it->second.enabled) return;
+    Entry& entry = it->second;
+
+    bool start_timer = entry.predicted.empty();
+    for (gsize i = 0; i < size; ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c < 0x7f) {
+            if (entry.paused || entry.suspended || entry.alternate_screen) continue;
+            if (entry.predicted.empty() && at_password_prompt(entry)) {
+                entry.suspended = true;
+                continue;
+            }
+            entry.predicted += static_cast<char>(c);
+        } else {
+            // Enter, editing keys, escape sequences and non-ASCII text: let the remote
+            // side show the result before predicting again
+            clear(entry);
+            entry.paused = true;
+            if (c == '\r') {
+                entry.suspended = false;
+            }
+        }
+    }
+
+    draw(entry);
+    if (start_timer) {
+        restart_echo_timer(page, entry);
+    }
+}
+
+// Track the alternate screen (DECSET 47, 1047, 1049) across read boundaries
+void scan_output_byte(Entry& entry, unsigned char c) {
+    switch (entry.scan) {
+        case Entry::Scan::Ground:
+            if (c == 0x1b) entry.scan = Entry::Scan::Escape;
+            break;
+        case Entry::Scan::Escape:
+            if (c == '[') {
+                entry.scan = Entry::Scan::Csi;
+                entry.csi_params.clear();
+            } else {
+                entry.scan = Entry::Scan::Ground;
+            }
+            break;
+        case Entry::Scan::Csi:
+            if (c >= 0x40 && c <= 0x7e) {
+                if ((c == 'h' || c == 'l') &&
+                    (entry.csi_params == "?1049" || entry.csi_params == "?1047" || entry.csi_params == "?47")) {
+                    entry.alternate_screen = (c == 'h');
+                }
+                entry.scan = Entry::Scan::Ground;
+            } else if (entry.csi_params.size() < 16) {
+                entry.csi_params += static_cast<char>(c);
+            }
+            break;
+    }
+}
+
+void on_output(GtkWidget* page, const char* data, gsize length) {
+    auto it = entries_by_page.find(page);
+    if (it == entries_by_page.end()) return;
+    Entry& entry = it->second;
+
+    // Keep following the screen mode while disabled, so enabling it in vim stays quiet
+    if (!entry.enabled) {
+        for (gsize i = 0; i < length; ++i) {
+            scan_output_byte(entry, static_cast<unsigned char>(data[i]));
+        }
+        return;
+    }
+
+    // The real output goes where the predictions are drawn
+    erase(entry);
+    entry.paused = false;
+
+    bool confirmed = false;
+    for (gsize i = 0; i < length; ++i) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        bool ground = (entry.scan == Entry::Scan::Ground && c != 0x1b);
+        scan_output_byte(entry, c);
+        if (entry.predicted.empty()) continue;
+
+        if (ground && c == static_cast<unsigned char>(entry.predicted.front())) {
+            entry.predicted.erase(0, 1);
+            confirmed = true;
+        } else {
+            // Anything else than the expected echo (redraws, colors, completion) ends the guess
+            entry.predicted.clear();
+            entry.echo_timer.disconnect();
+        }
+    }
+    if (entry.alternate_screen) {
+        entry.predicted.clear();
+    }
+    if (confirmed) {
+        restart_echo_timer(page, entry);
+    }
+}
+
+void on_output_shown(GtkWidget* page) {
+    auto it = entries_by_page.find(page);
+    if (it != entries_by_page.end() && it->second.enabled) {
+        draw(it->second);
+    }
+}
+
+void forget(GtkWidget* page) {
+    auto it = entries_by_page.find(page);
+    if (it == entries_by_page.end()) return;
+    it->second.echo_timer.disconnect();
+    for (auto& connection : it->second.connections) {
+        connection.disconnect();
+    }
+    entries_by_page.erase(it);
+}
+
+} // namespace
+
+void track(Gtk::Notebook& notebook) {
+    notebook.signal_page_removed().connect([](Gtk::Widget* page, guint) {
+        if (page) {
+            forget(GTK_WIDGET(page->gobj()));
+        }
+    });
+}
+
+void attach(Session& session, bool enabled) {
+    PtyRelay* relay = PtyRelay::get(session.terminal);
+    if (!relay || !session.page) return;
+
+    GtkWidget* page = GTK_WIDGET(session.page->gobj());
+    forget(page);
+    Entry& entry = entries_by_page[page];
+    entry.terminal = session.terminal;
+    entry.enabled = enabled;
+
+    entry.connections.push_back(relay->signal_input().connect([page](const char* text, gsize size) {
+        on_input(page, text, size);
+    }));
+    entry.connections.push_back(relay->signal_output().connect([page](const char* data, gsize length) {
+        on_output(page, data, length);
+    }));
+    entry.connections.push_back(relay->signal_output_shown().connect([page](const char*, gsize) {
+        on_output_shown(page);
+    }));
+    // Predictions would end up in the wrong place after a resize or a new child
+    entry.connections.push_back(relay->signal_resize().connect([page](int, int) {
+        auto it = entries_by_page.find(page);
+        if (it != entries_by_page.end()) clear(it->second);
+    }));
+    entry.connections.push_back(relay->signal_child_exited().connect([page](int) {
+        auto it = entries_by_page.find(page);
+        if (it != entries_by_page.end()) {
+            clear(it->second);
+            it->second.alternate_screen = false;
+            it->second.scan = Entry::Scan::Ground;
+        }
+    }));
+}
+
+void toggle(Session& session) {
+    if (!session.page) return;
+    auto it = entries_by_page.find(GTK_WIDGET(session.page->gobj()));
+    if (it == entries_by_page.end()) return;
+
+    Entry& entry = it->second;
+    clear(entry);
+    entry.enabled = !entry.enabled;
+    entry.paused = false;
+    entry.suspended = false;
+    SessionRegistry::refresh_tab_label(session);
+}
+
+bool is_enabled(const Session& session) {
+    if (!session.page) return false;
+    auto it = entries_by_page.find(GTK_WIDGET(session.page->gobj()));
+    return it != entries_by_page.end() && it->second.enabled;
+}
+
+} // namespace LocalEcho
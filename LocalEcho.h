@@ -0,0 +1,22 @@
+#ifndef LOCALECHO_H
+#define LOCALECHO_H
+
+#include <gtkmm/notebook.h>
+#include "Sessions.h"
+
+namespace LocalEcho {
+
+// Forget closed tabs
+void track(Gtk::Notebook& notebook);
+
+// Prepare a session's terminal for predictive local echo, enabled or not
+void attach(Session& session, bool enabled);
+
+// Turn predictive local echo on or off for a tab
+void toggle(Session& session);
+
+bool is_enabled(const Session& session);
+
+} // namespace LocalEcho
+
+#endif // LOCALECHO_H
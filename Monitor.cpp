@@ -0,0 +1,154 @@
+#include "Monitor.h"
+#include "Config.h"
+#include "PtyRelay.h"
+#include <glibmm/main.h>
+#include <unordered_map>
+
+namespace Monitor {
+
+namespace {
+
+// Output is only counted here; all monitored tabs are evaluated on one shared timer
+struct Entry {
+    bool activity = false;
+    bool silence = false;
+    guint64 bytes = 0;          // Output bytes, updated from the relay
+    guint64 seen_bytes = 0;     // Value of bytes at the last timer tick
+    gint64 last_output = 0;     // Monotonic time of the last tick that saw output
+    bool silence_armed = false; // Output arrived since the last silence mark
+    Mark mark = Mark::None;
+    sigc::connection output_connection;
+};
+
+const unsigned int TICK_INTERVAL_MS = 1000;
+
+std::unordered_map<GtkWidget*, Entry> entries_by_page;
+sigc::connection tick_timer;
+
+void set_mark(GtkWidget* page, Entry& entry, Mark mark) {
+    if (entry.mark == mark) return;
+    entry.mark = mark;
+    if (Session* session = SessionRegistry::find_by_widget(page)) {
+        SessionRegistry::refresh_tab_label(*session);
+    }
+}
+
+bool on_tick() {
+    gint64 now = g_get_monotonic_time();
+    gint64 silence_us = static_cast<gint64>(Config::get_silence_seconds()) * G_USEC_PER_SEC;
+    Session* current = SessionRegistry::current();
+    GtkWidget* current_page = (current && current->page) ? GTK_WIDGET(current->page->gobj()) : nullptr;
+
+    for (auto& item : entries_by_page) {
+        GtkWidget* page = item.first;
+        Entry& entry = item.second;
+
+        if (entry.bytes != entry.seen_bytes) {
+            entry.seen_bytes = entry.bytes;
+            entry.last_output = now;
+            entry.silence_armed = true;
+            if (entry.activity && page != current_page) {
+                set_mark(page, entry, Mark::Activity);
+            }
+        } else if (entry.silence && entry.silence_armed && now - entry.last_output >= silence_us) {
+            entry.silence_armed = false;
+            if (page != current_page) {
+                set_mark(page, entry, Mark::Silence);
+            }
+        }
+    }
+    return true;
+}
+
+void update_timer() {
+    if (entries_by_page.empty()) {
+        tick_timer.disconnect();
+    } else if (!tick_timer.connected()) {
+        tick_timer = Glib::signal_timeout().connect(sigc::ptr_fun(&on_tick), TICK_INTERVAL_MS);
+    }
+}
+
+// Create or drop the entry for a session after its monitors changed
+void update_entry(Session& session, bool activity, bool silence) {
+    GtkWidget* page = GTK_WIDGET(session.page->gobj());
+    if (!activity && !silence) {
+        auto it = entries_by_page.find(page);
+        if (it != entries_by_page.end()) {
+            it->second.output_connection.disconnect();
+            entries_by_page.erase(it);
+        }
+    } else {
+        bool created = !entries_by_page.count(page);
+        Entry& entry = entries_by_page[page];
+        entry.activity = activity;
+        entry.silence = silence;
+        if (created) {
+            entry.last_output = g_get_monotonic_time();
+            if (PtyRelay* relay = PtyRelay::get(session.terminal)) {
+                // Map nodes are stable and the connection is dropped with the entry
+                guint64* bytes = &entry.bytes;
+                entry.output_connection = relay->signal_output().connect([bytes](const char*, gsize length) {
+                    *bytes += length;
+                });
+            }
+        }
+        if (!activity && entry.mark == Mark::Activity) entry.mark = Mark::None;
+        if (!silence && entry.mark == Mark::Silence) entry.mark = Mark::None;
+    }
+    update_timer();
+    SessionRegistry::refresh_tab_label(session);
+}
+
+const Entry* find_entry(const Session& session) {
+    if (!session.page) return nullptr;
+    auto it = entries_by_page.find(GTK_WIDGET(session.page->gobj()));
+    return (it != entries_by_page.end()) ? &it->second : nullptr;
+}
+
+} // namespace
+
+void track(Gtk::Notebook& notebook) {
+    notebook.signal_switch_page().connect([](Gtk::Widget* page, guint) {
+        if (!page) return;
+        auto it = entries_by_page.find(GTK_WIDGET(page->gobj()));
+        if (it != entries_by_page.end()) {
+            set_mark(it->first, it->second, Mark::None);
+        }
+    });
+    notebook.signal_page_removed().connect([](Gtk::Widget* page, guint) {
+        if (!page) return;
+        auto it = entries_by_page.find(GTK_WIDGET(page->gobj()));
+        if (it != entries_by_page.end()) {
+            it->second.output_connection.disconnect();
+            entries_by_page.erase(it);
+            update_timer();
+        }
+    });
+}
+
+void toggle_activity(Session& session) {
+    if (!session.terminal || !session.page) return;
+    update_entry(session, !is_watching_activity(session), is_watching_silence(session));
+}
+
+void toggle_silence(Session& session) {
+    if (!session.terminal || !session.page) return;
+    update_entry(session, is_watching_activity(session), !is_watching_silence(session));
+}
+
+bool is_watching_activity(const Session& session) {
+    const Entry* entry = find_entry(session);
+    return entry && entry->activity;
+}
+
+bool is_watching_silence(const Session& session) {
+    const Entry* entry = find_entry(session);
+    return entry && entry->silence;
+}
+
+Mark get_mark(const Session& session) {
+    const Entry* entry = find_entry(session);
+    return entry ? entry->mark : Mark::None;
+}
+
+} // namespace Monitor
@@ -0,0 +1,28 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <gtkmm/notebook.h>
+#include "Sessions.h"
+
+namespace Monitor {
+
+enum class Mark { None, Activity, Silence };
+
+// Clear a tab's mark when it is selected and forget closed tabs
+void track(Gtk::Notebook& notebook);
+
+// Mark the tab when output arrives while it is in the background
+void toggle_activity(Session& session);
+
+// Mark the tab when output stops for the "silence_seconds" setting
+void toggle_silence(Session& session);
+
+bool is_watching_activity(const Session& session);
+bool is_watching_silence(const Session& session);
+
+// Current mark shown on the tab
+Mark get_mark(const Session& session);
+
+} // namespace Monitor
+
+#endif // MONITOR_H
@@ -0,0 +1,89 @@
+#include "NetworkProfiles.h"
+#include "Tools.h"
+
+namespace NetworkProfiles {
+
+namespace {
+
+struct Settings {
+    const char* name;
+    const char* compression;
+    const char* ciphers;       // Preferred first, the rest of ssh's defaults follow
+    const char* ip_qos;        // Interactive and bulk traffic classes
+    const char* alive_interval;
+    const char* alive_count;
+    const char* tcp_keepalive;
+    const char* connect_timeout;
+    const char* control_persist;
+};
+
+// AES-GCM is fastest with AES-NI on a LAN; ChaCha20 holds up better on small routers and
+// phones. Compression only pays off when the link is slower than the CPUs.
+const Settings SETTINGS[] = {
+    {"LAN", "no", "aes128-gcm@openssh.com,aes256-gcm@openssh.com", "lowdelay throughput",
+     "30", "3", "yes", "5", "60"},
+    {"WAN", "yes", "chacha20-poly1305@openssh.com,aes128-gcm@openssh.com", "af21 cs1",
+     "15", "4", "no", "20", "300"},
+    {"Satellite", "yes", "chacha20-poly1305@openssh.com,aes128-gcm@openssh.com", "af21 cs1",
+     "60", "10", "no", "60", "1800"},
+};
+
+// MACs only matter for the non-AEAD ciphers; encrypt-then-MAC variants first
+const char* MACS = "umac-128-etm@openssh.com,hmac-sha2-256-etm@openssh.com";
+
+const Settings* find(const std::string& profile) {
+    for (const auto& settings : SETTINGS) {
+        if (profile == settings.name) return &settings;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+const std::vector<Profile>& get_all() {
+    static const std::vector<Profile> profiles = {
+        {"LAN", "Fast local network: no compression, AES-GCM, low-delay QoS"},
+        {"WAN", "Internet or VPN: compression, ChaCha20, keepalives every 15 s"},
+        {"Satellite", "High latency or 3G: compression, patient keepalives and timeouts, long-lived shared connections"},
+    };
+    return profiles;
+}
+
+std::string resolve(const ConnectionInfo& conn) {
+    Glib::ustring profile = conn.network_profile;
+    if (profile.empty()) {
+        profile = ConnectionManager::resolve_folder_setting(conn.folder_id,
+            [](const FolderInfo& folder) { return folder.network_profile; });
+    }
+    return (profile == "Default") ? "" : profile.raw();
+}
+
+std::vector<std::string> get_ssh_options(const std::string& profile) {
+    const Settings* settings = find(profile);
+    if (!settings) return {};
+
+    std::vector<std::string> options = {
+        "-o", std::string("Compression=") + settings->compression,
+        "-o", std::string("IPQoS=") + settings->ip_qos,
+        "-o", std::string("ServerAliveInterval=") + settings->alive_interval,
+        "-o", std::string("ServerAliveCountMax=") + settings->alive_count,
+        "-o", std::string("TCPKeepAlive=") + settings->tcp_keepalive,
+        "-o", std::string("ConnectTimeout=") + settings->connect_timeout,
+    };
+    // "^" puts the preferred algorithms first and keeps the defaults as fallbacks, so a server
+    // without them still connects; older clients would take the list as the only choices
+    if (Tools::is_at_least("ssh", 8, 2)) {
+        options.push_back("-o");
+        options.push_back(std::string("Ciphers=^") + settings->ciphers);
+        options.push_back("-o");
+        options.push_back(std::string("MACs=^") + MACS);
+    }
+    return options;
+}
+
+std::string get_control_persist(const std::string& profile, const std::string& default_value) {
+    const Settings* settings = find(profile);
+    return settings ? settings->control_persist : default_value;
+}
+
+} // namespace NetworkProfiles
@@ -0,0 +1,33 @@
+#ifndef NETWORKPROFILES_H
+#define NETWORKPROFILES_H
+
+#include "Connections.h"
+#include <string>
+#include <vector>
+
+// Named ssh tunings for the kind of link a host sits behind (compression, algorithm
+// preferences, IPQoS, keepalives, how long shared connections stay up)
+namespace NetworkProfiles {
+
+struct Profile {
+    std::string name;        // Saved in connections and folders
+    std::string description; // One line for dialogs and the info panel
+};
+
+// Built-in profiles in menu order
+const std::vector<Profile>& get_all();
+
+// Profile in effect for a connection: its own, else the nearest folder's. Empty when none
+// applies or "Default" was chosen.
+std::string resolve(const ConnectionInfo& conn);
+
+// ssh "-o" arguments of a profile, empty for an unknown one. They come after the user's
+// own options, which ssh lets take precedence.
+std::vector<std::string> get_ssh_options(const std::string& profile);
+
+// ControlPersist for connections ngTerm shares between commands, default_value without a profile
+std::string get_control_persist(const std::string& profile, const std::string& default_value);
+
+} // namespace NetworkProfiles
+
+#endif // NETWORKPROFILES_H
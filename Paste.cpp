@@ -0,0 +1,221 @@
+#include "Paste.h"
+#include "PtyRelay.h"
+#include <gtkmm/infobar.h>
+#include <gtkmm/progressbar.h>
+#include <glibmm/main.h>
+#include <algorithm>
+#include <unordered_map>
+
+namespace Paste {
+
+namespace {
+
+// Input committed in one piece at least this large is a paste; typing never gets close
+const gsize PASTE_THRESHOLD = 4096;
+
+// Upper bound of a chunk; chunks end at a line break when there is one
+const gsize CHUNK_SIZE = 1024;
+
+// Wait this long for the remote side to echo a chunk before pacing by time instead
+const unsigned int ECHO_TIMEOUT_MS = 300;
+
+// Interval between chunks once the remote side is known not to echo (e.g. stty -echo)
+const unsigned int FIXED_INTERVAL_MS = 20;
+
+// Retry interval while the PTY has not taken the previous chunk yet
+const unsigned int WRITABLE_RETRY_MS = 10;
+
+const std::string BRACKET_START = "\033[200~";
+const std::string BRACKET_END = "\033[201~";
+
+// A paste in progress. Later pastes into the same tab are appended, so their bracketed
+// paste markers stay in order.
+struct Job {
+    PtyRelay* relay = nullptr;
+    std::string data;
+    gsize offset = 0;
+    bool waiting_for_echo = false;
+    bool echo_reliable = true;
+    sigc::connection timer;
+    sigc::connection output_connection;
+    Gtk::InfoBar* bar = nullptr;
+    Gtk::ProgressBar* progress = nullptr;
+};
+
+std::unordered_map<GtkWidget*, Job> jobs_by_page;
+
+void send_next(GtkWidget* page);
+
+// Length of the next chunk: up to CHUNK_SIZE, cut after the last line break if there is
+// one, otherwise not inside a UTF-8 sequence
+gsize next_chunk_length(const std::string& data, gsize offset) {
+    gsize length = std::min(CHUNK_SIZE, data.size() - offset);
+    if (offset + length == data.size()) return length;
+
+    for (gsize i = length; i > 0; --i) {
+        char c = data[offset + i - 1];
+        if (c == '\r' || c == '\n') return i;
+    }
+    while (length > 1 && (static_cast<unsigned char>(data[offset + length]) & 0xC0) == 0x80) {
+        length--;
+    }
+    return length;
+}
+
+void remove_bar(Job& job) {
+    if (!job.bar) return;
+    if (Gtk::Container* parent = job.bar->get_parent()) {
+        parent->remove(*job.bar); // Managed, so this destroys it
+    }
+    job.bar = nullptr;
+    job.progress = nullptr;
+}
+
+void finish(GtkWidget* page) {
+    auto it = jobs_by_page.find(page);
+    if (it == jobs_by_page.end()) return;
+    it->second.timer.disconnect();
+    it->second.output_connection.disconnect();
+    remove_bar(it->second);
+    jobs_by_page.erase(it);
+}
+
+void cancel(GtkWidget* page) {
+    auto it = jobs_by_page.find(page);
+    if (it == jobs_by_page.end()) return;
+    Job& job = it->second;
+
+    // Close an open bracketed paste, or the application would wait for the end forever
+    std::string sent = job.data.substr(0, job.offset);
+    size_t last_start = sent.rfind(BRACKET_START);
+    size_t last_end = sent.rfind(BRACKET_END);
+    if (last_start != std::string::npos && (last_end == std::string::npos || last_end < last_start)) {
+        job.relay->write_input(BRACKET_END.data(), BRACKET_END.size());
+    }
+    finish(page);
+}
+
+void on_output(GtkWidget* page) {
+    auto it = jobs_by_page.find(page);
+    if (it == jobs_by_page.end() || !it->second.waiting_for_echo) return;
+
+    // The remote side is keeping up; send the next chunk once this output was handled
+    it->second.waiting_for_echo = false;
+    it->second.timer.disconnect();
+    it->second.timer = Glib::signal_idle().connect([page]() {
+        send_next(page);
+        return false;
+    });
+}
+
+void send_next(GtkWidget* page) {
+    auto it = jobs_by_page.find(page);
+    if (it == jobs_by_page.end()) return;
+    Job& job = it->second;
+    job.timer.disconnect();
+
+    // Let the PTY take the previous chunk first
+    if (job.relay->get_pending_input_size() > 0) {
+        job.timer = Glib::signal_timeout().connect([page]() {
+            send_next(page);
+            return false;
+        }, WRITABLE_RETRY_MS);
+        return;
+    }
+
+    if (job.offset >= job.data.size()) {
+        finish(page);
+        return;
+    }
+
+    gsize length = next_chunk_length(job.data, job.offset);
+    job.relay->write_input(job.data.data() + job.offset, length);
+    job.offset += length;
+    if (job.progress) {
+        job.progress->set_fraction(static_cast<double>(job.offset) / job.data.size());
+        job.progress->set_text(std::to_string(job.offset / 1024) + " of " +
+                               std::to_string(job.data.size() / 1024) + " KiB");
+    }
+
+    if (job.echo_reliable) {
+        job.waiting_for_echo = true;
+        job.timer = Glib::signal_timeout().connect([page]() {
+            auto timed_out = jobs_by_page.find(page);
+            if (timed_out != jobs_by_page.end()) {
+                timed_out->second.waiting_for_echo = false;
+                timed_out->second.echo_reliable = false;
+            }
+            send_next(page);
+            return false;
+        }, ECHO_TIMEOUT_MS);
+    } else {
+        job.timer = Glib::signal_timeout().connect([page]() {
+            send_next(page);
+            return false;
+        }, FIXED_INTERVAL_MS);
+    }
+}
+
+void start(Session& session, PtyRelay* relay, const char* text, gsize size) {
+    GtkWidget* page = GTK_WIDGET(session.page->gobj());
+    Job& job = jobs_by_page[page];
+    job.relay = relay;
+    job.data.assign(text, size);
+    job.output_connection = relay->signal_output().connect([page](const char*, gsize) {
+        on_output(page);
+    });
+
+    job.bar = Gtk::manage(new Gtk::InfoBar());
+    job.bar->set_message_type(Gtk::MESSAGE_INFO);
+    Gtk::Label* label = Gtk::manage(new Gtk::Label("Pasting..."));
+    job.progress = Gtk::manage(new Gtk::ProgressBar());
+    job.progress->set_show_text(true);
+    job.progress->set_hexpand(true);
+    job.progress->set_valign(Gtk::ALIGN_CENTER);
+    if (Gtk::Box* box = dynamic_cast<Gtk::Box*>(job.bar->get_content_area())) {
+        box->pack_start(*label, Gtk::PACK_SHRINK);
+        box->pack_start(*job.progress, Gtk::PACK_EXPAND_WIDGET);
+    }
+    job.bar->add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+    job.bar->signal_response().connect([page](int) {
+        // The bar is destroyed by cancel(); leave its signal emission first
+        Glib::signal_idle().connect_once([page]() { cancel(page); });
+    });
+    session.page->pack_end(*job.bar, Gtk::PACK_SHRINK);
+    job.bar->show_all();
+
+    send_next(page);
+}
+
+} // namespace
+
+void track(Gtk::Notebook& notebook) {
+    notebook.signal_page_removed().connect([](Gtk::Widget* page, guint) {
+        if (page) {
+            finish(GTK_WIDGET(page->gobj()));
+        }
+    });
+}
+
+void attach(Session& session) {
+    PtyRelay* relay = PtyRelay::get(session.terminal);
+    if (!relay || !session.page) return;
+
+    GtkWidget* page = GTK_WIDGET(session.page->gobj());
+    relay->set_input_filter([page, relay](const char* text, gsize size) {
+        auto it = jobs_by_page.find(page);
+        if (it != jobs_by_page.end()) {
+            if (size < PASTE_THRESHOLD) return false; // Typing (e.g. Ctrl+C) goes through at once
+            it->second.data.append(text, size);
+            return true;
+        }
+        if (size < PASTE_THRESHOLD) return false;
+
+        Session* session = SessionRegistry::find_by_widget(page);
+        if (!session) return false;
+        start(*session, relay, text, size);
+        return true;
+    });
+}
+
+} // namespace Paste
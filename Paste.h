@@ -0,0 +1,18 @@
+#ifndef PASTE_H
+#define PASTE_H
+
+#include <gtkmm/notebook.h>
+#include "Sessions.h"
+
+namespace Paste {
+
+// Cancel pastes of tabs that close
+void track(Gtk::Notebook& notebook);
+
+// Send large pastes into a session's terminal in paced chunks, with progress and cancel.
+// Catches every paste path (clipboard, primary selection, broadcast) at the relay input.
+void attach(Session& session);
+
+} // namespace Paste
+
+#endif // PASTE_H
@@ -0,0 +1,363 @@
+#include "PtyHelper.h"
+#include "PtyHelperProtocol.h"
+#include "Config.h"
+#include <glib-unix.h>
+#include <algorithm>
+#include <unordered_map>
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace PtyHelperProtocol;
+
+namespace {
+
+const char* HELPER_NAME = "ngterm-ptyd";
+
+// How long to wait for the helper's answer to LIST when connecting
+const int LIST_TIMEOUT_MS = 2000;
+
+int helper_fd = -1;
+guint read_source = 0;
+guint write_source = 0;
+std::string in_buffer;
+std::string out_buffer;
+std::unordered_map<guint32, PtyHelper::Callbacks> sessions;
+std::vector<PtyHelper::Survivor> survivors;
+guint32 next_id = 1;
+bool shutting_down = false;
+
+// Avoid retrying a helper that failed to start for every new tab
+bool start_failed = false;
+
+gboolean on_helper_readable(gint fd, GIOCondition condition, gpointer user_data);
+gboolean on_helper_writable(gint fd, GIOCondition condition, gpointer user_data);
+
+int connect_socket() {
+    // A socket in a directory someone else controls would get every argv and keystroke
+    std::string error;
+    if (prepare_socket_dir(error).empty()) {
+        std::cerr << "PtyHelper: " << error << std::endl;
+        return -1;
+    }
+    std::string path = get_socket_path();
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return -1;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// The helper installed next to the ngTerm binary, or the one on PATH
+std::string find_helper() {
+    gchar* self = g_file_read_link("/proc/self/exe", nullptr);
+    if (self) {
+        gchar* dir = g_path_get_dirname(self);
+        gchar* path = g_build_filename(dir, HELPER_NAME, nullptr);
+        std::string result = g_file_test(path, G_FILE_TEST_IS_EXECUTABLE) ? path : "";
+        g_free(path);
+        g_free(dir);
+        g_free(self);
+        if (!result.empty()) return result;
+    }
+    return HELPER_NAME;
+}
+
+// The helper forks into the background once its socket listens, so waiting for it is short
+bool start_helper() {
+    std::string helper = find_helper();
+    gchar* argv[] = {const_cast<gchar*>(helper.c_str()), nullptr};
+    gint status = 0;
+    GError* error = nullptr;
+    if (!g_spawn_sync(nullptr, argv, nullptr, G_SPAWN_SEARCH_PATH, nullptr, nullptr,
+                      nullptr, nullptr, &status, &error)) {
+        std::cerr << "PtyHelper: Failed to start " << helper << ": " << error->message << std::endl;
+        g_error_free(error);
+        return false;
+    }
+    return true;
+}
+
+// Ask for the sessions that survived, before anything else is sent
+void read_survivors() {
+    std::string request = encode(LIST, 0);
+    if (::write(helper_fd, request.data(), request.size()) != static_cast<ssize_t>(request.size())) return;
+
+    char buffer[65536];
+    while (true) {
+        struct pollfd entry = {helper_fd, POLLIN, 0};
+        if (poll(&entry, 1, LIST_TIMEOUT_MS) <= 0) return;
+        ssize_t length = read(helper_fd, buffer, sizeof(buffer));
+        if (length <= 0) return;
+        in_buffer.append(buffer, length);
+
+        uint8_t type = 0;
+        uint32_t id = 0;
+        std::string payload;
+        while (decode(in_buffer, type, id, payload)) {
+            if (type == LIST_END) return;
+            if (type != LIST_ENTRY) continue;
+
+            uint8_t running = 0;
+            int32_t status = 0;
+            size_t offset = 0;
+            if (!get(payload, offset, running) || !get(payload, offset, status)) continue;
+            json tag = json::parse(payload.substr(offset), nullptr, false);
+
+            PtyHelper::Survivor survivor;
+            survivor.id = id;
+            survivor.running = running != 0;
+            if (tag.is_object()) {
+                survivor.connection_id = tag.value("connection_id", "");
+                survivor.title = tag.value("title", "");
+            }
+            survivors.push_back(survivor);
+            next_id = std::max(next_id, id + 1);
+        }
+    }
+}
+
+bool connect_helper() {
+    helper_fd = connect_socket();
+    if (helper_fd < 0) {
+        if (start_failed || !start_helper()) {
+            start_failed = true;
+            return false;
+        }
+        helper_fd = connect_socket();
+        if (helper_fd < 0) {
+            std::cerr << "PtyHelper: " << HELPER_NAME << " is not reachable at " << get_socket_path() << std::endl;
+            start_failed = true;
+            return false;
+        }
+    }
+
+    read_survivors();
+    g_unix_set_fd_nonblocking(helper_fd, TRUE, nullptr);
+    read_source = g_unix_fd_add(helper_fd, GIOCondition(G_IO_IN | G_IO_HUP | G_IO_ERR), on_helper_readable, nullptr);
+    return true;
+}
+
+void disconnect_helper() {
+    if (read_source) {
+        g_source_remove(read_source);
+        read_source = 0;
+    }
+    if (write_source) {
+        g_source_remove(write_source);
+        write_source = 0;
+    }
+    if (helper_fd >= 0) {
+        close(helper_fd);
+        helper_fd = -1;
+    }
+    in_buffer.clear();
+    out_buffer.clear();
+    survivors.clear();
+}
+
+void flush() {
+    while (!out_buffer.empty() && helper_fd >= 0) {
+        ssize_t written = ::write(helper_fd, out_buffer.data(), out_buffer.size());
+        if (written > 0) {
+            out_buffer.erase(0, written);
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written < 0 && errno == EAGAIN) {
+            if (!write_source) {
+                write_source = g_unix_fd_add(helper_fd, G_IO_OUT, on_helper_writable, nullptr);
+            }
+            return;
+        } else {
+            return; // The read side notices the hangup
+        }
+    }
+}
+
+void send_message(uint8_t type, guint32 id, const std::string& payload = std::string()) {
+    if (helper_fd < 0) return;
+    out_buffer += encode(type, id, payload);
+    if (!write_source) flush();
+}
+
+// The helper went away; its sessions went with it
+void on_helper_lost() {
+    std::cerr << "PtyHelper: Lost the connection to " << HELPER_NAME << std::endl;
+    disconnect_helper();
+    auto lost = std::move(sessions);
+    sessions.clear();
+    for (auto& item : lost) {
+        if (item.second.exited) item.second.exited(SIGHUP);
+    }
+}
+
+void dispatch(uint8_t type, guint32 id, const std::string& payload) {
+    auto it = sessions.find(id);
+    if (it == sessions.end()) return; // Hung up meanwhile
+
+    size_t offset = 0;
+    switch (type) {
+        case OUTPUT:
+            if (it->second.output) it->second.output(payload.data(), payload.size());
+            break;
+        case STARTED: {
+            int32_t pid = 0;
+            if (get(payload, offset, pid) && it->second.started) it->second.started(pid);
+            break;
+        }
+        case FAILED: {
+            auto callback = it->second.failed;
+            sessions.erase(it);
+            if (callback) callback(payload);
+            break;
+        }
+        case EXITED: {
+            int32_t status = 0;
+            get(payload, offset, status);
+            auto callback = it->second.exited;
+            sessions.erase(it);
+            if (callback) callback(status);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+gboolean on_helper_readable(gint fd, GIOCondition /* condition */, gpointer /* user_data */) {
+    char buffer[65536];
+    bool lost = false;
+    while (true) {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length > 0) {
+            in_buffer.append(buffer, length);
+        } else if (length < 0 && errno == EINTR) {
+            continue;
+        } else if (length < 0 && errno == EAGAIN) {
+            break;
+        } else {
+            lost = true;
+            break;
+        }
+    }
+
+    // Callbacks may feed terminals and hang up sessions, but never disconnect
+    uint8_t type = 0;
+    uint32_t id = 0;
+    std::string payload;
+    while (decode(in_buffer, type, id, payload)) {
+        dispatch(type, id, payload);
+    }
+
+    if (lost) {
+        read_source = 0; // Removed by returning G_SOURCE_REMOVE
+        on_helper_lost();
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+gboolean on_helper_writable(gint /* fd */, GIOCondition /* condition */, gpointer /* user_data */) {
+    write_source = 0;
+    flush();
+    return G_SOURCE_REMOVE;
+}
+
+} // namespace
+
+bool PtyHelper::is_enabled() {
+    if (shutting_down || !Config::get_pty_helper()) return false;
+    return helper_fd >= 0 || connect_helper();
+}
+
+std::string PtyHelper::make_tag(const std::string& connection_id, const std::string& title) {
+    return json{{"connection_id", connection_id}, {"title", title}}.dump();
+}
+
+guint32 PtyHelper::spawn(const std::vector<std::string>& argv, int columns, int rows, const std::string& tag,
+                         const Callbacks& callbacks) {
+    if (helper_fd < 0 || argv.empty()) return 0;
+
+    std::string payload;
+    put<uint16_t>(payload, static_cast<uint16_t>(columns));
+    put<uint16_t>(payload, static_cast<uint16_t>(rows));
+    put<uint32_t>(payload, static_cast<uint32_t>(tag.size()));
+    payload += tag;
+    for (const auto& arg : argv) {
+        payload += arg;
+        payload += '\0';
+    }
+
+    guint32 id = next_id++;
+    sessions[id] = callbacks;
+    send_message(SPAWN, id, payload);
+    return id;
+}
+
+void PtyHelper::attach(guint32 id, const Callbacks& callbacks) {
+    if (helper_fd < 0) return;
+    sessions[id] = callbacks;
+    send_message(ATTACH, id);
+}
+
+void PtyHelper::write(guint32 id, const char* data, gsize length) {
+    for (gsize offset = 0; offset < length; offset += MAX_PAYLOAD) {
+        send_message(INPUT, id, std::string(data + offset, std::min<gsize>(MAX_PAYLOAD, length - offset)));
+    }
+}
+
+void PtyHelper::resize(guint32 id, int columns, int rows) {
+    std::string payload;
+    put<uint16_t>(payload, static_cast<uint16_t>(columns));
+    put<uint16_t>(payload, static_cast<uint16_t>(rows));
+    send_message(RESIZE, id, payload);
+}
+
+void PtyHelper::hangup(guint32 id) {
+    sessions.erase(id);
+    if (!shutting_down) {
+        send_message(HANGUP, id);
+    }
+}
+
+gsize PtyHelper::get_backlog() {
+    return out_buffer.size();
+}
+
+std::vector<PtyHelper::Survivor> PtyHelper::get_survivors() {
+    return survivors;
+}
+
+bool PtyHelper::claim(guint32 id) {
+    for (auto it = survivors.begin(); it != survivors.end(); ++it) {
+        if (it->id == id) {
+            survivors.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void PtyHelper::shutdown() {
+    shutting_down = true;
+    sessions.clear();
+    if (helper_fd < 0) return;
+
+    // Hand over typed input that is still queued, without blocking the exit for long
+    struct pollfd entry = {helper_fd, POLLOUT, 0};
+    while (!out_buffer.empty() && poll(&entry, 1, 200) > 0) {
+        ssize_t written = ::write(helper_fd, out_buffer.data(), out_buffer.size());
+        if (written <= 0 && errno != EINTR && errno != EAGAIN) break;
+        if (written > 0) out_buffer.erase(0, written);
+    }
+    disconnect_helper();
+}
@@ -0,0 +1,63 @@
+#ifndef PTYHELPER_H
+#define PTYHELPER_H
+
+#include <glib.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Client side of the PTY helper (ngterm-ptyd). When enabled in the preferences, terminal
+// sessions of saved connections run under the helper instead of ngTerm itself, so they
+// keep running when ngTerm exits or crashes and can be re-attached on its next start.
+namespace PtyHelper {
+
+struct Callbacks {
+    std::function<void(const char*, gsize)> output;
+    std::function<void(GPid)> started;
+    std::function<void(const std::string&)> failed; // The session is gone afterwards
+    std::function<void(int)> exited;                // Wait status; the session is gone afterwards
+};
+
+// A session the helper kept from a previous run
+struct Survivor {
+    guint32 id = 0;
+    std::string connection_id;
+    std::string title;
+    bool running = false; // False if it ended while ngTerm was away
+};
+
+// True if sessions should run under the helper. Starts the helper if needed and, on the
+// first connection, learns which sessions survived the previous run.
+bool is_enabled();
+
+// Description stored with a session, so it can be matched to its connection later
+std::string make_tag(const std::string& connection_id, const std::string& title);
+
+// Start argv under the helper; returns the session ID, 0 if the helper is not reachable
+guint32 spawn(const std::vector<std::string>& argv, int columns, int rows, const std::string& tag,
+              const Callbacks& callbacks);
+
+// Take over a surviving session. Its buffered output is delivered first.
+void attach(guint32 id, const Callbacks& callbacks);
+
+void write(guint32 id, const char* data, gsize length);
+void resize(guint32 id, int columns, int rows);
+
+// Hang up the session's child and forget it. After shutdown() it is only forgotten.
+void hangup(guint32 id);
+
+// Bytes queued for the helper that it has not taken yet
+gsize get_backlog();
+
+// Surviving sessions nobody has claimed yet
+std::vector<Survivor> get_survivors();
+
+// Remove a survivor from the list before attaching it; false if it was already claimed
+bool claim(guint32 id);
+
+// Disconnect on exit, leaving all sessions running in the helper
+void shutdown();
+
+} // namespace PtyHelper
+
+#endif // PTYHELPER_H
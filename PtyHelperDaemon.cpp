@@ -0,0 +1,512 @@
+// ngterm-ptyd: holds the PTYs and child processes of ngTerm sessions, so they survive
+// when ngTerm exits or crashes (in the spirit of dtach and abduco). ngTerm connects over
+// a Unix socket, starts sessions through it and re-attaches to them on its next start.
+// The last output of every session is kept in a ring buffer and replayed on attach.
+
+#include "PtyHelperProtocol.h"
+#include <iostream>
+#include <map>
+#include <vector>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+
+using namespace PtyHelperProtocol;
+
+namespace {
+
+// Output kept per session for replay on attach
+const size_t RING_SIZE = 256 * 1024;
+
+// Stop reading the PTYs while this much output waits for a slow ngTerm
+const size_t CLIENT_BACKLOG_LIMIT = 4 * 1024 * 1024;
+
+// Exit this long after the last session ended while ngTerm is not connected
+const int IDLE_EXIT_MS = 10000;
+
+struct Session {
+    int master = -1;           // PTY master, -1 once the child side hung up
+    pid_t pid = 0;
+    bool running = true;
+    int status = 0;            // Wait status once the child exited
+    std::string tag;           // Opaque description from ngTerm (connection, title)
+    std::string ring;          // Last output, at most 2 * RING_SIZE before trimming
+    std::string pending_input; // Input the PTY could not take yet
+    bool attached = false;     // ngTerm wants this session's output
+};
+
+std::map<uint32_t, Session> sessions;
+std::string socket_path;
+int listen_fd = -1;
+int client_fd = -1;
+std::string client_in;
+std::string client_out;
+int signal_pipe[2] = {-1, -1};
+
+void on_sigchld(int) {
+    int saved_errno = errno;
+    ssize_t ignored = write(signal_pipe[1], "c", 1);
+    (void)ignored;
+    errno = saved_errno;
+}
+
+void set_nonblocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+void send_message(uint8_t type, uint32_t id, const std::string& payload = std::string()) {
+    if (client_fd < 0) return;
+    client_out += encode(type, id, payload);
+}
+
+void send_output(uint32_t id, const std::string& data) {
+    for (size_t offset = 0; offset < data.size(); offset += MAX_PAYLOAD) {
+        send_message(OUTPUT, id, data.substr(offset, MAX_PAYLOAD));
+    }
+}
+
+void send_exited(uint32_t id, int status) {
+    std::string payload;
+    put<int32_t>(payload, status);
+    send_message(EXITED, id, payload);
+}
+
+void close_master(Session& session) {
+    if (session.master >= 0) {
+        close(session.master);
+        session.master = -1;
+    }
+}
+
+// Read what the child wrote; returns false once the child side is gone
+bool read_master(uint32_t id, Session& session) {
+    char buffer[65536];
+    for (int i = 0; i < 16; ++i) {
+        ssize_t length = read(session.master, buffer, sizeof(buffer));
+        if (length > 0) {
+            session.ring.append(buffer, length);
+            if (session.ring.size() > 2 * RING_SIZE) {
+                session.ring.erase(0, session.ring.size() - RING_SIZE);
+            }
+            if (session.attached) {
+                send_output(id, std::string(buffer, length));
+            }
+        } else if (length < 0 && errno == EINTR) {
+            continue;
+        } else if (length < 0 && errno == EAGAIN) {
+            return true;
+        } else {
+            return false; // EOF, or EIO once the last slave descriptor was closed
+        }
+    }
+    return true;
+}
+
+void flush_input(Session& session) {
+    while (!session.pending_input.empty() && session.master >= 0) {
+        ssize_t written = write(session.master, session.pending_input.data(), session.pending_input.size());
+        if (written > 0) {
+            session.pending_input.erase(0, written);
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written < 0 && errno == EAGAIN) {
+            return;
+        } else {
+            session.pending_input.clear();
+        }
+    }
+}
+
+void set_size(int master, uint16_t columns, uint16_t rows) {
+    struct winsize size = {};
+    size.ws_col = columns;
+    size.ws_row = rows;
+    ioctl(master, TIOCSWINSZ, &size);
+}
+
+void spawn_session(uint32_t id, const std::string& payload) {
+    uint16_t columns = 0, rows = 0;
+    uint32_t tag_length = 0;
+    size_t offset = 0;
+    if (!get(payload, offset, columns) || !get(payload, offset, rows) || !get(payload, offset, tag_length) ||
+        offset + tag_length > payload.size() || sessions.count(id)) {
+        send_message(FAILED, id, "Invalid spawn request");
+        return;
+    }
+    std::string tag = payload.substr(offset, tag_length);
+    offset += tag_length;
+
+    std::vector<std::string> argv;
+    while (offset < payload.size()) {
+        size_t end = payload.find('\0', offset);
+        if (end == std::string::npos) end = payload.size();
+        argv.push_back(payload.substr(offset, end - offset));
+        offset = end + 1;
+    }
+    if (argv.empty()) {
+        send_message(FAILED, id, "Empty command");
+        return;
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        send_message(FAILED, id, std::string("Failed to create PTY: ") + strerror(errno));
+        if (master >= 0) close(master);
+        return;
+    }
+    std::string slave_path = ptsname(master);
+    set_size(master, columns, rows);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        send_message(FAILED, id, std::string("Failed to fork: ") + strerror(errno));
+        close(master);
+        return;
+    }
+    if (pid == 0) {
+        // Child: new session with the PTY as controlling terminal
+        setsid();
+        int slave = open(slave_path.c_str(), O_RDWR);
+        if (slave < 0) _exit(127);
+        ioctl(slave, TIOCSCTTY, 0);
+        dup2(slave, STDIN_FILENO);
+        dup2(slave, STDOUT_FILENO);
+        dup2(slave, STDERR_FILENO);
+        if (slave > STDERR_FILENO) close(slave);
+        signal(SIGPIPE, SIG_DFL);
+        signal(SIGCHLD, SIG_DFL);
+        signal(SIGHUP, SIG_DFL);
+        setenv("TERM", "xterm-256color", 1);
+        setenv("COLORTERM", "truecolor", 1);
+
+        std::vector<char*> args;
+        for (auto& arg : argv) {
+            args.push_back(const_cast<char*>(arg.c_str()));
+        }
+        args.push_back(nullptr);
+        execvp(args[0], args.data());
+        std::string message = "Failed to execute " + argv[0] + ": " + strerror(errno) + "\r\n";
+        ssize_t ignored = write(STDERR_FILENO, message.data(), message.size());
+        (void)ignored;
+        _exit(127);
+    }
+
+    set_nonblocking(master);
+    Session& session = sessions[id];
+    session.master = master;
+    session.pid = pid;
+    session.tag = tag;
+    session.attached = true;
+
+    std::string started;
+    put<int32_t>(started, pid);
+    send_message(STARTED, id, started);
+}
+
+void attach_session(uint32_t id) {
+    auto it = sessions.find(id);
+    if (it == sessions.end()) {
+        send_message(FAILED, id, "The session is gone");
+        return;
+    }
+    Session& session = it->second;
+    session.attached = true;
+    if (session.running) {
+        std::string started;
+        put<int32_t>(started, session.pid);
+        send_message(STARTED, id, started);
+    }
+    send_output(id, session.ring.size() > RING_SIZE ? session.ring.substr(session.ring.size() - RING_SIZE) : session.ring);
+
+    // A session that ended while ngTerm was away is delivered once and then dropped
+    if (!session.running) {
+        send_exited(id, session.status);
+        close_master(session);
+        sessions.erase(it);
+    }
+}
+
+void hangup_session(uint32_t id) {
+    auto it = sessions.find(id);
+    if (it == sessions.end()) return;
+    if (it->second.running) {
+        kill(it->second.pid, SIGHUP); // Reaped by reap_children() like any other child
+    }
+    close_master(it->second);
+    sessions.erase(it);
+}
+
+void list_sessions() {
+    for (const auto& item : sessions) {
+        std::string payload;
+        put<uint8_t>(payload, item.second.running ? 1 : 0);
+        put<int32_t>(payload, item.second.status);
+        payload += item.second.tag;
+        send_message(LIST_ENTRY, item.first, payload);
+    }
+    send_message(LIST_END, 0);
+}
+
+void handle_message(uint8_t type, uint32_t id, const std::string& payload) {
+    switch (type) {
+        case LIST:
+            list_sessions();
+            break;
+        case SPAWN:
+            spawn_session(id, payload);
+            break;
+        case ATTACH:
+            attach_session(id);
+            break;
+        case INPUT: {
+            auto it = sessions.find(id);
+            if (it != sessions.end() && it->second.master >= 0) {
+                it->second.pending_input += payload;
+                flush_input(it->second);
+            }
+            break;
+        }
+        case RESIZE: {
+            uint16_t columns = 0, rows = 0;
+            size_t offset = 0;
+            auto it = sessions.find(id);
+            if (it != sessions.end() && it->second.master >= 0 &&
+                get(payload, offset, columns) && get(payload, offset, rows)) {
+                set_size(it->second.master, columns, rows);
+            }
+            break;
+        }
+        case HANGUP:
+            hangup_session(id);
+            break;
+        default:
+            break;
+    }
+}
+
+void disconnect_client() {
+    if (client_fd >= 0) {
+        close(client_fd);
+        client_fd = -1;
+    }
+    client_in.clear();
+    client_out.clear();
+    for (auto& item : sessions) {
+        item.second.attached = false;
+    }
+}
+
+void accept_client() {
+    int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (fd < 0) return;
+    // One ngTerm at a time; a new one takes over (e.g. after a crash left a stale connection)
+    disconnect_client();
+    client_fd = fd;
+}
+
+void read_client() {
+    char buffer[65536];
+    while (true) {
+        ssize_t length = read(client_fd, buffer, sizeof(buffer));
+        if (length > 0) {
+            client_in.append(buffer, length);
+        } else if (length < 0 && errno == EINTR) {
+            continue;
+        } else if (length < 0 && errno == EAGAIN) {
+            break;
+        } else {
+            // ngTerm exited or crashed; the sessions keep running
+            disconnect_client();
+            return;
+        }
+    }
+
+    uint8_t type = 0;
+    uint32_t id = 0;
+    std::string payload;
+    while (client_fd >= 0 && decode(client_in, type, id, payload)) {
+        handle_message(type, id, payload);
+    }
+}
+
+void write_client() {
+    while (!client_out.empty()) {
+        ssize_t written = write(client_fd, client_out.data(), client_out.size());
+        if (written > 0) {
+            client_out.erase(0, written);
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written < 0 && errno == EAGAIN) {
+            return;
+        } else {
+            disconnect_client();
+            return;
+        }
+    }
+}
+
+void reap_children() {
+    int status = 0;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (auto it = sessions.begin(); it != sessions.end(); ++it) {
+            Session& session = it->second;
+            if (session.pid != pid || !session.running) continue;
+
+            // Deliver what the child wrote before it exited
+            if (session.master >= 0) {
+                read_master(it->first, session);
+                close_master(session);
+            }
+            session.running = false;
+            session.status = status;
+            if (session.attached) {
+                send_exited(it->first, status);
+                sessions.erase(it);
+            }
+            break;
+        }
+    }
+}
+
+bool listen_on_socket() {
+    std::string error;
+    if (prepare_socket_dir(error).empty()) {
+        std::cerr << "ngterm-ptyd: " << error << std::endl;
+        return false;
+    }
+    socket_path = get_socket_path();
+
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "ngterm-ptyd: Socket path too long: " << socket_path << std::endl;
+        return false;
+    }
+    strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    // A helper that answers is already running; a socket nobody answers is stale
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (connect(probe, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0) {
+        close(probe);
+        return false;
+    }
+    close(probe);
+    unlink(socket_path.c_str());
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listen_fd < 0 ||
+        bind(listen_fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listen_fd, 4) != 0) {
+        std::cerr << "ngterm-ptyd: Cannot listen on " << socket_path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    chmod(socket_path.c_str(), 0600);
+    return true;
+}
+
+long long now_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<long long>(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    bool foreground = (argc > 1 && std::string(argv[1]) == "--foreground");
+
+    if (!listen_on_socket()) {
+        return 1;
+    }
+
+    // ngTerm waits for this process; the socket is ready once it returns
+    if (!foreground) {
+        pid_t pid = fork();
+        if (pid < 0) return 1;
+        if (pid > 0) _exit(0);
+        setsid();
+        if (chdir("/") != 0) return 1;
+        int null_fd = open("/dev/null", O_RDWR);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDIN_FILENO);
+            dup2(null_fd, STDOUT_FILENO);
+            dup2(null_fd, STDERR_FILENO);
+            if (null_fd > STDERR_FILENO) close(null_fd);
+        }
+    }
+
+    if (pipe2(signal_pipe, O_CLOEXEC | O_NONBLOCK) != 0) return 1;
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGHUP, SIG_IGN);
+    struct sigaction action = {};
+    action.sa_handler = on_sigchld;
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &action, nullptr);
+
+    long long idle_since = now_ms();
+    while (true) {
+        // Nothing to keep alive and nobody to serve
+        if (sessions.empty() && client_fd < 0) {
+            if (now_ms() - idle_since >= IDLE_EXIT_MS) break;
+        } else {
+            idle_since = now_ms();
+        }
+
+        std::vector<struct pollfd> fds;
+        std::vector<uint32_t> fd_sessions;
+        fds.push_back({signal_pipe[0], POLLIN, 0});
+        fds.push_back({listen_fd, POLLIN, 0});
+        fds.push_back({client_fd, static_cast<short>(client_fd >= 0 ? (POLLIN | (client_out.empty() ? 0 : POLLOUT)) : 0), 0});
+        bool backlogged = client_out.size() > CLIENT_BACKLOG_LIMIT;
+        for (auto& item : sessions) {
+            if (item.second.master < 0) continue;
+            short events = 0;
+            if (!backlogged) events |= POLLIN;
+            if (!item.second.pending_input.empty()) events |= POLLOUT;
+            fds.push_back({item.second.master, events, 0});
+            fd_sessions.push_back(item.first);
+        }
+
+        if (poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR) break;
+
+        if (fds[0].revents & POLLIN) {
+            char drain[64];
+            while (read(signal_pipe[0], drain, sizeof(drain)) > 0) {}
+            reap_children();
+        }
+        if (fds[1].revents & POLLIN) {
+            accept_client();
+        }
+        if (client_fd >= 0 && client_fd == fds[2].fd && (fds[2].revents & (POLLIN | POLLHUP | POLLERR))) {
+            read_client();
+        }
+        for (size_t i = 0; i < fd_sessions.size(); ++i) {
+            const struct pollfd& entry = fds[i + 3];
+            if (!entry.revents) continue;
+            auto it = sessions.find(fd_sessions[i]);
+            if (it == sessions.end() || it->second.master != entry.fd) continue; // Hung up meanwhile
+            if (entry.revents & POLLOUT) {
+                flush_input(it->second);
+            }
+            if ((entry.revents & (POLLIN | POLLHUP | POLLERR)) && !read_master(it->first, it->second)) {
+                // The exit itself is reported when the child is reaped
+                close_master(it->second);
+            }
+        }
+        if (client_fd >= 0 && !client_out.empty()) {
+            write_client();
+        }
+    }
+
+    unlink(socket_path.c_str());
+    return 0;
+}
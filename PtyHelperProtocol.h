@@ -0,0 +1,115 @@
+#ifndef PTYHELPERPROTOCOL_H
+#define PTYHELPERPROTOCOL_H
+
+// Messages between ngTerm and the PTY helper (ngterm-ptyd) over a Unix stream socket.
+// Every message is a 9 byte header (type, session ID, payload length, host byte order)
+// followed by the payload. Both ends run on the same machine from the same build.
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <cerrno>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace PtyHelperProtocol {
+
+enum MessageType : uint8_t {
+    // ngTerm to helper
+    LIST = 1,     // Report all sessions; answered by LIST_ENTRY messages and LIST_END
+    SPAWN = 2,    // Start a session: u16 columns, u16 rows, u32 tag length, tag, NUL-terminated argv
+    ATTACH = 3,   // Send a surviving session's buffered output, then its live output
+    INPUT = 4,    // Bytes for the child
+    RESIZE = 5,   // u16 columns, u16 rows
+    HANGUP = 6,   // Hang up the child and drop the session
+
+    // Helper to ngTerm
+    LIST_ENTRY = 64, // u8 running, i32 wait status, tag
+    LIST_END = 65,
+    STARTED = 66,    // i32 child PID
+    FAILED = 67,     // Error message
+    OUTPUT = 68,     // Bytes from the child
+    EXITED = 69      // i32 wait status; the session is gone afterwards
+};
+
+const size_t HEADER_SIZE = 9;
+
+// Upper bound for one payload; larger data is split
+const uint32_t MAX_PAYLOAD = 65536;
+
+inline std::string encode(uint8_t type, uint32_t id, const std::string& payload = std::string()) {
+    std::string message(HEADER_SIZE, '\0');
+    uint32_t length = static_cast<uint32_t>(payload.size());
+    message[0] = static_cast<char>(type);
+    memcpy(&message[1], &id, sizeof(id));
+    memcpy(&message[5], &length, sizeof(length));
+    return message + payload;
+}
+
+// Take one complete message from the front of buffer; false if it holds none yet
+inline bool decode(std::string& buffer, uint8_t& type, uint32_t& id, std::string& payload) {
+    if (buffer.size() < HEADER_SIZE) return false;
+    uint32_t length = 0;
+    memcpy(&id, &buffer[1], sizeof(id));
+    memcpy(&length, &buffer[5], sizeof(length));
+    if (buffer.size() < HEADER_SIZE + length) return false;
+    type = static_cast<uint8_t>(buffer[0]);
+    payload = buffer.substr(HEADER_SIZE, length);
+    buffer.erase(0, HEADER_SIZE + length);
+    return true;
+}
+
+template <typename T>
+inline void put(std::string& payload, T value) {
+    payload.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+inline bool get(const std::string& payload, size_t& offset, T& value) {
+    if (offset + sizeof(value) > payload.size()) return false;
+    memcpy(&value, payload.data() + offset, sizeof(value));
+    offset += sizeof(value);
+    return true;
+}
+
+// Directory of the helper socket, ssh-agent and ssh control sockets. Without
+// XDG_RUNTIME_DIR its name in /tmp is predictable, so use it through
+// prepare_socket_dir() only.
+inline std::string get_socket_dir() {
+    const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir && *runtime_dir) {
+        return std::string(runtime_dir) + "/ngTerm";
+    }
+    return "/tmp/ngTerm-" + std::to_string(getuid());
+}
+
+// Create the socket directory, or check that the existing one is a real directory owned by
+// this user with mode 0700. Whatever listens in it is trusted with passwords, keystrokes and
+// keys, so a directory another user made first must never be used. Returns the directory,
+// or an empty string with error set.
+inline std::string prepare_socket_dir(std::string& error) {
+    std::string dir = get_socket_dir();
+    if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+        error = "Cannot create " + dir + ": " + strerror(errno);
+        return "";
+    }
+    struct stat info;
+    if (lstat(dir.c_str(), &info) != 0) {
+        error = "Cannot check " + dir + ": " + strerror(errno);
+        return "";
+    }
+    if (!S_ISDIR(info.st_mode) || info.st_uid != getuid() || (info.st_mode & 07777) != 0700) {
+        error = dir + " is not a directory of this user with mode 0700, refusing to use it";
+        return "";
+    }
+    return dir;
+}
+
+inline std::string get_socket_path() {
+    return get_socket_dir() + "/ptyd.sock";
+}
+
+} // namespace PtyHelperProtocol
+
+#endif // PTYHELPERPROTOCOL_H
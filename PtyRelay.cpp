@@ -0,0 +1,346 @@
+#include "PtyRelay.h"
+#include <glib-unix.h>
+#include <iostream>
+#include <unordered_map>
+#include <cerrno>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+const char* RELAY_KEY = "ngterm-pty-relay";
+
+// Reads per main loop dispatch, so a flood of output cannot starve the UI
+const int MAX_READS_PER_DISPATCH = 8;
+
+// Reads when draining the PTY after the child exited
+const int MAX_DRAIN_READS = 256;
+
+// Spawns in flight, so a completion arriving after the relay is gone is detected
+std::unordered_map<guint, PtyRelay*> relays_by_spawn;
+guint next_spawn_id = 0;
+
+char read_buffer[65536];
+
+void reap_child(GPid pid, gint /* status */, gpointer /* user_data */) {
+    g_spawn_close_pid(pid);
+}
+
+} // namespace
+
+PtyRelay* PtyRelay::attach(VteTerminal* terminal) {
+    if (PtyRelay* existing = get(terminal)) return existing;
+
+    PtyRelay* relay = new PtyRelay(terminal);
+    g_object_set_data_full(G_OBJECT(terminal), RELAY_KEY, relay, &PtyRelay::on_destroy_notify);
+    return relay;
+}
+
+PtyRelay* PtyRelay::get(VteTerminal* terminal) {
+    if (!terminal) return nullptr;
+    return static_cast<PtyRelay*>(g_object_get_data(G_OBJECT(terminal), RELAY_KEY));
+}
+
+PtyRelay::PtyRelay(VteTerminal* terminal) : terminal(terminal) {
+    commit_handler = g_signal_connect(terminal, "commit", G_CALLBACK(on_commit), this);
+    size_handler = g_signal_connect_after(terminal, "size-allocate", G_CALLBACK(on_size_allocate), this);
+    destroy_handler = g_signal_connect(terminal, "destroy", G_CALLBACK(on_terminal_destroy), this);
+    columns = vte_terminal_get_column_count(terminal);
+    rows = vte_terminal_get_row_count(terminal);
+}
+
+PtyRelay::~PtyRelay() {
+    for (gulong handler : {commit_handler, size_handler, destroy_handler}) {
+        if (handler && g_signal_handler_is_connected(terminal, handler)) {
+            g_signal_handler_disconnect(terminal, handler);
+        }
+    }
+    close_pty();
+}
+
+bool PtyRelay::spawn(const std::vector<std::string>& argv, const std::string& tag) {
+    if (argv.empty()) return false;
+    close_pty();
+
+    if (!tag.empty() && PtyHelper::is_enabled()) {
+        columns = vte_terminal_get_column_count(terminal);
+        rows = vte_terminal_get_row_count(terminal);
+        helper_session = PtyHelper::spawn(argv, columns, rows, tag, make_helper_callbacks());
+        return helper_session != 0;
+    }
+
+    GError* error = nullptr;
+    pty = vte_pty_new_sync(VTE_PTY_DEFAULT, nullptr, &error);
+    if (!pty) {
+        std::cerr << "PtyRelay: Failed to create PTY: " << error->message << std::endl;
+        g_error_free(error);
+        return false;
+    }
+
+    int fd = vte_pty_get_fd(pty);
+    g_unix_set_fd_nonblocking(fd, TRUE, nullptr);
+    columns = vte_terminal_get_column_count(terminal);
+    rows = vte_terminal_get_row_count(terminal);
+    vte_pty_set_size(pty, rows, columns, nullptr);
+    read_source = g_unix_fd_add(fd, GIOCondition(G_IO_IN | G_IO_HUP | G_IO_ERR), on_pty_readable, this);
+
+    std::vector<char*> args;
+    for (const auto& arg : argv) {
+        args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+
+    // VTE only sets these itself when it spawns the child
+    char** env = g_get_environ();
+    env = g_environ_setenv(env, "TERM", "xterm-256color", TRUE);
+    env = g_environ_setenv(env, "COLORTERM", "truecolor", TRUE);
+
+    spawn_id = ++next_spawn_id;
+    relays_by_spawn[spawn_id] = this;
+    vte_pty_spawn_async(
+        pty,
+        nullptr,     // working directory
+        args.data(), // command
+        env,         // environment
+        GSpawnFlags(G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD),
+        nullptr, nullptr, nullptr, // child setup
+        -1,         // timeout
+        nullptr,    // cancellable
+        on_spawned,
+        GUINT_TO_POINTER(spawn_id)
+    );
+    g_strfreev(env);
+    return true;
+}
+
+void PtyRelay::adopt(guint32 helper_id) {
+    close_pty();
+    helper_session = helper_id;
+    PtyHelper::attach(helper_id, make_helper_callbacks());
+
+    // The terminal may have a different size than when the session was started
+    columns = vte_terminal_get_column_count(terminal);
+    rows = vte_terminal_get_row_count(terminal);
+    PtyHelper::resize(helper_id, columns, rows);
+}
+
+PtyHelper::Callbacks PtyRelay::make_helper_callbacks() {
+    // The callbacks are dropped by close_pty(), so they never outlive the relay
+    PtyHelper::Callbacks callbacks;
+    callbacks.output = [this](const char* data, gsize length) {
+        deliver_output(data, length);
+    };
+    callbacks.started = [this](GPid pid) {
+        child_pid = pid;
+    };
+    callbacks.failed = [this](const std::string& error) {
+        helper_session = 0;
+        std::string message = "\r\nFailed to start the session: " + error + "\r\n";
+        vte_terminal_feed(terminal, message.data(), message.size());
+        close_pty();
+        exit_signal.emit(W_EXITCODE(127, 0));
+    };
+    callbacks.exited = [this](int status) {
+        // The helper delivered the remaining output before reporting the exit
+        helper_session = 0;
+        child_pid = 0;
+        close_pty();
+        exit_signal.emit(status);
+    };
+    return callbacks;
+}
+
+gsize PtyRelay::get_pending_input_size() const {
+    return helper_session ? PtyHelper::get_backlog() : pending_input.size();
+}
+
+void PtyRelay::write_input(const char* data, gsize length) {
+    if (helper_session && length > 0) {
+        PtyHelper::write(helper_session, data, length);
+        return;
+    }
+    if (!pty || length == 0) return;
+    pending_input.append(data, length);
+    flush_input();
+}
+
+void PtyRelay::flush_input() {
+    if (!pty || write_source) return;
+
+    int fd = vte_pty_get_fd(pty);
+    while (!pending_input.empty()) {
+        ssize_t written = write(fd, pending_input.data(), pending_input.size());
+        if (written > 0) {
+            pending_input.erase(0, written);
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written < 0 && errno == EAGAIN) {
+            write_source = g_unix_fd_add(fd, G_IO_OUT, on_pty_writable, this);
+            return;
+        } else {
+            pending_input.clear(); // The PTY is gone
+            return;
+        }
+    }
+}
+
+bool PtyRelay::read_output(int max_reads) {
+    int fd = vte_pty_get_fd(pty);
+    for (int i = 0; i < max_reads; ++i) {
+        ssize_t length = read(fd, read_buffer, sizeof(read_buffer));
+        if (length > 0) {
+            deliver_output(read_buffer, length);
+        } else if (length < 0 && errno == EINTR) {
+            continue;
+        } else if (length < 0 && errno == EAGAIN) {
+            return true;
+        } else {
+            return false; // EOF, or EIO once the last slave descriptor was closed
+        }
+    }
+    return true;
+}
+
+void PtyRelay::deliver_output(const char* data, gsize length) {
+    // Observers must not destroy the terminal from here; defer such actions to idle
+    if (output_filter && output_filter(data, length)) return;
+    output_signal.emit(data, length);
+    vte_terminal_feed(terminal, data, length);
+    output_shown_signal.emit(data, length);
+}
+
+void PtyRelay::close_pty() {
+    if (helper_session) {
+        // The helper hangs up the child, unless ngTerm is exiting and leaves it running
+        PtyHelper::hangup(helper_session);
+        helper_session = 0;
+        child_pid = 0;
+    }
+    if (spawn_id) {
+        relays_by_spawn.erase(spawn_id);
+        spawn_id = 0;
+    }
+    if (read_source) {
+        g_source_remove(read_source);
+        read_source = 0;
+    }
+    if (write_source) {
+        g_source_remove(write_source);
+        write_source = 0;
+    }
+    if (child_watch_source) {
+        g_source_remove(child_watch_source);
+        child_watch_source = 0;
+    }
+    if (child_pid > 0) {
+        // Hang up a child that is still running and keep reaping it in the background
+        kill(child_pid, SIGHUP);
+        g_child_watch_add(child_pid, reap_child, nullptr);
+        child_pid = 0;
+    }
+    pending_input.clear();
+    if (pty) {
+        g_object_unref(pty);
+        pty = nullptr;
+    }
+}
+
+void PtyRelay::finish_child(int status) {
+    // Deliver what the child wrote before it exited. Background processes that still
+    // hold the PTY open are hung up when it is closed.
+    if (read_source) {
+        read_output(MAX_DRAIN_READS);
+    }
+    close_pty();
+    exit_signal.emit(status);
+}
+
+void PtyRelay::on_destroy_notify(gpointer data) {
+    delete static_cast<PtyRelay*>(data);
+}
+
+void PtyRelay::on_terminal_destroy(GtkWidget* widget, gpointer /* user_data */) {
+    // Drop the relay while the terminal's signal handlers are still connected
+    g_object_set_data(G_OBJECT(widget), RELAY_KEY, nullptr);
+}
+
+void PtyRelay::on_commit(VteTerminal* /* terminal */, gchar* text, guint size, gpointer user_data) {
+    PtyRelay* relay = static_cast<PtyRelay*>(user_data);
+    if (relay->input_filter && relay->input_filter(text, size)) return;
+    relay->input_signal.emit(text, size);
+    relay->write_input(text, size);
+}
+
+void PtyRelay::on_size_allocate(GtkWidget* /* widget */, GdkRectangle* /* allocation */, gpointer user_data) {
+    PtyRelay* relay = static_cast<PtyRelay*>(user_data);
+    int new_columns = vte_terminal_get_column_count(relay->terminal);
+    int new_rows = vte_terminal_get_row_count(relay->terminal);
+    if (new_columns == relay->columns && new_rows == relay->rows) return;
+
+    relay->columns = new_columns;
+    relay->rows = new_rows;
+    if (relay->helper_session) {
+        PtyHelper::resize(relay->helper_session, new_columns, new_rows);
+    } else if (relay->pty) {
+        vte_pty_set_size(relay->pty, new_rows, new_columns, nullptr);
+    }
+    relay->resize_signal.emit(new_columns, new_rows);
+}
+
+void PtyRelay::on_spawned(GObject* source, GAsyncResult* result, gpointer user_data) {
+    GPid pid = 0;
+    GError* error = nullptr;
+    gboolean spawned = vte_pty_spawn_finish(VTE_PTY(source), result, &pid, &error);
+
+    auto it = relays_by_spawn.find(GPOINTER_TO_UINT(user_data));
+    if (it == relays_by_spawn.end()) {
+        // The relay was closed or respawned while this child was starting
+        if (spawned) {
+            kill(pid, SIGHUP);
+            g_child_watch_add(pid, reap_child, nullptr);
+        }
+        if (error) g_error_free(error);
+        return;
+    }
+
+    PtyRelay* relay = it->second;
+    relays_by_spawn.erase(it);
+    relay->spawn_id = 0;
+
+    if (!spawned) {
+        std::string message = std::string("\r\nFailed to start the session: ") + error->message + "\r\n";
+        vte_terminal_feed(relay->terminal, message.data(), message.size());
+        g_error_free(error);
+        relay->close_pty();
+        relay->exit_signal.emit(W_EXITCODE(127, 0)); // Same status as a shell's "command not found"
+        return;
+    }
+
+    relay->child_pid = pid;
+    relay->child_watch_source = g_child_watch_add(pid, on_child_watch, relay);
+}
+
+void PtyRelay::on_child_watch(GPid pid, gint status, gpointer user_data) {
+    PtyRelay* relay = static_cast<PtyRelay*>(user_data);
+    relay->child_watch_source = 0; // Source is removed after this callback
+    relay->child_pid = 0;
+    g_spawn_close_pid(pid);
+    relay->finish_child(status);
+}
+
+gboolean PtyRelay::on_pty_readable(gint /* fd */, GIOCondition /* condition */, gpointer user_data) {
+    PtyRelay* relay = static_cast<PtyRelay*>(user_data);
+    if (relay->read_output(MAX_READS_PER_DISPATCH)) return G_SOURCE_CONTINUE;
+
+    // The child side hung up; the exit itself is reported by the child watch
+    relay->read_source = 0;
+    return G_SOURCE_REMOVE;
+}
+
+gboolean PtyRelay::on_pty_writable(gint /* fd */, GIOCondition /* condition */, gpointer user_data) {
+    PtyRelay* relay = static_cast<PtyRelay*>(user_data);
+    relay->write_source = 0;
+    relay->flush_input();
+    return G_SOURCE_REMOVE;
+}
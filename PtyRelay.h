@@ -0,0 +1,122 @@
+#ifndef PTYRELAY_H
+#define PTYRELAY_H
+
+#include <vte/vte.h>
+#include <sigc++/sigc++.h>
+#include "PtyHelper.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+// Owns the PTY of a terminal session and relays bytes between the child and the VTE widget.
+// The widget gets no PTY of its own: child output is read here and fed to it, typed input
+// arrives through its "commit" signal. Other modules can observe the raw output stream,
+// and observers stay connected when the session respawns its command.
+class PtyRelay {
+public:
+    using OutputSignal = sigc::signal<void, const char*, gsize>;
+    using ResizeSignal = sigc::signal<void, int, int>;
+    using ExitSignal = sigc::signal<void, int>;
+
+    // Sees typed or pasted input before it is written; returns true if it took the input over
+    using InputFilter = std::function<bool(const char*, gsize)>;
+
+    // Sees child output before anything else; returns true if it took the output over
+    using OutputFilter = std::function<bool(const char*, gsize)>;
+
+    // Create the relay for a terminal; it is destroyed together with the terminal widget
+    static PtyRelay* attach(VteTerminal* terminal);
+
+    // Relay of a terminal, or nullptr
+    static PtyRelay* get(VteTerminal* terminal);
+
+    // Spawn argv on a fresh PTY sized to the terminal. A previous child is hung up.
+    // With a tag, the session runs under the PTY helper when that is enabled.
+    bool spawn(const std::vector<std::string>& argv, const std::string& tag = std::string());
+
+    // Take over a session that survived in the PTY helper; its recent output is replayed
+    void adopt(guint32 helper_id);
+
+    // Write bytes to the child as if they were typed
+    void write_input(const char* data, gsize length);
+
+    // Bytes accepted by write_input() that the PTY has not taken yet
+    gsize get_pending_input_size() const;
+
+    // Install the filter for terminal input (one per relay)
+    void set_input_filter(const InputFilter& filter) { input_filter = filter; }
+
+    // Install the filter for child output (one per relay). Output it takes over is not
+    // fed to the terminal and not emitted to observers.
+    void set_output_filter(const OutputFilter& filter) { output_filter = filter; }
+
+    bool is_running() const { return child_pid > 0; }
+    GPid get_child_pid() const { return child_pid; }
+    VteTerminal* get_terminal() const { return terminal; }
+    int get_columns() const { return columns; }
+    int get_rows() const { return rows; }
+
+    // Raw child output, emitted before it is fed to the terminal
+    OutputSignal& signal_output() { return output_signal; }
+
+    // The same output, emitted after the terminal has processed it
+    OutputSignal& signal_output_shown() { return output_shown_signal; }
+
+    // Terminal input that was not taken over by the input filter, emitted before it is written
+    OutputSignal& signal_input() { return input_signal; }
+
+    // Terminal grid size changes, as (columns, rows)
+    ResizeSignal& signal_resize() { return resize_signal; }
+
+    // Child exit with its wait status, emitted after its remaining output was delivered
+    ExitSignal& signal_child_exited() { return exit_signal; }
+
+    PtyRelay(const PtyRelay&) = delete;
+    PtyRelay& operator=(const PtyRelay&) = delete;
+
+private:
+    explicit PtyRelay(VteTerminal* terminal);
+    ~PtyRelay();
+
+    // Read whatever the child has written; returns false once the PTY reached EOF
+    bool read_output(int max_reads);
+    void deliver_output(const char* data, gsize length);
+    PtyHelper::Callbacks make_helper_callbacks();
+    void flush_input();
+    void close_pty();
+    void finish_child(int status);
+
+    static void on_destroy_notify(gpointer data);
+    static void on_terminal_destroy(GtkWidget* widget, gpointer user_data);
+    static void on_commit(VteTerminal* terminal, gchar* text, guint size, gpointer user_data);
+    static void on_size_allocate(GtkWidget* widget, GdkRectangle* allocation, gpointer user_data);
+    static void on_spawned(GObject* source, GAsyncResult* result, gpointer user_data);
+    static void on_child_watch(GPid pid, gint status, gpointer user_data);
+    static gboolean on_pty_readable(gint fd, GIOCondition condition, gpointer user_data);
+    static gboolean on_pty_writable(gint fd, GIOCondition condition, gpointer user_data);
+
+    VteTerminal* terminal = nullptr;
+    VtePty* pty = nullptr;
+    GPid child_pid = 0;
+    guint32 helper_session = 0;  // Session in the PTY helper, 0 when the PTY is our own
+    guint spawn_id = 0;          // Identifies the spawn in flight, 0 when none
+    guint read_source = 0;
+    guint write_source = 0;
+    guint child_watch_source = 0;
+    gulong commit_handler = 0;
+    gulong size_handler = 0;
+    gulong destroy_handler = 0;
+    int columns = 0;
+    int rows = 0;
+    std::string pending_input;   // Typed input the PTY could not take yet
+    InputFilter input_filter;
+    OutputFilter output_filter;
+
+    OutputSignal output_signal;
+    OutputSignal output_shown_signal;
+    OutputSignal input_signal;
+    ResizeSignal resize_signal;
+    ExitSignal exit_signal;
+};
+
+#endif // PTYRELAY_H
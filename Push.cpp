@@ -0,0 +1,480 @@
+#include "Push.h"
+#include "Fleet.h"
+#include "Ssh.h"
+#include <gtkmm/box.h>
+#include <gtkmm/button.h>
+#include <gtkmm/entry.h>
+#include <gtkmm/filechooserdialog.h>
+#include <gtkmm/grid.h>
+#include <gtkmm/label.h>
+#include <gtkmm/liststore.h>
+#include <gtkmm/messagedialog.h>
+#include <gtkmm/scrolledwindow.h>
+#include <gtkmm/spinbutton.h>
+#include <gtkmm/treeview.h>
+#include <glibmm/miscutils.h>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <sys/stat.h>
+
+namespace Push {
+
+namespace {
+
+const int CHECK_TIMEOUT_SECONDS = 60;
+const int COPY_TIMEOUT_SECONDS = 600;
+
+struct LocalFile {
+    std::string path;
+    std::string name;
+    std::string sha256;
+    unsigned int mode = 0644;
+};
+
+struct Host {
+    enum class State { Waiting, Checking, Copying, Passed, Failed, Cancelled };
+
+    ConnectionInfo conn;
+    State state = State::Waiting;
+    std::vector<size_t> to_copy; // Indexes into the file list
+    size_t next_copy = 0;
+    int copied = 0;
+    int unchanged = 0;
+    std::string output;
+    std::string detail;
+};
+
+bool hash_file(const std::string& path, std::string& digest) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    GChecksum* checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    char buffer[65536];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        g_checksum_update(checksum, reinterpret_cast<const guchar*>(buffer), file.gcount());
+    }
+    digest = g_checksum_get_string(checksum);
+    g_checksum_free(checksum);
+    return !file.bad();
+}
+
+// A path for the remote shell; a leading ~/ stays unquoted so it expands to the home directory
+std::string quote_remote_path(const std::string& path) {
+    if (path == "~") return "~";
+    if (path.compare(0, 2, "~/") == 0) return "~/" + Ssh::shell_quote(path.substr(2));
+    return Ssh::shell_quote(path);
+}
+
+// Last non-empty line of a command's error output
+std::string last_line(const std::string& text) {
+    size_t end = text.find_last_not_of("\r\n");
+    if (end == std::string::npos) return std::string();
+    size_t start = text.find_last_of("\r\n", end);
+    start = (start == std::string::npos) ? 0 : start + 1;
+    return text.substr(start, end - start + 1);
+}
+
+class FileColumns : public Gtk::TreeModel::ColumnRecord {
+public:
+    FileColumns() {
+        add(path);
+    }
+    Gtk::TreeModelColumn<std::string> path;
+};
+
+class HostColumns : public Gtk::TreeModel::ColumnRecord {
+public:
+    HostColumns() {
+        add(index);
+        add(host);
+        add(result);
+        add(copied);
+        add(unchanged);
+        add(detail);
+    }
+    Gtk::TreeModelColumn<int> index;
+    Gtk::TreeModelColumn<Glib::ustring> host;
+    Gtk::TreeModelColumn<Glib::ustring> result;
+    Gtk::TreeModelColumn<int> copied;
+    Gtk::TreeModelColumn<int> unchanged;
+    Gtk::TreeModelColumn<Glib::ustring> detail;
+};
+
+class PushWindow : public Gtk::Window {
+public:
+    explicit PushWindow(Gtk::Window& parent) : box(Gtk::ORIENTATION_VERTICAL, 6),
+                                               file_buttons(Gtk::ORIENTATION_VERTICAL, 6),
+                                               action_box(Gtk::ORIENTATION_HORIZONTAL, 6),
+                                               selection_button("Use Tree Selection"),
+                                               add_files_button("Add Files..."), remove_file_button("Remove"),
+                                               push_button("Push"), cancel_button("Cancel") {
+        set_title("Push Files");
+        set_transient_for(parent);
+        set_default_size(760, 560);
+        set_border_width(8);
+
+        Gtk::Grid* grid = Gtk::manage(new Gtk::Grid());
+        grid->set_row_spacing(6);
+        grid->set_column_spacing(12);
+
+        hosts_label.set_halign(Gtk::ALIGN_START);
+        hosts_label.set_hexpand(true);
+        selection_button.set_tooltip_text("Push to the connection or folder selected in the connection tree");
+        selection_button.signal_clicked().connect(sigc::mem_fun(*this, &PushWindow::load_selection));
+        grid->attach(*Gtk::manage(new Gtk::Label("Hosts:", Gtk::ALIGN_START)), 0, 0, 1, 1);
+        grid->attach(hosts_label, 1, 0, 1, 1);
+        grid->attach(selection_button, 2, 0, 1, 1);
+
+        files_store = Gtk::ListStore::create(file_columns);
+        files_view.set_model(files_store);
+        files_view.append_column("Local File", file_columns.path);
+        files_view.set_headers_visible(false);
+        files_scrolled.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+        files_scrolled.set_min_content_height(90);
+        files_scrolled.add(files_view);
+        add_files_button.signal_clicked().connect(sigc::mem_fun(*this, &PushWindow::on_add_files));
+        remove_file_button.signal_clicked().connect([this]() {
+            Gtk::TreeModel::iterator iter = files_view.get_selection()->get_selected();
+            if (iter) files_store->erase(iter);
+        });
+        file_buttons.pack_start(add_files_button, Gtk::PACK_SHRINK);
+        file_buttons.pack_start(remove_file_button, Gtk::PACK_SHRINK);
+        grid->attach(*Gtk::manage(new Gtk::Label("Files:", Gtk::ALIGN_START, Gtk::ALIGN_START)), 0, 1, 1, 1);
+        grid->attach(files_scrolled, 1, 1, 1, 1);
+        grid->attach(file_buttons, 2, 1, 1, 1);
+
+        remote_entry.set_text("/tmp");
+        remote_entry.set_tooltip_text("Directory on every host, created if missing; ~/ is the home directory");
+        grid->attach(*Gtk::manage(new Gtk::Label("Remote Directory:", Gtk::ALIGN_START)), 0, 2, 1, 1);
+        grid->attach(remote_entry, 1, 2, 2, 1);
+
+        parallel_spin.set_range(1, 256);
+        parallel_spin.set_increments(1, 8);
+        parallel_spin.set_value(16);
+        parallel_spin.set_tooltip_text("Hosts worked on at the same time");
+        parallel_spin.set_halign(Gtk::ALIGN_START);
+        grid->attach(*Gtk::manage(new Gtk::Label("Parallel Hosts:", Gtk::ALIGN_START)), 0, 3, 1, 1);
+        grid->attach(parallel_spin, 1, 3, 1, 1);
+
+        push_button.signal_clicked().connect(sigc::mem_fun(*this, &PushWindow::on_push));
+        cancel_button.signal_clicked().connect(sigc::mem_fun(*this, &PushWindow::on_cancel));
+        cancel_button.set_sensitive(false);
+        summary_label.set_halign(Gtk::ALIGN_START);
+        action_box.pack_start(summary_label, Gtk::PACK_EXPAND_WIDGET);
+        action_box.pack_end(cancel_button, Gtk::PACK_SHRINK);
+        action_box.pack_end(push_button, Gtk::PACK_SHRINK);
+
+        hosts_store = Gtk::ListStore::create(host_columns);
+        hosts_view.set_model(hosts_store);
+        hosts_view.append_column("Host", host_columns.host);
+        hosts_view.append_column("Result", host_columns.result);
+        hosts_view.append_column("Copied", host_columns.copied);
+        hosts_view.append_column("Unchanged", host_columns.unchanged);
+        hosts_view.append_column("Detail", host_columns.detail);
+        hosts_view.get_column(4)->set_expand(true);
+        hosts_scrolled.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+        hosts_scrolled.add(hosts_view);
+
+        box.pack_start(*grid, Gtk::PACK_SHRINK);
+        box.pack_start(action_box, Gtk::PACK_SHRINK);
+        box.pack_start(hosts_scrolled, Gtk::PACK_EXPAND_WIDGET);
+        add(box);
+        show_all_children();
+    }
+
+    bool is_busy() const {
+        return pool.get_running() > 0 || pool.get_queued() > 0;
+    }
+
+    void load_selection() {
+        if (is_busy()) return;
+        Glib::ustring description;
+        std::vector<ConnectionInfo> selected = Fleet::get_selected_hosts(description);
+        hosts.clear();
+        hosts_store->clear();
+        for (const auto& conn : selected) {
+            auto host = std::make_unique<Host>();
+            host->conn = conn;
+            Gtk::TreeModel::Row row = *hosts_store->append();
+            row[host_columns.index] = hosts.size();
+            row[host_columns.host] = conn.name;
+            hosts.push_back(std::move(host));
+        }
+        hosts_label.set_text(description + " (" + std::to_string(hosts.size()) + " SSH hosts)");
+        summary_label.set_text("");
+        push_button.set_sensitive(!hosts.empty());
+    }
+
+private:
+    void on_add_files() {
+        Gtk::FileChooserDialog dialog(*this, "Add Files", Gtk::FILE_CHOOSER_ACTION_OPEN);
+        dialog.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+        dialog.add_button("_Add", Gtk::RESPONSE_OK);
+        dialog.set_select_multiple(true);
+        if (dialog.run() != Gtk::RESPONSE_OK) return;
+        for (const auto& path : dialog.get_filenames()) {
+            Gtk::TreeModel::Row row = *files_store->append();
+            row[file_columns.path] = path;
+        }
+    }
+
+    void show_error(const Glib::ustring& text) {
+        Gtk::MessageDialog dialog(*this, "Cannot Push Files", false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
+        dialog.set_secondary_text(text);
+        dialog.run();
+    }
+
+    void on_push() {
+        if (is_busy() || hosts.empty()) return;
+        remote_directory = remote_entry.get_text();
+        if (remote_directory.empty()) {
+            show_error("Enter the remote directory to copy the files to.");
+            return;
+        }
+
+        // Hash the local files once; every host compares against these
+        files.clear();
+        for (const auto& row : files_store->children()) {
+            LocalFile file;
+            file.path = static_cast<std::string>(row[file_columns.path]);
+            file.name = Glib::path_get_basename(file.path);
+            struct stat info;
+            if (stat(file.path.c_str(), &info) != 0 || !S_ISREG(info.st_mode) || !hash_file(file.path, file.sha256)) {
+                show_error("Cannot read " + file.path + ".");
+                return;
+            }
+            file.mode = info.st_mode & 07777;
+            files.push_back(file);
+        }
+        if (files.empty()) {
+            show_error("Add the files to push.");
+            return;
+        }
+
+        pool.set_max_running(parallel_spin.get_value_as_int());
+        for (size_t i = 0; i < hosts.size(); ++i) {
+            Host& host = *hosts[i];
+            host.state = Host::State::Waiting;
+            host.to_copy.clear();
+            host.next_copy = 0;
+            host.copied = 0;
+            host.unchanged = 0;
+            host.detail.clear();
+            check(i);
+        }
+        push_button.set_sensitive(false);
+        selection_button.set_sensitive(false);
+        cancel_button.set_sensitive(true);
+        update_all();
+    }
+
+    void on_cancel() {
+        pool.cancel();
+        for (auto& host : hosts) {
+            if (host->state == Host::State::Waiting || host->state == Host::State::Checking ||
+                host->state == Host::State::Copying) {
+                host->state = Host::State::Cancelled;
+            }
+        }
+        done();
+    }
+
+    // Ask the host for the SHA-256 of the files already in the remote directory
+    void check(size_t index) {
+        std::string names;
+        for (const auto& file : files) {
+            names += " " + Ssh::shell_quote(file.name);
+        }
+        std::string command = "cd " + quote_remote_path(remote_directory) + " 2>/dev/null && "
+                              "{ sha256sum --" + names + " || shasum -a 256 --" + names + "; } 2>/dev/null; exit 0";
+
+        Fleet::Job job;
+        job.argv = Fleet::ssh_command(hosts[index]->conn, command);
+        job.timeout_seconds = CHECK_TIMEOUT_SECONDS;
+        job.on_start = [this, index]() {
+            hosts[index]->state = Host::State::Checking;
+            update_row(index);
+        };
+        job.on_output = [this, index](const std::string& data, bool is_stderr) {
+            Host& host = *hosts[index];
+            if (!is_stderr) {
+                host.output += data;
+            } else if (!last_line(data).empty()) {
+                host.detail = last_line(data);
+            }
+        };
+        job.on_done = [this, index](const Fleet::Result& result) {
+            Host& host = *hosts[index];
+            if (!succeeded(index, result)) return;
+
+            std::map<std::string, std::string> remote_hashes;
+            std::istringstream lines(host.output);
+            std::string line;
+            while (std::getline(lines, line)) {
+                size_t space = line.find(' ');
+                if (space == std::string::npos || space + 2 > line.size()) continue;
+                remote_hashes[line.substr(space + 2)] = line.substr(0, space); // "<hash>  <name>" or "<hash> *<name>"
+            }
+            host.output.clear();
+            for (size_t i = 0; i < files.size(); ++i) {
+                auto it = remote_hashes.find(files[i].name);
+                if (it != remote_hashes.end() && it->second == files[i].sha256) {
+                    host.unchanged++;
+                } else {
+                    host.to_copy.push_back(i);
+                }
+            }
+            host.detail.clear();
+            copy_next(index);
+        };
+        pool.add(std::move(job));
+    }
+
+    // Copy the changed files one after another through the host's multiplexed connection
+    void copy_next(size_t index) {
+        Host& host = *hosts[index];
+        if (host.next_copy >= host.to_copy.size()) {
+            host.state = Host::State::Passed;
+            update_row(index);
+            check_done();
+            return;
+        }
+        host.state = Host::State::Copying;
+        update_row(index);
+
+        const LocalFile& file = files[host.to_copy[host.next_copy]];
+        std::string temporary = Ssh::shell_quote("." + file.name + ".ngterm-push");
+        char mode[8];
+        snprintf(mode, sizeof(mode), "%o", file.mode);
+        std::string command = "mkdir -p " + quote_remote_path(remote_directory) +
+                              " && cd " + quote_remote_path(remote_directory) +
+                              " && cat > " + temporary +
+                              " && chmod " + mode + " " + temporary +
+                              " && mv -f " + temporary + " " + Ssh::shell_quote(file.name);
+
+        Fleet::Job job;
+        job.argv = Fleet::ssh_command(host.conn, command);
+        job.input_path = file.path;
+        job.timeout_seconds = COPY_TIMEOUT_SECONDS;
+        job.on_output = [this, index](const std::string& data, bool is_stderr) {
+            if (is_stderr && !last_line(data).empty()) hosts[index]->detail = last_line(data);
+        };
+        job.on_done = [this, index](const Fleet::Result& result) {
+            Host& host = *hosts[index];
+            if (!succeeded(index, result)) return;
+            host.copied++;
+            host.next_copy++;
+            host.detail.clear();
+            copy_next(index);
+        };
+        pool.add(std::move(job));
+    }
+
+    // Mark the host failed unless the job ended cleanly
+    bool succeeded(size_t index, const Fleet::Result& result) {
+        if (result.error.empty() && !result.timed_out && result.exit_status == 0) return true;
+        Host& host = *hosts[index];
+        host.state = Host::State::Failed;
+        if (!result.error.empty()) {
+            host.detail = result.error;
+        } else if (result.timed_out) {
+            host.detail = "Timed out";
+        } else if (host.detail.empty()) {
+            host.detail = "Exit status " + std::to_string(result.exit_status);
+        }
+        update_row(index);
+        check_done();
+        return false;
+    }
+
+    void check_done() {
+        update_summary();
+        if (!is_busy()) done();
+    }
+
+    void done() {
+        push_button.set_sensitive(!hosts.empty());
+        selection_button.set_sensitive(true);
+        cancel_button.set_sensitive(false);
+        update_all();
+    }
+
+    void update_row(size_t index) {
+        const Host& host = *hosts[index];
+        Gtk::TreeModel::Row row = hosts_store->children()[index];
+        switch (host.state) {
+            case Host::State::Waiting: row[host_columns.result] = "Waiting"; break;
+            case Host::State::Checking: row[host_columns.result] = "Comparing"; break;
+            case Host::State::Copying:
+                row[host_columns.result] = "Copying " + std::to_string(host.next_copy + 1) + "/" +
+                                           std::to_string(host.to_copy.size());
+                break;
+            case Host::State::Passed: row[host_columns.result] = "✔ Pass"; break;
+            case Host::State::Failed: row[host_columns.result] = "✘ Fail"; break;
+            case Host::State::Cancelled: row[host_columns.result] = "Cancelled"; break;
+        }
+        row[host_columns.copied] = host.copied;
+        row[host_columns.unchanged] = host.unchanged;
+        row[host_columns.detail] = host.detail;
+    }
+
+    void update_all() {
+        for (size_t i = 0; i < hosts.size(); ++i) {
+            update_row(i);
+        }
+        update_summary();
+    }
+
+    void update_summary() {
+        int passed = 0, failed = 0, pending = 0;
+        for (const auto& host : hosts) {
+            if (host->state == Host::State::Passed) passed++;
+            else if (host->state == Host::State::Failed) failed++;
+            else if (host->state != Host::State::Cancelled) pending++;
+        }
+        summary_label.set_text(std::to_string(passed) + " passed, " + std::to_string(failed) + " failed" +
+                               (pending > 0 ? ", " + std::to_string(pending) + " in progress" : std::string()));
+    }
+
+    Gtk::Box box;
+    Gtk::Label hosts_label;
+    Gtk::Box file_buttons;
+    Gtk::Box action_box;
+    Gtk::Button selection_button;
+    Gtk::ScrolledWindow files_scrolled;
+    Gtk::TreeView files_view;
+    FileColumns file_columns;
+    Glib::RefPtr<Gtk::ListStore> files_store;
+    Gtk::Button add_files_button;
+    Gtk::Button remove_file_button;
+    Gtk::Entry remote_entry;
+    Gtk::SpinButton parallel_spin;
+    Gtk::Button push_button;
+    Gtk::Button cancel_button;
+    Gtk::Label summary_label;
+    Gtk::ScrolledWindow hosts_scrolled;
+    Gtk::TreeView hosts_view;
+    HostColumns host_columns;
+    Glib::RefPtr<Gtk::ListStore> hosts_store;
+
+    std::string remote_directory;
+    std::vector<LocalFile> files;
+    std::vector<std::unique_ptr<Host>> hosts;
+    Fleet::Pool pool;
+};
+
+PushWindow* push_window = nullptr;
+
+} // namespace
+
+void show_window(Gtk::Window& parent) {
+    if (!push_window) {
+        push_window = new PushWindow(parent);
+    }
+    push_window->load_selection();
+    push_window->present();
+}
+
+} // namespace Push
@@ -0,0 +1,15 @@
+#ifndef PUSH_H
+#define PUSH_H
+
+#include <gtkmm/window.h>
+
+namespace Push {
+
+// Show the window that copies local files to a remote directory on every SSH host of the
+// tree selection (a connection or a folder). Hosts are worked on in parallel up to a
+// limit, and files whose SHA-256 already matches on a host are skipped.
+void show_window(Gtk::Window& parent);
+
+} // namespace Push
+
+#endif // PUSH_H
@@ -1,4 +1,5 @@
 #include "Rdp.h"
+#include "Tools.h"
 #include <gtkmm/socket.h>
 #include <gdk/gdkx.h>
 #include <iostream>
@@ -20,12 +21,12 @@ Rdp::ProcessExitSignal Rdp::process_exit_signal_;
 // Static callback function for child process exit
 void Rdp::on_child_exit(GPid pid, gint /* status */, gpointer /* user_data */) {
     Rdp* self = Rdp::instance();
+    g_spawn_close_pid(pid);
     if (pid == self->pid_) {
-        g_spawn_close_pid(self->pid_);
         self->pid_ = 0;
-        // Emit signal that the process has exited
-        self->process_exit_signal_.emit();
     }
+    // Emit signal that the process has exited so its session page can be closed
+    self->process_exit_signal_.emit(pid);
 }
 
 // Define the C-style callback function
@@ -42,7 +43,8 @@ Gtk::Socket* Rdp::create_rdp_session(
     const std::string& username,
     const std::string& password,
     int width,
-    int height)
+    int height,
+    const ProcessStartedSlot& on_started)
 {
     // Create a new socket
     Gtk::Socket* socket = new Gtk::Socket();
@@ -116,7 +118,7 @@ Gtk::Socket* Rdp::create_rdp_session(
                     nullptr, // working directory
                     const_cast<gchar**>(argv_ptrs.data()),
                     nullptr, // environment
-                    static_cast<GSpawnFlags>(G_SPAWN_DO_NOT_REAP_CHILD),
+                    static_cast<GSpawnFlags>(G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_SEARCH_PATH),
                     nullptr, // child setup function
                     nullptr, // user data for setup
                     &pid,
@@ -132,6 +134,9 @@ Gtk::Socket* Rdp::create_rdp_session(
                 self->pid_ = pid;
                 g_child_watch_add(pid, child_watch_cb, nullptr);
                 std::cout << "RDP: Started process with PID: " << pid << std::endl;
+                if (on_started) {
+                    on_started(pid);
+                }
             } catch (const std::exception& e) {
                 std::cerr << "RDP: Error in RDP session creation: " << e.what() << std::endl;
             }
@@ -149,9 +154,21 @@ std::vector<std::string> Rdp::build_rdp_command(
     int height,
     unsigned long xid)
 {
+    // FreeRDP 3 is installed as xfreerdp3 next to version 2 by some distributions, and
+    // replaces xfreerdp by others
+    std::string program = Tools::get_path("xfreerdp3");
+    bool freerdp3 = !program.empty();
+    if (program.empty()) {
+        program = Tools::get_path("xfreerdp");
+        freerdp3 = Tools::is_at_least("xfreerdp", 3, 0);
+    }
+    if (program.empty()) {
+        program = "xfreerdp"; // Not found at startup; spawning reports the error
+    }
+
     // Build the command with basic settings
     std::vector<std::string> argv = {
-        "/usr/bin/xfreerdp",
+        program,
         "/v:" + server,
         "/u:" + username,
         "/w:" + std::to_string(width),
@@ -161,7 +178,7 @@ std::vector<std::string> Rdp::build_rdp_command(
         "/sec:rdp",
         "+clipboard",
         "+auto-reconnect",
-        "/cert-ignore",
+        freerdp3 ? "/cert:ignore" : "/cert-ignore",
         "/bpp:16",   // Use 16-bit color depth
         "/rfx",      // Enable RDP 8.0 RemoteFX codec
         "/network:auto"  // Auto-detect network conditions
@@ -20,8 +20,11 @@ void child_watch_cb(GPid pid, gint status, gpointer user_data);
 
 class Rdp {
     public:
-        // Signal type for process exit
-        using ProcessExitSignal = sigc::signal<void>;
+        // Signal type for process exit, carries the PID of the viewer that exited
+        using ProcessExitSignal = sigc::signal<void, GPid>;
+
+        // Slot invoked with the PID once the viewer process has been started
+        using ProcessStartedSlot = sigc::slot<void, GPid>;
 
         // Get the singleton instance
         static Rdp* instance() {
@@ -40,7 +43,8 @@ class Rdp {
             const std::string& username,
             const std::string& password,
             int width,
-            int height);
+            int height,
+            const ProcessStartedSlot& on_started = ProcessStartedSlot());
 
         static GPid get_pid() {
             return pid_;
@@ -0,0 +1,148 @@
+#include "Reconnect.h"
+#include "Config.h"
+#include "main.h"
+#include <glib.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <string>
+
+namespace Reconnect {
+
+namespace {
+
+const guint BACKOFF_BASE_MS = 1000;
+const guint BACKOFF_CAP_MS = 60000;
+
+// A session that stayed up this long starts a fresh backoff sequence on its next drop
+const gint64 STABLE_SESSION_US = 60 * G_USEC_PER_SEC;
+
+// Stop after this many consecutive exits caused by rejected credentials
+const int MAX_AUTH_FAILURES = 2;
+
+// sshpass exit codes for a rejected password and an unknown host key
+const int SSHPASS_INVALID_PASSWORD = 5;
+const int SSHPASS_HOST_KEY_UNKNOWN = 6;
+
+void feed_message(VteTerminal* terminal, const std::string& message) {
+    std::string text = "\r\n\033[1;33m[ngTerm]\033[0m " + message + "\r\n";
+    vte_terminal_feed(terminal, text.data(), text.size());
+}
+
+// Exponential backoff with "equal jitter": half the delay is fixed, half is random,
+// so tabs that dropped together do not all reconnect in the same instant
+guint backoff_delay_ms(int attempt) {
+    guint delay = BACKOFF_CAP_MS;
+    if (attempt < 16) {
+        delay = std::min<guint>(BACKOFF_BASE_MS << attempt, BACKOFF_CAP_MS);
+    }
+    guint half = delay / 2;
+    return half + static_cast<guint>(g_random_int_range(0, static_cast<gint32>(half) + 1));
+}
+
+// The last few lines the child printed before it exited
+std::string get_last_lines(Session& session) {
+    glong cursor_row = 0;
+    vte_terminal_get_cursor_position(session.terminal, nullptr, &cursor_row);
+    glong first_row = std::max<glong>(0, cursor_row - 5);
+    glong last_col = vte_terminal_get_column_count(session.terminal);
+    char* text = vte_terminal_get_text_range(session.terminal, first_row, 0, cursor_row, last_col,
+                                             nullptr, nullptr, nullptr);
+    if (!text) return "";
+    std::string lines(text);
+    g_free(text);
+    return lines;
+}
+
+// Retrying a rejected password or key only locks the account, so look at the exit
+// status and at the last lines ssh printed before giving up
+bool is_auth_failure(Session& session, int status) {
+    if (WIFEXITED(status)) {
+        int code = WEXITSTATUS(status);
+        if (code == SSHPASS_INVALID_PASSWORD || code == SSHPASS_HOST_KEY_UNKNOWN) {
+            return true;
+        }
+    }
+
+    std::string text = get_last_lines(session);
+    return text.find("Permission denied") != std::string::npos ||
+           text.find("Authentication failed") != std::string::npos ||
+           text.find("Too many authentication failures") != std::string::npos ||
+           text.find("Host key verification failed") != std::string::npos;
+}
+
+// mosh could log in but not start mosh-server (not installed, no UTF-8 locale, ...);
+// that will not change by trying again
+bool is_mosh_server_failure(Session& session) {
+    if (session.connection_type != "Mosh") return false;
+
+    std::string text = get_last_lines(session);
+    return text.find("Did not find mosh server startup message") != std::string::npos ||
+           text.find("mosh-server: command not found") != std::string::npos;
+}
+
+gboolean on_reconnect_timeout(gpointer user_data) {
+    // Look the tab up again, it may have been closed while waiting
+    Session* session = SessionRegistry::find_by_widget(static_cast<GtkWidget*>(user_data));
+    if (!session || !session->terminal || !session->child_exited) return G_SOURCE_REMOVE;
+
+    if (session->close_key_handler) {
+        g_signal_handler_disconnect(session->terminal, session->close_key_handler);
+        session->close_key_handler = 0;
+    }
+
+    feed_message(session->terminal, "Reconnecting...");
+    spawn_session_command(*session);
+    return G_SOURCE_REMOVE;
+}
+
+} // namespace
+
+bool schedule(Session& session, int status) {
+    if (!session.auto_reconnect || !session.terminal || session.argv.empty()) return false;
+
+    // A clean exit means the user logged out, not that the link dropped
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        session.reconnect_attempts = 0;
+        session.auth_failures = 0;
+        return false;
+    }
+
+    if (g_get_monotonic_time() - session.spawned_at > STABLE_SESSION_US) {
+        session.reconnect_attempts = 0;
+    }
+
+    if (is_mosh_server_failure(session)) {
+        feed_message(session.terminal, "mosh-server could not be started, not reconnecting.");
+        return false;
+    }
+
+    if (is_auth_failure(session, status)) {
+        if (++session.auth_failures >= MAX_AUTH_FAILURES) {
+            feed_message(session.terminal, "Authentication failed, not reconnecting.");
+            return false;
+        }
+    } else {
+        session.auth_failures = 0;
+    }
+
+    int max_attempts = Config::get_reconnect_max_attempts();
+    if (session.reconnect_attempts >= max_attempts) {
+        feed_message(session.terminal, "Giving up after " + std::to_string(max_attempts) + " reconnect attempts.");
+        return false;
+    }
+
+    guint delay_ms = backoff_delay_ms(session.reconnect_attempts);
+    session.reconnect_attempts++;
+
+    char seconds[32];
+    g_snprintf(seconds, sizeof(seconds), "%.1f", delay_ms / 1000.0);
+    feed_message(session.terminal,
+                 std::string("Connection lost. Reconnecting in ") + seconds + "s (attempt " +
+                 std::to_string(session.reconnect_attempts) + " of " + std::to_string(max_attempts) +
+                 "), press any key to close this terminal...");
+
+    g_timeout_add(delay_ms, on_reconnect_timeout, GTK_WIDGET(session.page->gobj()));
+    return true;
+}
+
+} // namespace Reconnect
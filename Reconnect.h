@@ -0,0 +1,16 @@
+#ifndef RECONNECT_H
+#define RECONNECT_H
+
+#include "Sessions.h"
+
+namespace Reconnect {
+
+// Called when a session's child exits. If the session has auto-reconnect enabled and
+// the exit looks like a dropped connection, print a notice in the terminal, schedule a
+// respawn in the same terminal with exponential backoff and return true.
+// Returns false when the tab should show the normal "Process completed" prompt.
+bool schedule(Session& session, int status);
+
+} // namespace Reconnect
+
+#endif // RECONNECT_H
@@ -0,0 +1,390 @@
+#include "Recording.h"
+#include "Config.h"
+#include "PtyRelay.h"
+#include "SpscQueue.h"
+#include <glibmm/miscutils.h>
+#include <zlib.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+
+namespace Recording {
+
+namespace {
+
+const size_t QUEUE_CAPACITY = 8192;
+
+// Slots kept free for start/stop frames so they get through while output is dropped
+const size_t CONTROL_RESERVE = 64;
+
+// Output bytes allowed in the queue before new output frames are dropped
+const size_t MAX_QUEUED_BYTES = 32 * 1024 * 1024;
+
+// Files are sync-flushed this often, so a crash loses at most a few seconds
+const gint64 FLUSH_INTERVAL_US = 2 * G_USEC_PER_SEC;
+
+// Counters shared between the GTK thread and the writer
+struct Counters {
+    std::atomic<guint64> dropped_frames{0};
+};
+
+struct Frame {
+    enum class Type { Open, Output, Resize, Close };
+    Type type = Type::Output;
+    guint id = 0;                       // Recording the frame belongs to
+    double time = 0;                    // Seconds since the recording started
+    std::string data;                   // Output bytes; the file path for Open
+    std::string header;                 // asciicast header line for Open
+    std::shared_ptr<Counters> counters; // Set for Open
+    int columns = 0;
+    int rows = 0;
+};
+
+// GTK thread side of an active recording
+struct ActiveRecording {
+    guint id = 0;
+    std::string path;
+    gint64 started_at = 0;
+    std::shared_ptr<Counters> counters;
+    sigc::connection output_connection;
+    sigc::connection resize_connection;
+};
+
+// Writer thread side of an active recording
+struct OpenFile {
+    gzFile file = nullptr;
+    std::shared_ptr<Counters> counters;
+    guint64 reported_drops = 0;
+    std::string utf8_tail; // Start of a UTF-8 sequence split across output frames
+};
+
+SpscQueue<Frame> frame_queue(QUEUE_CAPACITY);
+std::atomic<size_t> queued_bytes{0};
+
+std::unordered_map<GtkWidget*, ActiveRecording> recordings_by_page;
+guint next_recording_id = 0;
+
+std::thread writer_thread;
+std::atomic<bool> writer_stop{false};
+std::mutex wake_mutex;
+std::condition_variable wake_cv;
+
+// Number of bytes at the end of data that begin a UTF-8 sequence completed in a later frame
+size_t incomplete_utf8_tail(const std::string& data) {
+    size_t size = data.size();
+    for (size_t back = 1; back <= 3 && back <= size; ++back) {
+        unsigned char c = static_cast<unsigned char>(data[size - back]);
+        if ((c & 0xC0) == 0x80) continue; // Continuation byte, keep looking for the lead byte
+        size_t needed = ((c & 0xE0) == 0xC0) ? 2 : ((c & 0xF0) == 0xE0) ? 3 : ((c & 0xF8) == 0xF0) ? 4 : 1;
+        return (needed > back) ? back : 0;
+    }
+    return 0;
+}
+
+void write_event(OpenFile& open_file, double time, const char* code, const std::string& data) {
+    json event = json::array({time, code, data});
+    std::string line = event.dump(-1, ' ', false, json::error_handler_t::replace) + "\n";
+    gzwrite(open_file.file, line.data(), static_cast<unsigned>(line.size()));
+}
+
+void write_frame(std::unordered_map<guint, OpenFile>& files, Frame& frame) {
+    if (frame.type == Frame::Type::Open) {
+        gzFile file = gzopen(frame.data.c_str(), "wb6");
+        if (!file) {
+            std::cerr << "Recording: Failed to open " << frame.data << std::endl;
+            return;
+        }
+        frame.header += "\n";
+        gzwrite(file, frame.header.data(), static_cast<unsigned>(frame.header.size()));
+        OpenFile& open_file = files[frame.id];
+        open_file.file = file;
+        open_file.counters = frame.counters;
+        return;
+    }
+
+    auto it = files.find(frame.id);
+    if (it == files.end()) return; // The file could not be opened
+    OpenFile& open_file = it->second;
+
+    // Leave a marker where output was lost, so a reviewer knows the recording has a gap
+    guint64 dropped = open_file.counters->dropped_frames.load(std::memory_order_relaxed);
+    if (dropped != open_file.reported_drops) {
+        write_event(open_file, frame.time, "m",
+                    "ngTerm: " + std::to_string(dropped - open_file.reported_drops) + " output frames dropped");
+        open_file.reported_drops = dropped;
+    }
+
+    switch (frame.type) {
+        case Frame::Type::Output: {
+            std::string text = open_file.utf8_tail + frame.data;
+            size_t tail = incomplete_utf8_tail(text);
+            open_file.utf8_tail = text.substr(text.size() - tail);
+            text.resize(text.size() - tail);
+            if (!text.empty()) {
+                write_event(open_file, frame.time, "o", text);
+            }
+            break;
+        }
+        case Frame::Type::Resize:
+            write_event(open_file, frame.time, "r",
+                        std::to_string(frame.columns) + "x" + std::to_string(frame.rows));
+            break;
+        case Frame::Type::Close:
+            gzclose(open_file.file);
+            files.erase(it);
+            break;
+        case Frame::Type::Open:
+            break;
+    }
+}
+
+void writer_main() {
+    std::unordered_map<guint, OpenFile> files;
+    gint64 last_flush = g_get_monotonic_time();
+    Frame frame;
+
+    for (;;) {
+        if (frame_queue.try_pop(frame)) {
+            if (frame.type == Frame::Type::Output) {
+                queued_bytes.fetch_sub(frame.data.size(), std::memory_order_relaxed);
+            }
+            write_frame(files, frame);
+            continue;
+        }
+
+        // Only stop once everything queued before shutdown was written
+        if (writer_stop.load()) break;
+
+        gint64 now = g_get_monotonic_time();
+        if (now - last_flush >= FLUSH_INTERVAL_US) {
+            for (auto& entry : files) {
+                gzflush(entry.second.file, Z_SYNC_FLUSH);
+            }
+            last_flush = now;
+        }
+
+        // The producer notifies without taking the lock; a missed wakeup costs one timeout
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        wake_cv.wait_for(lock, std::chrono::milliseconds(100));
+    }
+
+    for (auto& entry : files) {
+        gzclose(entry.second.file);
+    }
+}
+
+void ensure_writer() {
+    if (!writer_thread.joinable()) {
+        writer_stop = false;
+        writer_thread = std::thread(writer_main);
+    }
+}
+
+// Start and stop frames must not be lost; wait for the writer if the queue is full
+bool push_control_frame(Frame&& frame) {
+    for (int attempt = 0; attempt < 1000; ++attempt) {
+        if (frame_queue.try_push(std::move(frame))) {
+            wake_cv.notify_one();
+            return true;
+        }
+        wake_cv.notify_one();
+        g_usleep(1000);
+    }
+    return false;
+}
+
+void refresh_label(GtkWidget* page) {
+    if (Session* session = SessionRegistry::find_by_widget(page)) {
+        SessionRegistry::refresh_tab_label(*session);
+    }
+}
+
+void on_output(GtkWidget* page, guint id, gint64 started_at, Counters& counters, const char* data, gsize length) {
+    if (queued_bytes.load(std::memory_order_relaxed) + length <= MAX_QUEUED_BYTES) {
+        Frame frame;
+        frame.type = Frame::Type::Output;
+        frame.id = id;
+        frame.time = (g_get_monotonic_time() - started_at) / 1e6;
+        frame.data.assign(data, length);
+        if (frame_queue.try_push(std::move(frame), CONTROL_RESERVE)) {
+            queued_bytes.fetch_add(length, std::memory_order_relaxed);
+            wake_cv.notify_one();
+            return;
+        }
+    }
+
+    // The disk is falling behind; never block the GTK thread on it
+    guint64 dropped = counters.dropped_frames.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (dropped == 1 || dropped % 1000 == 0) {
+        refresh_label(page);
+    }
+}
+
+void on_resize(guint id, gint64 started_at, int columns, int rows) {
+    Frame frame;
+    frame.type = Frame::Type::Resize;
+    frame.id = id;
+    frame.time = (g_get_monotonic_time() - started_at) / 1e6;
+    frame.columns = columns;
+    frame.rows = rows;
+    if (frame_queue.try_push(std::move(frame), CONTROL_RESERVE)) {
+        wake_cv.notify_one();
+    }
+}
+
+// "<date>-<time>-<title>-<pid>-<n>.cast.gz", keeping only filename-safe title characters
+std::string make_file_name(const Session& session, guint id) {
+    std::time_t now = std::time(nullptr);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+
+    std::string title;
+    for (char c : session.title.raw()) {
+        title += (g_ascii_isalnum(c) || c == '-' || c == '_' || c == '.') ? c : '_';
+    }
+    return std::string(stamp) + "-" + title + "-" + std::to_string(getpid()) + "-" +
+           std::to_string(id) + ".cast.gz";
+}
+
+void stop_page(GtkWidget* page) {
+    auto it = recordings_by_page.find(page);
+    if (it == recordings_by_page.end()) return;
+
+    ActiveRecording& recording = it->second;
+    recording.output_connection.disconnect();
+    recording.resize_connection.disconnect();
+
+    Frame frame;
+    frame.type = Frame::Type::Close;
+    frame.id = recording.id;
+    frame.time = (g_get_monotonic_time() - recording.started_at) / 1e6;
+    if (!push_control_frame(std::move(frame))) {
+        std::cerr << "Recording: Writer is stuck, " << recording.path << " is closed on exit" << std::endl;
+    }
+    recordings_by_page.erase(it);
+}
+
+} // namespace
+
+void track(Gtk::Notebook& notebook) {
+    notebook.signal_page_removed().connect([](Gtk::Widget* page, guint) {
+        if (page) {
+            stop_page(GTK_WIDGET(page->gobj()));
+        }
+    });
+}
+
+bool start(Session& session) {
+    if (!session.terminal || !session.page) return false;
+    GtkWidget* page = GTK_WIDGET(session.page->gobj());
+    if (recordings_by_page.count(page)) return true;
+
+    PtyRelay* relay = PtyRelay::get(session.terminal);
+    if (!relay) return false;
+
+    std::error_code ec;
+    std::filesystem::path dir = get_directory();
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "Recording: Failed to create " << dir << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    ActiveRecording recording;
+    recording.id = ++next_recording_id;
+    recording.path = (dir / make_file_name(session, recording.id)).string();
+    recording.started_at = g_get_monotonic_time();
+    recording.counters = std::make_shared<Counters>();
+
+    json header = {
+        {"version", 2},
+        {"width", relay->get_columns()},
+        {"height", relay->get_rows()},
+        {"timestamp", static_cast<long long>(std::time(nullptr))},
+        {"title", session.title.raw()},
+        {"env", {{"TERM", "xterm-256color"}}}
+    };
+
+    Frame frame;
+    frame.type = Frame::Type::Open;
+    frame.id = recording.id;
+    frame.data = recording.path;
+    frame.header = header.dump(-1, ' ', false, json::error_handler_t::replace);
+    frame.counters = recording.counters;
+
+    ensure_writer();
+    if (!push_control_frame(std::move(frame))) {
+        std::cerr << "Recording: Writer is stuck, not recording " << session.title << std::endl;
+        return false;
+    }
+
+    guint id = recording.id;
+    gint64 started_at = recording.started_at;
+    std::shared_ptr<Counters> counters = recording.counters;
+    recording.output_connection = relay->signal_output().connect(
+        [page, id, started_at, counters](const char* data, gsize length) {
+            on_output(page, id, started_at, *counters, data, length);
+        });
+    recording.resize_connection = relay->signal_resize().connect(
+        [id, started_at](int columns, int rows) {
+            on_resize(id, started_at, columns, rows);
+        });
+
+    recordings_by_page[page] = recording;
+    SessionRegistry::refresh_tab_label(session);
+    return true;
+}
+
+void stop(Session& session) {
+    if (!session.page) return;
+    stop_page(GTK_WIDGET(session.page->gobj()));
+    SessionRegistry::refresh_tab_label(session);
+}
+
+bool is_recording(const Session& session) {
+    return session.page && recordings_by_page.count(GTK_WIDGET(session.page->gobj()));
+}
+
+std::string get_path(const Session& session) {
+    if (!session.page) return "";
+    auto it = recordings_by_page.find(GTK_WIDGET(session.page->gobj()));
+    return (it != recordings_by_page.end()) ? it->second.path : "";
+}
+
+guint64 get_dropped_frames(const Session& session) {
+    if (!session.page) return 0;
+    auto it = recordings_by_page.find(GTK_WIDGET(session.page->gobj()));
+    return (it != recordings_by_page.end()) ? it->second.counters->dropped_frames.load() : 0;
+}
+
+std::string get_directory() {
+    std::string dir = Config::get_recording_dir();
+    if (!dir.empty()) return dir;
+    return (std::filesystem::path(Glib::get_user_data_dir()) / "ngTerm" / "recordings").string();
+}
+
+void shutdown() {
+    std::vector<GtkWidget*> pages;
+    for (const auto& entry : recordings_by_page) {
+        pages.push_back(entry.first);
+    }
+    for (GtkWidget* page : pages) {
+        stop_page(page);
+    }
+
+    if (writer_thread.joinable()) {
+        writer_stop = true;
+        wake_cv.notify_one();
+        writer_thread.join();
+    }
+}
+
+} // namespace Recording
@@ -0,0 +1,37 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <gtkmm/notebook.h>
+#include <glib.h>
+#include <string>
+#include "Sessions.h"
+
+namespace Recording {
+
+// Stop recordings when their tabs close
+void track(Gtk::Notebook& notebook);
+
+// Start recording a terminal session to a gzip-compressed asciicast v2 file.
+// Output is timestamped on the GTK thread and written by a background writer thread.
+bool start(Session& session);
+
+// Stop recording a session and close its file
+void stop(Session& session);
+
+bool is_recording(const Session& session);
+
+// File the session is being recorded to, empty if not recording
+std::string get_path(const Session& session);
+
+// Output frames dropped because the writer fell behind
+guint64 get_dropped_frames(const Session& session);
+
+// Folder new recordings are written to
+std::string get_directory();
+
+// Close all recordings and wait for the writer to flush them; call before exiting
+void shutdown();
+
+} // namespace Recording
+
+#endif // RECORDING_H
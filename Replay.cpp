@@ -0,0 +1,846 @@
+#include "Replay.h"
+#include "Config.h"
+#include "Recording.h"
+#include "Scrollback.h"
+#include "Sessions.h"
+#include <gtkmm/button.h>
+#include <gtkmm/comboboxtext.h>
+#include <gtkmm/filechooserdialog.h>
+#include <gtkmm/messagedialog.h>
+#include <gtkmm/scale.h>
+#include <glibmm/dispatcher.h>
+#include <glibmm/main.h>
+#include <zlib.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Replay {
+
+namespace {
+
+// A keyframe is taken every this many seconds of recording time
+const double KEYFRAME_INTERVAL = 10.0;
+
+// Most output replayed to rebuild the screen at a keyframe when there is no clean point
+// nearby. Interactive programs redraw the visible screen well within this much output.
+const size_t KEYFRAME_WINDOW_BYTES = 256 * 1024;
+
+// Decompressed bytes between the points where decoding a .cast.gz can resume, and the
+// deflate history needed to resume there
+const gint64 ACCESS_SPAN = 1024 * 1024;
+const size_t WINDOW_SIZE = 32768;
+
+const int INDEX_VERSION = 2;
+
+// Sequences after which the screen no longer depends on earlier output:
+// clear screen, full reset, and switching to the alternate screen
+const char* const CLEAN_SEQUENCES[] = {"\033[2J", "\033c", "\033[?1049h", "\033[?1047h", "\033[?47h"};
+
+const double SPEEDS[] = {0.5, 1, 2, 4, 8, 16};
+
+struct Event {
+    double time = 0;
+    char code = 'o';  // 'o' output or 'r' resize
+    std::string data;
+};
+
+// Decoding a .cast.gz can restart at a deflate block boundary, given the output before it
+struct AccessPoint {
+    gint64 in = 0;        // Compressed offset of the byte the block starts in
+    int bits = 0;         // Bits of the byte before in that belong to the block
+    gint64 out = 0;       // Decompressed offset of the block
+    std::string window;   // Up to WINDOW_SIZE decompressed bytes before out
+};
+
+// Replaying the events from the line at offset, up to time, on a reset terminal of
+// columns x rows reproduces the screen as it was at time
+struct Keyframe {
+    double time = 0;
+    gint64 offset = 0;
+    int columns = 80;
+    int rows = 24;
+};
+
+// Built once per recording by reading it through, then kept next to it
+struct Index {
+    double duration = 0;
+    std::vector<Keyframe> keyframes;
+    std::vector<AccessPoint> access_points; // Empty for uncompressed recordings
+};
+
+// Reads a recording line by line, gzip-compressed or not, and jumps to a decompressed
+// offset by resuming at the nearest access point instead of decoding from the start.
+// Recordings are a single gzip member; a truncated one (still being written) just ends early.
+class CastReader {
+public:
+    CastReader() = default;
+    CastReader(const CastReader&) = delete;
+    CastReader& operator=(const CastReader&) = delete;
+
+    ~CastReader() {
+        end_stream();
+        if (file) std::fclose(file);
+    }
+
+    bool open(const std::string& path) {
+        file = std::fopen(path.c_str(), "rb");
+        if (!file) return false;
+        unsigned char magic[2] = {0, 0};
+        compressed = std::fread(magic, 1, 2, file) == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+        return restart();
+    }
+
+    // Record access points while reading; only valid for a pass from the start
+    void collect_access_points(std::vector<AccessPoint>* points) {
+        collected_points = points;
+    }
+
+    // Decompressed offset of the next unread byte
+    gint64 tell() const {
+        return decoded - static_cast<gint64>(pending.size() - pending_pos);
+    }
+
+    // Next line without its newline, and the offset it starts at
+    bool read_line(std::string& line, gint64& line_offset) {
+        line.clear();
+        line_offset = tell();
+        for (;;) {
+            size_t newline = pending.find('\n', pending_pos);
+            if (newline != std::string::npos) {
+                line.append(pending, pending_pos, newline - pending_pos);
+                pending_pos = newline + 1;
+                return true;
+            }
+            line.append(pending, pending_pos, std::string::npos);
+            pending.clear();
+            pending_pos = 0;
+            if (!fill()) return !line.empty();
+        }
+    }
+
+    bool seek(gint64 offset, const std::vector<AccessPoint>& points) {
+        if (!compressed) {
+            if (fseeko(file, offset, SEEK_SET) != 0) return false;
+            pending.clear();
+            pending_pos = 0;
+            decoded = offset;
+            return true;
+        }
+
+        auto after = std::upper_bound(points.begin(), points.end(), offset,
+            [](gint64 value, const AccessPoint& point) { return value < point.out; });
+        if (!(after == points.begin() ? restart() : resume(*(after - 1)))) return false;
+
+        // At most ACCESS_SPAN bytes are decoded and dropped here
+        gint64 count = offset - tell();
+        while (count > 0) {
+            gint64 available = static_cast<gint64>(pending.size() - pending_pos);
+            if (available == 0) {
+                pending.clear();
+                pending_pos = 0;
+                if (!fill()) return false;
+                continue;
+            }
+            gint64 take = std::min(available, count);
+            pending_pos += static_cast<size_t>(take);
+            count -= take;
+        }
+        return true;
+    }
+
+private:
+    bool restart() {
+        end_stream();
+        if (fseeko(file, 0, SEEK_SET) != 0) return false;
+        pending.clear();
+        pending_pos = 0;
+        decoded = 0;
+        in_position = 0;
+        if (!compressed) return true;
+        stream = z_stream();
+        if (inflateInit2(&stream, 15 + 16) != Z_OK) return false; // gzip header
+        stream_open = true;
+        return true;
+    }
+
+    bool resume(const AccessPoint& point) {
+        end_stream();
+        gint64 start = point.in - (point.bits ? 1 : 0);
+        if (fseeko(file, start, SEEK_SET) != 0) return false;
+        in_position = start;
+        int byte = 0;
+        if (point.bits) {
+            byte = std::fgetc(file);
+            if (byte == EOF) return false;
+            in_position++;
+        }
+        stream = z_stream();
+        if (inflateInit2(&stream, -15) != Z_OK) return false; // Raw deflate from here on
+        stream_open = true;
+        if (point.bits) {
+            inflatePrime(&stream, point.bits, byte >> (8 - point.bits));
+        }
+        if (!point.window.empty()) {
+            inflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(point.window.data()),
+                                 static_cast<uInt>(point.window.size()));
+        }
+        pending.clear();
+        pending_pos = 0;
+        decoded = point.out;
+        return true;
+    }
+
+    void end_stream() {
+        if (stream_open) {
+            inflateEnd(&stream);
+            stream_open = false;
+        }
+        stream_done = false;
+        ring_wrapped = false;
+    }
+
+    // Append more decompressed bytes to pending; false at the end of the recording
+    bool fill() {
+        if (!compressed) {
+            char buffer[65536];
+            size_t length = std::fread(buffer, 1, sizeof(buffer), file);
+            if (length == 0) return false;
+            pending.append(buffer, length);
+            decoded += static_cast<gint64>(length);
+            return true;
+        }
+
+        while (!stream_done) {
+            bool at_end = false;
+            if (stream.avail_in == 0) {
+                size_t length = std::fread(input, 1, sizeof(input), file);
+                at_end = (length == 0); // inflate may still hold output for a full ring
+                in_position += static_cast<gint64>(length);
+                stream.next_in = input;
+                stream.avail_in = static_cast<uInt>(length);
+            }
+            // Output goes through a ring of the last WINDOW_SIZE bytes, the history an
+            // access point needs
+            if (stream.avail_out == 0) {
+                ring_wrapped = stream.next_out != nullptr;
+                stream.next_out = ring;
+                stream.avail_out = WINDOW_SIZE;
+            }
+
+            unsigned char* before = stream.next_out;
+            int result = inflate(&stream, Z_BLOCK);
+            size_t produced = static_cast<size_t>(stream.next_out - before);
+            pending.append(reinterpret_cast<char*>(before), produced);
+            decoded += static_cast<gint64>(produced);
+
+            if (result == Z_STREAM_END || (result != Z_OK && result != Z_BUF_ERROR) ||
+                (result == Z_BUF_ERROR && stream.avail_in != 0 && stream.avail_out != 0)) {
+                stream_done = true; // Finished, or damaged from here on
+            } else if (collected_points && (stream.data_type & 128) && !(stream.data_type & 64) &&
+                       (collected_points->empty() || decoded - collected_points->back().out >= ACCESS_SPAN)) {
+                add_access_point();
+            }
+            if (produced > 0) return true;
+            if (at_end) stream_done = true;
+        }
+        return false;
+    }
+
+    void add_access_point() {
+        AccessPoint point;
+        point.in = in_position - stream.avail_in;
+        point.bits = stream.data_type & 7;
+        point.out = decoded;
+        size_t left = stream.avail_out;
+        if (ring_wrapped) {
+            point.window.assign(reinterpret_cast<char*>(ring) + WINDOW_SIZE - left, left);
+        }
+        point.window.append(reinterpret_cast<char*>(ring), WINDOW_SIZE - left);
+        collected_points->push_back(std::move(point));
+    }
+
+    FILE* file = nullptr;
+    bool compressed = false;
+    z_stream stream = z_stream();
+    bool stream_open = false;
+    bool stream_done = false;
+    bool ring_wrapped = false;
+    gint64 in_position = 0;         // Compressed bytes read from the file
+    gint64 decoded = 0;             // Decompressed offset of the end of pending
+    std::string pending;
+    size_t pending_pos = 0;
+    std::vector<AccessPoint>* collected_points = nullptr;
+    unsigned char input[16384];
+    unsigned char ring[WINDOW_SIZE];
+};
+
+bool parse_size(const std::string& size, int& columns, int& rows) {
+    return std::sscanf(size.c_str(), "%dx%d", &columns, &rows) == 2 && columns > 0 && rows > 0;
+}
+
+// Skips unknown event types and a truncated last line of an interrupted recording
+bool parse_event(const std::string& line, Event& parsed) {
+    json event = json::parse(line, nullptr, false);
+    if (!event.is_array() || event.size() < 3 || !event[0].is_number() ||
+        !event[1].is_string() || !event[2].is_string()) return false;
+    std::string code = event[1].get<std::string>();
+    if (code != "o" && code != "r") return false;
+
+    parsed.time = event[0].get<double>();
+    parsed.code = code[0];
+    parsed.data = event[2].get<std::string>();
+    return true;
+}
+
+// Terminal size from the asciicast v2 header line; false if it is not one
+bool parse_header(const std::string& line, int& columns, int& rows) {
+    json header = json::parse(line, nullptr, false);
+    if (!header.is_object() || header.value("version", 0) != 2) return false;
+    columns = header.value("width", 80);
+    rows = header.value("height", 24);
+    return true;
+}
+
+bool is_clean_point(const Event& event) {
+    if (event.code != 'o') return false;
+    for (const char* sequence : CLEAN_SEQUENCES) {
+        if (event.data.find(sequence) != std::string::npos) return true;
+    }
+    return false;
+}
+
+// One pass over the recording, collecting access points on the way. The replay start of a
+// keyframe is the latest clean point, or the start of the output window if the clean point
+// is further back than that.
+bool build_index(const std::string& path, Index& index, const std::atomic<bool>& cancelled) {
+    CastReader reader;
+    if (!reader.open(path)) return false;
+    reader.collect_access_points(&index.access_points);
+
+    std::string line;
+    gint64 offset = 0;
+    int columns = 80;
+    int rows = 24;
+    if (!reader.read_line(line, offset) || !parse_header(line, columns, rows)) return false;
+
+    // Events in the output window, with the terminal size in effect before each
+    struct Mark {
+        gint64 offset;
+        size_t bytes;
+        int columns;
+        int rows;
+    };
+    std::deque<Mark> window;
+    size_t window_bytes = 0;
+    Mark first = {reader.tell(), 0, columns, rows};
+    Mark last_clean = first;
+
+    double next_time = 0;
+    auto add_keyframes = [&](double time) {
+        for (; next_time <= time; next_time += KEYFRAME_INTERVAL) {
+            const Mark& start = window.empty() ? first
+                : (last_clean.offset >= window.front().offset ? last_clean : window.front());
+            index.keyframes.push_back({next_time, start.offset, start.columns, start.rows});
+        }
+    };
+
+    Event event;
+    while (reader.read_line(line, offset)) {
+        if (cancelled.load()) return false;
+        if (!parse_event(line, event)) continue;
+        add_keyframes(event.time);
+
+        Mark mark = {offset, event.data.size(), columns, rows};
+        if (event.code == 'r') {
+            parse_size(event.data, columns, rows);
+        }
+        if (is_clean_point(event)) {
+            last_clean = mark;
+        }
+        window.push_back(mark);
+        window_bytes += mark.bytes;
+        while (window_bytes > KEYFRAME_WINDOW_BYTES && window.size() > 1) {
+            window_bytes -= window.front().bytes;
+            window.pop_front();
+        }
+        index.duration = event.time;
+    }
+    add_keyframes(index.duration);
+    return true;
+}
+
+std::string get_index_path(const std::string& path) {
+    return path + ".idx";
+}
+
+// The sidecar is only trusted for the exact file it was built from
+json get_source_stamp(const std::string& path) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(path, ec);
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    return {
+        {"source_size", static_cast<unsigned long long>(size)},
+        {"source_mtime", static_cast<long long>(mtime.time_since_epoch().count())}
+    };
+}
+
+// Access point histories are stored deflated and base64 encoded
+std::string encode_window(const std::string& window) {
+    uLongf length = compressBound(window.size());
+    std::string packed(length, '\0');
+    if (compress2(reinterpret_cast<Bytef*>(&packed[0]), &length,
+                  reinterpret_cast<const Bytef*>(window.data()), window.size(), 6) != Z_OK) return "";
+    gchar* text = g_base64_encode(reinterpret_cast<const guchar*>(packed.data()), length);
+    std::string encoded = text;
+    g_free(text);
+    return encoded;
+}
+
+bool decode_window(const std::string& encoded, size_t size, std::string& window) {
+    if (size > WINDOW_SIZE) return false;
+    gsize packed_length = 0;
+    guchar* packed = g_base64_decode(encoded.c_str(), &packed_length);
+    window.assign(size, '\0');
+    uLongf length = size;
+    int result = uncompress(reinterpret_cast<Bytef*>(&window[0]), &length, packed, packed_length);
+    g_free(packed);
+    return result == Z_OK && length == size;
+}
+
+bool load_index(const std::string& path, Index& index) {
+    std::ifstream file(get_index_path(path));
+    if (!file) return false;
+    json stored = json::parse(file, nullptr, false);
+    if (!stored.is_object() || stored.value("version", 0) != INDEX_VERSION ||
+        stored.value("stamp", json()) != get_source_stamp(path) ||
+        !stored.contains("keyframes") || !stored["keyframes"].is_array() ||
+        !stored.contains("access_points") || !stored["access_points"].is_array()) return false;
+
+    Index loaded;
+    try {
+        loaded.duration = stored.value("duration", 0.0);
+        for (const auto& entry : stored["keyframes"]) {
+            if (!entry.is_array() || entry.size() != 4) return false;
+            loaded.keyframes.push_back({entry[0].get<double>(), entry[1].get<gint64>(),
+                                        entry[2].get<int>(), entry[3].get<int>()});
+        }
+        for (const auto& entry : stored["access_points"]) {
+            if (!entry.is_array() || entry.size() != 5) return false;
+            AccessPoint point;
+            point.in = entry[0].get<gint64>();
+            point.bits = entry[1].get<int>();
+            point.out = entry[2].get<gint64>();
+            if (point.bits < 0 || point.bits > 7 ||
+                !decode_window(entry[4].get<std::string>(), entry[3].get<size_t>(), point.window)) return false;
+            loaded.access_points.push_back(std::move(point));
+        }
+    } catch (const json::exception&) {
+        return false; // Damaged index, rebuild it
+    }
+    if (loaded.keyframes.empty()) return false;
+    index = std::move(loaded);
+    return true;
+}
+
+void save_index(const std::string& path, const Index& index) {
+    json keyframes = json::array();
+    for (const Keyframe& keyframe : index.keyframes) {
+        keyframes.push_back({keyframe.time, keyframe.offset, keyframe.columns, keyframe.rows});
+    }
+    json access_points = json::array();
+    for (const AccessPoint& point : index.access_points) {
+        access_points.push_back({point.in, point.bits, point.out, point.window.size(), encode_window(point.window)});
+    }
+    json stored = {
+        {"version", INDEX_VERSION},
+        {"stamp", get_source_stamp(path)},
+        {"duration", index.duration},
+        {"keyframes", keyframes},
+        {"access_points", access_points}
+    };
+
+    // Recordings may live on read-only media; the index is only a cache
+    std::ofstream file(get_index_path(path));
+    if (file) {
+        file << stored.dump();
+    }
+}
+
+std::string format_time(double seconds) {
+    int total = static_cast<int>(seconds);
+    char text[32];
+    if (total >= 3600) {
+        std::snprintf(text, sizeof(text), "%d:%02d:%02d", total / 3600, (total / 60) % 60, total % 60);
+    } else {
+        std::snprintf(text, sizeof(text), "%d:%02d", total / 60, total % 60);
+    }
+    return text;
+}
+
+// Plays a recording into a read-only terminal, reading events as they are due. Playback time
+// is derived from the monotonic clock, so timer jitter does not accumulate. The index is
+// loaded or built on a worker thread; seeking is available once it is there.
+class Player {
+public:
+    Player(Session& session, const std::string& recording_path, int header_columns, int header_rows)
+        : path(recording_path), columns(header_columns), rows(header_rows) {
+        build_ui(session);
+        index_dispatcher.connect(sigc::mem_fun(*this, &Player::on_index_ready));
+        indexer = std::thread(&Player::load_or_build_index, this);
+
+        if (reader.open(path)) {
+            std::string header;
+            gint64 offset = 0;
+            reader.read_line(header, offset);
+            data_offset = reader.tell();
+        }
+        restart(data_offset, columns, rows);
+        update_widgets(0);
+        play();
+    }
+
+    ~Player() {
+        timer.disconnect();
+        cancelled = true;
+        if (indexer.joinable()) {
+            indexer.join();
+        }
+    }
+
+private:
+    void build_ui(Session& session) {
+        Gtk::Box* controls = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_HORIZONTAL, 6));
+        controls->set_border_width(4);
+
+        play_button = Gtk::manage(new Gtk::Button("Pause"));
+        play_button->signal_clicked().connect([this]() {
+            if (playing) {
+                pause();
+            } else {
+                play();
+            }
+        });
+
+        speed_combo = Gtk::manage(new Gtk::ComboBoxText());
+        for (double speed : SPEEDS) {
+            char text[16];
+            std::snprintf(text, sizeof(text), "%gx", speed);
+            speed_combo->append(text);
+        }
+        speed_combo->set_active(1);
+        speed_combo->signal_changed().connect([this]() {
+            int active = speed_combo->get_active_row_number();
+            if (active >= 0) {
+                set_speed(SPEEDS[active]);
+            }
+        });
+
+        position_scale = Gtk::manage(new Gtk::Scale(Gtk::ORIENTATION_HORIZONTAL));
+        position_scale->set_range(0, 0.1);
+        position_scale->set_draw_value(false);
+        position_scale->set_hexpand(true);
+        position_scale->set_sensitive(false); // Until the index is ready
+        position_scale->signal_change_value().connect([this](Gtk::ScrollType, double value) {
+            seek(value);
+            return false;
+        });
+
+        time_label = Gtk::manage(new Gtk::Label());
+
+        // A replay has no child process whose exit would close the tab
+        Gtk::Button* close_button = Gtk::manage(new Gtk::Button("Close"));
+        GtkWidget* page = GTK_WIDGET(session.page->gobj());
+        close_button->signal_clicked().connect([page]() {
+            // Closing destroys this player and the button; leave the click handler first
+            Glib::signal_idle().connect_once([page]() {
+                if (Session* closing = SessionRegistry::find_by_widget(page)) {
+                    SessionRegistry::close(*closing);
+                }
+            });
+        });
+
+        controls->pack_start(*play_button, Gtk::PACK_SHRINK);
+        controls->pack_start(*speed_combo, Gtk::PACK_SHRINK);
+        controls->pack_start(*position_scale, Gtk::PACK_EXPAND_WIDGET);
+        controls->pack_start(*time_label, Gtk::PACK_SHRINK);
+        controls->pack_start(*close_button, Gtk::PACK_SHRINK);
+
+        GtkWidget* terminal_widget = vte_terminal_new();
+        terminal = VTE_TERMINAL(terminal_widget);
+        vte_terminal_set_input_enabled(terminal, FALSE);
+
+        session.page->pack_start(*controls, Gtk::PACK_SHRINK);
+        session.page->pack_start(*Gtk::manage(Glib::wrap(terminal_widget)), Gtk::PACK_EXPAND_WIDGET);
+        session.page->show_all();
+        SessionRegistry::set_terminal(session, terminal);
+    }
+
+    // Worker thread; reads nothing the GTK thread writes
+    void load_or_build_index() {
+        Index loaded;
+        bool ok = load_index(path, loaded);
+        if (!ok) {
+            loaded = Index();
+            ok = build_index(path, loaded, cancelled);
+            if (ok) {
+                save_index(path, loaded);
+            }
+        }
+        if (!ok || cancelled.load()) return;
+        {
+            std::lock_guard<std::mutex> lock(index_mutex);
+            built_index = std::move(loaded);
+        }
+        index_dispatcher.emit();
+    }
+
+    void on_index_ready() {
+        {
+            std::lock_guard<std::mutex> lock(index_mutex);
+            index = std::move(built_index);
+        }
+        index_ready = true;
+        position_scale->set_range(0, std::max(index.duration, 0.1));
+        position_scale->set_sensitive(true);
+        update_widgets(current_time());
+    }
+
+    double get_duration() const {
+        return index_ready ? index.duration : last_time;
+    }
+
+    double current_time() const {
+        if (!playing) return base_time;
+        return base_time + (g_get_monotonic_time() - base_monotonic) / 1e6 * speed;
+    }
+
+    void read_next() {
+        std::string line;
+        gint64 offset = 0;
+        has_next = false;
+        while (reader.read_line(line, offset)) {
+            if (parse_event(line, next)) {
+                has_next = true;
+                return;
+            }
+        }
+    }
+
+    void apply(const Event& event) {
+        if (event.code == 'o') {
+            vte_terminal_feed(terminal, event.data.data(), event.data.size());
+        } else {
+            int new_columns = 0;
+            int new_rows = 0;
+            if (parse_size(event.data, new_columns, new_rows)) {
+                vte_terminal_set_size(terminal, new_columns, new_rows);
+            }
+        }
+        last_time = std::max(last_time, event.time);
+    }
+
+    void apply_until(double time) {
+        while (has_next && next.time <= time) {
+            apply(next);
+            read_next();
+        }
+    }
+
+    // Reset the terminal and continue reading at the event line at offset
+    void restart(gint64 offset, int start_columns, int start_rows) {
+        vte_terminal_reset(terminal, TRUE, TRUE);
+        vte_terminal_set_size(terminal, start_columns, start_rows);
+        has_next = false;
+        if (reader.seek(offset, index.access_points)) {
+            read_next();
+        }
+    }
+
+    void update_widgets(double time) {
+        position_scale->set_value(time);
+        time_label->set_text(format_time(time) + " / " +
+                             (index_ready ? format_time(index.duration) : std::string("indexing...")));
+    }
+
+    void play() {
+        if (!has_next) {
+            seek(0);
+        }
+        base_monotonic = g_get_monotonic_time();
+        playing = true;
+        play_button->set_label("Pause");
+        schedule();
+    }
+
+    void pause() {
+        base_time = current_time();
+        playing = false;
+        timer.disconnect();
+        play_button->set_label("Play");
+    }
+
+    void set_speed(double new_speed) {
+        base_time = current_time();
+        base_monotonic = g_get_monotonic_time();
+        speed = new_speed;
+        schedule();
+    }
+
+    // Rebuild the screen from the nearest keyframe instead of replaying from the start.
+    // Without the index only the start can be sought.
+    void seek(double time) {
+        time = index_ready ? std::clamp(time, 0.0, index.duration) : 0.0;
+        gint64 offset = data_offset;
+        int start_columns = columns;
+        int start_rows = rows;
+        auto after = std::upper_bound(index.keyframes.begin(), index.keyframes.end(), time,
+            [](double value, const Keyframe& keyframe) { return value < keyframe.time; });
+        if (after != index.keyframes.begin()) {
+            const Keyframe& keyframe = *(after - 1);
+            offset = keyframe.offset;
+            start_columns = keyframe.columns;
+            start_rows = keyframe.rows;
+        }
+
+        restart(offset, start_columns, start_rows);
+        apply_until(time);
+
+        base_time = time;
+        base_monotonic = g_get_monotonic_time();
+        update_widgets(time);
+        schedule();
+    }
+
+    void schedule() {
+        timer.disconnect();
+        if (!playing || !has_next) return;
+
+        // Wake up at least a few times a second to move the position slider
+        double wait = (next.time - current_time()) / speed;
+        unsigned int wait_ms = static_cast<unsigned int>(std::clamp(wait * 1000, 0.0, 250.0));
+        timer = Glib::signal_timeout().connect(sigc::mem_fun(*this, &Player::on_tick), wait_ms);
+    }
+
+    bool on_tick() {
+        double time = current_time();
+        apply_until(time);
+
+        if (!has_next) {
+            pause();
+            base_time = get_duration();
+            update_widgets(base_time);
+            return false;
+        }
+        update_widgets(time);
+        schedule();
+        return false;
+    }
+
+    std::string path;
+    int columns = 80;             // Terminal size from the header
+    int rows = 24;
+    gint64 data_offset = 0;       // Offset of the first event line
+    CastReader reader;            // Playback position, one event ahead
+    Event next;
+    bool has_next = false;
+    double last_time = 0;         // Latest event time applied, the duration until indexed
+
+    Index index;
+    bool index_ready = false;
+    std::thread indexer;
+    std::atomic<bool> cancelled{false};
+    std::mutex index_mutex;
+    Index built_index;            // Handed over from the worker under index_mutex
+    Glib::Dispatcher index_dispatcher;
+
+    VteTerminal* terminal = nullptr;
+    Gtk::Button* play_button = nullptr;
+    Gtk::ComboBoxText* speed_combo = nullptr;
+    Gtk::Scale* position_scale = nullptr;
+    Gtk::Label* time_label = nullptr;
+
+    bool playing = false;
+    double speed = 1;
+    double base_time = 0;         // Recording time at base_monotonic
+    gint64 base_monotonic = 0;
+    sigc::connection timer;
+};
+
+std::unordered_map<GtkWidget*, std::unique_ptr<Player>> players_by_page;
+
+} // namespace
+
+void track(Gtk::Notebook& notebook) {
+    notebook.signal_page_removed().connect([](Gtk::Widget* page, guint) {
+        if (page) {
+            players_by_page.erase(GTK_WIDGET(page->gobj()));
+        }
+    });
+}
+
+void choose_and_open(Gtk::Window& parent) {
+    Gtk::FileChooserDialog dialog(parent, "Replay Recording", Gtk::FILE_CHOOSER_ACTION_OPEN);
+    dialog.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+    dialog.add_button("_Open", Gtk::RESPONSE_OK);
+    dialog.set_current_folder(Recording::get_directory());
+
+    auto filter = Gtk::FileFilter::create();
+    filter->set_name("Session recordings");
+    filter->add_pattern("*.cast.gz");
+    filter->add_pattern("*.cast");
+    dialog.add_filter(filter);
+
+    if (dialog.run() != Gtk::RESPONSE_OK) return;
+    std::string path = dialog.get_filename();
+    dialog.hide();
+
+    std::string error;
+    if (!open(path, error)) {
+        Gtk::MessageDialog error_dialog(parent, "Cannot Replay Recording", false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
+        error_dialog.set_secondary_text(error);
+        error_dialog.run();
+    }
+}
+
+bool open(const std::string& path, std::string& error) {
+    // Only the header is read here; events are read as they play
+    int columns = 80;
+    int rows = 24;
+    {
+        CastReader reader;
+        if (!reader.open(path)) {
+            error = "The file could not be opened.";
+            return false;
+        }
+        std::string header;
+        gint64 offset = 0;
+        if (!reader.read_line(header, offset) || !parse_header(header, columns, rows)) {
+            error = "The file is not an asciicast v2 recording.";
+            return false;
+        }
+    }
+
+    std::string name = std::filesystem::path(path).filename().string();
+    Session* session = SessionRegistry::create("", "Replay: " + name, "Replay");
+    if (!session) {
+        error = "No notebook to open the replay in.";
+        return false;
+    }
+
+    GtkWidget* page = GTK_WIDGET(session->page->gobj());
+    players_by_page[page] = std::make_unique<Player>(*session, path, columns, rows);
+    Scrollback::attach(*session, 0, true);
+    SessionRegistry::present(*session);
+    return true;
+}
+
+} // namespace Replay
@@ -0,0 +1,24 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <gtkmm/notebook.h>
+#include <gtkmm/window.h>
+#include <string>
+
+namespace Replay {
+
+// Release players when their tabs close
+void track(Gtk::Notebook& notebook);
+
+// Ask for a recording and open it in a replay tab
+void choose_and_open(Gtk::Window& parent);
+
+// Open an asciicast v2 recording (.cast or .cast.gz) in a read-only replay tab. Events are
+// read as they play. A keyframe index with byte offsets (and deflate resume points for .gz)
+// is kept next to the recording as "<file>.idx", built in the background on first open, so
+// seeking only decodes a bounded stretch. On failure, error describes why.
+bool open(const std::string& path, std::string& error);
+
+} // namespace Replay
+
+#endif // REPLAY_H
@@ -0,0 +1,264 @@
+#include "Restore.h"
+#include "main.h"
+#include <glibmm/main.h>
+#include <glibmm/markup.h>
+#include <gtkmm/button.h>
+#include <gtkmm/socket.h>
+#include <deque>
+#include <unordered_map>
+
+namespace SessionRestore {
+
+namespace {
+
+Gtk::Notebook* restore_notebook = nullptr;
+
+// Suppresses saving and auto-start while restore() builds the placeholder tabs
+bool restoring = false;
+
+// Debounced save after tab changes
+sigc::connection save_timer;
+
+// Placeholder pages waiting for a background start, and starts still connecting
+std::deque<GtkWidget*> pending_pages;
+int starts_in_flight = 0;
+
+// A background start counts as in flight until the terminal shows its first output (the SSH
+// handshake got somewhere) or the RDP viewer embedded its window, or until a timeout,
+// whichever comes first
+struct BackgroundStart {
+    GtkWidget* widget = nullptr;  // Terminal or RDP socket, cleared if it is destroyed first
+    gulong started_handler = 0;
+    guint timeout_source = 0;
+};
+
+const guint BACKGROUND_START_TIMEOUT_MS = 15000;
+
+void pump_background_starts();
+
+void finish_background_start(BackgroundStart* start) {
+    if (start->widget) {
+        g_signal_handler_disconnect(start->widget, start->started_handler);
+        g_object_remove_weak_pointer(G_OBJECT(start->widget), reinterpret_cast<gpointer*>(&start->widget));
+    }
+    if (start->timeout_source) {
+        g_source_remove(start->timeout_source);
+    }
+    delete start;
+
+    starts_in_flight--;
+    Glib::signal_idle().connect_once(sigc::ptr_fun(&pump_background_starts));
+}
+
+// "contents-changed" of a terminal or "plug-added" of an RDP socket
+void on_background_started(GtkWidget* /* widget */, gpointer user_data) {
+    finish_background_start(static_cast<BackgroundStart*>(user_data));
+}
+
+gboolean on_background_start_timeout(gpointer user_data) {
+    BackgroundStart* start = static_cast<BackgroundStart*>(user_data);
+    start->timeout_source = 0; // Source is removed by returning G_SOURCE_REMOVE
+    finish_background_start(start);
+    return G_SOURCE_REMOVE;
+}
+
+void pump_background_starts() {
+    int limit = Config::get_restore_concurrency();
+    while (starts_in_flight < limit && !pending_pages.empty()) {
+        GtkWidget* page = pending_pages.front();
+        pending_pages.pop_front();
+
+        Session* session = SessionRegistry::find_by_widget(page);
+        if (!session || !session->placeholder) continue; // Closed or already started
+
+        materialize(*session, false);
+
+        BackgroundStart* start = new BackgroundStart();
+        const char* started_signal = "contents-changed";
+        if (session->terminal) {
+            start->widget = GTK_WIDGET(session->terminal);
+        } else {
+            for (Gtk::Widget* child : session->page->get_children()) {
+                if (Gtk::Socket* socket = dynamic_cast<Gtk::Socket*>(child)) {
+                    start->widget = GTK_WIDGET(socket->gobj());
+                    started_signal = "plug-added";
+                    break;
+                }
+            }
+        }
+        if (!start->widget) { // Nothing was launched, e.g. the connection was deleted
+            delete start;
+            continue;
+        }
+        g_object_add_weak_pointer(G_OBJECT(start->widget), reinterpret_cast<gpointer*>(&start->widget));
+        start->started_handler = g_signal_connect(start->widget, started_signal,
+                                                  G_CALLBACK(on_background_started), start);
+        start->timeout_source = g_timeout_add(BACKGROUND_START_TIMEOUT_MS, on_background_start_timeout, start);
+        starts_in_flight++;
+    }
+}
+
+void schedule_save() {
+    if (restoring || save_timer.connected()) return;
+    save_timer = Glib::signal_timeout().connect([]() {
+        save();
+        return false;
+    }, 1000);
+}
+
+void on_switch_page(Gtk::Widget* page, guint /* page_num */) {
+    schedule_save();
+    if (restoring || !page) return;
+
+    Session* session = SessionRegistry::find_by_widget(GTK_WIDGET(page->gobj()));
+    if (session && session->placeholder) {
+        // Start outside the switch-page emission
+        GtkWidget* page_widget = GTK_WIDGET(page->gobj());
+        Glib::signal_idle().connect_once([page_widget]() {
+            Session* selected = SessionRegistry::find_by_widget(page_widget);
+            if (selected && selected->placeholder) {
+                materialize(*selected, true);
+            }
+        });
+    }
+}
+
+// Build the content shown in a placeholder page until its process is started
+void fill_placeholder_page(Session& session) {
+    Gtk::Box* box = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_VERTICAL, 12));
+    box->set_valign(Gtk::ALIGN_CENTER);
+    box->set_halign(Gtk::ALIGN_CENTER);
+
+    Gtk::Label* label = Gtk::manage(new Gtk::Label());
+    label->set_markup("<b>" + Glib::Markup::escape_text(session.title) + "</b>\n"
+                      "Restored from the previous session. Select this tab or click Connect to start it.");
+    label->set_justify(Gtk::JUSTIFY_CENTER);
+
+    Gtk::Button* connect_button = Gtk::manage(new Gtk::Button("Connect"));
+    connect_button->set_halign(Gtk::ALIGN_CENTER);
+    GtkWidget* page_widget = GTK_WIDGET(session.page->gobj());
+    connect_button->signal_clicked().connect([page_widget]() {
+        // Start on idle, materialize() destroys this button
+        Glib::signal_idle().connect_once([page_widget]() {
+            Session* selected = SessionRegistry::find_by_widget(page_widget);
+            if (selected && selected->placeholder) {
+                materialize(*selected, true);
+            }
+        });
+    });
+
+    box->pack_start(*label, Gtk::PACK_SHRINK);
+    box->pack_start(*connect_button, Gtk::PACK_SHRINK);
+    session.page->pack_start(*box, Gtk::PACK_EXPAND_WIDGET);
+    box->show_all();
+}
+
+} // namespace
+
+void track(Gtk::Notebook& notebook) {
+    restore_notebook = &notebook;
+    notebook.signal_page_added().connect([](Gtk::Widget*, guint) { schedule_save(); });
+    notebook.signal_page_removed().connect([](Gtk::Widget*, guint) { schedule_save(); });
+    notebook.signal_page_reordered().connect([](Gtk::Widget*, guint) { schedule_save(); });
+    notebook.signal_switch_page().connect(sigc::ptr_fun(&on_switch_page));
+}
+
+void save() {
+    if (save_timer.connected()) {
+        save_timer.disconnect();
+    }
+    if (!Config::get_restore_sessions()) return;
+
+    json connection_ids = json::array();
+    int active = -1;
+    Session* current = SessionRegistry::current();
+    for (Session* session : SessionRegistry::all()) {
+        if (session->connection_id.empty()) continue; // Tabs not backed by a saved connection
+        if (session == current) {
+            active = static_cast<int>(connection_ids.size());
+        }
+        connection_ids.push_back(session->connection_id);
+    }
+
+    json new_config = Config::get();
+    json open_sessions = {
+        {"connections", connection_ids},
+        {"active", active}
+    };
+    if (new_config.value("open_sessions", json::object()) != open_sessions) {
+        new_config["open_sessions"] = open_sessions;
+        Config::update(new_config);
+    }
+}
+
+void restore(Gtk::Notebook& notebook) {
+    if (!Config::get_restore_sessions()) return;
+
+    const json& config = Config::get();
+    if (!config.contains("open_sessions") || !config["open_sessions"].is_object()) return;
+    const json& open_sessions = config["open_sessions"];
+    json connection_ids = open_sessions.value("connections", json::array());
+    int active = open_sessions.value("active", -1);
+    if (!connection_ids.is_array() || connection_ids.empty()) return;
+
+    // Load the saved connections once instead of once per tab
+    std::unordered_map<std::string, ConnectionInfo> connections;
+    for (const auto& conn : ConnectionManager::load_connections()) {
+        connections[conn.id.raw()] = conn;
+    }
+
+    restoring = true;
+    Session* active_session = nullptr;
+    int index = 0;
+    for (const auto& id_value : connection_ids) {
+        int position = index++;
+        if (!id_value.is_string()) continue;
+        auto conn_it = connections.find(id_value.get<std::string>());
+        if (conn_it == connections.end()) continue; // Connection was deleted since
+
+        Session* session = SessionRegistry::create(conn_it->first, conn_it->second.name,
+                                                   conn_it->second.connection_type);
+        if (!session) continue;
+        session->placeholder = true;
+        fill_placeholder_page(*session);
+        SessionRegistry::refresh_tab_label(*session);
+
+        if (position == active) {
+            active_session = session;
+        } else {
+            pending_pages.push_back(GTK_WIDGET(session->page->gobj()));
+        }
+    }
+    restoring = false;
+
+    if (active_session) {
+        notebook.set_current_page(notebook.page_num(*active_session->page));
+        materialize(*active_session, true);
+    }
+
+    // Give the main window a moment to appear before connecting in the background
+    Glib::signal_timeout().connect_once(sigc::ptr_fun(&pump_background_starts), 500);
+}
+
+void materialize(Session& session, bool foreground) {
+    if (!session.placeholder || !restore_notebook) return;
+
+    // Remove the placeholder content; the page widget itself stays in place
+    for (Gtk::Widget* child : session.page->get_children()) {
+        session.page->remove(*child);
+    }
+    session.placeholder = false;
+    SessionRegistry::refresh_tab_label(session);
+
+    ConnectionInfo conn = ConnectionManager::get_connection_by_id(session.connection_id);
+    if (conn.id.empty()) {
+        Gtk::Label* label = Gtk::manage(new Gtk::Label("This connection no longer exists."));
+        session.page->pack_start(*label, Gtk::PACK_EXPAND_WIDGET);
+        label->show();
+        return;
+    }
+
+    start_session(*restore_notebook, session, conn, foreground);
+}
+
+} // namespace SessionRestore
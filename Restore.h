@@ -0,0 +1,26 @@
+#ifndef RESTORE_H
+#define RESTORE_H
+
+#include <gtkmm/notebook.h>
+#include "Sessions.h"
+
+namespace SessionRestore {
+
+// Watch the notebook and persist the open tab list (connection IDs, order, active tab)
+// whenever it changes. Also starts placeholder tabs when they are selected.
+void track(Gtk::Notebook& notebook);
+
+// Recreate the previously open tabs as lightweight placeholders. The active tab is
+// started immediately; the rest start when selected or in the background, limited
+// by the "restore_concurrency" setting.
+void restore(Gtk::Notebook& notebook);
+
+// Write the open tab list to the configuration now
+void save();
+
+// Replace a placeholder page with its real terminal or RDP viewer and start it
+void materialize(Session& session, bool foreground);
+
+} // namespace SessionRestore
+
+#endif // RESTORE_H
@@ -0,0 +1,261 @@
+#include "Scrollback.h"
+#include "Config.h"
+#include <glibmm/miscutils.h>
+#include <zlib.h>
+#include <algorithm>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#include <cstdlib>
+
+namespace Scrollback {
+
+namespace {
+
+// A terminal under the budget. Entries are kept in most-recently-used order.
+struct Entry {
+    GtkWidget* page = nullptr;
+    VteTerminal* terminal = nullptr;
+    long preferred_lines = 0;  // Lines the tab gets while it fits in the budget
+    long current_lines = 0;    // Lines currently configured on the terminal
+    std::string spill_path;    // Compressed archive of scrollback dropped by reductions
+};
+
+std::list<Entry> entries_mru;
+std::unordered_map<GtkWidget*, std::list<Entry>::iterator> entries_by_page;
+unsigned int spill_counter = 0;
+
+std::filesystem::path get_spill_dir() {
+    return std::filesystem::path(Glib::get_user_cache_dir()) / "ngTerm" / "scrollback";
+}
+
+// Text on its way to an archive, or the removal of one, in the order they were queued
+struct SpillTask {
+    std::string path;
+    std::string text;   // Empty to remove the archive
+};
+
+// Compressing and writing happen on one writer thread; archive_mutex keeps readers from
+// seeing a half-written gzip member
+std::thread writer_thread;
+std::deque<SpillTask> spill_tasks;
+std::mutex tasks_mutex;
+std::condition_variable tasks_cv;
+bool writer_stop = false;
+std::mutex archive_mutex;
+
+void write_spill(const SpillTask& task) {
+    std::lock_guard<std::mutex> lock(archive_mutex);
+    if (task.text.empty()) {
+        std::error_code ec;
+        std::filesystem::remove(task.path, ec);
+        return;
+    }
+
+    // Each spill is a separate gzip member, so zcat shows the archive as one text file
+    gzFile file = gzopen(task.path.c_str(), "ab6");
+    if (!file) {
+        std::cerr << "Scrollback: Failed to open " << task.path << std::endl;
+        return;
+    }
+    gzwrite(file, task.text.data(), static_cast<unsigned>(task.text.size()));
+    gzclose(file);
+}
+
+void writer_main() {
+    for (;;) {
+        SpillTask task;
+        {
+            std::unique_lock<std::mutex> lock(tasks_mutex);
+            tasks_cv.wait(lock, []() { return writer_stop || !spill_tasks.empty(); });
+            if (spill_tasks.empty()) return; // Stopping, everything queued was written
+            task = std::move(spill_tasks.front());
+            spill_tasks.pop_front();
+        }
+        write_spill(task);
+    }
+}
+
+void queue_task(SpillTask task) {
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        if (writer_stop) return;
+        spill_tasks.push_back(std::move(task));
+    }
+    if (!writer_thread.joinable()) {
+        writer_thread = std::thread(writer_main);
+    }
+    tasks_cv.notify_one();
+}
+
+// Copy the scrollback lines that shrinking to target_lines drops and queue them for the
+// archive. Only the dropped rows are copied here; compression runs on the writer thread.
+void spill(Entry& entry, long target_lines) {
+    if (!entry.terminal) return;
+
+    GtkAdjustment* adjustment = gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(entry.terminal));
+    long first_row = static_cast<long>(gtk_adjustment_get_lower(adjustment));
+    long end_row = static_cast<long>(gtk_adjustment_get_upper(adjustment));
+    long history = end_row - first_row - vte_terminal_get_row_count(entry.terminal);
+    long dropped = history - target_lines;
+    if (dropped <= 0) return;
+
+    long columns = vte_terminal_get_column_count(entry.terminal);
+    char* text = vte_terminal_get_text_range(entry.terminal, first_row, 0, first_row + dropped - 1,
+                                             columns - 1, nullptr, nullptr, nullptr);
+    if (!text || !*text) {
+        g_free(text);
+        return;
+    }
+
+    if (entry.spill_path.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(get_spill_dir(), ec);
+        entry.spill_path = (get_spill_dir() /
+            (std::to_string(getpid()) + "-" + std::to_string(++spill_counter) + ".txt.gz")).string();
+    }
+
+    std::time_t now = std::time(nullptr);
+    char stamp[64];
+    std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+    SpillTask task;
+    task.path = entry.spill_path;
+    task.text = std::string("----- ngTerm scrollback saved ") + stamp + " -----\n" + text;
+    g_free(text);
+    queue_task(std::move(task));
+}
+
+void on_switch_page(Gtk::Widget* page, guint /* page_num */) {
+    if (!page) return;
+    auto it = entries_by_page.find(GTK_WIDGET(page->gobj()));
+    if (it == entries_by_page.end()) return;
+
+    // Move to the front of the MRU list in O(1)
+    entries_mru.splice(entries_mru.begin(), entries_mru, it->second);
+    rebalance();
+}
+
+void on_page_removed(Gtk::Widget* page, guint /* page_num */) {
+    if (!page) return;
+    auto it = entries_by_page.find(GTK_WIDGET(page->gobj()));
+    if (it == entries_by_page.end()) return;
+
+    // The archive only exists to back the live tab; removed after its pending writes
+    if (!it->second->spill_path.empty()) {
+        queue_task({it->second->spill_path, ""});
+    }
+    entries_mru.erase(it->second);
+    entries_by_page.erase(it);
+}
+
+void on_terminal_destroy(GtkWidget* /* widget */, gpointer user_data) {
+    // The page may outlive its terminal (e.g. a placeholder being refilled)
+    auto it = entries_by_page.find(static_cast<GtkWidget*>(user_data));
+    if (it != entries_by_page.end()) {
+        it->second->terminal = nullptr;
+    }
+}
+
+} // namespace
+
+void track(Gtk::Notebook& notebook) {
+    notebook.signal_switch_page().connect(sigc::ptr_fun(&on_switch_page));
+    notebook.signal_page_removed().connect(sigc::ptr_fun(&on_page_removed));
+
+    // Archives are named "<pid>-<n>.txt.gz"; remove those left behind by instances that are gone
+    std::error_code ec;
+    for (const auto& dir_entry : std::filesystem::directory_iterator(get_spill_dir(), ec)) {
+        std::string name = dir_entry.path().filename().string();
+        pid_t owner = static_cast<pid_t>(std::atol(name.c_str()));
+        if (owner <= 0 || (kill(owner, 0) != 0 && errno == ESRCH)) {
+            std::filesystem::remove(dir_entry.path(), ec);
+        }
+    }
+}
+
+void attach(Session& session, int preferred_lines, bool foreground) {
+    if (!session.terminal || !session.page) return;
+
+    GtkWidget* page = GTK_WIDGET(session.page->gobj());
+    auto existing = entries_by_page.find(page);
+    if (existing != entries_by_page.end()) {
+        entries_mru.erase(existing->second);
+        entries_by_page.erase(existing);
+    }
+
+    Entry entry;
+    entry.page = page;
+    entry.terminal = session.terminal;
+    entry.preferred_lines = (preferred_lines > 0) ? preferred_lines : Config::get_scrollback_lines();
+    entry.current_lines = entry.preferred_lines;
+    vte_terminal_set_scrollback_lines(session.terminal, entry.current_lines);
+    g_signal_connect(session.terminal, "destroy", G_CALLBACK(on_terminal_destroy), page);
+
+    auto position = foreground ? entries_mru.begin() : entries_mru.end();
+    entries_by_page[page] = entries_mru.insert(position, entry);
+    rebalance();
+}
+
+void rebalance() {
+    const long budget = Config::get_scrollback_budget_lines();
+    const long idle_lines = Config::get_scrollback_idle_lines();
+    long used = 0;
+
+    // Walk from most to least recently used; tabs that no longer fit are trimmed
+    for (Entry& entry : entries_mru) {
+        if (!entry.terminal) continue;
+
+        long target = entry.preferred_lines;
+        if (used + target > budget) {
+            target = std::min(entry.preferred_lines, idle_lines);
+        }
+        used += target;
+
+        if (target == entry.current_lines) continue;
+        if (target < entry.current_lines) {
+            spill(entry, target);
+        }
+        vte_terminal_set_scrollback_lines(entry.terminal, target);
+        entry.current_lines = target;
+    }
+}
+
+std::string get_saved_path(const Session& session) {
+    if (!session.page) return "";
+    auto it = entries_by_page.find(GTK_WIDGET(session.page->gobj()));
+    return (it != entries_by_page.end()) ? it->second->spill_path : "";
+}
+
+std::string read_saved(const std::string& path) {
+    std::lock_guard<std::mutex> lock(archive_mutex);
+    std::string text;
+    gzFile file = gzopen(path.c_str(), "rb");
+    if (!file) return text;
+    char buffer[65536];
+    int length = 0;
+    while ((length = gzread(file, buffer, sizeof(buffer))) > 0) {
+        text.append(buffer, static_cast<size_t>(length));
+    }
+    gzclose(file);
+    return text;
+}
+
+void shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        writer_stop = true;
+    }
+    tasks_cv.notify_all();
+    if (writer_thread.joinable()) {
+        writer_thread.join();
+    }
+}
+
+} // namespace Scrollback
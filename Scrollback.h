@@ -0,0 +1,33 @@
+#ifndef SCROLLBACK_H
+#define SCROLLBACK_H
+
+#include <gtkmm/notebook.h>
+#include "Sessions.h"
+#include <string>
+
+namespace Scrollback {
+
+// Watch tab switches and closes so recently used tabs keep their full scrollback
+void track(Gtk::Notebook& notebook);
+
+// Put a session's terminal under the global scrollback budget.
+// preferred_lines <= 0 uses the global "scrollback_lines" default.
+// Foreground sessions count as most recently used, background ones as least.
+void attach(Session& session, int preferred_lines, bool foreground);
+
+// Re-apply the budget, e.g. after the settings changed
+void rebalance();
+
+// Compressed archive of the scrollback lines a tab lost to trimming, empty if it has none.
+// It lives as long as the tab.
+std::string get_saved_path(const Session& session);
+
+// Text of an archive; safe on worker threads, never sees a half-written part
+std::string read_saved(const std::string& path);
+
+// Finish writing archives; call before exiting
+void shutdown();
+
+} // namespace Scrollback
+
+#endif // SCROLLBACK_H
@@ -0,0 +1,419 @@
+#include "Search.h"
+#include "Sessions.h"
+#include "Scrollback.h"
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include <pcre2.h>
+#include <gtkmm/box.h>
+#include <gtkmm/button.h>
+#include <gtkmm/checkbutton.h>
+#include <gtkmm/entry.h>
+#include <gtkmm/label.h>
+#include <gtkmm/scrolledwindow.h>
+#include <gtkmm/treestore.h>
+#include <gtkmm/treeview.h>
+#include <glibmm/dispatcher.h>
+#include <glibmm/main.h>
+#include <glibmm/markup.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Search {
+
+namespace {
+
+// Matches reported per tab, and characters shown per matching line
+const size_t MAX_MATCHES_PER_TAB = 1000;
+const long MAX_LINE_CHARS = 300;
+
+using RegexPtr = std::shared_ptr<pcre2_code>;
+
+// A terminal's scrollback, copied on the GTK thread for a worker to search
+struct Job {
+    guint generation = 0;
+    GtkWidget* page = nullptr;
+    std::string title;
+    std::string text;
+    long first_row = 0;   // Terminal row of the first line in text
+    long columns = 80;
+    std::string saved_path; // Scrollback archive of lines trimmed from the tab, read by the worker
+    RegexPtr regex;
+};
+
+struct Match {
+    long row = 0;
+    std::string line;
+};
+
+struct TabResult {
+    guint generation = 0;
+    GtkWidget* page = nullptr;
+    std::string title;
+    std::vector<Match> matches;
+    bool truncated = false;
+    std::vector<Match> saved_matches; // From the archive; rows are not on screen any more
+    bool saved_truncated = false;
+};
+
+// Worker pool shared by all searches; a new search bumps the generation so
+// queued and running work for older searches is skipped
+std::vector<std::thread> workers;
+std::deque<Job> jobs;
+std::mutex jobs_mutex;
+std::condition_variable jobs_cv;
+bool workers_stop = false;
+std::atomic<guint> current_generation{0};
+
+std::deque<TabResult> results;
+std::mutex results_mutex;
+Glib::Dispatcher* results_dispatcher = nullptr;
+
+// Collect the matching lines of text, numbering rows from first_row
+void search_text(const Job& job, const std::string& text, long first_row,
+                 std::vector<Match>& matches, bool& truncated) {
+    pcre2_match_data* match_data = pcre2_match_data_create_from_pattern(job.regex.get(), nullptr);
+    long row = first_row;
+    size_t line_start = 0;
+    while (line_start <= text.size()) {
+        if (current_generation.load() != job.generation) break; // Superseded
+
+        size_t line_end = text.find('\n', line_start);
+        if (line_end == std::string::npos) line_end = text.size();
+        const char* line = text.data() + line_start;
+        size_t length = line_end - line_start;
+
+        if (pcre2_match(job.regex.get(), reinterpret_cast<PCRE2_SPTR>(line), length, 0, 0, match_data, nullptr) >= 0) {
+            if (matches.size() >= MAX_MATCHES_PER_TAB) {
+                truncated = true;
+                break;
+            }
+            Glib::ustring line_text(std::string(line, length));
+            if (line_text.validate() && static_cast<long>(line_text.length()) > MAX_LINE_CHARS) {
+                line_text = line_text.substr(0, MAX_LINE_CHARS) + "…";
+            }
+            matches.push_back({row, line_text.raw()});
+        }
+
+        // Soft-wrapped rows come back as one line; count the rows it covers
+        long cells = g_utf8_strlen(line, length);
+        row += std::max(1L, (cells + job.columns - 1) / job.columns);
+        line_start = line_end + 1;
+    }
+    pcre2_match_data_free(match_data);
+}
+
+TabResult search_job(const Job& job) {
+    TabResult result;
+    result.generation = job.generation;
+    result.page = job.page;
+    result.title = job.title;
+    if (!job.saved_path.empty()) {
+        search_text(job, Scrollback::read_saved(job.saved_path), 0, result.saved_matches, result.saved_truncated);
+    }
+    search_text(job, job.text, job.first_row, result.matches, result.truncated);
+    return result;
+}
+
+void worker_main() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(jobs_mutex);
+            jobs_cv.wait(lock, []() { return workers_stop || !jobs.empty(); });
+            if (workers_stop) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        if (job.generation != current_generation.load()) continue;
+
+        TabResult result = search_job(job);
+        {
+            std::lock_guard<std::mutex> lock(results_mutex);
+            results.push_back(std::move(result));
+        }
+        results_dispatcher->emit();
+    }
+}
+
+void ensure_workers() {
+    if (!workers.empty()) return;
+    unsigned int count = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+    for (unsigned int i = 0; i < count; ++i) {
+        workers.emplace_back(worker_main);
+    }
+}
+
+class SearchColumns : public Gtk::TreeModel::ColumnRecord {
+public:
+    SearchColumns() {
+        add(text);
+        add(page);
+        add(row);
+    }
+    Gtk::TreeModelColumn<Glib::ustring> text;
+    Gtk::TreeModelColumn<gpointer> page;
+    Gtk::TreeModelColumn<long> row;
+};
+
+class SearchWindow : public Gtk::Window {
+public:
+    explicit SearchWindow(Gtk::Window& parent) : box(Gtk::ORIENTATION_VERTICAL, 6), query_box(Gtk::ORIENTATION_HORIZONTAL, 6),
+                                                 case_check("Match case"), search_button("Search") {
+        set_title("Search All Tabs");
+        set_transient_for(parent);
+        set_default_size(700, 500);
+        set_border_width(8);
+
+        pattern_entry.set_placeholder_text("Regular expression");
+        pattern_entry.set_hexpand(true);
+        pattern_entry.signal_activate().connect(sigc::mem_fun(*this, &SearchWindow::start_search));
+        search_button.signal_clicked().connect(sigc::mem_fun(*this, &SearchWindow::start_search));
+        query_box.pack_start(pattern_entry, Gtk::PACK_EXPAND_WIDGET);
+        query_box.pack_start(case_check, Gtk::PACK_SHRINK);
+        query_box.pack_start(search_button, Gtk::PACK_SHRINK);
+
+        store = Gtk::TreeStore::create(columns);
+        results_view.set_model(store);
+        results_view.append_column("", columns.text);
+        results_view.set_headers_visible(false);
+        results_view.signal_row_activated().connect(sigc::mem_fun(*this, &SearchWindow::on_row_activated));
+        scrolled.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+        scrolled.add(results_view);
+
+        status_label.set_halign(Gtk::ALIGN_START);
+
+        box.pack_start(query_box, Gtk::PACK_SHRINK);
+        box.pack_start(scrolled, Gtk::PACK_EXPAND_WIDGET);
+        box.pack_start(status_label, Gtk::PACK_SHRINK);
+        add(box);
+        show_all_children();
+
+        results_dispatcher->connect(sigc::mem_fun(*this, &SearchWindow::on_results));
+    }
+
+    void focus_pattern() {
+        pattern_entry.grab_focus();
+    }
+
+private:
+    void start_search() {
+        Glib::ustring pattern = pattern_entry.get_text();
+        if (pattern.empty()) return;
+
+        int error_code = 0;
+        PCRE2_SIZE error_offset = 0;
+        uint32_t options = PCRE2_UTF | PCRE2_NO_UTF_CHECK | (case_check.get_active() ? 0 : PCRE2_CASELESS);
+        pcre2_code* code = pcre2_compile(reinterpret_cast<PCRE2_SPTR>(pattern.c_str()), PCRE2_ZERO_TERMINATED,
+                                         options, &error_code, &error_offset, nullptr);
+        if (!code) {
+            PCRE2_UCHAR message[256];
+            pcre2_get_error_message(error_code, message, sizeof(message));
+            status_label.set_text("Invalid pattern: " + std::string(reinterpret_cast<char*>(message)));
+            return;
+        }
+        pcre2_jit_compile(code, PCRE2_JIT_COMPLETE); // Falls back to the interpreter if JIT is unavailable
+        regex = RegexPtr(code, pcre2_code_free);
+        last_pattern = pattern;
+        last_case_sensitive = case_check.get_active();
+
+        generation = ++current_generation;
+        store->clear();
+        tabs_total = 0;
+        tabs_done = 0;
+        match_count = 0;
+
+        // Snapshot one tab per idle iteration so the UI stays responsive
+        pending_pages.clear();
+        for (Session* session : SessionRegistry::all()) {
+            if (session->terminal) {
+                pending_pages.push_back(GTK_WIDGET(session->page->gobj()));
+            }
+        }
+        tabs_total = pending_pages.size();
+        update_status();
+
+        snapshot_idle.disconnect();
+        if (!pending_pages.empty()) {
+            ensure_workers();
+            snapshot_idle = Glib::signal_idle().connect(sigc::mem_fun(*this, &SearchWindow::snapshot_next));
+        }
+    }
+
+    bool snapshot_next() {
+        while (!pending_pages.empty()) {
+            GtkWidget* page = pending_pages.front();
+            pending_pages.pop_front();
+
+            Session* session = SessionRegistry::find_by_widget(page);
+            if (!session || !session->terminal) {
+                tabs_done++; // Closed since the search started
+                update_status();
+                continue;
+            }
+
+            GtkAdjustment* adjustment = gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(session->terminal));
+            long first_row = static_cast<long>(gtk_adjustment_get_lower(adjustment));
+            long last_row = static_cast<long>(gtk_adjustment_get_upper(adjustment)) - 1;
+            long columns = vte_terminal_get_column_count(session->terminal);
+            char* text = vte_terminal_get_text_range(session->terminal, first_row, 0, last_row, columns - 1,
+                                                     nullptr, nullptr, nullptr);
+
+            Job job;
+            job.generation = generation;
+            job.page = page;
+            job.title = session->title.raw();
+            job.text = text ? text : "";
+            job.first_row = first_row;
+            job.columns = std::max(1L, columns);
+            job.saved_path = Scrollback::get_saved_path(*session);
+            job.regex = regex;
+            g_free(text);
+            {
+                std::lock_guard<std::mutex> lock(jobs_mutex);
+                jobs.push_back(std::move(job));
+            }
+            jobs_cv.notify_one();
+            return !pending_pages.empty();
+        }
+        return false;
+    }
+
+    void on_results() {
+        std::deque<TabResult> ready;
+        {
+            std::lock_guard<std::mutex> lock(results_mutex);
+            ready.swap(results);
+        }
+
+        for (TabResult& result : ready) {
+            if (result.generation != generation) continue;
+            tabs_done++;
+            size_t total = result.matches.size() + result.saved_matches.size();
+            if (total == 0) continue;
+            match_count += total;
+
+            Gtk::TreeModel::Row tab_row = *store->append();
+            Glib::ustring count = std::to_string(total) + (result.truncated || result.saved_truncated ? "+" : "");
+            tab_row[columns.text] = Glib::ustring(result.title) + " (" + count +
+                                    (total == 1 ? " match)" : " matches)");
+            tab_row[columns.page] = result.page;
+            tab_row[columns.row] = -1;
+
+            // Trimmed lines only exist in the archive, so these just bring the tab up
+            if (!result.saved_matches.empty()) {
+                Gtk::TreeModel::Row saved_row = *store->append(tab_row.children());
+                saved_row[columns.text] = "Saved scrollback (" + std::to_string(result.saved_matches.size()) +
+                                          (result.saved_truncated ? "+" : "") + ")";
+                saved_row[columns.page] = result.page;
+                saved_row[columns.row] = -1;
+                for (const Match& match : result.saved_matches) {
+                    Gtk::TreeModel::Row line_row = *store->append(saved_row.children());
+                    line_row[columns.text] = match.line;
+                    line_row[columns.page] = result.page;
+                    line_row[columns.row] = -1;
+                }
+            }
+            for (const Match& match : result.matches) {
+                Gtk::TreeModel::Row line_row = *store->append(tab_row.children());
+                line_row[columns.text] = match.line;
+                line_row[columns.page] = result.page;
+                line_row[columns.row] = match.row;
+            }
+        }
+        update_status();
+    }
+
+    void update_status() {
+        Glib::ustring status = std::to_string(match_count) + " matches";
+        if (tabs_done < tabs_total) {
+            status += ", searched " + std::to_string(tabs_done) + " of " + std::to_string(tabs_total) + " tabs...";
+        } else {
+            status += " in " + std::to_string(tabs_total) + " tabs";
+        }
+        status_label.set_text(status);
+    }
+
+    // Show the tab, scroll near the line, then let VTE select the exact match
+    void on_row_activated(const Gtk::TreeModel::Path& path, Gtk::TreeViewColumn*) {
+        Gtk::TreeModel::iterator iter = store->get_iter(path);
+        if (!iter) return;
+        gpointer page = (*iter)[columns.page];
+        Session* session = SessionRegistry::find_by_widget(static_cast<GtkWidget*>(page));
+        if (!session || !session->terminal) {
+            status_label.set_text("That tab was closed.");
+            return;
+        }
+        SessionRegistry::present(*session);
+
+        long row = (*iter)[columns.row];
+        if (row < 0) return;
+
+        GtkAdjustment* adjustment = gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(session->terminal));
+        double target = std::max(gtk_adjustment_get_lower(adjustment), static_cast<double>(row - 1));
+        gtk_adjustment_set_value(adjustment, target);
+
+        uint32_t flags = PCRE2_MULTILINE | (last_case_sensitive ? 0 : PCRE2_CASELESS);
+        VteRegex* vte_regex = vte_regex_new_for_search(last_pattern.c_str(), -1, flags, nullptr);
+        if (vte_regex) {
+            vte_terminal_unselect_all(session->terminal);
+            vte_terminal_search_set_regex(session->terminal, vte_regex, 0);
+            vte_terminal_search_find_next(session->terminal);
+            vte_regex_unref(vte_regex);
+        }
+    }
+
+    Gtk::Box box;
+    Gtk::Box query_box;
+    Gtk::Entry pattern_entry;
+    Gtk::CheckButton case_check;
+    Gtk::Button search_button;
+    Gtk::ScrolledWindow scrolled;
+    Gtk::TreeView results_view;
+    Gtk::Label status_label;
+    SearchColumns columns;
+    Glib::RefPtr<Gtk::TreeStore> store;
+
+    RegexPtr regex;
+    Glib::ustring last_pattern;
+    bool last_case_sensitive = false;
+    guint generation = 0;
+    std::deque<GtkWidget*> pending_pages;
+    sigc::connection snapshot_idle;
+    size_t tabs_total = 0;
+    size_t tabs_done = 0;
+    size_t match_count = 0;
+};
+
+SearchWindow* search_window = nullptr;
+
+} // namespace
+
+void show_window(Gtk::Window& parent) {
+    if (!search_window) {
+        results_dispatcher = new Glib::Dispatcher();
+        search_window = new SearchWindow(parent);
+    }
+    search_window->present();
+    search_window->focus_pattern();
+}
+
+void shutdown() {
+    current_generation++;
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        workers_stop = true;
+        jobs.clear();
+    }
+    jobs_cv.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+} // namespace Search
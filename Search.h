@@ -0,0 +1,17 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <gtkmm/window.h>
+
+namespace Search {
+
+// Show the window that searches the scrollback of all open terminals with a regex.
+// Matching runs on worker threads over text snapshots; results stream in per tab.
+void show_window(Gtk::Window& parent);
+
+// Stop the worker threads; call before exiting
+void shutdown();
+
+} // namespace Search
+
+#endif // SEARCH_H
@@ -0,0 +1,250 @@
+#include "Sessions.h"
+#include "Broadcast.h"
+#include "Recording.h"
+#include "Triggers.h"
+#include "Monitor.h"
+#include "LocalEcho.h"
+#include "LinkHealth.h"
+#include <glibmm/markup.h>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <signal.h>
+
+namespace {
+
+Gtk::Notebook* session_notebook = nullptr;
+
+// Owning map keyed by page widget, plus secondary indexes for O(1) lookups
+std::unordered_map<GtkWidget*, std::unique_ptr<Session>> sessions_by_page;
+std::unordered_map<GtkWidget*, Session*> sessions_by_widget;
+std::unordered_map<std::string, std::vector<Session*>> sessions_by_connection;
+
+} // namespace
+
+void SessionRegistry::init(Gtk::Notebook& notebook) {
+    session_notebook = &notebook;
+    notebook.signal_page_removed().connect(sigc::ptr_fun(&SessionRegistry::on_page_removed));
+}
+
+Gtk::Notebook* SessionRegistry::get_notebook() {
+    return session_notebook;
+}
+
+Session* SessionRegistry::create(const std::string& connection_id, const Glib::ustring& title,
+                                 const Glib::ustring& connection_type) {
+    if (!session_notebook) return nullptr;
+
+    auto session = std::make_unique<Session>();
+    session->connection_id = connection_id;
+    session->title = title;
+    session->connection_type = connection_type;
+    session->page = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_VERTICAL));
+    session->tab_label = Gtk::manage(new Gtk::Label(title, Gtk::ALIGN_START));
+
+    Session* raw = session.get();
+    GtkWidget* page_widget = GTK_WIDGET(raw->page->gobj());
+    sessions_by_page[page_widget] = std::move(session);
+    sessions_by_widget[page_widget] = raw;
+    sessions_by_connection[connection_id].push_back(raw);
+
+    session_notebook->append_page(*raw->page, *raw->tab_label);
+    session_notebook->set_tab_reorderable(*raw->page, true);
+    raw->page->show();
+    raw->tab_label->show();
+    return raw;
+}
+
+void SessionRegistry::set_terminal(Session& session, VteTerminal* terminal) {
+    if (session.terminal) {
+        sessions_by_widget.erase(GTK_WIDGET(session.terminal));
+    }
+    session.terminal = terminal;
+    if (terminal) {
+        sessions_by_widget[GTK_WIDGET(terminal)] = &session;
+    }
+}
+
+Session* SessionRegistry::find_by_widget(GtkWidget* widget) {
+    auto it = sessions_by_widget.find(widget);
+    return (it != sessions_by_widget.end()) ? it->second : nullptr;
+}
+
+Session* SessionRegistry::find_by_terminal(VteTerminal* terminal) {
+    return find_by_widget(GTK_WIDGET(terminal));
+}
+
+Session* SessionRegistry::find_first_by_connection(const std::string& connection_id) {
+    auto it = sessions_by_connection.find(connection_id);
+    if (it == sessions_by_connection.end() || it->second.empty()) return nullptr;
+    return it->second.front();
+}
+
+std::vector<Session*> SessionRegistry::find_by_connection(const std::string& connection_id) {
+    auto it = sessions_by_connection.find(connection_id);
+    return (it != sessions_by_connection.end()) ? it->second : std::vector<Session*>();
+}
+
+Session* SessionRegistry::find_by_pid(GPid pid) {
+    if (pid <= 0) return nullptr;
+    for (auto& entry : sessions_by_page) {
+        if (entry.second->pid == pid) return entry.second.get();
+    }
+    return nullptr;
+}
+
+std::vector<Session*> SessionRegistry::all() {
+    std::vector<Session*> ordered;
+    if (!session_notebook) return ordered;
+    for (int i = 0; i < session_notebook->get_n_pages(); ++i) {
+        Gtk::Widget* page = session_notebook->get_nth_page(i);
+        if (!page) continue;
+        auto it = sessions_by_page.find(GTK_WIDGET(page->gobj()));
+        if (it != sessions_by_page.end()) {
+            ordered.push_back(it->second.get());
+        }
+    }
+    return ordered;
+}
+
+Session* SessionRegistry::current() {
+    if (!session_notebook) return nullptr;
+    Gtk::Widget* page = session_notebook->get_nth_page(session_notebook->get_current_page());
+    if (!page) return nullptr;
+    auto it = sessions_by_page.find(GTK_WIDGET(page->gobj()));
+    return (it != sessions_by_page.end()) ? it->second.get() : nullptr;
+}
+
+void SessionRegistry::present(Session& session) {
+    if (!session_notebook || !session.page) return;
+    int page_num = session_notebook->page_num(*session.page);
+    if (page_num >= 0) {
+        session_notebook->set_current_page(page_num);
+    }
+    if (session.terminal) {
+        gtk_widget_grab_focus(GTK_WIDGET(session.terminal));
+    }
+}
+
+void SessionRegistry::close(Session& session) {
+    if (!session_notebook || !session.page) return;
+
+    // RDP viewers run outside the widget tree, so stop them explicitly.
+    // Terminal children get SIGHUP when the VTE and its PTY are destroyed.
+    if (!session.terminal && session.pid > 0) {
+        kill(session.pid, SIGTERM);
+    }
+
+    int page_num = session_notebook->page_num(*session.page);
+    if (page_num != -1) {
+        // on_page_removed() drops the registry entry
+        session_notebook->remove_page(page_num);
+    } else {
+        forget(&session);
+    }
+}
+
+void SessionRegistry::refresh_tab_label(Session& session) {
+    if (!session.tab_label) return;
+
+    Glib::ustring markup = Glib::Markup::escape_text(session.title);
+    Glib::ustring tooltip;
+
+    if (session.placeholder) {
+        markup = "<i>" + markup + "</i>";
+        tooltip = "Not connected yet, select the tab to connect";
+    }
+
+    if (session.terminal && Broadcast::is_target(session.terminal)) {
+        markup = "<span foreground='#e66100'><b>[B]</b></span> " + markup;
+        tooltip = "Broadcasting keyboard input to the group";
+    }
+
+    switch (Monitor::get_mark(session)) {
+        case Monitor::Mark::Activity:
+            markup = "<span foreground='#26a269'>●</span> <b>" + markup + "</b>";
+            break;
+        case Monitor::Mark::Silence:
+            markup = "<span foreground='#1c71d8'>◌</span> <b>" + markup + "</b>";
+            break;
+        case Monitor::Mark::None:
+            break;
+    }
+    if (Monitor::is_watching_activity(session) || Monitor::is_watching_silence(session)) {
+        if (!tooltip.empty()) tooltip += "\n";
+        tooltip += Monitor::is_watching_activity(session) ? "Monitoring for activity" : "";
+        if (Monitor::is_watching_silence(session)) {
+            tooltip += Monitor::is_watching_activity(session) ? " and silence" : "Monitoring for silence";
+        }
+    }
+
+    if (LocalEcho::is_enabled(session)) {
+        if (!tooltip.empty()) tooltip += "\n";
+        tooltip += "Predictive local echo on";
+    }
+
+    Glib::ustring alert = Triggers::get_alert(session);
+    if (!alert.empty()) {
+        markup = "<span foreground='#c01c28'><b>" + markup + "</b></span>";
+        if (!tooltip.empty()) tooltip += "\n";
+        tooltip += alert;
+    }
+
+    if (Recording::is_recording(session)) {
+        markup = "<span foreground='#c01c28'><b>[REC]</b></span> " + markup;
+        if (!tooltip.empty()) tooltip += "\n";
+        tooltip += "Recording to " + Recording::get_path(session);
+        guint64 dropped = Recording::get_dropped_frames(session);
+        if (dropped > 0) {
+            tooltip += "\n" + std::to_string(dropped) + " output frames dropped, the disk is falling behind";
+        }
+    }
+
+    LinkHealth::Status health = LinkHealth::get_status(session);
+    switch (health.state) {
+        case LinkHealth::State::Good:
+            markup = "<span foreground='#2ec27e'>•</span> " + markup;
+            break;
+        case LinkHealth::State::Slow:
+            markup = "<span foreground='#e5a50a'>•</span> " + markup;
+            break;
+        case LinkHealth::State::Down:
+            markup = "<span foreground='#e01b24'>•</span> " + markup;
+            break;
+        case LinkHealth::State::Unknown:
+            break;
+    }
+    if (health.state != LinkHealth::State::Unknown) {
+        if (!tooltip.empty()) tooltip += "\n";
+        tooltip += "Link: " + LinkHealth::describe(health) + ", last heard from " +
+                   LinkHealth::describe_last_seen(health);
+    }
+
+    session.tab_label->set_markup(markup);
+    session.tab_label->set_tooltip_text(tooltip);
+}
+
+void SessionRegistry::on_page_removed(Gtk::Widget* page, guint /* page_num */) {
+    if (!page) return;
+    auto it = sessions_by_page.find(GTK_WIDGET(page->gobj()));
+    if (it != sessions_by_page.end()) {
+        forget(it->second.get());
+    }
+}
+
+void SessionRegistry::forget(Session* session) {
+    if (!session) return;
+
+    auto& siblings = sessions_by_connection[session->connection_id];
+    siblings.erase(std::remove(siblings.begin(), siblings.end(), session), siblings.end());
+    if (siblings.empty()) {
+        sessions_by_connection.erase(session->connection_id);
+    }
+
+    if (session->terminal) {
+        sessions_by_widget.erase(GTK_WIDGET(session->terminal));
+    }
+    GtkWidget* page_widget = GTK_WIDGET(session->page->gobj());
+    sessions_by_widget.erase(page_widget);
+    sessions_by_page.erase(page_widget); // Destroys the Session
+}
@@ -0,0 +1,74 @@
+#ifndef SESSIONS_H
+#define SESSIONS_H
+
+#include <gtkmm/notebook.h>
+#include <gtkmm/box.h>
+#include <gtkmm/label.h>
+#include <glibmm/ustring.h>
+#include <vte/vte.h>
+#include <string>
+#include <vector>
+
+// One open tab in the notebook: a terminal or an RDP viewer attached to a saved connection.
+// The page widget stays the same for the lifetime of the tab, so lookups survive reordering.
+struct Session {
+    std::string connection_id;        // Saved connection this tab was opened from
+    Glib::ustring title;              // Tab title (the connection name)
+    Glib::ustring connection_type;    // "SSH", "RDP", ...
+    Gtk::Box* page = nullptr;         // Notebook page; owns the session content widget
+    Gtk::Label* tab_label = nullptr;  // Label shown in the notebook tab
+    VteTerminal* terminal = nullptr;  // Terminal widget, nullptr for RDP pages
+    GPid pid = 0;                     // Child process (RDP viewer), 0 if unknown
+    std::vector<std::string> argv;    // Command spawned in the terminal, reused on reconnect
+    gint64 spawned_at = 0;            // Monotonic time (us) of the last spawn
+    bool auto_reconnect = false;      // Respawn argv when the child dies unexpectedly
+    int reconnect_attempts = 0;       // Consecutive reconnect attempts
+    int auth_failures = 0;            // Consecutive exits caused by failed authentication
+    bool placeholder = false;         // Restored tab whose process has not been started yet
+    bool child_exited = false;        // Terminal child has exited, waiting for close
+    gulong close_key_handler = 0;     // "key-press-event" handler installed after exit
+};
+
+class SessionRegistry {
+public:
+    // Bind the registry to the notebook that hosts all session pages
+    static void init(Gtk::Notebook& notebook);
+
+    // Get the notebook the sessions live in
+    static Gtk::Notebook* get_notebook();
+
+    // Create a session with an empty page box and add it as a new reorderable tab
+    static Session* create(const std::string& connection_id, const Glib::ustring& title,
+                           const Glib::ustring& connection_type);
+
+    // Register the terminal shown inside a session page
+    static void set_terminal(Session& session, VteTerminal* terminal);
+
+    // O(1) lookups by page/content widget and by connection ID
+    static Session* find_by_widget(GtkWidget* widget);
+    static Session* find_by_terminal(VteTerminal* terminal);
+    static Session* find_first_by_connection(const std::string& connection_id);
+    static std::vector<Session*> find_by_connection(const std::string& connection_id);
+    static Session* find_by_pid(GPid pid);
+
+    // All sessions in current tab order
+    static std::vector<Session*> all();
+
+    // Session shown in the current notebook page, or nullptr
+    static Session* current();
+
+    // Bring a session's tab to the front and focus its content
+    static void present(Session& session);
+
+    // Close a session's tab; SSH and RDP pages share this single cleanup path
+    static void close(Session& session);
+
+    // Recompose the tab label from the session title and its state indicators
+    static void refresh_tab_label(Session& session);
+
+private:
+    static void on_page_removed(Gtk::Widget* page, guint page_num);
+    static void forget(Session* session);
+};
+
+#endif // SESSIONS_H
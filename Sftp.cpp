@@ -0,0 +1,831 @@
+#include "Sftp.h"
+#include "SftpClient.h"
+#include "Sessions.h"
+#include "Ssh.h"
+#include <gtkmm/box.h>
+#include <gtkmm/button.h>
+#include <gtkmm/cellrendererpixbuf.h>
+#include <gtkmm/cellrendererprogress.h>
+#include <gtkmm/dialog.h>
+#include <gtkmm/entry.h>
+#include <gtkmm/filechooserdialog.h>
+#include <gtkmm/label.h>
+#include <gtkmm/liststore.h>
+#include <gtkmm/messagedialog.h>
+#include <gtkmm/paned.h>
+#include <gtkmm/scrolledwindow.h>
+#include <gtkmm/treeview.h>
+#include <glibmm/datetime.h>
+#include <glibmm/main.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Sftp {
+
+namespace {
+
+// Transfers move 32 KiB per request, the size every server accepts, with up to 16 requests
+// in flight per file so a high-latency link stays full, and up to 3 files at once
+const uint32_t CHUNK_SIZE = 32 * 1024;
+const int MAX_REQUESTS_PER_FILE = 16;
+const int MAX_ACTIVE_FILES = 3;
+
+std::string join_path(const std::string& directory, const std::string& name) {
+    if (directory.empty() || directory.back() == '/') return directory + name;
+    return directory + "/" + name;
+}
+
+std::string parent_path(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos) return ".";
+    if (slash == 0) return "/";
+    return path.substr(0, slash);
+}
+
+std::string base_name(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return (slash == std::string::npos) ? path : path.substr(slash + 1);
+}
+
+Glib::ustring format_bytes(double bytes) {
+    const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    int unit = 0;
+    while (bytes >= 1024 && unit < 4) {
+        bytes /= 1024;
+        unit++;
+    }
+    char text[32];
+    snprintf(text, sizeof(text), unit == 0 ? "%.0f %s" : "%.1f %s", bytes, units[unit]);
+    return text;
+}
+
+Glib::ustring format_duration(double seconds) {
+    long total = static_cast<long>(seconds + 0.5);
+    char text[32];
+    if (total >= 3600) {
+        snprintf(text, sizeof(text), "%ld:%02ld:%02ld", total / 3600, (total / 60) % 60, total % 60);
+    } else {
+        snprintf(text, sizeof(text), "%ld:%02ld", total / 60, total % 60);
+    }
+    return text;
+}
+
+Glib::ustring format_mode(uint32_t mode) {
+    std::string text = S_ISDIR(mode) ? "d" : S_ISLNK(mode) ? "l" : "-";
+    const char* letters = "rwxrwxrwx";
+    for (int i = 0; i < 9; ++i) {
+        text += (mode & (0400 >> i)) ? letters[i] : '-';
+    }
+    return text;
+}
+
+// One file moving in either direction. Callbacks hold it by shared_ptr, so replies that
+// arrive after a failure or cancel find it and are dropped.
+struct Transfer {
+    enum class State { Queued, Running, Done, Failed };
+
+    bool upload = false;
+    std::string local_path;
+    std::string remote_path;
+    State state = State::Queued;
+    std::string error;
+    std::string handle;
+    int fd = -1;
+    guint64 size = 0;
+    guint64 done = 0;
+    guint64 next_offset = 0;
+    guint64 end_offset = G_MAXUINT64; // Where a download hit EOF
+    int in_flight = 0;
+
+    // Throughput, smoothed over the refresh ticks
+    double rate = 0;
+    guint64 rate_done = 0;
+    gint64 rate_time = 0;
+};
+
+class BrowserColumns : public Gtk::TreeModel::ColumnRecord {
+public:
+    BrowserColumns() {
+        add(icon);
+        add(name);
+        add(is_dir);
+        add(is_link);
+        add(size);
+        add(size_text);
+        add(modified);
+        add(permissions);
+    }
+    Gtk::TreeModelColumn<Glib::ustring> icon;
+    Gtk::TreeModelColumn<Glib::ustring> name;
+    Gtk::TreeModelColumn<bool> is_dir;
+    Gtk::TreeModelColumn<bool> is_link;
+    Gtk::TreeModelColumn<guint64> size;
+    Gtk::TreeModelColumn<Glib::ustring> size_text;
+    Gtk::TreeModelColumn<Glib::ustring> modified;
+    Gtk::TreeModelColumn<Glib::ustring> permissions;
+};
+
+class TransferColumns : public Gtk::TreeModel::ColumnRecord {
+public:
+    TransferColumns() {
+        add(index);
+        add(name);
+        add(direction);
+        add(progress);
+        add(progress_text);
+        add(rate);
+        add(eta);
+        add(state);
+    }
+    Gtk::TreeModelColumn<int> index;
+    Gtk::TreeModelColumn<Glib::ustring> name;
+    Gtk::TreeModelColumn<Glib::ustring> direction;
+    Gtk::TreeModelColumn<int> progress;
+    Gtk::TreeModelColumn<Glib::ustring> progress_text;
+    Gtk::TreeModelColumn<Glib::ustring> rate;
+    Gtk::TreeModelColumn<Glib::ustring> eta;
+    Gtk::TreeModelColumn<Glib::ustring> state;
+};
+
+// The content of an SFTP tab: a remote directory view above a transfer queue
+class Browser {
+public:
+    Browser(Session& session, const ConnectionInfo& conn)
+        : session(session), conn(conn), box(Gtk::ORIENTATION_VERTICAL, 6), toolbar(Gtk::ORIENTATION_HORIZONTAL, 6),
+          paned(Gtk::ORIENTATION_VERTICAL), transfer_box(Gtk::ORIENTATION_VERTICAL, 6),
+          transfer_buttons(Gtk::ORIENTATION_HORIZONTAL, 6),
+          up_button("Up"), refresh_button("Refresh"), upload_button("Upload..."), download_button("Download..."),
+          mkdir_button("New Folder..."), delete_button("Delete"),
+          close_button("Close"), cancel_button("Cancel Transfer"), clear_button("Clear Finished") {
+        box.set_border_width(6);
+
+        path_entry.set_hexpand(true);
+        path_entry.signal_activate().connect([this]() { load(path_entry.get_text()); });
+        up_button.signal_clicked().connect([this]() { load(parent_path(current_directory)); });
+        refresh_button.signal_clicked().connect([this]() {
+            if (!client.is_running()) {
+                connect();
+            } else {
+                load(current_directory);
+            }
+        });
+        upload_button.signal_clicked().connect(sigc::mem_fun(*this, &Browser::on_upload));
+        download_button.signal_clicked().connect(sigc::mem_fun(*this, &Browser::on_download));
+        mkdir_button.signal_clicked().connect(sigc::mem_fun(*this, &Browser::on_mkdir));
+        delete_button.signal_clicked().connect(sigc::mem_fun(*this, &Browser::on_delete));
+        GtkWidget* page = GTK_WIDGET(session.page->gobj());
+        close_button.signal_clicked().connect([page]() {
+            // Closing destroys this browser, its ssh and the button; leave the click handler first
+            Glib::signal_idle().connect_once([page]() {
+                if (Session* closing = SessionRegistry::find_by_widget(page)) {
+                    SessionRegistry::close(*closing);
+                }
+            });
+        });
+        toolbar.pack_start(up_button, Gtk::PACK_SHRINK);
+        toolbar.pack_start(refresh_button, Gtk::PACK_SHRINK);
+        toolbar.pack_start(path_entry, Gtk::PACK_EXPAND_WIDGET);
+        toolbar.pack_start(upload_button, Gtk::PACK_SHRINK);
+        toolbar.pack_start(download_button, Gtk::PACK_SHRINK);
+        toolbar.pack_start(mkdir_button, Gtk::PACK_SHRINK);
+        toolbar.pack_start(delete_button, Gtk::PACK_SHRINK);
+        toolbar.pack_start(close_button, Gtk::PACK_SHRINK);
+
+        // Directory view. Rows are appended unsorted while a listing streams in and sorted
+        // once at the end, so a directory with many thousands of entries stays responsive.
+        files = Gtk::ListStore::create(file_columns);
+        files->set_sort_func(file_columns.name, [this](const Gtk::TreeModel::iterator& a, const Gtk::TreeModel::iterator& b) {
+            bool a_dir = (*a)[file_columns.is_dir];
+            bool b_dir = (*b)[file_columns.is_dir];
+            if (a_dir != b_dir) return a_dir ? -1 : 1;
+            Glib::ustring a_name = (*a)[file_columns.name];
+            Glib::ustring b_name = (*b)[file_columns.name];
+            return a_name.raw().compare(b_name.raw());
+        });
+        file_view.set_model(files);
+        auto* name_column = Gtk::manage(new Gtk::TreeViewColumn("Name"));
+        auto* icon_renderer = Gtk::manage(new Gtk::CellRendererPixbuf());
+        name_column->pack_start(*icon_renderer, false);
+        name_column->add_attribute(icon_renderer->property_icon_name(), file_columns.icon);
+        name_column->pack_start(file_columns.name);
+        name_column->set_expand(true);
+        file_view.append_column(*name_column);
+        file_view.append_column("Size", file_columns.size_text);
+        file_view.append_column("Modified", file_columns.modified);
+        file_view.append_column("Permissions", file_columns.permissions);
+        file_view.get_selection()->set_mode(Gtk::SELECTION_MULTIPLE);
+        file_view.signal_row_activated().connect(sigc::mem_fun(*this, &Browser::on_row_activated));
+        file_scrolled.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+        file_scrolled.add(file_view);
+
+        // Transfer queue
+        transfers_store = Gtk::ListStore::create(transfer_columns);
+        transfer_view.set_model(transfers_store);
+        transfer_view.append_column("File", transfer_columns.name);
+        transfer_view.append_column("Direction", transfer_columns.direction);
+        auto* progress_renderer = Gtk::manage(new Gtk::CellRendererProgress());
+        auto* progress_column = Gtk::manage(new Gtk::TreeViewColumn("Progress", *progress_renderer));
+        progress_column->add_attribute(progress_renderer->property_value(), transfer_columns.progress);
+        progress_column->add_attribute(progress_renderer->property_text(), transfer_columns.progress_text);
+        progress_column->set_expand(true);
+        transfer_view.append_column(*progress_column);
+        transfer_view.append_column("Rate", transfer_columns.rate);
+        transfer_view.append_column("ETA", transfer_columns.eta);
+        transfer_view.append_column("State", transfer_columns.state);
+        transfer_view.get_column(0)->set_expand(true);
+        transfer_scrolled.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+        transfer_scrolled.add(transfer_view);
+
+        cancel_button.signal_clicked().connect(sigc::mem_fun(*this, &Browser::on_cancel));
+        clear_button.signal_clicked().connect(sigc::mem_fun(*this, &Browser::on_clear));
+        status_label.set_halign(Gtk::ALIGN_START);
+        status_label.set_ellipsize(Pango::ELLIPSIZE_END);
+        transfer_buttons.pack_start(status_label, Gtk::PACK_EXPAND_WIDGET);
+        transfer_buttons.pack_end(clear_button, Gtk::PACK_SHRINK);
+        transfer_buttons.pack_end(cancel_button, Gtk::PACK_SHRINK);
+        transfer_box.pack_start(transfer_scrolled, Gtk::PACK_EXPAND_WIDGET);
+        transfer_box.pack_start(transfer_buttons, Gtk::PACK_SHRINK);
+
+        paned.pack1(file_scrolled, true, false);
+        paned.pack2(transfer_box, false, false);
+        paned.set_position(360);
+
+        box.pack_start(toolbar, Gtk::PACK_SHRINK);
+        box.pack_start(paned, Gtk::PACK_EXPAND_WIDGET);
+        session.page->pack_start(box, Gtk::PACK_EXPAND_WIDGET);
+        box.show_all();
+
+        client.on_ready = [this]() {
+            client.realpath(current_directory.empty() ? "." : current_directory, [this](const Reply& reply) {
+                load(reply.entries.empty() ? std::string(".") : reply.entries.front().name);
+            });
+        };
+        client.on_closed = [this](const std::string& reason) {
+            set_status("Disconnected: " + reason + ". Press Refresh to connect again.");
+            for (auto& transfer : transfers) {
+                if (transfer->state == Transfer::State::Queued || transfer->state == Transfer::State::Running) {
+                    fail(transfer, reason);
+                }
+            }
+        };
+
+        refresh_timer = Glib::signal_timeout().connect_seconds([this]() {
+            update_transfers();
+            return true;
+        }, 1);
+    }
+
+    ~Browser() {
+        refresh_timer.disconnect();
+        client.on_closed = nullptr;
+        for (auto& transfer : transfers) {
+            if (transfer->fd >= 0) ::close(transfer->fd);
+            transfer->fd = -1;
+        }
+        client.stop();
+    }
+
+    bool connect() {
+        std::vector<std::string> args = Ssh::generate_background_command_args(conn, {"-o", "ControlMaster=no", "-s"});
+        args.push_back("sftp");
+        std::string error;
+        if (!client.start(args, error)) {
+            set_status("Cannot start ssh: " + error);
+            return false;
+        }
+        set_status("Connecting to " + conn.host + "...");
+        return true;
+    }
+
+private:
+    void set_status(const Glib::ustring& text) {
+        status_label.set_text(text);
+        status_label.set_tooltip_text(text);
+    }
+
+    // Stream a directory listing into the view, batch by batch as READDIR answers
+    void load(const std::string& path) {
+        if (!client.is_ready()) return;
+        unsigned int generation = ++load_generation;
+        client.opendir(path, [this, generation, path](const Reply& reply) {
+            if (generation != load_generation) {
+                if (!reply.handle.empty()) client.close_handle(reply.handle);
+                return;
+            }
+            if (reply.handle.empty()) {
+                set_status("Cannot open " + path + ": " + (reply.message.empty() ? "failed" : reply.message));
+                return;
+            }
+            current_directory = path;
+            path_entry.set_text(path);
+            files->set_sort_column(GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID, Gtk::SORT_ASCENDING);
+            files->clear();
+            listed = 0;
+            read_directory(reply.handle, generation);
+        });
+    }
+
+    void read_directory(const std::string& handle, unsigned int generation) {
+        client.readdir(handle, [this, handle, generation](const Reply& reply) {
+            if (generation != load_generation) {
+                client.close_handle(handle);
+                return;
+            }
+            if (reply.type != FXP_NAME) {
+                client.close_handle(handle);
+                files->set_sort_column(file_columns.name, Gtk::SORT_ASCENDING);
+                if (reply.status == FX_EOF) {
+                    set_status(std::to_string(listed) + " items in " + current_directory);
+                } else {
+                    set_status("Listing stopped: " + reply.message);
+                }
+                return;
+            }
+            for (const auto& entry : reply.entries) {
+                if (entry.name == "." || entry.name == "..") continue;
+                bool is_dir = S_ISDIR(entry.attrs.permissions);
+                bool is_link = S_ISLNK(entry.attrs.permissions);
+                Gtk::TreeModel::Row row = *files->append();
+                row[file_columns.icon] = is_dir ? "folder" : is_link ? "emblem-symbolic-link" : "text-x-generic";
+                row[file_columns.name] = entry.name;
+                row[file_columns.is_dir] = is_dir;
+                row[file_columns.is_link] = is_link;
+                row[file_columns.size] = entry.attrs.size;
+                row[file_columns.size_text] = is_dir ? Glib::ustring() : format_bytes(entry.attrs.size);
+                if (entry.attrs.flags & ATTR_ACMODTIME) {
+                    row[file_columns.modified] = Glib::DateTime::create_now_local(entry.attrs.mtime).format("%Y-%m-%d %H:%M");
+                }
+                if (entry.attrs.flags & ATTR_PERMISSIONS) {
+                    row[file_columns.permissions] = format_mode(entry.attrs.permissions);
+                }
+                listed++;
+            }
+            set_status("Loading " + current_directory + "... " + std::to_string(listed) + " items");
+            read_directory(handle, generation);
+        });
+    }
+
+    void on_row_activated(const Gtk::TreeModel::Path& path, Gtk::TreeViewColumn* /* column */) {
+        Gtk::TreeModel::iterator iter = files->get_iter(path);
+        if (!iter) return;
+        std::string target = join_path(current_directory, static_cast<Glib::ustring>((*iter)[file_columns.name]).raw());
+        if ((*iter)[file_columns.is_dir]) {
+            load(target);
+        } else if ((*iter)[file_columns.is_link]) {
+            // Follow links to directories
+            client.stat(target, [this, target](const Reply& reply) {
+                if (reply.type == FXP_ATTRS && S_ISDIR(reply.attrs.permissions)) load(target);
+            });
+        }
+    }
+
+    Gtk::Window* get_window() {
+        return dynamic_cast<Gtk::Window*>(box.get_toplevel());
+    }
+
+    void show_error(const Glib::ustring& title, const Glib::ustring& text) {
+        Gtk::Window* window = get_window();
+        if (!window) return;
+        Gtk::MessageDialog dialog(*window, title, false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
+        dialog.set_secondary_text(text);
+        dialog.run();
+    }
+
+    std::vector<Gtk::TreeModel::iterator> selected_files() {
+        std::vector<Gtk::TreeModel::iterator> selected;
+        for (const auto& path : file_view.get_selection()->get_selected_rows()) {
+            Gtk::TreeModel::iterator iter = files->get_iter(path);
+            if (iter) selected.push_back(iter);
+        }
+        return selected;
+    }
+
+    void on_upload() {
+        Gtk::Window* window = get_window();
+        if (!window || !client.is_ready()) return;
+        Gtk::FileChooserDialog dialog(*window, "Upload Files", Gtk::FILE_CHOOSER_ACTION_OPEN);
+        dialog.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+        dialog.add_button("_Upload", Gtk::RESPONSE_OK);
+        dialog.set_select_multiple(true);
+        if (dialog.run() != Gtk::RESPONSE_OK) return;
+
+        for (const auto& local_path : dialog.get_filenames()) {
+            auto transfer = std::make_shared<Transfer>();
+            transfer->upload = true;
+            transfer->local_path = local_path;
+            transfer->remote_path = join_path(current_directory, base_name(local_path));
+            queue(transfer);
+        }
+    }
+
+    void on_download() {
+        Gtk::Window* window = get_window();
+        std::vector<Gtk::TreeModel::iterator> selected = selected_files();
+        if (!window || selected.empty()) return;
+
+        Gtk::FileChooserDialog dialog(*window, "Download To", Gtk::FILE_CHOOSER_ACTION_SELECT_FOLDER);
+        dialog.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+        dialog.add_button("_Download", Gtk::RESPONSE_OK);
+        if (!download_directory.empty()) {
+            dialog.set_current_folder(download_directory);
+        }
+        if (dialog.run() != Gtk::RESPONSE_OK) return;
+        download_directory = dialog.get_filename();
+
+        int skipped = 0;
+        for (const auto& iter : selected) {
+            if ((*iter)[file_columns.is_dir]) {
+                skipped++;
+                continue;
+            }
+            std::string name = static_cast<Glib::ustring>((*iter)[file_columns.name]).raw();
+            auto transfer = std::make_shared<Transfer>();
+            transfer->local_path = download_directory + "/" + name;
+            transfer->remote_path = join_path(current_directory, name);
+            transfer->size = (*iter)[file_columns.size];
+            queue(transfer);
+        }
+        if (skipped > 0) {
+            set_status(std::to_string(skipped) + " folders skipped, only files are downloaded");
+        }
+    }
+
+    void on_mkdir() {
+        Gtk::Window* window = get_window();
+        if (!window || !client.is_ready()) return;
+        Gtk::Dialog dialog("New Folder", *window, true);
+        dialog.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+        dialog.add_button("_Create", Gtk::RESPONSE_OK);
+        dialog.set_default_response(Gtk::RESPONSE_OK);
+        Gtk::Entry name_entry;
+        name_entry.set_activates_default(true);
+        name_entry.set_margin_start(10);
+        name_entry.set_margin_end(10);
+        name_entry.set_margin_top(10);
+        name_entry.set_margin_bottom(10);
+        dialog.get_content_area()->pack_start(name_entry, Gtk::PACK_SHRINK);
+        dialog.show_all();
+        if (dialog.run() != Gtk::RESPONSE_OK || name_entry.get_text().empty()) return;
+
+        std::string path = join_path(current_directory, name_entry.get_text().raw());
+        client.mkdir(path, [this, path](const Reply& reply) {
+            if (reply.failed()) {
+                set_status("Cannot create " + path + ": " + reply.message);
+            } else {
+                load(current_directory);
+            }
+        });
+    }
+
+    void on_delete() {
+        Gtk::Window* window = get_window();
+        std::vector<Gtk::TreeModel::iterator> selected = selected_files();
+        if (!window || selected.empty() || !client.is_ready()) return;
+
+        Gtk::MessageDialog confirm(*window, "Delete " + std::to_string(selected.size()) + " item(s)?", false,
+                                   Gtk::MESSAGE_QUESTION, Gtk::BUTTONS_OK_CANCEL, true);
+        confirm.set_secondary_text("Files are deleted on the server. Folders must be empty.");
+        if (confirm.run() != Gtk::RESPONSE_OK) return;
+
+        auto remaining = std::make_shared<size_t>(selected.size());
+        for (const auto& iter : selected) {
+            std::string path = join_path(current_directory, static_cast<Glib::ustring>((*iter)[file_columns.name]).raw());
+            auto done = [this, path, remaining](const Reply& reply) {
+                if (reply.failed()) {
+                    set_status("Cannot delete " + path + ": " + reply.message);
+                }
+                if (--*remaining == 0) load(current_directory);
+            };
+            if ((*iter)[file_columns.is_dir]) {
+                client.rmdir(path, done);
+            } else {
+                client.remove(path, done);
+            }
+        }
+    }
+
+    // ---- Transfers ----
+
+    void queue(const std::shared_ptr<Transfer>& transfer) {
+        transfers.push_back(transfer);
+        Gtk::TreeModel::Row row = *transfers_store->append();
+        row[transfer_columns.index] = transfers.size() - 1;
+        row[transfer_columns.name] = base_name(transfer->remote_path);
+        row[transfer_columns.direction] = transfer->upload ? "Upload" : "Download";
+        pump();
+        update_transfers();
+    }
+
+    // Start queued transfers while fewer than MAX_ACTIVE_FILES run
+    void pump() {
+        if (!client.is_ready()) return;
+        int running = 0;
+        for (const auto& transfer : transfers) {
+            if (transfer->state == Transfer::State::Running) running++;
+        }
+        for (auto& transfer : transfers) {
+            if (running >= MAX_ACTIVE_FILES) break;
+            if (transfer->state != Transfer::State::Queued) continue;
+            running++;
+            begin(transfer);
+        }
+    }
+
+    void begin(const std::shared_ptr<Transfer>& transfer) {
+        transfer->state = Transfer::State::Running;
+        transfer->rate_time = g_get_monotonic_time();
+        if (transfer->upload) {
+            transfer->fd = ::open(transfer->local_path.c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat info;
+            if (transfer->fd < 0 || fstat(transfer->fd, &info) != 0) {
+                fail(transfer, strerror(errno));
+                return;
+            }
+            transfer->size = info.st_size;
+        } else {
+            transfer->fd = ::open(transfer->local_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (transfer->fd < 0) {
+                fail(transfer, strerror(errno));
+                return;
+            }
+        }
+
+        uint32_t flags = transfer->upload ? (FXF_WRITE | FXF_CREAT | FXF_TRUNC) : FXF_READ;
+        client.open(transfer->remote_path, flags, [this, transfer](const Reply& reply) {
+            if (transfer->state != Transfer::State::Running) {
+                if (!reply.handle.empty()) client.close_handle(reply.handle);
+                return;
+            }
+            if (reply.handle.empty()) {
+                fail(transfer, reply.message.empty() ? "Cannot open the remote file" : reply.message);
+                return;
+            }
+            transfer->handle = reply.handle;
+            fill(transfer);
+        });
+    }
+
+    // Keep up to MAX_REQUESTS_PER_FILE reads or writes outstanding
+    void fill(const std::shared_ptr<Transfer>& transfer) {
+        while (transfer->state == Transfer::State::Running && transfer->in_flight < MAX_REQUESTS_PER_FILE) {
+            if (transfer->upload) {
+                if (transfer->next_offset >= transfer->size) break;
+                std::string chunk(std::min<guint64>(CHUNK_SIZE, transfer->size - transfer->next_offset), '\0');
+                ssize_t length = pread(transfer->fd, &chunk[0], chunk.size(), transfer->next_offset);
+                if (length < 0) {
+                    fail(transfer, strerror(errno));
+                    return;
+                }
+                if (length == 0) {
+                    transfer->size = transfer->next_offset; // The file shrank
+                    break;
+                }
+                chunk.resize(length);
+                send_chunk(transfer, transfer->next_offset, chunk);
+                transfer->next_offset += length;
+            } else {
+                if (transfer->next_offset >= transfer->end_offset) break;
+                request_chunk(transfer, transfer->next_offset, CHUNK_SIZE);
+                transfer->next_offset += CHUNK_SIZE;
+            }
+        }
+
+        bool complete = transfer->upload ? transfer->next_offset >= transfer->size
+                                         : transfer->next_offset >= transfer->end_offset;
+        if (transfer->state == Transfer::State::Running && complete && transfer->in_flight == 0) {
+            finish(transfer);
+        }
+    }
+
+    void send_chunk(const std::shared_ptr<Transfer>& transfer, guint64 offset, const std::string& chunk) {
+        transfer->in_flight++;
+        guint64 length = chunk.size();
+        client.write(transfer->handle, offset, chunk, [this, transfer, length](const Reply& reply) {
+            transfer->in_flight--;
+            if (transfer->state != Transfer::State::Running) return;
+            if (reply.failed()) {
+                fail(transfer, reply.message);
+                return;
+            }
+            transfer->done += length;
+            fill(transfer);
+        });
+    }
+
+    void request_chunk(const std::shared_ptr<Transfer>& transfer, guint64 offset, uint32_t length) {
+        transfer->in_flight++;
+        client.read(transfer->handle, offset, length, [this, transfer, offset, length](const Reply& reply) {
+            transfer->in_flight--;
+            if (transfer->state != Transfer::State::Running) return;
+            if (reply.type == FXP_DATA) {
+                // Replies can arrive out of order, so each chunk is written at its offset
+                if (pwrite(transfer->fd, reply.data.data(), reply.data.size(), offset) != ssize_t(reply.data.size())) {
+                    fail(transfer, strerror(errno));
+                    return;
+                }
+                transfer->done += reply.data.size();
+                if (!reply.data.empty() && reply.data.size() < length) {
+                    // A short read; ask for the rest of the chunk
+                    request_chunk(transfer, offset + reply.data.size(), length - reply.data.size());
+                }
+            } else if (reply.type == FXP_STATUS && reply.status == FX_EOF) {
+                transfer->end_offset = std::min(transfer->end_offset, offset);
+            } else {
+                fail(transfer, reply.message.empty() ? "Read failed" : reply.message);
+                return;
+            }
+            fill(transfer);
+        });
+    }
+
+    void finish(const std::shared_ptr<Transfer>& transfer) {
+        transfer->state = Transfer::State::Done;
+        if (!transfer->upload) {
+            transfer->size = transfer->done;
+        }
+        ::close(transfer->fd);
+        transfer->fd = -1;
+        bool upload = transfer->upload;
+        client.close_handle(transfer->handle, [this, upload](const Reply& /* reply */) {
+            if (upload) load(current_directory); // Show the new file
+        });
+        transfer->handle.clear();
+        pump();
+        update_transfers();
+    }
+
+    void fail(const std::shared_ptr<Transfer>& transfer, const std::string& error) {
+        bool was_running = transfer->state == Transfer::State::Running;
+        transfer->state = Transfer::State::Failed;
+        transfer->error = error;
+        if (transfer->fd >= 0) {
+            ::close(transfer->fd);
+            transfer->fd = -1;
+            if (!transfer->upload) {
+                unlink(transfer->local_path.c_str()); // Do not leave a partial download behind
+            }
+        }
+        if (!transfer->handle.empty()) {
+            client.close_handle(transfer->handle);
+            transfer->handle.clear();
+        }
+        if (was_running) pump();
+        update_transfers();
+    }
+
+    void on_cancel() {
+        Gtk::TreeModel::iterator iter = transfer_view.get_selection()->get_selected();
+        if (!iter) return;
+        int index = (*iter)[transfer_columns.index];
+        auto& transfer = transfers[index];
+        if (transfer->state == Transfer::State::Queued || transfer->state == Transfer::State::Running) {
+            fail(transfer, "Cancelled");
+        }
+    }
+
+    void on_clear() {
+        std::vector<std::shared_ptr<Transfer>> active;
+        for (auto& transfer : transfers) {
+            if (transfer->state == Transfer::State::Queued || transfer->state == Transfer::State::Running) {
+                active.push_back(transfer);
+            }
+        }
+        transfers.swap(active);
+        transfers_store->clear();
+        for (size_t i = 0; i < transfers.size(); ++i) {
+            Gtk::TreeModel::Row row = *transfers_store->append();
+            row[transfer_columns.index] = i;
+            row[transfer_columns.name] = base_name(transfers[i]->remote_path);
+            row[transfer_columns.direction] = transfers[i]->upload ? "Upload" : "Download";
+        }
+        update_transfers();
+    }
+
+    void update_transfers() {
+        gint64 now = g_get_monotonic_time();
+        double total_rate = 0;
+        int active = 0;
+        for (auto& row : transfers_store->children()) {
+            Transfer& transfer = *transfers[row[transfer_columns.index]];
+            if (transfer.state == Transfer::State::Running && now - transfer.rate_time >= G_USEC_PER_SEC / 2) {
+                double seconds = double(now - transfer.rate_time) / G_USEC_PER_SEC;
+                double current = double(transfer.done - transfer.rate_done) / seconds;
+                transfer.rate = (transfer.rate == 0) ? current : 0.7 * transfer.rate + 0.3 * current;
+                transfer.rate_done = transfer.done;
+                transfer.rate_time = now;
+            }
+
+            int percent = transfer.size > 0 ? int(std::min<guint64>(100, transfer.done * 100 / transfer.size)) : 0;
+            if (transfer.state == Transfer::State::Done) percent = 100;
+            row[transfer_columns.progress] = percent;
+            row[transfer_columns.progress_text] = format_bytes(transfer.done) + " / " + format_bytes(transfer.size);
+            switch (transfer.state) {
+                case Transfer::State::Queued:
+                    row[transfer_columns.state] = "Queued";
+                    row[transfer_columns.rate] = "";
+                    row[transfer_columns.eta] = "";
+                    break;
+                case Transfer::State::Running:
+                    active++;
+                    total_rate += transfer.rate;
+                    row[transfer_columns.state] = "Running";
+                    row[transfer_columns.rate] = format_bytes(transfer.rate) + "/s";
+                    row[transfer_columns.eta] = (transfer.rate > 0 && transfer.size > transfer.done)
+                        ? format_duration((transfer.size - transfer.done) / transfer.rate) : Glib::ustring();
+                    break;
+                case Transfer::State::Done:
+                    row[transfer_columns.state] = "Done";
+                    row[transfer_columns.rate] = "";
+                    row[transfer_columns.eta] = "";
+                    break;
+                case Transfer::State::Failed:
+                    row[transfer_columns.state] = transfer.error;
+                    row[transfer_columns.rate] = "";
+                    row[transfer_columns.eta] = "";
+                    break;
+            }
+        }
+        if (active > 0) {
+            set_status(std::to_string(active) + " transfers running at " + format_bytes(total_rate) + "/s");
+        }
+    }
+
+    Session& session;
+    ConnectionInfo conn;
+    Client client;
+    std::string current_directory;
+    std::string download_directory;
+    unsigned int load_generation = 0;
+    size_t listed = 0;
+    std::vector<std::shared_ptr<Transfer>> transfers;
+
+    Gtk::Box box;
+    Gtk::Box toolbar;
+    Gtk::Paned paned;
+    Gtk::Box transfer_box;
+    Gtk::Box transfer_buttons;
+    Gtk::Button up_button;
+    Gtk::Button refresh_button;
+    Gtk::Entry path_entry;
+    Gtk::Button upload_button;
+    Gtk::Button download_button;
+    Gtk::Button mkdir_button;
+    Gtk::Button delete_button;
+    Gtk::Button close_button;
+    Gtk::ScrolledWindow file_scrolled;
+    Gtk::TreeView file_view;
+    BrowserColumns file_columns;
+    Glib::RefPtr<Gtk::ListStore> files;
+    Gtk::ScrolledWindow transfer_scrolled;
+    Gtk::TreeView transfer_view;
+    TransferColumns transfer_columns;
+    Glib::RefPtr<Gtk::ListStore> transfers_store;
+    Gtk::Button cancel_button;
+    Gtk::Button clear_button;
+    Gtk::Label status_label;
+    sigc::connection refresh_timer;
+};
+
+std::unordered_map<GtkWidget*, std::unique_ptr<Browser>> browsers_by_page;
+
+} // namespace
+
+void track(Gtk::Notebook& notebook) {
+    notebook.signal_page_removed().connect([](Gtk::Widget* page, guint) {
+        if (page) {
+            browsers_by_page.erase(GTK_WIDGET(page->gobj()));
+        }
+    });
+}
+
+bool open(const ConnectionInfo& conn, std::string& error) {
+    if (conn.connection_type != "SSH") {
+        error = "SFTP is only available for SSH connections.";
+        return false;
+    }
+
+    // Not tied to the connection ID, so restore and reconnect leave the tab alone
+    Session* session = SessionRegistry::create("", "SFTP: " + conn.name, "SFTP");
+    if (!session) {
+        error = "No notebook to open the browser in.";
+        return false;
+    }
+
+    GtkWidget* page = GTK_WIDGET(session->page->gobj());
+    auto browser = std::make_unique<Browser>(*session, conn);
+    browser->connect();
+    browsers_by_page[page] = std::move(browser);
+    SessionRegistry::present(*session);
+    return true;
+}
+
+} // namespace Sftp
@@ -0,0 +1,20 @@
+#ifndef SFTP_H
+#define SFTP_H
+
+#include "Connections.h"
+#include <gtkmm/notebook.h>
+#include <string>
+
+namespace Sftp {
+
+// Release browsers, and their ssh processes, when their tabs close
+void track(Gtk::Notebook& notebook);
+
+// Open an SFTP browser tab for a saved SSH connection. It logs in with the connection's
+// settings through "ssh -s sftp", so any sshd with the sftp subsystem works, including
+// one on localhost. On failure, error describes why.
+bool open(const ConnectionInfo& conn, std::string& error);
+
+} // namespace Sftp
+
+#endif // SFTP_H
@@ -0,0 +1,368 @@
+#include "SftpClient.h"
+#include <glib-unix.h>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+
+namespace Sftp {
+
+namespace {
+
+// Refuse packets larger than this; servers send at most a little more than a chunk
+const uint32_t MAX_PACKET = 256 * 1024;
+
+void put_u32(std::string& out, uint32_t value) {
+    char bytes[4] = {char(value >> 24), char(value >> 16), char(value >> 8), char(value)};
+    out.append(bytes, 4);
+}
+
+void put_u64(std::string& out, guint64 value) {
+    put_u32(out, uint32_t(value >> 32));
+    put_u32(out, uint32_t(value));
+}
+
+void put_string(std::string& out, const std::string& value) {
+    put_u32(out, value.size());
+    out += value;
+}
+
+// Reads fields from a packet; a short packet clears ok instead of reading past the end
+struct Reader {
+    const std::string& data;
+    size_t pos = 0;
+    bool ok = true;
+
+    explicit Reader(const std::string& data) : data(data) {}
+
+    uint8_t u8() {
+        if (pos + 1 > data.size()) { ok = false; return 0; }
+        return static_cast<uint8_t>(data[pos++]);
+    }
+    uint32_t u32() {
+        if (pos + 4 > data.size()) { ok = false; return 0; }
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) value = (value << 8) | static_cast<uint8_t>(data[pos++]);
+        return value;
+    }
+    guint64 u64() {
+        guint64 high = u32();
+        return (high << 32) | u32();
+    }
+    std::string str() {
+        uint32_t length = u32();
+        if (!ok || pos + length > data.size()) { ok = false; return std::string(); }
+        std::string value = data.substr(pos, length);
+        pos += length;
+        return value;
+    }
+    Attributes attrs() {
+        Attributes attrs;
+        attrs.flags = u32();
+        if (attrs.flags & ATTR_SIZE) attrs.size = u64();
+        if (attrs.flags & ATTR_UIDGID) { u32(); u32(); }
+        if (attrs.flags & ATTR_PERMISSIONS) attrs.permissions = u32();
+        if (attrs.flags & ATTR_ACMODTIME) { u32(); attrs.mtime = u32(); }
+        if (attrs.flags & ATTR_EXTENDED) {
+            uint32_t count = u32();
+            for (uint32_t i = 0; i < count && ok; ++i) { str(); str(); }
+        }
+        return attrs;
+    }
+};
+
+} // namespace
+
+bool Client::start(const std::vector<std::string>& args, std::string& error) {
+    std::vector<char*> argv;
+    for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    last_error.clear();
+    GError* spawn_error = nullptr;
+    if (!g_spawn_async_with_pipes(nullptr, argv.data(), nullptr,
+                                  GSpawnFlags(G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD),
+                                  nullptr, nullptr, &pid, &in_fd, &out_fd, &err_fd, &spawn_error)) {
+        error = spawn_error->message;
+        g_error_free(spawn_error);
+        return false;
+    }
+    for (int fd : {in_fd, out_fd, err_fd}) {
+        g_unix_set_fd_nonblocking(fd, TRUE, nullptr);
+    }
+    out_source = g_unix_fd_add(out_fd, GIOCondition(G_IO_IN | G_IO_HUP | G_IO_ERR), on_output, this);
+    err_source = g_unix_fd_add(err_fd, GIOCondition(G_IO_IN | G_IO_HUP | G_IO_ERR), on_error_output, this);
+    child_source = g_child_watch_add(pid, on_child_exit, this);
+
+    std::string payload;
+    put_u32(payload, 3);
+    send_packet(FXP_INIT, payload);
+    return true;
+}
+
+void Client::realpath(const std::string& path, Callback callback) {
+    std::string payload;
+    put_string(payload, path);
+    request(FXP_REALPATH, payload, std::move(callback));
+}
+
+void Client::stat(const std::string& path, Callback callback) {
+    std::string payload;
+    put_string(payload, path);
+    request(FXP_STAT, payload, std::move(callback));
+}
+
+void Client::opendir(const std::string& path, Callback callback) {
+    std::string payload;
+    put_string(payload, path);
+    request(FXP_OPENDIR, payload, std::move(callback));
+}
+
+void Client::readdir(const std::string& handle, Callback callback) {
+    std::string payload;
+    put_string(payload, handle);
+    request(FXP_READDIR, payload, std::move(callback));
+}
+
+void Client::open(const std::string& path, uint32_t flags, Callback callback) {
+    std::string payload;
+    put_string(payload, path);
+    put_u32(payload, flags);
+    put_u32(payload, 0); // No attributes, the server applies its umask
+    request(FXP_OPEN, payload, std::move(callback));
+}
+
+void Client::close_handle(const std::string& handle, Callback callback) {
+    std::string payload;
+    put_string(payload, handle);
+    request(FXP_CLOSE, payload, std::move(callback));
+}
+
+void Client::read(const std::string& handle, guint64 offset, uint32_t length, Callback callback) {
+    std::string payload;
+    put_string(payload, handle);
+    put_u64(payload, offset);
+    put_u32(payload, length);
+    request(FXP_READ, payload, std::move(callback));
+}
+
+void Client::write(const std::string& handle, guint64 offset, const std::string& data, Callback callback) {
+    std::string payload;
+    put_string(payload, handle);
+    put_u64(payload, offset);
+    put_string(payload, data);
+    request(FXP_WRITE, payload, std::move(callback));
+}
+
+void Client::mkdir(const std::string& path, Callback callback) {
+    std::string payload;
+    put_string(payload, path);
+    put_u32(payload, 0);
+    request(FXP_MKDIR, payload, std::move(callback));
+}
+
+void Client::remove(const std::string& path, Callback callback) {
+    std::string payload;
+    put_string(payload, path);
+    request(FXP_REMOVE, payload, std::move(callback));
+}
+
+void Client::rmdir(const std::string& path, Callback callback) {
+    std::string payload;
+    put_string(payload, path);
+    request(FXP_RMDIR, payload, std::move(callback));
+}
+
+void Client::stop() {
+    for (guint* source : {&out_source, &err_source, &write_source, &child_source}) {
+        if (*source) {
+            g_source_remove(*source);
+            *source = 0;
+        }
+    }
+    for (int* fd : {&in_fd, &out_fd, &err_fd}) {
+        if (*fd >= 0) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+    if (pid > 0) {
+        // The child watch is gone, so reap in the background
+        kill(pid, SIGTERM);
+        g_child_watch_add(pid, [](GPid child, gint, gpointer) { g_spawn_close_pid(child); }, nullptr);
+        pid = 0;
+    }
+    ready = false;
+    pending.clear();
+    output.clear();
+    input.clear();
+}
+
+void Client::request(uint8_t type, const std::string& payload, Callback callback) {
+    if (pid <= 0) return; // Disconnected; on_closed already failed the callers
+    uint32_t id = next_id++;
+    std::string packet;
+    put_u32(packet, id);
+    packet += payload;
+    pending[id] = std::move(callback);
+    send_packet(type, packet);
+}
+
+void Client::send_packet(uint8_t type, const std::string& payload) {
+    put_u32(output, payload.size() + 1);
+    output += char(type);
+    output += payload;
+    flush();
+}
+
+void Client::flush() {
+    while (!output.empty()) {
+        ssize_t written = ::write(in_fd, output.data(), output.size());
+        if (written > 0) {
+            output.erase(0, written);
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (written < 0 && errno == EAGAIN && !write_source) {
+                write_source = g_unix_fd_add(in_fd, G_IO_OUT, on_writable, this);
+            }
+            return; // A broken pipe shows up as the child exiting
+        }
+    }
+}
+
+void Client::handle_packet(const std::string& packet) {
+    Reader reader(packet);
+    Reply reply;
+    reply.type = reader.u8();
+    if (reply.type == FXP_VERSION) {
+        ready = true;
+        if (on_ready) on_ready();
+        return;
+    }
+
+    uint32_t id = reader.u32();
+    switch (reply.type) {
+        case FXP_STATUS:
+            reply.status = reader.u32();
+            reply.message = reader.str();
+            if (!reader.ok) reply.message.clear(); // Version 3 servers may omit the message
+            reader.ok = true;
+            break;
+        case FXP_HANDLE:
+            reply.handle = reader.str();
+            break;
+        case FXP_DATA:
+            reply.data = reader.str();
+            break;
+        case FXP_NAME: {
+            uint32_t count = reader.u32();
+            for (uint32_t i = 0; i < count && reader.ok; ++i) {
+                Entry entry;
+                entry.name = reader.str();
+                reader.str(); // ls -l style line
+                entry.attrs = reader.attrs();
+                reply.entries.push_back(std::move(entry));
+            }
+            break;
+        }
+        case FXP_ATTRS:
+            reply.attrs = reader.attrs();
+            break;
+    }
+    if (!reader.ok) {
+        reply.type = FXP_STATUS;
+        reply.status = FX_FAILURE;
+        reply.message = "Malformed reply from the server";
+    }
+
+    auto it = pending.find(id);
+    if (it == pending.end()) return;
+    Callback callback = std::move(it->second);
+    pending.erase(it);
+    if (callback) callback(reply);
+}
+
+void Client::disconnect(const std::string& reason) {
+    // Fail outstanding requests so their owners can clean up
+    std::map<uint32_t, Callback> failed;
+    failed.swap(pending);
+    stop();
+    Reply reply;
+    reply.type = FXP_STATUS;
+    reply.status = FX_FAILURE;
+    reply.message = reason;
+    for (auto& item : failed) {
+        if (item.second) item.second(reply);
+    }
+    if (on_closed) on_closed(reason);
+}
+
+gboolean Client::on_output(gint fd, GIOCondition /* condition */, gpointer user_data) {
+    Client* client = static_cast<Client*>(user_data);
+    char buffer[65536];
+    ssize_t length = ::read(fd, buffer, sizeof(buffer));
+    if (length < 0 && (errno == EAGAIN || errno == EINTR)) return G_SOURCE_CONTINUE;
+    if (length <= 0) {
+        client->out_source = 0;
+        return G_SOURCE_REMOVE; // The child watch reports the disconnect
+    }
+    client->input.append(buffer, length);
+
+    size_t offset = 0;
+    while (client->input.size() - offset >= 4) {
+        Reader header(client->input);
+        header.pos = offset;
+        uint32_t packet_length = header.u32();
+        if (packet_length == 0 || packet_length > MAX_PACKET) {
+            client->out_source = 0;
+            client->disconnect("The server sent an invalid packet");
+            return G_SOURCE_REMOVE;
+        }
+        if (client->input.size() - offset - 4 < packet_length) break;
+        std::string packet = client->input.substr(offset + 4, packet_length);
+        offset += 4 + packet_length;
+        client->handle_packet(packet);
+        if (client->pid <= 0) return G_SOURCE_REMOVE; // A callback stopped the client
+    }
+    client->input.erase(0, offset);
+    return G_SOURCE_CONTINUE;
+}
+
+gboolean Client::on_error_output(gint fd, GIOCondition /* condition */, gpointer user_data) {
+    Client* client = static_cast<Client*>(user_data);
+    char buffer[4096];
+    ssize_t length = ::read(fd, buffer, sizeof(buffer));
+    if (length < 0 && (errno == EAGAIN || errno == EINTR)) return G_SOURCE_CONTINUE;
+    if (length <= 0) {
+        client->err_source = 0;
+        return G_SOURCE_REMOVE;
+    }
+    // Keep the last complaint of ssh as the reason shown on disconnect
+    std::string text(buffer, length);
+    size_t end = text.find_last_not_of("\r\n");
+    if (end != std::string::npos) {
+        size_t start = text.find_last_of("\r\n", end);
+        start = (start == std::string::npos) ? 0 : start + 1;
+        client->last_error = text.substr(start, end - start + 1);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+gboolean Client::on_writable(gint /* fd */, GIOCondition /* condition */, gpointer user_data) {
+    Client* client = static_cast<Client*>(user_data);
+    client->write_source = 0;
+    client->flush();
+    return G_SOURCE_REMOVE;
+}
+
+void Client::on_child_exit(GPid child, gint /* status */, gpointer user_data) {
+    Client* client = static_cast<Client*>(user_data);
+    g_spawn_close_pid(child);
+    client->child_source = 0;
+    client->pid = 0;
+    client->disconnect(client->last_error.empty() ? "The connection closed" : client->last_error);
+}
+
+} // namespace Sftp
@@ -0,0 +1,118 @@
+#ifndef SFTPCLIENT_H
+#define SFTPCLIENT_H
+
+#include <glib.h>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Sftp {
+
+// Packet types and constants of SFTP version 3 (draft-ietf-secsh-filexfer-02), the
+// version OpenSSH speaks
+enum PacketType : uint8_t {
+    FXP_INIT = 1, FXP_VERSION = 2, FXP_OPEN = 3, FXP_CLOSE = 4, FXP_READ = 5, FXP_WRITE = 6,
+    FXP_OPENDIR = 11, FXP_READDIR = 12, FXP_REMOVE = 13, FXP_MKDIR = 14, FXP_RMDIR = 15,
+    FXP_REALPATH = 16, FXP_STAT = 17,
+    FXP_STATUS = 101, FXP_HANDLE = 102, FXP_DATA = 103, FXP_NAME = 104, FXP_ATTRS = 105
+};
+
+enum StatusCode : uint32_t { FX_OK = 0, FX_EOF = 1, FX_NO_SUCH_FILE = 2, FX_FAILURE = 4 };
+
+enum OpenFlags : uint32_t { FXF_READ = 0x01, FXF_WRITE = 0x02, FXF_CREAT = 0x08, FXF_TRUNC = 0x10 };
+
+enum AttrFlags : uint32_t {
+    ATTR_SIZE = 0x01, ATTR_UIDGID = 0x02, ATTR_PERMISSIONS = 0x04, ATTR_ACMODTIME = 0x08, ATTR_EXTENDED = 0x80000000
+};
+
+struct Attributes {
+    uint32_t flags = 0;
+    guint64 size = 0;
+    uint32_t permissions = 0;
+    uint32_t mtime = 0;
+};
+
+struct Entry {
+    std::string name;
+    Attributes attrs;
+};
+
+struct Reply {
+    uint8_t type = 0;
+    uint32_t status = FX_OK;
+    std::string message;  // Status message
+    std::string handle;
+    std::string data;
+    std::vector<Entry> entries;
+    Attributes attrs;
+
+    bool failed() const { return type == FXP_STATUS && status != FX_OK; }
+};
+
+// SFTP client on the stdin/stdout of "ssh -s sftp", driven by the GLib main loop. Requests
+// are answered asynchronously and matched by ID, so any number can be outstanding on the
+// one channel.
+class Client {
+public:
+    using Callback = std::function<void(const Reply&)>;
+
+    std::function<void()> on_ready;
+    std::function<void(const std::string&)> on_closed;
+
+    ~Client() { stop(); }
+
+    // Run the command that carries the SFTP channel and send INIT; on_ready follows the
+    // server's VERSION. On failure, error describes why.
+    bool start(const std::vector<std::string>& args, std::string& error);
+
+    bool is_ready() const { return ready; }
+    bool is_running() const { return pid > 0; }
+
+    void realpath(const std::string& path, Callback callback);
+    void stat(const std::string& path, Callback callback);
+    void opendir(const std::string& path, Callback callback);
+    void readdir(const std::string& handle, Callback callback);
+    void open(const std::string& path, uint32_t flags, Callback callback);
+    void close_handle(const std::string& handle, Callback callback = nullptr);
+    void read(const std::string& handle, guint64 offset, uint32_t length, Callback callback);
+    void write(const std::string& handle, guint64 offset, const std::string& data, Callback callback);
+    void mkdir(const std::string& path, Callback callback);
+    void remove(const std::string& path, Callback callback);
+    void rmdir(const std::string& path, Callback callback);
+
+    // Stop the child without calling on_closed; outstanding callbacks are dropped
+    void stop();
+
+private:
+    void request(uint8_t type, const std::string& payload, Callback callback);
+    void send_packet(uint8_t type, const std::string& payload);
+    void flush();
+    void handle_packet(const std::string& packet);
+    void disconnect(const std::string& reason);
+
+    static gboolean on_output(gint fd, GIOCondition condition, gpointer user_data);
+    static gboolean on_error_output(gint fd, GIOCondition condition, gpointer user_data);
+    static gboolean on_writable(gint fd, GIOCondition condition, gpointer user_data);
+    static void on_child_exit(GPid child, gint status, gpointer user_data);
+
+    GPid pid = 0;
+    int in_fd = -1;
+    int out_fd = -1;
+    int err_fd = -1;
+    guint out_source = 0;
+    guint err_source = 0;
+    guint write_source = 0;
+    guint child_source = 0;
+    bool ready = false;
+    uint32_t next_id = 1;
+    std::map<uint32_t, Callback> pending;
+    std::string output;
+    std::string input;
+    std::string last_error;
+};
+
+} // namespace Sftp
+
+#endif // SFTPCLIENT_H
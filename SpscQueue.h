@@ -0,0 +1,53 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// The capacity is rounded up to a power of two.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t min_capacity) {
+        size_t capacity = 1;
+        while (capacity < min_capacity) capacity <<= 1;
+        slots.resize(capacity);
+        mask = capacity - 1;
+    }
+
+    // Producer side. Fails without touching item when fewer than reserve + 1 slots are
+    // free, so callers can keep room for items that must not be dropped.
+    bool try_push(T&& item, size_t reserve = 0) {
+        size_t tail_index = tail.load(std::memory_order_relaxed);
+        size_t used = tail_index - head.load(std::memory_order_acquire);
+        if (used + reserve >= slots.size()) return false;
+        slots[tail_index & mask] = std::move(item);
+        tail.store(tail_index + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool try_pop(T& item) {
+        size_t head_index = head.load(std::memory_order_relaxed);
+        if (head_index == tail.load(std::memory_order_acquire)) return false;
+        item = std::move(slots[head_index & mask]);
+        head.store(head_index + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Number of queued items; exact only on the producer or consumer thread
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> slots;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{0}; // Next slot to pop, written by the consumer
+    alignas(64) std::atomic<size_t> tail{0}; // Next slot to fill, written by the producer
+};
+
+#endif // SPSCQUEUE_H
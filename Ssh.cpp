@@ -1,46 +1,243 @@
 #include "Ssh.h"
+#include "Agent.h"
+#include "NetworkProfiles.h"
+#include "PtyHelperProtocol.h"
+#include "Tools.h"
+#include <glib.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
 #include <iostream>
+#include <map>
+#include <set>
 #include <sstream>
 #include <iterator>
 #include <vector>
 #include <string>
-#include <cstdlib>
+#include <unistd.h>
 
 namespace Ssh {
 
     bool is_sshpass_available() {
-        return system("which sshpass > /dev/null 2>&1") == 0;
+        return Tools::is_available("sshpass");
     }
 
-    std::vector<std::string> generate_ssh_command_args(const ConnectionInfo& conn_info) {
+    std::string shell_quote(const std::string& word) {
+        if (!word.empty() && word.find_first_of(" \t\n'\"\\$`;&|<>()*?[]#~") == std::string::npos) {
+            return word;
+        }
+        std::string quoted = "'";
+        for (char c : word) {
+            if (c == '\'') {
+                quoted += "'\\''";
+            } else {
+                quoted += c;
+            }
+        }
+        return quoted + "'";
+    }
 
-        std::vector<std::string> args;
-        static bool sshpass_checked = false;
-        static bool sshpass_available = false;
+    // Bastions used through a shared master in this run, by the arguments that address them
+    static std::map<std::string, std::vector<std::string>> bastion_masters;
+
+    // ssh expands % tokens in a ProxyCommand once, so a nested one needs them doubled
+    static std::string escape_percent(const std::string& command) {
+        std::string escaped;
+        for (char c : command) {
+            if (c == '%') escaped += '%';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    // Agent::get_wait_prefix() as the start of a command line, empty or ending in a space
+    static std::string quote_wait_prefix(const ConnectionInfo& conn_info, bool escape_tokens) {
+        std::string prefix;
+        for (const auto& word : Agent::get_wait_prefix(conn_info)) {
+            prefix += shell_quote(escape_tokens ? escape_percent(word) : word) + " ";
+        }
+        return prefix;
+    }
+
+    // Without a directory only this user can reach, sessions are not multiplexed
+    static std::string get_control_path() {
+        std::string error;
+        std::string dir = PtyHelperProtocol::prepare_socket_dir(error);
+        if (dir.empty()) {
+            std::cerr << "Warning: " << error << std::endl;
+            return "none";
+        }
+        return dir + "/ssh-%C"; // Hash of local host, remote host, port and user; short enough for a socket path
+    }
+
+    // Files sshpass -f reads the passwords from, written in this run
+    static std::set<std::string> password_files;
+
+    // sshpass words that answer the password prompt of a connection, empty if there is no
+    // saved password. The password goes through a file in the private socket directory, so it
+    // never shows up in a command line other users can read in /proc.
+    static std::vector<std::string> get_sshpass_words(const ConnectionInfo& conn_info) {
+        if (conn_info.auth_method != "Password" || conn_info.password.empty() || !is_sshpass_available()) {
+            return {};
+        }
+        std::string error;
+        std::string dir = PtyHelperProtocol::prepare_socket_dir(error);
+        if (dir.empty()) {
+            std::cerr << "Warning: " << error << "; the password will be asked for" << std::endl;
+            return {};
+        }
+        std::string key = conn_info.id.raw() + "\n" + conn_info.username.raw() + "@" + conn_info.host.raw();
+        std::string path = dir + "/sshpass-" + std::to_string(std::hash<std::string>()(key));
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            std::cerr << "Warning: cannot write " << path << ": " << strerror(errno) << std::endl;
+            return {};
+        }
+        const std::string& password = conn_info.password.raw();
+        bool written = ::fchmod(fd, 0600) == 0 &&
+                       ::write(fd, password.data(), password.size()) == static_cast<ssize_t>(password.size());
+        ::close(fd);
+        if (!written) {
+            ::unlink(path.c_str());
+            return {};
+        }
+        password_files.insert(path);
+        return {"sshpass", "-f", path};
+    }
 
-        if (!sshpass_checked) {
-            sshpass_available = is_sshpass_available();
-            sshpass_checked = true;
+    // Arguments that reach the master of a jump host through its control socket
+    static std::vector<std::string> get_master_address(const ConnectionInfo& hop) {
+        std::vector<std::string> address;
+        if (hop.port > 0 && hop.port != 22) {
+            address.push_back("-p");
+            address.push_back(std::to_string(hop.port));
         }
+        address.push_back("-o");
+        address.push_back("ControlPath=" + get_control_path());
+        address.push_back(hop.username.empty() ? hop.host.raw() : hop.username.raw() + "@" + hop.host.raw());
+        return address;
+    }
+
+    // Command that opens a stdio channel to %h:%p through one jump host. The first session
+    // through a bastion becomes its master; later ones, at any depth of a chain, share it.
+    static std::string jump_command(const ConnectionInfo& hop, const std::string& inner_command) {
+        bastion_masters[hop.id.raw()] = get_master_address(hop);
+
+        std::string command;
+        for (const auto& word : get_sshpass_words(hop)) {
+            command += shell_quote(escape_percent(word)) + " ";
+        }
+        std::string profile = NetworkProfiles::resolve(hop);
+        command += "ssh -o ControlMaster=auto -o ControlPersist=" + NetworkProfiles::get_control_persist(profile, "600");
+        command += " -o " + shell_quote("ControlPath=" + escape_percent(get_control_path()));
+        if (hop.auth_method == "SSHKey" && !hop.ssh_key_path.empty()) {
+            command += " -i " + shell_quote(hop.ssh_key_path);
+            for (const auto& option : Agent::get_ssh_options(hop)) {
+                command += " " + shell_quote(escape_percent(option));
+            }
+        }
+        if (hop.port > 0 && hop.port != 22) {
+            command += " -p " + std::to_string(hop.port);
+        }
+        if (!hop.additional_ssh_options.empty()) {
+            command += " " + hop.additional_ssh_options; // Already written as shell words
+        }
+        for (const auto& option : NetworkProfiles::get_ssh_options(profile)) {
+            command += " " + shell_quote(option);
+        }
+        if (!inner_command.empty()) {
+            command += " -o " + shell_quote("ProxyCommand=" + escape_percent(inner_command));
+        }
+        std::string user_host = hop.username.empty() ? hop.host.raw() : hop.username.raw() + "@" + hop.host.raw();
+        command += " -W %h:%p " + shell_quote(user_host);
+        return quote_wait_prefix(hop, true) + command;
+    }
+
+    std::string generate_jump_proxy_command(const ConnectionInfo& conn_info) {
+        std::string command;
+        for (const auto& hop : ConnectionManager::resolve_jump_chain(conn_info)) {
+            command = jump_command(hop, command);
+        }
+        return command;
+    }
+
+    std::vector<std::string> get_jump_master_args(const ConnectionInfo& conn_info) {
+        std::vector<ConnectionInfo> chain = ConnectionManager::resolve_jump_chain(conn_info);
+        return chain.empty() ? std::vector<std::string>() : get_master_address(chain.front());
+    }
+
+    // ssh config for a session without a network profile: the user's and the system's config,
+    // then keepalives, so a dead link ends the session (and auto-reconnect can step in) and the
+    // link health indicator sees traffic. ssh keeps the first value it reads for an option, so
+    // what the user configured still wins, without running anything at connect time.
+    static const char* KEEPALIVE_CONFIG =
+        "Include ~/.ssh/config\n"
+        "Include /etc/ssh/ssh_config\n"
+        "Host *\n"
+        "    ServerAliveInterval 15\n"
+        "    ServerAliveCountMax 4\n";
+
+    // -F options that read the config above, empty if the user's flags name a config file
+    static std::vector<std::string> get_keepalive_defaults(const std::vector<std::string>& options) {
+        for (const auto& option : options) {
+            if (option.compare(0, 2, "-F") == 0) return {};
+        }
+        static std::string config_path;
+        if (config_path.empty()) {
+            std::string error;
+            std::string dir = PtyHelperProtocol::prepare_socket_dir(error);
+            if (dir.empty()) return {};
+            std::string path = dir + "/ssh_config";
+            if (!g_file_set_contents(path.c_str(), KEEPALIVE_CONFIG, -1, nullptr)) return {};
+            config_path = path;
+        }
+        return {"-F", config_path};
+    }
+
+    void stop_bastion_masters() {
+        for (const auto& item : bastion_masters) {
+            std::vector<std::string> args = {"ssh", "-O", "exit"};
+            args.insert(args.end(), item.second.begin(), item.second.end());
+            std::vector<char*> argv;
+            for (auto& arg : args) {
+                argv.push_back(const_cast<char*>(arg.c_str()));
+            }
+            argv.push_back(nullptr);
+            g_spawn_sync(nullptr, argv.data(), nullptr,
+                         GSpawnFlags(G_SPAWN_SEARCH_PATH | G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL),
+                         nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+        }
+        bastion_masters.clear();
+    }
+
+    void shutdown() {
+        for (const auto& path : password_files) {
+            ::unlink(path.c_str());
+        }
+        password_files.clear();
+    }
+
+    std::vector<std::string> generate_ssh_command_args(const ConnectionInfo& conn_info) {
+
+        std::vector<std::string> args;
+        bool sshpass_available = is_sshpass_available();
 
         if (conn_info.auth_method == "Password") {
             if (sshpass_available) {
-                if (!conn_info.password.empty()) {
-                    args.push_back("sshpass");
-                    args.push_back("-p");
-                    args.push_back(conn_info.password);
-                }
-                args.push_back("ssh");
-                args.push_back("-tt");
+                args = get_sshpass_words(conn_info);
             } else {
                 std::cerr << "Warning: sshpass is not installed. Password authentication will be interactive." << std::endl;
             }
+            args.push_back("ssh");
+            args.push_back("-tt");
         }
         else if (conn_info.auth_method == "SSHKey" && !conn_info.ssh_key_path.empty()) {
             args.push_back("ssh");
             args.push_back("-tt");
             args.push_back("-i");
             args.push_back(conn_info.ssh_key_path);
+            std::vector<std::string> agent_options = Agent::get_ssh_options(conn_info);
+            args.insert(args.end(), agent_options.begin(), agent_options.end());
         }
 
         if (conn_info.port > 0 && conn_info.port != 22) {
@@ -48,6 +245,12 @@ namespace Ssh {
             args.push_back(std::to_string(conn_info.port));
         }
 
+        std::string proxy_command = generate_jump_proxy_command(conn_info);
+        if (!proxy_command.empty()) {
+            args.push_back("-o");
+            args.push_back("ProxyCommand=" + proxy_command);
+        }
+
         std::string user_host_arg;
         if (!conn_info.username.empty()) {
             user_host_arg = conn_info.username + "@" + conn_info.host;
@@ -56,14 +259,120 @@ namespace Ssh {
         }
         args.push_back(user_host_arg);
 
+        std::vector<std::string> options;
         if (!conn_info.additional_ssh_options.empty()) {
             std::istringstream iss(conn_info.additional_ssh_options);
-            std::vector<std::string> options{
-                std::istream_iterator<std::string>(iss),
-                std::istream_iterator<std::string>()};
+            options.assign(std::istream_iterator<std::string>(iss), std::istream_iterator<std::string>());
             args.insert(args.end(), options.begin(), options.end());
         }
 
+        // After the user's own options, so those still win
+        std::vector<std::string> profile_options = NetworkProfiles::get_ssh_options(NetworkProfiles::resolve(conn_info));
+        args.insert(args.end(), profile_options.begin(), profile_options.end());
+
+        if (profile_options.empty()) {
+            std::vector<std::string> keepalive_options = get_keepalive_defaults(options);
+            args.insert(args.end(), keepalive_options.begin(), keepalive_options.end());
+        }
+
+        // Attach tmux in control mode; the Tmux module turns its windows into tabs
+        if (!conn_info.tmux_session.empty()) {
+            args.push_back("tmux -CC new-session -A -s " + shell_quote(conn_info.tmux_session));
+        }
+
+        std::vector<std::string> wait_prefix = Agent::get_wait_prefix(conn_info);
+        args.insert(args.begin(), wait_prefix.begin(), wait_prefix.end());
+        return args;
+    }
+
+    std::vector<std::string> generate_background_command_args(const ConnectionInfo& conn_info,
+                                                              const std::vector<std::string>& extra_args) {
+        std::vector<std::string> args = get_sshpass_words(conn_info);
+        if (!args.empty()) {
+            args.push_back("ssh");
+        } else {
+            // Nobody can answer a prompt, so fail instead of waiting for one
+            args = {"ssh", "-o", "BatchMode=yes"};
+        }
+        if (conn_info.auth_method == "SSHKey" && !conn_info.ssh_key_path.empty()) {
+            args.push_back("-i");
+            args.push_back(conn_info.ssh_key_path);
+            std::vector<std::string> agent_options = Agent::get_ssh_options(conn_info);
+            args.insert(args.end(), agent_options.begin(), agent_options.end());
+        }
+        if (conn_info.port > 0 && conn_info.port != 22) {
+            args.push_back("-p");
+            args.push_back(std::to_string(conn_info.port));
+        }
+        args.push_back("-o");
+        args.push_back("ControlPath=" + get_control_path());
+
+        std::string proxy_command = generate_jump_proxy_command(conn_info);
+        if (!proxy_command.empty()) {
+            args.push_back("-o");
+            args.push_back("ProxyCommand=" + proxy_command);
+        }
+        if (!conn_info.additional_ssh_options.empty()) {
+            std::istringstream iss(conn_info.additional_ssh_options);
+            args.insert(args.end(), std::istream_iterator<std::string>(iss), std::istream_iterator<std::string>());
+        }
+        std::vector<std::string> profile_options = NetworkProfiles::get_ssh_options(NetworkProfiles::resolve(conn_info));
+        args.insert(args.end(), profile_options.begin(), profile_options.end());
+        args.insert(args.end(), extra_args.begin(), extra_args.end());
+        args.push_back(conn_info.username.empty() ? conn_info.host.raw() : conn_info.username.raw() + "@" + conn_info.host.raw());
+
+        std::vector<std::string> wait_prefix = Agent::get_wait_prefix(conn_info);
+        args.insert(args.begin(), wait_prefix.begin(), wait_prefix.end());
+        return args;
+    }
+
+    bool is_mosh_available() {
+        return Tools::is_available("mosh");
+    }
+
+    std::vector<std::string> generate_mosh_command_args(const ConnectionInfo& conn_info) {
+
+        // sshpass answers the password prompt of the ssh that mosh runs for the bootstrap
+        std::vector<std::string> args = get_sshpass_words(conn_info);
+        args.push_back("mosh");
+
+        std::string ssh_command = "ssh";
+        if (conn_info.auth_method == "SSHKey" && !conn_info.ssh_key_path.empty()) {
+            ssh_command += " -i " + shell_quote(conn_info.ssh_key_path);
+            for (const auto& option : Agent::get_ssh_options(conn_info)) {
+                ssh_command += " " + shell_quote(option);
+            }
+        }
+        if (conn_info.port > 0 && conn_info.port != 22) {
+            ssh_command += " -p " + std::to_string(conn_info.port);
+        }
+        if (!conn_info.additional_ssh_options.empty()) {
+            ssh_command += " " + conn_info.additional_ssh_options; // Already written as shell words
+        }
+        for (const auto& option : NetworkProfiles::get_ssh_options(NetworkProfiles::resolve(conn_info))) {
+            ssh_command += " " + shell_quote(option);
+        }
+        std::string proxy_command = generate_jump_proxy_command(conn_info);
+        if (!proxy_command.empty()) {
+            ssh_command += " -o " + shell_quote("ProxyCommand=" + proxy_command);
+        }
+        args.push_back("--ssh=" + quote_wait_prefix(conn_info, false) + ssh_command);
+
+        if (!conn_info.mosh_port.empty()) {
+            args.push_back("--port=" + conn_info.mosh_port);
+        }
+        if (!conn_info.mosh_server.empty()) {
+            args.push_back("--server=" + conn_info.mosh_server);
+        }
+
+        std::string user_host_arg;
+        if (!conn_info.username.empty()) {
+            user_host_arg = conn_info.username + "@" + conn_info.host;
+        } else {
+            user_host_arg = conn_info.host;
+        }
+        args.push_back(user_host_arg);
+
         return args;
     }
 
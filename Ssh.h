@@ -10,9 +10,38 @@ namespace Ssh {
 // Check if sshpass is available on the system
 bool is_sshpass_available();
 
+// Quote a word for command lines that are split with shell rules (remote commands, mosh --ssh)
+std::string shell_quote(const std::string& word);
+
 // Function to generate the SSH command and its arguments
 std::vector<std::string> generate_ssh_command_args(const ConnectionInfo& conn_info);
 
+// ProxyCommand that reaches the connection through its jump host chain, empty for a direct
+// connection. Each jump host is multiplexed, so all sessions behind it share one login.
+std::string generate_jump_proxy_command(const ConnectionInfo& conn_info);
+
+// Address of the shared master of the jump host reached directly, for "ssh -O"; that master
+// holds the TCP connection of every session behind the chain. Empty for a direct connection.
+std::vector<std::string> get_jump_master_args(const ConnectionInfo& conn_info);
+
+// ssh command for a connection without a terminal (tunnels). It shares the control socket
+// of the jump host masters; extra_args go before the destination, e.g. {"-N"}.
+std::vector<std::string> generate_background_command_args(const ConnectionInfo& conn_info,
+                                                          const std::vector<std::string>& extra_args);
+
+// Close the shared jump host connections opened in this run
+void stop_bastion_masters();
+
+// Remove the password files written for sshpass in this run
+void shutdown();
+
+// Check if the mosh client is available on the system
+bool is_mosh_available();
+
+// Generate the mosh command. The SSH settings of the connection (port, key, flags,
+// sshpass) are used for the bootstrap login that starts mosh-server.
+std::vector<std::string> generate_mosh_command_args(const ConnectionInfo& conn_info);
+
 } // namespace Ssh
 
 #endif // SSH_H
\ No newline at end of file
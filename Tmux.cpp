@@ -0,0 +1,475 @@
+#include "Tmux.h"
+#include "PtyRelay.h"
+#include "Broadcast.h"
+#include "Scrollback.h"
+#include "TmuxProtocol.h"
+#include <glibmm/main.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+namespace Tmux {
+
+namespace {
+
+// History copied into a pane's tab when it opens, so its native scrollback is useful
+const int CAPTURE_HISTORY_LINES = 2000;
+
+// Keys per send-keys command, sent as hex so any byte survives the command parser
+const gsize SEND_KEYS_CHUNK = 256;
+
+const char* LIST_PANES_FORMAT = " -F '#{pane_id} #{window_id} #{window_name}'";
+
+using Response = std::function<void(bool ok, const std::vector<std::string>& lines)>;
+
+struct Pane {
+    std::string window_id;
+    GtkWidget* page = nullptr;         // Tab of the pane, nullptr once the user closed it
+    VteTerminal* terminal = nullptr;
+    bool capturing = false;            // Waiting for the initial content, live output is in it
+    std::vector<std::string> capture;  // Initial content until the cursor position arrives
+};
+
+class Client;
+
+// Pane tabs, mapped to their client and tmux pane ID
+std::unordered_map<GtkWidget*, std::pair<Client*, std::string>> panes_by_page;
+
+bool starts_with(const std::string& text, const char* prefix) {
+    return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+// Close tabs outside of the current signal emission; they may be closed already by then
+void close_pages_later(const std::vector<GtkWidget*>& pages) {
+    if (pages.empty()) return;
+    Glib::signal_idle().connect_once([pages]() {
+        for (GtkWidget* page : pages) {
+            if (Session* session = SessionRegistry::find_by_widget(page)) {
+                SessionRegistry::close(*session);
+            }
+        }
+    });
+}
+
+// One tmux control mode connection, running in the terminal of a session
+class Client {
+public:
+    explicit Client(PtyRelay* relay) : relay(relay) {
+        parser.on_plain = [this](const char* data, size_t length) { feed_control(data, length); };
+        parser.on_start = [this]() { begin(); };
+        parser.on_block = [this](bool ok, const std::vector<std::string>& lines) { handle_block(ok, lines); };
+        parser.on_output = [this](const std::string& pane_id, const std::string& data) { handle_output(pane_id, data); };
+        parser.on_notification = [this](const std::string& line) { handle_notification(line); };
+        parser.on_exit = [this](const std::string& reason) { end(reason); };
+    }
+
+    ~Client() {
+        close_all_panes();
+    }
+
+    bool filter(const char* data, gsize length);
+    void reset();
+    void send_keys(const std::string& pane_id, const char* text, gsize size);
+    void update_size(int columns, int rows);
+    void forget_page(GtkWidget* page);
+
+private:
+    void feed_control(const char* data, gsize length);
+    void notice(const std::string& message);
+    void begin();
+    void end(const std::string& reason);
+    void handle_block(bool ok, const std::vector<std::string>& lines);
+    void handle_output(const std::string& pane_id, const std::string& data);
+    void handle_notification(const std::string& line);
+    void send_command(const std::string& command, Response response = nullptr);
+    void refresh_panes(const std::string& window_id);
+    void reconcile(const std::string& window_id, const std::vector<std::string>& lines);
+    void open_pane(const std::string& pane_id, const std::string& window_id);
+    void show_capture(const std::string& pane_id, const std::vector<std::string>& cursor_lines);
+    void close_window(const std::string& window_id);
+    void close_all_panes();
+    Glib::ustring pane_title(const std::string& pane_id, const std::string& window_id);
+    void retitle_window(const std::string& window_id);
+
+    PtyRelay* relay;
+    TmuxProtocol::Parser parser;
+    bool active = false;                // Control mode answered its first command, ours to drive
+    std::deque<Response> responses;     // Callbacks of commands sent, in order
+    std::map<std::string, Pane> panes;  // By pane ID ("%3")
+    std::map<std::string, Glib::ustring> window_names; // By window ID ("@1")
+    int sent_columns = 0;
+    int sent_rows = 0;
+};
+
+std::unordered_map<GtkWidget*, std::unique_ptr<Client>> clients_by_page;
+
+void on_pane_commit(VteTerminal* terminal, gchar* text, guint size, gpointer /* user_data */) {
+    Session* session = SessionRegistry::find_by_terminal(terminal);
+    if (!session) return;
+    auto it = panes_by_page.find(GTK_WIDGET(session->page->gobj()));
+    if (it != panes_by_page.end()) {
+        it->second.first->send_keys(it->second.second, text, size);
+    }
+}
+
+void on_pane_size_allocate(GtkWidget* widget, GdkRectangle* /* allocation */, gpointer /* user_data */) {
+    Session* session = SessionRegistry::find_by_widget(widget);
+    if (!session) return;
+    auto it = panes_by_page.find(GTK_WIDGET(session->page->gobj()));
+    if (it != panes_by_page.end()) {
+        VteTerminal* terminal = VTE_TERMINAL(widget);
+        it->second.first->update_size(vte_terminal_get_column_count(terminal),
+                                      vte_terminal_get_row_count(terminal));
+    }
+}
+
+bool Client::filter(const char* data, gsize length) {
+    return parser.feed(data, length);
+}
+
+void Client::reset() {
+    // The child is gone, and with it the tmux client
+    if (parser.in_control_mode()) {
+        close_all_panes();
+        vte_terminal_set_input_enabled(relay->get_terminal(), TRUE);
+    }
+    parser.reset();
+    active = false;
+    responses.clear();
+    sent_columns = 0;
+    sent_rows = 0;
+}
+
+void Client::feed_control(const char* data, gsize length) {
+    if (length > 0) {
+        vte_terminal_feed(relay->get_terminal(), data, length);
+    }
+}
+
+void Client::notice(const std::string& message) {
+    std::string text = "\r\n\033[1;33m[ngTerm]\033[0m " + message + "\r\n";
+    feed_control(text.data(), text.size());
+}
+
+void Client::begin() {
+    active = false;
+    // Keystrokes in this tab would reach tmux as commands
+    vte_terminal_set_input_enabled(relay->get_terminal(), FALSE);
+    notice("tmux control mode: the windows of this session open in their own tabs. Close this tab to detach.");
+}
+
+void Client::end(const std::string& reason) {
+    close_all_panes();
+    responses.clear();
+    window_names.clear();
+    active = false;
+    vte_terminal_set_input_enabled(relay->get_terminal(), TRUE);
+    notice("tmux control mode ended" + (reason.empty() ? std::string(".") : ": " + reason));
+}
+
+void Client::handle_block(bool ok, const std::vector<std::string>& lines) {
+    if (!active) {
+        // Response to the command tmux was started with; now it is ours to drive
+        active = true;
+        update_size(relay->get_columns(), relay->get_rows());
+        refresh_panes("");
+    } else if (!responses.empty()) {
+        Response response = std::move(responses.front());
+        responses.pop_front();
+        if (response) {
+            response(ok, lines);
+        }
+    }
+}
+
+void Client::handle_output(const std::string& pane_id, const std::string& data) {
+    auto it = panes.find(pane_id);
+    if (it == panes.end() || !it->second.terminal || it->second.capturing) return;
+    vte_terminal_feed(it->second.terminal, data.data(), data.size());
+}
+
+void Client::handle_notification(const std::string& line) {
+    if (starts_with(line, "%window-add ") || starts_with(line, "%layout-change ")) {
+        std::istringstream fields(line);
+        std::string name, window_id;
+        fields >> name >> window_id;
+        if (active) {
+            refresh_panes(window_id);
+        }
+    } else if (starts_with(line, "%window-close ") || starts_with(line, "%unlinked-window-close ")) {
+        close_window(line.substr(line.find(' ') + 1));
+    } else if (starts_with(line, "%window-renamed ")) {
+        size_t id_start = line.find(' ') + 1;
+        size_t id_end = line.find(' ', id_start);
+        if (id_end == std::string::npos) return;
+        std::string window_id = line.substr(id_start, id_end - id_start);
+        window_names[window_id] = line.substr(id_end + 1);
+        retitle_window(window_id);
+    } else if (starts_with(line, "%session-changed ")) {
+        if (active) {
+            refresh_panes("");
+        }
+    }
+}
+
+void Client::send_command(const std::string& command, Response response) {
+    std::string text = command + "\n";
+    responses.push_back(std::move(response));
+    relay->write_input(text.data(), text.size());
+}
+
+// List the panes of one window, or of the whole session for an empty window_id
+void Client::refresh_panes(const std::string& window_id) {
+    std::string target = window_id.empty() ? " -s" : " -t " + window_id;
+    send_command("list-panes" + target + LIST_PANES_FORMAT,
+                 [this, window_id](bool ok, const std::vector<std::string>& lines) {
+        if (ok) {
+            reconcile(window_id, lines);
+        }
+    });
+}
+
+void Client::reconcile(const std::string& window_id, const std::vector<std::string>& lines) {
+    std::set<std::string> listed;
+    std::set<std::string> changed_windows;
+    for (const std::string& entry : lines) {
+        size_t first = entry.find(' ');
+        size_t second = (first == std::string::npos) ? std::string::npos : entry.find(' ', first + 1);
+        if (second == std::string::npos) continue;
+        std::string pane_id = entry.substr(0, first);
+        std::string pane_window = entry.substr(first + 1, second - first - 1);
+        window_names[pane_window] = entry.substr(second + 1);
+        listed.insert(pane_id);
+        changed_windows.insert(pane_window);
+
+        auto it = panes.find(pane_id);
+        if (it == panes.end()) {
+            open_pane(pane_id, pane_window);
+        } else {
+            changed_windows.insert(it->second.window_id); // Panes can move between windows
+            it->second.window_id = pane_window;
+        }
+    }
+
+    // Panes that are gone: exited, or moved out of the listed window
+    std::vector<GtkWidget*> closing;
+    for (auto it = panes.begin(); it != panes.end();) {
+        bool in_scope = window_id.empty() || it->second.window_id == window_id;
+        if (in_scope && !listed.count(it->first)) {
+            if (it->second.page) {
+                panes_by_page.erase(it->second.page);
+                closing.push_back(it->second.page);
+            }
+            changed_windows.insert(it->second.window_id);
+            it = panes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    close_pages_later(closing);
+
+    for (const std::string& changed : changed_windows) {
+        retitle_window(changed);
+    }
+}
+
+void Client::open_pane(const std::string& pane_id, const std::string& window_id) {
+    Pane& pane = panes[pane_id];
+    pane.window_id = window_id;
+
+    Session* session = SessionRegistry::create("", pane_title(pane_id, window_id), "tmux");
+    if (!session) return;
+
+    GtkWidget* terminal = vte_terminal_new();
+    session->page->pack_start(*Gtk::manage(Glib::wrap(terminal)), Gtk::PACK_EXPAND_WIDGET);
+    SessionRegistry::set_terminal(*session, VTE_TERMINAL(terminal));
+    gtk_widget_show(terminal);
+    Scrollback::attach(*session, 0, false);
+    Broadcast::attach_terminal(VTE_TERMINAL(terminal));
+
+    // No PTY here: typed input becomes send-keys, the grid size becomes the client size
+    g_signal_connect(terminal, "commit", G_CALLBACK(on_pane_commit), nullptr);
+    g_signal_connect(terminal, "size-allocate", G_CALLBACK(on_pane_size_allocate), nullptr);
+
+    pane.page = GTK_WIDGET(session->page->gobj());
+    pane.terminal = VTE_TERMINAL(terminal);
+    pane.capturing = true;
+    panes_by_page[pane.page] = {this, pane_id};
+
+    // Output notifications queued before the capture runs are part of what it returns
+    send_command("capture-pane -p -e -t " + pane_id + " -S -" + std::to_string(CAPTURE_HISTORY_LINES),
+                 [this, pane_id](bool ok, const std::vector<std::string>& lines) {
+        auto it = panes.find(pane_id);
+        if (it != panes.end() && ok) {
+            it->second.capture = lines;
+        }
+    });
+    send_command("display-message -p -t " + pane_id + " '#{cursor_x} #{cursor_y} #{pane_height}'",
+                 [this, pane_id](bool ok, const std::vector<std::string>& lines) {
+        show_capture(pane_id, ok ? lines : std::vector<std::string>());
+    });
+}
+
+void Client::show_capture(const std::string& pane_id, const std::vector<std::string>& cursor_lines) {
+    auto it = panes.find(pane_id);
+    if (it == panes.end()) return;
+    Pane& pane = it->second;
+    pane.capturing = false;
+    std::vector<std::string> capture;
+    capture.swap(pane.capture);
+    if (!pane.terminal) return;
+
+    std::string text;
+    for (size_t i = 0; i < capture.size(); ++i) {
+        if (i > 0) text += "\r\n";
+        text += capture[i];
+    }
+    text += "\033[0m";
+
+    // Put the cursor where tmux has it; the pane's screen is the bottom of what was fed
+    int cursor_x = 0, cursor_y = 0, pane_height = 0;
+    if (!cursor_lines.empty() &&
+        sscanf(cursor_lines.front().c_str(), "%d %d %d", &cursor_x, &cursor_y, &pane_height) == 3) {
+        long rows = vte_terminal_get_row_count(pane.terminal);
+        long bottom = std::min<long>(static_cast<long>(capture.size()), rows);
+        long top = std::max<long>(0, bottom - pane_height);
+        text += "\033[" + std::to_string(top + cursor_y + 1) + ";" + std::to_string(cursor_x + 1) + "H";
+    }
+    vte_terminal_feed(pane.terminal, text.data(), text.size());
+}
+
+void Client::close_window(const std::string& window_id) {
+    std::vector<GtkWidget*> closing;
+    for (auto it = panes.begin(); it != panes.end();) {
+        if (it->second.window_id == window_id) {
+            if (it->second.page) {
+                panes_by_page.erase(it->second.page);
+                closing.push_back(it->second.page);
+            }
+            it = panes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    window_names.erase(window_id);
+    close_pages_later(closing);
+}
+
+void Client::close_all_panes() {
+    std::vector<GtkWidget*> closing;
+    for (auto& item : panes) {
+        if (item.second.page) {
+            panes_by_page.erase(item.second.page);
+            closing.push_back(item.second.page);
+        }
+    }
+    panes.clear();
+    close_pages_later(closing);
+}
+
+void Client::send_keys(const std::string& pane_id, const char* text, gsize size) {
+    if (!active) return;
+    for (gsize offset = 0; offset < size; offset += SEND_KEYS_CHUNK) {
+        std::string command = "send-keys -t " + pane_id + " -H";
+        gsize end = std::min(size, offset + SEND_KEYS_CHUNK);
+        char hex[4];
+        for (gsize i = offset; i < end; ++i) {
+            g_snprintf(hex, sizeof(hex), " %02x", static_cast<unsigned char>(text[i]));
+            command += hex;
+        }
+        send_command(command);
+    }
+}
+
+void Client::update_size(int columns, int rows) {
+    if (!active || columns <= 0 || rows <= 0) return;
+    if (columns == sent_columns && rows == sent_rows) return;
+    sent_columns = columns;
+    sent_rows = rows;
+    send_command("refresh-client -C " + std::to_string(columns) + "," + std::to_string(rows));
+}
+
+void Client::forget_page(GtkWidget* page) {
+    // The pane keeps running in tmux; its tab comes back on the next attach
+    for (auto& item : panes) {
+        if (item.second.page == page) {
+            item.second.page = nullptr;
+            item.second.terminal = nullptr;
+        }
+    }
+}
+
+// Window name, plus the pane ID when the window is split over several tabs
+Glib::ustring Client::pane_title(const std::string& pane_id, const std::string& window_id) {
+    int count = 0;
+    for (const auto& item : panes) {
+        if (item.second.window_id == window_id) count++;
+    }
+    Glib::ustring title = "tmux: " + window_names[window_id];
+    if (count > 1) {
+        title += " (" + pane_id + ")";
+    }
+    return title;
+}
+
+void Client::retitle_window(const std::string& window_id) {
+    for (const auto& item : panes) {
+        if (item.second.window_id != window_id || !item.second.page) continue;
+        if (Session* session = SessionRegistry::find_by_widget(item.second.page)) {
+            session->title = pane_title(item.first, window_id);
+            SessionRegistry::refresh_tab_label(*session);
+        }
+    }
+}
+
+void on_page_removed(Gtk::Widget* page, guint /* page_num */) {
+    if (!page) return;
+    GtkWidget* page_widget = GTK_WIDGET(page->gobj());
+
+    auto pane = panes_by_page.find(page_widget);
+    if (pane != panes_by_page.end()) {
+        pane->second.first->forget_page(page_widget);
+        panes_by_page.erase(pane);
+    }
+
+    // Closing the control tab hangs up the tmux client, which detaches it
+    clients_by_page.erase(page_widget);
+}
+
+} // namespace
+
+void track(Gtk::Notebook& notebook) {
+    notebook.signal_page_removed().connect(sigc::ptr_fun(&on_page_removed));
+}
+
+std::vector<std::string> local_command_args(const std::string& session_name) {
+    return {"tmux", "-CC", "new-session", "-A", "-s", session_name};
+}
+
+void attach(Session& session) {
+    PtyRelay* relay = PtyRelay::get(session.terminal);
+    if (!relay || !session.page) return;
+
+    GtkWidget* page = GTK_WIDGET(session.page->gobj());
+    Client* client = new Client(relay);
+    clients_by_page[page].reset(client);
+
+    relay->set_output_filter([client](const char* data, gsize length) {
+        return client->filter(data, length);
+    });
+    relay->signal_child_exited().connect([page](int) {
+        auto it = clients_by_page.find(page);
+        if (it != clients_by_page.end()) {
+            it->second->reset();
+        }
+    });
+}
+
+} // namespace Tmux
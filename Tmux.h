@@ -0,0 +1,24 @@
+#ifndef TMUX_H
+#define TMUX_H
+
+#include <gtkmm/notebook.h>
+#include <string>
+#include <vector>
+#include "Sessions.h"
+
+namespace Tmux {
+
+// Detach control sessions whose tab closes and forget pane tabs the user closed
+void track(Gtk::Notebook& notebook);
+
+// Command that attaches (or creates) a local tmux session in control mode
+std::vector<std::string> local_command_args(const std::string& session_name);
+
+// Watch a session's output for tmux control mode (tmux -CC). Once tmux starts it, the
+// protocol is consumed here and every pane of the tmux session gets a tab of its own;
+// until then and after tmux exits, output is shown in the session's terminal as usual.
+void attach(Session& session);
+
+} // namespace Tmux
+
+#endif // TMUX_H
@@ -0,0 +1,143 @@
+#include "TmuxProtocol.h"
+#include <algorithm>
+#include <cstring>
+
+namespace TmuxProtocol {
+
+const std::string CONTROL_START = "\033P1000p";
+const std::string CONTROL_END = "\033\\";
+
+namespace {
+
+bool starts_with(const std::string& text, const char* prefix) {
+    return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+// Length of the longest tail of text that could be the start of CONTROL_START
+size_t partial_start_length(const std::string& text, size_t from) {
+    size_t max = std::min(CONTROL_START.size() - 1, text.size() - from);
+    for (size_t length = max; length > 0; --length) {
+        if (text.compare(text.size() - length, length, CONTROL_START, 0, length) == 0) {
+            return length;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+std::string decode_output(const std::string& escaped) {
+    std::string data;
+    data.reserve(escaped.size());
+    for (size_t i = 0; i < escaped.size(); ++i) {
+        if (escaped[i] == '\\' && i + 3 < escaped.size() &&
+            escaped[i + 1] >= '0' && escaped[i + 1] <= '7' &&
+            escaped[i + 2] >= '0' && escaped[i + 2] <= '7' &&
+            escaped[i + 3] >= '0' && escaped[i + 3] <= '7') {
+            data += static_cast<char>(((escaped[i + 1] - '0') << 6) | ((escaped[i + 2] - '0') << 3) |
+                                      (escaped[i + 3] - '0'));
+            i += 3;
+        } else {
+            data += escaped[i];
+        }
+    }
+    return data;
+}
+
+bool Parser::feed(const char* data, size_t length) {
+    // Outside control mode, plain output keeps its normal path (and its observers)
+    if (state == State::Waiting && held.empty()) {
+        std::string chunk(data, length);
+        if (chunk.find(CONTROL_START) == std::string::npos && partial_start_length(chunk, 0) == 0) {
+            return false;
+        }
+    }
+
+    std::string input = held + std::string(data, length);
+    held.clear();
+    size_t pos = 0;
+    while (pos < input.size()) {
+        if (state == State::Waiting) {
+            size_t start = input.find(CONTROL_START, pos);
+            size_t end = (start == std::string::npos) ? input.size() - partial_start_length(input, pos) : start;
+            if (end > pos && on_plain) {
+                on_plain(input.data() + pos, end - pos);
+            }
+            if (start == std::string::npos) {
+                held = input.substr(end);
+                return true;
+            }
+            pos = start + CONTROL_START.size();
+            state = State::Control;
+            partial_line.clear();
+            in_block = false;
+            block_lines.clear();
+            if (on_start) on_start();
+        } else if (state == State::Ending) {
+            // Skip the ST that closes control mode; what follows is the shell again
+            size_t available = input.size() - pos;
+            if (available < CONTROL_END.size() && CONTROL_END.compare(0, available, input, pos, available) == 0) {
+                held = input.substr(pos);
+                return true;
+            }
+            if (input.compare(pos, CONTROL_END.size(), CONTROL_END) == 0) {
+                pos += CONTROL_END.size();
+            }
+            state = State::Waiting;
+        } else {
+            size_t newline = input.find('\n', pos);
+            if (newline == std::string::npos) {
+                partial_line.append(input, pos, std::string::npos);
+                return true;
+            }
+            partial_line.append(input, pos, newline - pos);
+            pos = newline + 1;
+            if (!partial_line.empty() && partial_line.back() == '\r') {
+                partial_line.pop_back();
+            }
+            std::string complete;
+            complete.swap(partial_line);
+            handle_line(complete);
+        }
+    }
+    return true;
+}
+
+void Parser::reset() {
+    state = State::Waiting;
+    held.clear();
+    partial_line.clear();
+    in_block = false;
+    block_lines.clear();
+}
+
+void Parser::handle_line(const std::string& line) {
+    if (in_block) {
+        bool ok = starts_with(line, "%end ");
+        if (!ok && !starts_with(line, "%error ")) {
+            block_lines.push_back(line);
+            return;
+        }
+        in_block = false;
+        std::vector<std::string> lines;
+        lines.swap(block_lines);
+        if (on_block) on_block(ok, lines);
+        return;
+    }
+
+    if (starts_with(line, "%begin ")) {
+        in_block = true;
+        block_lines.clear();
+    } else if (starts_with(line, "%output ")) {
+        size_t space = line.find(' ', 8);
+        if (space == std::string::npos) return;
+        if (on_output) on_output(line.substr(8, space - 8), decode_output(line.substr(space + 1)));
+    } else if (line == "%exit" || starts_with(line, "%exit ")) {
+        state = State::Ending;
+        if (on_exit) on_exit(line.size() > 6 ? line.substr(6) : "");
+    } else if (on_notification) {
+        on_notification(line);
+    }
+}
+
+} // namespace TmuxProtocol
@@ -0,0 +1,60 @@
+#ifndef TMUXPROTOCOL_H
+#define TMUXPROTOCOL_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// The tmux control mode wire format (tmux -CC), without any UI: splits a terminal's output
+// into plain output and protocol lines, and those into command responses and notifications
+namespace TmuxProtocol {
+
+// tmux wraps control mode in a DCS sequence: this starts it, ST ends it after "%exit"
+extern const std::string CONTROL_START;
+extern const std::string CONTROL_END;
+
+// Undo the octal escaping of %output data (\ooo for control characters and backslash)
+std::string decode_output(const std::string& escaped);
+
+class Parser {
+public:
+    // Output outside control mode, in order, split wherever a possible DCS start is held back
+    std::function<void(const char* data, size_t length)> on_plain;
+    // Control mode started
+    std::function<void()> on_start;
+    // A %begin ... %end (ok) or %begin ... %error block, the first one answering the
+    // command tmux was started with
+    std::function<void(bool ok, const std::vector<std::string>& lines)> on_block;
+    // %output of a pane, decoded
+    std::function<void(const std::string& pane_id, const std::string& data)> on_output;
+    // Any other notification line outside a block ("%window-add @1", ...)
+    std::function<void(const std::string& line)> on_notification;
+    // %exit, with its reason if any; the ST after it is skipped
+    std::function<void(const std::string& reason)> on_exit;
+
+    // Consume a chunk of output. Returns false without consuming it when the chunk is plain
+    // output that cannot start control mode, so callers can keep their normal path for it.
+    bool feed(const char* data, size_t length);
+
+    // Forget partial input and leave control mode, e.g. when the child exited
+    void reset();
+
+    // Between the DCS start and the ST end
+    bool in_control_mode() const { return state != State::Waiting; }
+
+private:
+    enum class State { Waiting, Control, Ending };
+
+    void handle_line(const std::string& line);
+
+    State state = State::Waiting;
+    std::string held;                   // Possible start of CONTROL_START or CONTROL_END
+    std::string partial_line;           // Protocol line read so far
+    bool in_block = false;              // Inside a %begin ... %end command response
+    std::vector<std::string> block_lines;
+};
+
+} // namespace TmuxProtocol
+
+#endif // TMUXPROTOCOL_H
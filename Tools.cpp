@@ -0,0 +1,178 @@
+#include "Tools.h"
+#include <glib.h>
+#include <cctype>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace Tools {
+
+namespace {
+
+struct Probe {
+    const char* name;
+    const char* purpose;
+    const char* version_flag;
+};
+
+const Probe PROBES[] = {
+    {"ssh", "SSH connections, tunnels, SFTP and fleet actions", "-V"},
+    {"sshpass", "Saved passwords for SSH and Mosh", "-V"},
+    {"mosh", "Mosh connections", "--version"},
+    {"tmux", "tmux sessions as tabs", "-V"},
+    {"xfreerdp3", "RDP connections (FreeRDP 3)", "--version"},
+    {"xfreerdp", "RDP connections (FreeRDP 2)", "--version"},
+    {"ssh-agent", "Unlocking connection keys once", nullptr},
+    {"ssh-keyscan", "Fetching host keys", nullptr},
+};
+
+std::vector<ToolInfo> tools;
+std::string search_path; // PATH as seen at start(), so the thread does not read the environment
+std::mutex tools_mutex;
+std::condition_variable scan_cv;  // Signalled when the paths, and then each version, are known
+bool paths_ready = false;
+std::vector<bool> probed;         // Per tool: version probed, or nothing to probe
+bool started = false;
+std::thread scan_thread;
+
+std::string find_on_path(const std::string& name) {
+    std::istringstream dirs(search_path);
+    std::string dir;
+    while (std::getline(dirs, dir, ':')) {
+        if (dir.empty()) dir = ".";
+        std::string candidate = dir + "/" + name;
+        if (g_file_test(candidate.c_str(), G_FILE_TEST_IS_EXECUTABLE) &&
+            !g_file_test(candidate.c_str(), G_FILE_TEST_IS_DIR)) {
+            return candidate;
+        }
+    }
+    return "";
+}
+
+// First line of what the tool prints for its version flag (some print it to stderr)
+std::string read_version(const std::string& path, const char* flag) {
+    gchar* argv[] = {const_cast<gchar*>(path.c_str()), const_cast<gchar*>(flag), nullptr};
+    gchar* out = nullptr;
+    gchar* err = nullptr;
+    if (!g_spawn_sync(nullptr, argv, nullptr, G_SPAWN_DEFAULT, nullptr, nullptr,
+                      &out, &err, nullptr, nullptr)) {
+        return "";
+    }
+    std::string text = out && *out ? out : (err ? err : "");
+    g_free(out);
+    g_free(err);
+    std::string line = text.substr(0, text.find('\n'));
+    return line.size() > 120 ? line.substr(0, 120) : line;
+}
+
+// The first "major.minor" in a version line, e.g. "OpenSSH_9.6p1" or "This is FreeRDP version 3.5.1"
+void parse_version(ToolInfo& tool) {
+    const std::string& text = tool.version;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (isdigit(static_cast<unsigned char>(text[i])) &&
+            (i == 0 || !isalnum(static_cast<unsigned char>(text[i - 1])))) {
+            char* end = nullptr;
+            long major = strtol(text.c_str() + i, &end, 10);
+            if (*end == '.') {
+                tool.major = static_cast<int>(major);
+                tool.minor = static_cast<int>(strtol(end + 1, nullptr, 10));
+                return;
+            }
+        }
+    }
+}
+
+void scan() {
+    std::vector<ToolInfo> found;
+    for (const auto& probe : PROBES) {
+        ToolInfo tool;
+        tool.name = probe.name;
+        tool.purpose = probe.purpose;
+        tool.path = find_on_path(probe.name);
+        found.push_back(tool);
+    }
+    {
+        std::lock_guard<std::mutex> lock(tools_mutex);
+        tools = found;
+        probed.assign(found.size(), false);
+        for (size_t i = 0; i < found.size(); ++i) {
+            probed[i] = found[i].path.empty() || !PROBES[i].version_flag;
+        }
+        paths_ready = true;
+    }
+    scan_cv.notify_all();
+
+    // Versions take a process each, so they are filled in one by one afterwards
+    for (size_t i = 0; i < found.size(); ++i) {
+        if (found[i].path.empty() || !PROBES[i].version_flag) continue;
+        ToolInfo tool = found[i];
+        tool.version = read_version(tool.path, PROBES[i].version_flag);
+        parse_version(tool);
+        {
+            std::lock_guard<std::mutex> lock(tools_mutex);
+            tools[i] = tool;
+            probed[i] = true;
+        }
+        scan_cv.notify_all();
+    }
+}
+
+const ToolInfo* find(const std::string& name) {
+    for (const auto& tool : tools) {
+        if (tool.name == name) return &tool;
+    }
+    return nullptr;
+}
+
+// Blocks until the PATH scan is done; a caller before start() scans synchronously
+std::unique_lock<std::mutex> wait_for_paths() {
+    if (!started) start();
+    std::unique_lock<std::mutex> lock(tools_mutex);
+    scan_cv.wait(lock, []() { return paths_ready; });
+    return lock;
+}
+
+} // namespace
+
+void start() {
+    if (started) return;
+    started = true;
+    const char* path = g_getenv("PATH");
+    search_path = path ? path : "/usr/local/bin:/usr/bin:/bin";
+    scan_thread = std::thread(scan);
+}
+
+void shutdown() {
+    if (scan_thread.joinable()) {
+        scan_thread.join();
+    }
+}
+
+std::string get_path(const std::string& name) {
+    auto lock = wait_for_paths();
+    const ToolInfo* tool = find(name);
+    return tool ? tool->path : "";
+}
+
+bool is_available(const std::string& name) {
+    return !get_path(name).empty();
+}
+
+bool is_at_least(const std::string& name, int major, int minor) {
+    auto lock = wait_for_paths();
+    const ToolInfo* tool = find(name);
+    if (!tool || tool->path.empty()) return false;
+    size_t index = tool - tools.data();
+    scan_cv.wait(lock, [index]() { return probed[index]; });
+    if (tool->version.empty()) return false;
+    return tool->major > major || (tool->major == major && tool->minor >= minor);
+}
+
+std::vector<ToolInfo> get_all() {
+    auto lock = wait_for_paths();
+    return tools;
+}
+
+} // namespace Tools
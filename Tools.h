@@ -0,0 +1,41 @@
+#ifndef TOOLS_H
+#define TOOLS_H
+
+#include <string>
+#include <vector>
+
+// External programs ngTerm runs (ssh, sshpass, mosh, tmux, FreeRDP), found once at startup
+namespace Tools {
+
+struct ToolInfo {
+    std::string name;
+    std::string purpose;  // What ngTerm needs it for, shown in Preferences
+    std::string path;     // Absolute path, empty when not installed
+    std::string version;  // As reported by the tool, empty until probed
+    int major = 0;        // Parsed from version
+    int minor = 0;
+};
+
+// Look the tools up on PATH and ask them for their versions in a background thread
+void start();
+
+// Wait for the background thread
+void shutdown();
+
+// Absolute path of a tool, empty when it is not installed. Waits for the PATH scan, which
+// finishes right after start(), but never for the version probes.
+std::string get_path(const std::string& name);
+
+bool is_available(const std::string& name);
+
+// Whether the tool is installed with at least this version. Waits for the tool's version
+// probe, which runs right after the PATH scan (ssh's first), so callers building command
+// lines never see an unprobed tool as too old.
+bool is_at_least(const std::string& name, int major, int minor);
+
+// All tools in a fixed order, with what is known about them so far
+std::vector<ToolInfo> get_all();
+
+} // namespace Tools
+
+#endif // TOOLS_H
@@ -0,0 +1,466 @@
+#include "Triggers.h"
+#include "Config.h"
+#include "PtyRelay.h"
+#include <gio/gio.h>
+#include <gtkmm/button.h>
+#include <gtkmm/cellrenderercombo.h>
+#include <gtkmm/dialog.h>
+#include <gtkmm/liststore.h>
+#include <gtkmm/scrolledwindow.h>
+#include <gtkmm/treeview.h>
+#include <array>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace Triggers {
+
+namespace {
+
+// A trigger fires at most once per tab within this interval, so a flood of matching
+// output (or a send-text response that echoes the pattern) cannot loop
+const gint64 TRIGGER_COOLDOWN_US = 2 * G_USEC_PER_SEC;
+
+struct Trigger {
+    std::string pattern;
+    bool case_sensitive = false;
+    std::string action;  // "highlight", "notify" or "send"
+    std::string text;    // Text sent by "send", with \n, \r, \t and \\ escapes
+};
+
+// Aho-Corasick automaton compiled into a full transition table, so scanning costs one
+// table lookup per byte no matter how many patterns are configured
+class Automaton {
+public:
+    Automaton() {
+        add_node();
+    }
+
+    void add(const std::string& pattern, int id, bool fold_case) {
+        int node = 0;
+        for (unsigned char c : pattern) {
+            if (fold_case) c = g_ascii_tolower(c);
+            int& next = transitions[node * 256 + c];
+            if (next < 0) {
+                int created = add_node(); // May reallocate transitions
+                transitions[node * 256 + c] = created;
+                node = created;
+            } else {
+                node = next;
+            }
+        }
+        outputs[node].push_back(id);
+    }
+
+    // Fill in failure transitions breadth-first
+    void build() {
+        std::vector<int> fail(outputs.size(), 0);
+        std::deque<int> queue;
+        for (int c = 0; c < 256; ++c) {
+            int& next = transitions[c];
+            if (next < 0) {
+                next = 0;
+            } else {
+                queue.push_back(next);
+            }
+        }
+        while (!queue.empty()) {
+            int node = queue.front();
+            queue.pop_front();
+            for (int c = 0; c < 256; ++c) {
+                int& next = transitions[node * 256 + c];
+                int fallback = transitions[fail[node] * 256 + c];
+                if (next < 0) {
+                    next = fallback;
+                } else {
+                    fail[next] = fallback;
+                    const auto& inherited = outputs[fallback];
+                    outputs[next].insert(outputs[next].end(), inherited.begin(), inherited.end());
+                    queue.push_back(next);
+                }
+            }
+        }
+    }
+
+    int step(int state, unsigned char c) const {
+        return transitions[state * 256 + c];
+    }
+
+    const std::vector<int>& matches(int state) const {
+        return outputs[state];
+    }
+
+    bool empty() const {
+        return outputs.size() == 1;
+    }
+
+private:
+    int add_node() {
+        transitions.insert(transitions.end(), 256, -1);
+        outputs.emplace_back();
+        return static_cast<int>(outputs.size()) - 1;
+    }
+
+    std::vector<int> transitions;
+    std::vector<std::vector<int>> outputs;
+};
+
+// All enabled triggers. Case-sensitive and case-insensitive patterns live in separate
+// automata; the second one is fed ASCII-lowercased bytes.
+struct Engine {
+    std::vector<Trigger> triggers;
+    Automaton exact;
+    Automaton folded;
+};
+
+// Escape sequence parser state, so colored or cursor-positioned output still matches
+enum class AnsiState : unsigned char { Ground, Escape, Csi, String, StringEscape };
+
+// Per-tab scan state, carried across output chunks so matches can span reads
+struct Scanner {
+    std::shared_ptr<const Engine> engine;
+    AnsiState ansi = AnsiState::Ground;
+    int exact_state = 0;
+    int folded_state = 0;
+    std::vector<gint64> last_fired;
+    sigc::connection output_connection;
+    Glib::ustring alert;
+};
+
+std::shared_ptr<const Engine> current_engine;
+std::unordered_map<GtkWidget*, Scanner> scanners_by_page;
+
+// Returns true for bytes that are displayed text
+bool strip_ansi(AnsiState& state, unsigned char c) {
+    switch (state) {
+        case AnsiState::Ground:
+            if (c == 0x1b) {
+                state = AnsiState::Escape;
+                return false;
+            }
+            return true;
+        case AnsiState::Escape:
+            if (c == '[') {
+                state = AnsiState::Csi;
+            } else if (c == ']' || c == 'P' || c == 'X' || c == '^' || c == '_') {
+                state = AnsiState::String; // OSC, DCS, SOS, PM, APC
+            } else if (c < 0x20 || c > 0x2f) {
+                state = AnsiState::Ground; // Intermediate bytes keep the sequence going
+            }
+            return false;
+        case AnsiState::Csi:
+            if (c >= 0x40 && c <= 0x7e) {
+                state = AnsiState::Ground;
+            }
+            return false;
+        case AnsiState::String:
+            if (c == 0x07) {
+                state = AnsiState::Ground;
+            } else if (c == 0x1b) {
+                state = AnsiState::StringEscape;
+            }
+            return false;
+        case AnsiState::StringEscape:
+            state = (c == '\\') ? AnsiState::Ground : AnsiState::String;
+            return false;
+    }
+    return true;
+}
+
+std::string unescape(const std::string& text) {
+    std::string result;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\\' && i + 1 < text.size()) {
+            char next = text[++i];
+            switch (next) {
+                case 'n': result += '\n'; break;
+                case 'r': result += '\r'; break;
+                case 't': result += '\t'; break;
+                default: result += next; break;
+            }
+        } else {
+            result += text[i];
+        }
+    }
+    return result;
+}
+
+void send_notification(const Glib::ustring& summary, const Glib::ustring& body) {
+    static GDBusConnection* bus = g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, nullptr);
+    if (!bus) return;
+
+    GVariantBuilder actions;
+    g_variant_builder_init(&actions, G_VARIANT_TYPE("as"));
+    GVariantBuilder hints;
+    g_variant_builder_init(&hints, G_VARIANT_TYPE("a{sv}"));
+    g_dbus_connection_call(bus, "org.freedesktop.Notifications", "/org/freedesktop/Notifications",
+                           "org.freedesktop.Notifications", "Notify",
+                           g_variant_new("(susssasa{sv}i)", "ngTerm", 0u, "utilities-terminal",
+                                         summary.c_str(), body.c_str(), &actions, &hints, -1),
+                           nullptr, G_DBUS_CALL_FLAGS_NONE, -1, nullptr, nullptr, nullptr);
+}
+
+void fire(GtkWidget* page, Scanner& scanner, int id) {
+    gint64 now = g_get_monotonic_time();
+    if (scanner.last_fired[id] && now - scanner.last_fired[id] < TRIGGER_COOLDOWN_US) return;
+    scanner.last_fired[id] = now;
+
+    Session* session = SessionRegistry::find_by_widget(page);
+    if (!session) return;
+    const Trigger& trigger = scanner.engine->triggers[id];
+
+    if (trigger.action == "highlight") {
+        if (SessionRegistry::current() != session) {
+            scanner.alert = "Output matched \"" + trigger.pattern + "\"";
+            SessionRegistry::refresh_tab_label(*session);
+        }
+    } else if (trigger.action == "notify") {
+        send_notification("ngTerm: " + session->title, "Output matched \"" + trigger.pattern + "\"");
+    } else if (trigger.action == "send") {
+        if (PtyRelay* relay = PtyRelay::get(session->terminal)) {
+            std::string text = unescape(trigger.text);
+            relay->write_input(text.data(), text.size());
+        }
+    }
+}
+
+void scan(GtkWidget* page, const char* data, gsize length) {
+    auto it = scanners_by_page.find(page);
+    if (it == scanners_by_page.end() || !current_engine) return;
+    Scanner& scanner = it->second;
+
+    if (scanner.engine != current_engine) {
+        // The trigger list changed; restart matching with the new automata
+        scanner.engine = current_engine;
+        scanner.exact_state = 0;
+        scanner.folded_state = 0;
+        scanner.last_fired.assign(current_engine->triggers.size(), 0);
+    }
+    const Engine& engine = *scanner.engine;
+
+    for (gsize i = 0; i < length; ++i) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (!strip_ansi(scanner.ansi, c)) continue;
+
+        scanner.exact_state = engine.exact.step(scanner.exact_state, c);
+        for (int id : engine.exact.matches(scanner.exact_state)) {
+            fire(page, scanner, id);
+        }
+        scanner.folded_state = engine.folded.step(scanner.folded_state, g_ascii_tolower(c));
+        for (int id : engine.folded.matches(scanner.folded_state)) {
+            fire(page, scanner, id);
+        }
+    }
+}
+
+const char* const ACTION_IDS[] = {"highlight", "notify", "send"};
+const char* const ACTION_NAMES[] = {"Highlight Tab", "Desktop Notification", "Send Text"};
+
+Glib::ustring action_name(const std::string& id) {
+    for (size_t i = 0; i < G_N_ELEMENTS(ACTION_IDS); ++i) {
+        if (id == ACTION_IDS[i]) return ACTION_NAMES[i];
+    }
+    return ACTION_NAMES[0];
+}
+
+std::string action_id(const Glib::ustring& name) {
+    for (size_t i = 0; i < G_N_ELEMENTS(ACTION_NAMES); ++i) {
+        if (name == ACTION_NAMES[i]) return ACTION_IDS[i];
+    }
+    return ACTION_IDS[0];
+}
+
+class TriggerColumns : public Gtk::TreeModel::ColumnRecord {
+public:
+    TriggerColumns() {
+        add(enabled);
+        add(pattern);
+        add(case_sensitive);
+        add(action);
+        add(text);
+    }
+    Gtk::TreeModelColumn<bool> enabled;
+    Gtk::TreeModelColumn<Glib::ustring> pattern;
+    Gtk::TreeModelColumn<bool> case_sensitive;
+    Gtk::TreeModelColumn<Glib::ustring> action;
+    Gtk::TreeModelColumn<Glib::ustring> text;
+};
+
+class ActionColumns : public Gtk::TreeModel::ColumnRecord {
+public:
+    ActionColumns() {
+        add(name);
+    }
+    Gtk::TreeModelColumn<Glib::ustring> name;
+};
+
+} // namespace
+
+void track(Gtk::Notebook& notebook) {
+    notebook.signal_switch_page().connect([](Gtk::Widget* page, guint) {
+        if (!page) return;
+        auto it = scanners_by_page.find(GTK_WIDGET(page->gobj()));
+        if (it == scanners_by_page.end() || it->second.alert.empty()) return;
+        it->second.alert.clear();
+        if (Session* session = SessionRegistry::find_by_widget(GTK_WIDGET(page->gobj()))) {
+            SessionRegistry::refresh_tab_label(*session);
+        }
+    });
+    notebook.signal_page_removed().connect([](Gtk::Widget* page, guint) {
+        if (page) {
+            scanners_by_page.erase(GTK_WIDGET(page->gobj()));
+        }
+    });
+    reload();
+}
+
+void attach(Session& session) {
+    PtyRelay* relay = PtyRelay::get(session.terminal);
+    if (!relay || !session.page) return;
+
+    GtkWidget* page = GTK_WIDGET(session.page->gobj());
+    Scanner& scanner = scanners_by_page[page];
+    scanner.output_connection.disconnect();
+    scanner.output_connection = relay->signal_output().connect([page](const char* data, gsize length) {
+        scan(page, data, length);
+    });
+}
+
+void reload() {
+    auto engine = std::make_shared<Engine>();
+    const json& config = Config::get();
+    if (config.contains("triggers") && config["triggers"].is_array()) {
+        for (const auto& entry : config["triggers"]) {
+            if (!entry.is_object() || !entry.value("enabled", true)) continue;
+            Trigger trigger;
+            trigger.pattern = entry.value("pattern", "");
+            trigger.case_sensitive = entry.value("case_sensitive", false);
+            trigger.action = entry.value("action", "highlight");
+            trigger.text = entry.value("text", "");
+            if (trigger.pattern.empty()) continue;
+
+            int id = static_cast<int>(engine->triggers.size());
+            (trigger.case_sensitive ? engine->exact : engine->folded).add(trigger.pattern, id, !trigger.case_sensitive);
+            engine->triggers.push_back(trigger);
+        }
+    }
+    engine->exact.build();
+    engine->folded.build();
+
+    // Tabs switch to the new engine on their next output
+    current_engine = engine->triggers.empty() ? nullptr : engine;
+}
+
+Glib::ustring get_alert(const Session& session) {
+    if (!session.page) return "";
+    auto it = scanners_by_page.find(GTK_WIDGET(session.page->gobj()));
+    return (it != scanners_by_page.end()) ? it->second.alert : "";
+}
+
+void show_dialog(Gtk::Window& parent) {
+    Gtk::Dialog dialog("Output Triggers", parent, true);
+    dialog.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+    dialog.add_button("_Save", Gtk::RESPONSE_OK);
+    dialog.set_default_size(650, 350);
+
+    TriggerColumns columns;
+    Glib::RefPtr<Gtk::ListStore> store = Gtk::ListStore::create(columns);
+    const json& config = Config::get();
+    if (config.contains("triggers") && config["triggers"].is_array()) {
+        for (const auto& entry : config["triggers"]) {
+            if (!entry.is_object()) continue;
+            Gtk::TreeModel::Row row = *store->append();
+            row[columns.enabled] = entry.value("enabled", true);
+            row[columns.pattern] = entry.value("pattern", "");
+            row[columns.case_sensitive] = entry.value("case_sensitive", false);
+            row[columns.action] = action_name(entry.value("action", "highlight"));
+            row[columns.text] = entry.value("text", "");
+        }
+    }
+
+    Gtk::TreeView view(store);
+    view.append_column_editable("On", columns.enabled);
+    view.append_column_editable("Text to Match", columns.pattern);
+    view.append_column_editable("Match Case", columns.case_sensitive);
+    view.get_column(1)->set_expand(true);
+
+    ActionColumns action_columns;
+    Glib::RefPtr<Gtk::ListStore> action_store = Gtk::ListStore::create(action_columns);
+    for (const char* name : ACTION_NAMES) {
+        (*action_store->append())[action_columns.name] = name;
+    }
+    Gtk::CellRendererCombo* action_renderer = Gtk::manage(new Gtk::CellRendererCombo());
+    action_renderer->property_model() = action_store;
+    action_renderer->property_text_column() = 0;
+    action_renderer->property_has_entry() = false;
+    action_renderer->property_editable() = true;
+    action_renderer->signal_edited().connect([&store, &columns](const Glib::ustring& path, const Glib::ustring& text) {
+        Gtk::TreeModel::iterator iter = store->get_iter(path);
+        if (iter) {
+            (*iter)[columns.action] = text;
+        }
+    });
+    Gtk::TreeViewColumn* action_column = Gtk::manage(new Gtk::TreeViewColumn("Action"));
+    action_column->pack_start(*action_renderer);
+    action_column->add_attribute(action_renderer->property_text(), columns.action);
+    view.append_column(*action_column);
+
+    view.append_column_editable("Send Text", columns.text);
+    view.set_tooltip_text("Text to Match is plain text, found anywhere in a terminal's output. "
+                          "Send Text is typed into the terminal; use \\n or \\r for Enter.");
+
+    Gtk::ScrolledWindow scrolled;
+    scrolled.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+    scrolled.add(view);
+
+    Gtk::Box buttons(Gtk::ORIENTATION_HORIZONTAL, 6);
+    Gtk::Button add_button("Add");
+    Gtk::Button remove_button("Remove");
+    add_button.signal_clicked().connect([&store, &columns, &view]() {
+        Gtk::TreeModel::Row row = *store->append();
+        row[columns.enabled] = true;
+        row[columns.case_sensitive] = false;
+        row[columns.action] = ACTION_NAMES[0];
+        view.set_cursor(store->get_path(row), *view.get_column(1), true);
+    });
+    remove_button.signal_clicked().connect([&store, &view]() {
+        Gtk::TreeModel::iterator iter = view.get_selection()->get_selected();
+        if (iter) {
+            store->erase(iter);
+        }
+    });
+    buttons.pack_start(add_button, Gtk::PACK_SHRINK);
+    buttons.pack_start(remove_button, Gtk::PACK_SHRINK);
+
+    Gtk::Box* content_area = dialog.get_content_area();
+    content_area->set_spacing(6);
+    content_area->set_border_width(6);
+    content_area->pack_start(scrolled, Gtk::PACK_EXPAND_WIDGET);
+    content_area->pack_start(buttons, Gtk::PACK_SHRINK);
+
+    dialog.show_all();
+    if (dialog.run() != Gtk::RESPONSE_OK) return;
+
+    json triggers = json::array();
+    for (const auto& row : store->children()) {
+        Glib::ustring pattern = row[columns.pattern];
+        if (pattern.empty()) continue;
+        Glib::ustring action = row[columns.action];
+        Glib::ustring text = row[columns.text];
+        triggers.push_back({
+            {"enabled", static_cast<bool>(row[columns.enabled])},
+            {"pattern", pattern.raw()},
+            {"case_sensitive", static_cast<bool>(row[columns.case_sensitive])},
+            {"action", action_id(action)},
+            {"text", text.raw()}
+        });
+    }
+
+    json new_config = Config::get();
+    new_config["triggers"] = triggers;
+    Config::update(new_config);
+    reload();
+}
+
+} // namespace Triggers
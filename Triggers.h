@@ -0,0 +1,27 @@
+#ifndef TRIGGERS_H
+#define TRIGGERS_H
+
+#include <gtkmm/notebook.h>
+#include <gtkmm/window.h>
+#include "Sessions.h"
+
+namespace Triggers {
+
+// Clear a tab's trigger highlight when it is selected
+void track(Gtk::Notebook& notebook);
+
+// Scan a terminal session's output for the configured trigger patterns
+void attach(Session& session);
+
+// Rebuild the matcher after the "triggers" configuration changed
+void reload();
+
+// Description of the trigger that highlighted the tab, empty if none
+Glib::ustring get_alert(const Session& session);
+
+// Edit the trigger list
+void show_dialog(Gtk::Window& parent);
+
+} // namespace Triggers
+
+#endif // TRIGGERS_H
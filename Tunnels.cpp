@@ -0,0 +1,1064 @@
+#include "Tunnels.h"
+#include "Connections.h"
+#include "Ssh.h"
+#include <gtkmm/box.h>
+#include <gtkmm/button.h>
+#include <gtkmm/cellrenderertoggle.h>
+#include <gtkmm/checkbutton.h>
+#include <gtkmm/comboboxtext.h>
+#include <gtkmm/dialog.h>
+#include <gtkmm/entry.h>
+#include <gtkmm/grid.h>
+#include <gtkmm/label.h>
+#include <gtkmm/liststore.h>
+#include <gtkmm/messagedialog.h>
+#include <gtkmm/scrolledwindow.h>
+#include <gtkmm/spinbutton.h>
+#include <gtkmm/treeview.h>
+#include <glibmm/main.h>
+#include <glib-unix.h>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <cerrno>
+#include <cstdio>
+#include <csignal>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace Tunnels {
+
+namespace {
+
+// Stop reading one side of a channel while this much waits for the other side
+const gsize MAX_BUFFERED = 256 * 1024;
+
+// Backoff for restarting a master that dropped, and how long it must have stayed up
+// before the backoff starts over
+const int MAX_RETRY_SECONDS = 60;
+const gint64 STABLE_USEC = 30 * G_USEC_PER_SEC;
+
+// Printed by the master through LocalCommand once it has logged in
+const char* READY_MARKER = "ngterm-tunnel-ready";
+
+struct Tunnel;
+class Channel;
+
+// One direction of a channel: bytes read from one descriptor wait here until the
+// other descriptor takes them
+struct Flow {
+    Channel* owner = nullptr;
+    int from = -1;
+    int to = -1;
+    bool to_is_socket = false;
+    std::string buffer;
+    guint read_source = 0;
+    guint write_source = 0;
+    bool eof = false;  // The reading side ended
+    bool done = false; // ...and the end was passed on to the writing side
+    guint64* counter = nullptr;
+};
+
+// A connection accepted on a tunnel's listener, carried by its own "ssh -W" process
+class Channel {
+public:
+    Channel(Tunnel& tunnel, int client_fd);
+    ~Channel() { close(); }
+
+    // Connect to the destination, right away or after the SOCKS request named it
+    void start();
+
+    bool is_closed() const { return closed; }
+    void close();
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+private:
+    void open(const std::string& destination, const std::string& early_data);
+    bool parse_socks();
+    void reply(const std::string& data);
+
+    void watch_read(Flow& flow);
+    void flush(Flow& flow);
+
+    static gboolean on_socks_readable(gint fd, GIOCondition condition, gpointer user_data);
+    static gboolean on_readable(gint fd, GIOCondition condition, gpointer user_data);
+    static gboolean on_writable(gint fd, GIOCondition condition, gpointer user_data);
+
+    Tunnel& tunnel;
+    int client_fd;
+    int ssh_in = -1;
+    int ssh_out = -1;
+    GPid pid = 0;
+    Flow up;   // Client to ssh
+    Flow down; // ssh to client
+    std::string socks_buffer;
+    bool socks_greeted = false;
+    guint socks_source = 0;
+    bool closed = false;
+};
+
+// A defined port forward and, while started, its listener and channels
+struct Tunnel {
+    Glib::ustring connection_id;
+    Glib::ustring connection_name;
+    TunnelInfo info;
+    bool started = false;
+    int listen_fd = -1;
+    guint listen_source = 0;
+    std::string listen_error;
+    std::list<std::unique_ptr<Channel>> channels;
+    guint64 bytes_sent = 0;
+    guint64 bytes_received = 0;
+    guint64 total_channels = 0;
+};
+
+enum class MasterState { Stopped, Connecting, Up, Retrying };
+
+// The shared master of a connection's tunnels. It is a plain "ssh -N" that owns the control
+// socket; channels multiplex over it and fall back to their own login while it is down.
+struct Master {
+    MasterState state = MasterState::Stopped;
+    GPid pid = 0;
+    int out_fd = -1;
+    int err_fd = -1;
+    guint out_source = 0;
+    guint err_source = 0;
+    guint retry_source = 0;
+    std::string output;
+    std::string last_error;
+    int attempts = 0;
+    gint64 up_since = 0;
+    gint64 retry_at = 0;
+};
+
+// Keyed by connection ID, a tab character and the listen address
+std::map<std::string, std::unique_ptr<Tunnel>> tunnels;
+std::map<std::string, std::unique_ptr<Master>> masters;
+
+// ssh processes still running, so a closed channel does not signal a reused PID
+std::set<GPid> running_children;
+
+guint tick_source = 0;
+guint cleanup_source = 0;
+
+std::string tunnel_key(const Glib::ustring& connection_id, const TunnelInfo& info) {
+    return connection_id.raw() + "\t" + info.bind_address.raw() + ":" + std::to_string(info.listen_port);
+}
+
+void reap_child(GPid pid, gint /* status */, gpointer /* user_data */) {
+    running_children.erase(pid);
+    g_spawn_close_pid(pid);
+}
+
+void remove_source(guint& source) {
+    if (source) {
+        g_source_remove(source);
+        source = 0;
+    }
+}
+
+void close_fd(int& fd) {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+bool spawn_with_pipes(const std::vector<std::string>& args, GPid& pid, int* in_fd, int* out_fd, int* err_fd,
+                      std::string& error_message) {
+    std::vector<char*> argv;
+    for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    GError* error = nullptr;
+    GSpawnFlags flags = GSpawnFlags(G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD |
+                                    (err_fd ? 0 : G_SPAWN_STDERR_TO_DEV_NULL));
+    if (!g_spawn_async_with_pipes(nullptr, argv.data(), nullptr, flags, nullptr, nullptr,
+                                  &pid, in_fd, out_fd, err_fd, &error)) {
+        error_message = error->message;
+        g_error_free(error);
+        return false;
+    }
+    running_children.insert(pid);
+    for (int* fd : {in_fd, out_fd, err_fd}) {
+        if (fd) g_unix_set_fd_nonblocking(*fd, TRUE, nullptr);
+    }
+    return true;
+}
+
+gboolean drop_closed_channels(gpointer /* user_data */) {
+    cleanup_source = 0;
+    for (auto& item : tunnels) {
+        item.second->channels.remove_if([](const std::unique_ptr<Channel>& channel) { return channel->is_closed(); });
+    }
+    return G_SOURCE_REMOVE;
+}
+
+// ---- Channels ----
+
+Channel::Channel(Tunnel& tunnel, int client_fd) : tunnel(tunnel), client_fd(client_fd) {
+    up.owner = this;
+    up.from = client_fd;
+    up.counter = &tunnel.bytes_sent;
+    down.owner = this;
+    down.to = client_fd;
+    down.to_is_socket = true;
+    down.counter = &tunnel.bytes_received;
+}
+
+void Channel::start() {
+    if (tunnel.info.type == "Dynamic") {
+        socks_source = g_unix_fd_add(client_fd, GIOCondition(G_IO_IN | G_IO_HUP | G_IO_ERR), on_socks_readable, this);
+        return;
+    }
+    open(tunnel.info.target_host.raw() + ":" + std::to_string(tunnel.info.target_port), std::string());
+}
+
+void Channel::open(const std::string& destination, const std::string& early_data) {
+    ConnectionInfo conn = ConnectionManager::get_connection_by_id(tunnel.connection_id);
+    if (conn.id.empty()) {
+        close();
+        return;
+    }
+
+    // ControlMaster=no still multiplexes over the shared master when it is up
+    std::vector<std::string> args = Ssh::generate_background_command_args(conn, {
+        "-o", "ControlMaster=no", "-o", "ExitOnForwardFailure=yes", "-W", destination
+    });
+    std::string error;
+    if (!spawn_with_pipes(args, pid, &ssh_in, &ssh_out, nullptr, error)) {
+        std::cerr << "Tunnels: Failed to start ssh: " << error << std::endl;
+        close();
+        return;
+    }
+    g_child_watch_add(pid, reap_child, nullptr);
+
+    up.to = ssh_in;
+    down.from = ssh_out;
+    up.buffer = early_data;
+    flush(up);
+    if (!closed) watch_read(down);
+}
+
+// SOCKS5 without authentication, CONNECT only; enough for browsers, curl and ssh -o ProxyCommand=nc -X 5
+bool Channel::parse_socks() {
+    const std::string& data = socks_buffer;
+    if (!socks_greeted) {
+        if (data.size() < 2) return true;
+        if (data[0] != 5) return false;
+        size_t methods = static_cast<unsigned char>(data[1]);
+        if (data.size() < 2 + methods) return true;
+        bool no_auth = data.find('\0', 2) != std::string::npos && data.find('\0', 2) < 2 + methods;
+        reply(no_auth ? std::string("\x05\x00", 2) : std::string("\x05\xff", 2));
+        if (!no_auth) return false;
+        socks_buffer.erase(0, 2 + methods);
+        socks_greeted = true;
+    }
+
+    if (data.size() < 5) return true;
+    if (data[0] != 5) return false;
+    if (data[1] != 1) {
+        reply(std::string("\x05\x07\x00\x01\x00\x00\x00\x00\x00\x00", 10)); // Command not supported
+        return false;
+    }
+
+    std::string host;
+    size_t offset = 4;
+    unsigned char address_type = data[3];
+    if (address_type == 1) {
+        if (data.size() < offset + 4 + 2) return true;
+        char text[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, data.data() + offset, text, sizeof(text));
+        host = text;
+        offset += 4;
+    } else if (address_type == 3) {
+        size_t length = static_cast<unsigned char>(data[4]);
+        if (data.size() < offset + 1 + length + 2) return true;
+        host = data.substr(offset + 1, length);
+        offset += 1 + length;
+    } else if (address_type == 4) {
+        if (data.size() < offset + 16 + 2) return true;
+        char text[INET6_ADDRSTRLEN];
+        inet_ntop(AF_INET6, data.data() + offset, text, sizeof(text));
+        host = std::string("[") + text + "]";
+        offset += 16;
+    } else {
+        reply(std::string("\x05\x08\x00\x01\x00\x00\x00\x00\x00\x00", 10)); // Address type not supported
+        return false;
+    }
+    int port = (static_cast<unsigned char>(data[offset]) << 8) | static_cast<unsigned char>(data[offset + 1]);
+    offset += 2;
+
+    // ssh -W only reports failure by closing, so the request is granted up front
+    reply(std::string("\x05\x00\x00\x01\x00\x00\x00\x00\x00\x00", 10));
+    remove_source(socks_source);
+    open(host + ":" + std::to_string(port), socks_buffer.substr(offset));
+    return true;
+}
+
+void Channel::reply(const std::string& data) {
+    // Replies are a few bytes on a fresh connection, so the socket buffer takes them whole
+    ssize_t ignored = send(client_fd, data.data(), data.size(), MSG_NOSIGNAL);
+    (void)ignored;
+}
+
+void Channel::watch_read(Flow& flow) {
+    if (flow.read_source || flow.eof || flow.from < 0 || flow.buffer.size() >= MAX_BUFFERED) return;
+    flow.read_source = g_unix_fd_add(flow.from, GIOCondition(G_IO_IN | G_IO_HUP | G_IO_ERR), on_readable, &flow);
+}
+
+void Channel::flush(Flow& flow) {
+    while (!flow.buffer.empty()) {
+        ssize_t written = flow.to_is_socket
+            ? send(flow.to, flow.buffer.data(), flow.buffer.size(), MSG_NOSIGNAL)
+            : write(flow.to, flow.buffer.data(), flow.buffer.size());
+        if (written > 0) {
+            flow.buffer.erase(0, written);
+            *flow.counter += written;
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written < 0 && errno == EAGAIN) {
+            if (!flow.write_source) {
+                flow.write_source = g_unix_fd_add(flow.to, G_IO_OUT, on_writable, &flow);
+            }
+            return;
+        } else {
+            close(); // The other side is gone
+            return;
+        }
+    }
+
+    if (flow.eof && !flow.done) {
+        // Pass the end on, the other direction may still carry data
+        flow.done = true;
+        if (flow.to_is_socket) {
+            ::shutdown(flow.to, SHUT_WR);
+        } else {
+            close_fd(ssh_in);
+            flow.to = -1;
+        }
+        if (up.done && down.done) {
+            close();
+        }
+        return;
+    }
+    watch_read(flow);
+}
+
+void Channel::close() {
+    if (closed) return;
+    closed = true;
+    for (Flow* flow : {&up, &down}) {
+        remove_source(flow->read_source);
+        remove_source(flow->write_source);
+    }
+    remove_source(socks_source);
+    close_fd(client_fd);
+    close_fd(ssh_in);
+    close_fd(ssh_out);
+    if (pid > 0 && running_children.count(pid)) {
+        kill(pid, SIGTERM);
+    }
+    if (!cleanup_source) {
+        cleanup_source = g_idle_add(drop_closed_channels, nullptr);
+    }
+}
+
+gboolean Channel::on_socks_readable(gint fd, GIOCondition /* condition */, gpointer user_data) {
+    Channel* channel = static_cast<Channel*>(user_data);
+    char buffer[512];
+    ssize_t length = read(fd, buffer, sizeof(buffer));
+    if (length < 0 && (errno == EAGAIN || errno == EINTR)) return G_SOURCE_CONTINUE;
+    if (length <= 0 || channel->socks_buffer.size() > 1024) {
+        channel->socks_source = 0;
+        channel->close();
+        return G_SOURCE_REMOVE;
+    }
+    channel->socks_buffer.append(buffer, length);
+    if (!channel->parse_socks()) {
+        channel->socks_source = 0;
+        channel->close();
+        return G_SOURCE_REMOVE;
+    }
+    // parse_socks() removes this source once the request is complete
+    return channel->socks_source ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+gboolean Channel::on_readable(gint fd, GIOCondition /* condition */, gpointer user_data) {
+    Flow& flow = *static_cast<Flow*>(user_data);
+    Channel* channel = flow.owner;
+    char buffer[65536];
+    ssize_t length = read(fd, buffer, sizeof(buffer));
+    if (length < 0 && (errno == EAGAIN || errno == EINTR)) return G_SOURCE_CONTINUE;
+
+    // flush() watches again once the data is passed on; until then the reader waits (backpressure)
+    flow.read_source = 0;
+    if (length > 0) {
+        flow.buffer.append(buffer, length);
+    } else {
+        flow.eof = true;
+    }
+    if (!flow.write_source) {
+        channel->flush(flow);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+gboolean Channel::on_writable(gint /* fd */, GIOCondition /* condition */, gpointer user_data) {
+    Flow& flow = *static_cast<Flow*>(user_data);
+    flow.write_source = 0;
+    flow.owner->flush(flow);
+    return G_SOURCE_REMOVE;
+}
+
+// ---- Masters ----
+
+void stop_master_process(Master& master) {
+    remove_source(master.out_source);
+    remove_source(master.err_source);
+    remove_source(master.retry_source);
+    close_fd(master.out_fd);
+    close_fd(master.err_fd);
+    if (master.pid > 0 && running_children.count(master.pid)) {
+        kill(master.pid, SIGTERM);
+    }
+    master.pid = 0;
+}
+
+void start_master(const Glib::ustring& connection_id);
+
+bool has_started_tunnels(const Glib::ustring& connection_id) {
+    for (const auto& item : tunnels) {
+        if (item.second->started && item.second->connection_id == connection_id) return true;
+    }
+    return false;
+}
+
+gboolean on_master_retry(gpointer user_data) {
+    Glib::ustring connection_id = *static_cast<Glib::ustring*>(user_data);
+    auto it = masters.find(connection_id.raw());
+    if (it != masters.end()) {
+        it->second->retry_source = 0; // Removed by returning G_SOURCE_REMOVE
+        start_master(connection_id);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+void on_master_exit(GPid pid, gint /* status */, gpointer user_data) {
+    running_children.erase(pid);
+    g_spawn_close_pid(pid);
+
+    std::string connection_id = *static_cast<std::string*>(user_data);
+    delete static_cast<std::string*>(user_data);
+    auto it = masters.find(connection_id);
+    if (it == masters.end() || it->second->pid != pid) return; // Stopped or replaced meanwhile
+
+    Master& master = *it->second;
+    gint64 now = g_get_monotonic_time();
+    bool was_stable = master.state == MasterState::Up && now - master.up_since >= STABLE_USEC;
+    stop_master_process(master);
+    if (!has_started_tunnels(connection_id)) {
+        master.state = MasterState::Stopped;
+        return;
+    }
+
+    if (was_stable) master.attempts = 0;
+    int delay = std::min(MAX_RETRY_SECONDS, 1 << std::min(master.attempts, 6));
+    master.attempts++;
+    master.state = MasterState::Retrying;
+    master.retry_at = now + delay * G_USEC_PER_SEC;
+    master.retry_source = g_timeout_add_seconds_full(G_PRIORITY_DEFAULT, delay, on_master_retry,
+                                                     new Glib::ustring(connection_id),
+                                                     [](gpointer data) { delete static_cast<Glib::ustring*>(data); });
+}
+
+gboolean on_master_output(gint fd, GIOCondition /* condition */, gpointer user_data) {
+    Master& master = *static_cast<Master*>(user_data);
+    char buffer[4096];
+    ssize_t length = read(fd, buffer, sizeof(buffer));
+    if (length < 0 && (errno == EAGAIN || errno == EINTR)) return G_SOURCE_CONTINUE;
+    if (length <= 0) {
+        master.out_source = 0;
+        return G_SOURCE_REMOVE;
+    }
+    master.output.append(buffer, length);
+    if (master.state == MasterState::Connecting && master.output.find(READY_MARKER) != std::string::npos) {
+        master.state = MasterState::Up;
+        master.up_since = g_get_monotonic_time();
+        master.last_error.clear();
+    }
+    if (master.output.size() > 4096) {
+        master.output.erase(0, master.output.size() - 64);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+gboolean on_master_error(gint fd, GIOCondition /* condition */, gpointer user_data) {
+    Master& master = *static_cast<Master*>(user_data);
+    char buffer[4096];
+    ssize_t length = read(fd, buffer, sizeof(buffer));
+    if (length < 0 && (errno == EAGAIN || errno == EINTR)) return G_SOURCE_CONTINUE;
+    if (length <= 0) {
+        master.err_source = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    // Keep the last line ssh complained with, for the status column
+    std::string text(buffer, length);
+    size_t end = text.find_last_not_of("\r\n");
+    if (end != std::string::npos) {
+        size_t start = text.find_last_of("\r\n", end);
+        master.last_error = text.substr(start == std::string::npos ? 0 : start + 1, end - (start == std::string::npos ? 0 : start + 1) + 1);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+void start_master(const Glib::ustring& connection_id) {
+    std::unique_ptr<Master>& slot = masters[connection_id.raw()];
+    if (!slot) slot = std::make_unique<Master>();
+    Master& master = *slot;
+    if (master.pid > 0 || master.retry_source) return; // Running or waiting to retry
+
+    ConnectionInfo conn = ConnectionManager::get_connection_by_id(connection_id);
+    if (conn.id.empty()) {
+        master.state = MasterState::Stopped;
+        master.last_error = "The connection no longer exists";
+        return;
+    }
+
+    std::vector<std::string> args = Ssh::generate_background_command_args(conn, {
+        "-N",
+        "-o", "ControlMaster=yes",
+        "-o", "ControlPersist=no",
+        "-o", "ServerAliveInterval=15",
+        "-o", "ServerAliveCountMax=3",
+        "-o", "PermitLocalCommand=yes",
+        "-o", std::string("LocalCommand=echo ") + READY_MARKER
+    });
+    std::string error;
+    if (!spawn_with_pipes(args, master.pid, nullptr, &master.out_fd, &master.err_fd, error)) {
+        master.pid = 0;
+        master.last_error = error;
+        master.state = MasterState::Stopped;
+        return;
+    }
+    master.state = MasterState::Connecting;
+    master.output.clear();
+    master.out_source = g_unix_fd_add(master.out_fd, GIOCondition(G_IO_IN | G_IO_HUP | G_IO_ERR), on_master_output, &master);
+    master.err_source = g_unix_fd_add(master.err_fd, GIOCondition(G_IO_IN | G_IO_HUP | G_IO_ERR), on_master_error, &master);
+    g_child_watch_add(master.pid, on_master_exit, new std::string(connection_id.raw()));
+}
+
+void stop_master(const Glib::ustring& connection_id) {
+    auto it = masters.find(connection_id.raw());
+    if (it == masters.end()) return;
+    stop_master_process(*it->second);
+    it->second->state = MasterState::Stopped;
+    it->second->attempts = 0;
+}
+
+// ---- Tunnels ----
+
+gboolean on_accept(gint fd, GIOCondition /* condition */, gpointer user_data) {
+    Tunnel& tunnel = *static_cast<Tunnel*>(user_data);
+    int client_fd = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (client_fd < 0) return G_SOURCE_CONTINUE;
+
+    tunnel.total_channels++;
+    tunnel.channels.push_back(std::make_unique<Channel>(tunnel, client_fd));
+    tunnel.channels.back()->start();
+    return G_SOURCE_CONTINUE;
+}
+
+bool open_listener(Tunnel& tunnel) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    struct addrinfo* addresses = nullptr;
+    std::string bind_address = tunnel.info.bind_address.empty() ? "127.0.0.1" : tunnel.info.bind_address.raw();
+    std::string port = std::to_string(tunnel.info.listen_port);
+    int result = getaddrinfo(bind_address.c_str(), port.c_str(), &hints, &addresses);
+    if (result != 0) {
+        tunnel.listen_error = gai_strerror(result);
+        return false;
+    }
+
+    int fd = socket(addresses->ai_family, addresses->ai_socktype | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    int reuse = 1;
+    if (fd < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+        bind(fd, addresses->ai_addr, addresses->ai_addrlen) != 0 ||
+        listen(fd, 16) != 0) {
+        tunnel.listen_error = strerror(errno);
+        if (fd >= 0) ::close(fd);
+        freeaddrinfo(addresses);
+        return false;
+    }
+    freeaddrinfo(addresses);
+
+    tunnel.listen_fd = fd;
+    tunnel.listen_error.clear();
+    tunnel.listen_source = g_unix_fd_add(fd, G_IO_IN, on_accept, &tunnel);
+    return true;
+}
+
+void close_listener(Tunnel& tunnel) {
+    remove_source(tunnel.listen_source);
+    close_fd(tunnel.listen_fd);
+}
+
+// Retry listeners whose port was taken, e.g. by a previous ngTerm still shutting down
+gboolean on_tick(gpointer /* user_data */) {
+    bool any_started = false;
+    for (auto& item : tunnels) {
+        Tunnel& tunnel = *item.second;
+        if (!tunnel.started) continue;
+        any_started = true;
+        if (tunnel.listen_fd < 0) {
+            open_listener(tunnel);
+        }
+    }
+    if (!any_started) {
+        tick_source = 0;
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+void start_tunnel(Tunnel& tunnel) {
+    if (tunnel.started) return;
+
+    tunnel.started = true;
+    open_listener(tunnel);
+    start_master(tunnel.connection_id);
+    if (!tick_source) {
+        tick_source = g_timeout_add_seconds(5, on_tick, nullptr);
+    }
+}
+
+void stop_tunnel(Tunnel& tunnel) {
+    if (!tunnel.started) return;
+    tunnel.started = false;
+    close_listener(tunnel);
+    tunnel.listen_error.clear();
+    tunnel.channels.clear();
+    if (!has_started_tunnels(tunnel.connection_id)) {
+        stop_master(tunnel.connection_id);
+    }
+}
+
+// Bring the tunnel list in line with the saved connections, keeping running tunnels
+void reload_definitions() {
+    std::set<std::string> defined;
+    for (const auto& conn : ConnectionManager::load_connections()) {
+        if (conn.connection_type != "SSH") continue;
+        for (const auto& info : conn.tunnels) {
+            std::string key = tunnel_key(conn.id, info);
+            defined.insert(key);
+            std::unique_ptr<Tunnel>& tunnel = tunnels[key];
+            if (!tunnel) {
+                tunnel = std::make_unique<Tunnel>();
+                tunnel->connection_id = conn.id;
+            }
+            tunnel->connection_name = conn.name;
+            if (!tunnel->started) {
+                tunnel->info = info;
+            }
+            tunnel->info.auto_start = info.auto_start;
+        }
+    }
+    for (auto it = tunnels.begin(); it != tunnels.end();) {
+        if (!defined.count(it->first)) {
+            stop_tunnel(*it->second);
+            it = tunnels.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+Glib::ustring describe(const TunnelInfo& info) {
+    std::string listen = info.bind_address.raw() + ":" + std::to_string(info.listen_port);
+    if (info.type == "Dynamic") {
+        return "SOCKS " + listen;
+    }
+    return listen + " → " + info.target_host.raw() + ":" + std::to_string(info.target_port);
+}
+
+Glib::ustring format_bytes(guint64 bytes) {
+    const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    double value = static_cast<double>(bytes);
+    int unit = 0;
+    while (value >= 1024 && unit < 4) {
+        value /= 1024;
+        unit++;
+    }
+    char text[32];
+    snprintf(text, sizeof(text), unit == 0 ? "%.0f %s" : "%.1f %s", value, units[unit]);
+    return text;
+}
+
+Glib::ustring describe_state(const Tunnel& tunnel) {
+    if (!tunnel.started) return "Stopped";
+    if (tunnel.listen_fd < 0) return "Cannot listen: " + tunnel.listen_error + ", retrying";
+
+    auto it = masters.find(tunnel.connection_id.raw());
+    if (it == masters.end()) return "Listening";
+    const Master& master = *it->second;
+    switch (master.state) {
+        case MasterState::Connecting:
+            return "Connecting";
+        case MasterState::Up:
+            return "Up";
+        case MasterState::Retrying: {
+            gint64 seconds = std::max<gint64>(0, (master.retry_at - g_get_monotonic_time()) / G_USEC_PER_SEC);
+            Glib::ustring state = "Reconnecting in " + std::to_string(seconds) + "s";
+            return master.last_error.empty() ? state : state + ": " + master.last_error;
+        }
+        case MasterState::Stopped:
+            break;
+    }
+    return master.last_error.empty() ? Glib::ustring("Listening") : "Listening, " + master.last_error;
+}
+
+// Change one saved tunnel definition; false if it no longer exists
+bool update_definition(const std::string& key, const std::function<void(ConnectionInfo&, size_t)>& change) {
+    auto it = tunnels.find(key);
+    if (it == tunnels.end()) return false;
+    ConnectionInfo conn = ConnectionManager::get_connection_by_id(it->second->connection_id);
+    for (size_t i = 0; i < conn.tunnels.size(); ++i) {
+        if (tunnel_key(conn.id, conn.tunnels[i]) == key) {
+            change(conn, i);
+            ConnectionManager::save_connection(conn);
+            return true;
+        }
+    }
+    return false;
+}
+
+class TunnelColumns : public Gtk::TreeModel::ColumnRecord {
+public:
+    TunnelColumns() {
+        add(key);
+        add(connection);
+        add(forward);
+        add(auto_start);
+        add(state);
+        add(channels);
+        add(sent);
+        add(received);
+    }
+    Gtk::TreeModelColumn<std::string> key;
+    Gtk::TreeModelColumn<Glib::ustring> connection;
+    Gtk::TreeModelColumn<Glib::ustring> forward;
+    Gtk::TreeModelColumn<bool> auto_start;
+    Gtk::TreeModelColumn<Glib::ustring> state;
+    Gtk::TreeModelColumn<Glib::ustring> channels;
+    Gtk::TreeModelColumn<Glib::ustring> sent;
+    Gtk::TreeModelColumn<Glib::ustring> received;
+};
+
+class TunnelWindow : public Gtk::Window {
+public:
+    explicit TunnelWindow(Gtk::Window& parent) : box(Gtk::ORIENTATION_VERTICAL, 6), button_box(Gtk::ORIENTATION_HORIZONTAL, 6),
+                                                 add_button("Add..."), remove_button("Remove"),
+                                                 start_button("Start"), stop_button("Stop") {
+        set_title("Tunnels");
+        set_transient_for(parent);
+        set_default_size(800, 320);
+        set_border_width(8);
+
+        store = Gtk::ListStore::create(columns);
+        view.set_model(store);
+        view.append_column("Connection", columns.connection);
+        view.append_column("Forward", columns.forward);
+        int auto_column = view.append_column_editable("Auto Start", columns.auto_start) - 1;
+        view.append_column("State", columns.state);
+        view.append_column("Connections", columns.channels);
+        view.append_column("Sent", columns.sent);
+        view.append_column("Received", columns.received);
+        view.get_column(3)->set_expand(true);
+        view.set_tooltip_text("Auto Start tunnels start together with ngTerm. "
+                              "Connections shows the open connections and the total since the tunnel started.");
+        auto* toggle = dynamic_cast<Gtk::CellRendererToggle*>(view.get_column_cell_renderer(auto_column));
+        if (toggle) {
+            toggle->signal_toggled().connect(sigc::mem_fun(*this, &TunnelWindow::on_auto_start_toggled));
+        }
+        view.signal_row_activated().connect([this](const Gtk::TreeModel::Path&, Gtk::TreeViewColumn*) {
+            on_start_stop(true);
+        });
+        scrolled.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+        scrolled.add(view);
+
+        add_button.signal_clicked().connect(sigc::mem_fun(*this, &TunnelWindow::on_add));
+        remove_button.signal_clicked().connect(sigc::mem_fun(*this, &TunnelWindow::on_remove));
+        start_button.signal_clicked().connect([this]() { on_start_stop(true); });
+        stop_button.signal_clicked().connect([this]() { on_start_stop(false); });
+        button_box.pack_start(add_button, Gtk::PACK_SHRINK);
+        button_box.pack_start(remove_button, Gtk::PACK_SHRINK);
+        button_box.pack_end(stop_button, Gtk::PACK_SHRINK);
+        button_box.pack_end(start_button, Gtk::PACK_SHRINK);
+
+        box.pack_start(scrolled, Gtk::PACK_EXPAND_WIDGET);
+        box.pack_start(button_box, Gtk::PACK_SHRINK);
+        add(box);
+        show_all_children();
+
+        refresh_timer = Glib::signal_timeout().connect_seconds([this]() {
+            if (get_visible()) refresh();
+            return true;
+        }, 1);
+    }
+
+    ~TunnelWindow() override {
+        refresh_timer.disconnect();
+    }
+
+    void reload() {
+        reload_definitions();
+        refresh();
+    }
+
+private:
+    std::string selected_key() {
+        Gtk::TreeModel::iterator iter = view.get_selection()->get_selected();
+        return iter ? static_cast<std::string>((*iter)[columns.key]) : std::string();
+    }
+
+    // Update the rows in place so the selection survives, rebuild when tunnels came or went
+    void refresh() {
+        bool same_rows = store->children().size() == tunnels.size();
+        if (same_rows) {
+            auto it = tunnels.begin();
+            for (const auto& row : store->children()) {
+                if (static_cast<std::string>(row[columns.key]) != it->first) {
+                    same_rows = false;
+                    break;
+                }
+                ++it;
+            }
+        }
+        if (!same_rows) {
+            std::string selected = selected_key();
+            store->clear();
+            for (const auto& item : tunnels) {
+                Gtk::TreeModel::Row row = *store->append();
+                row[columns.key] = item.first;
+                if (item.first == selected) view.get_selection()->select(row);
+            }
+        }
+
+        for (auto& row : store->children()) {
+            const Tunnel& tunnel = *tunnels[static_cast<std::string>(row[columns.key])];
+            row[columns.connection] = tunnel.connection_name;
+            row[columns.forward] = describe(tunnel.info);
+            row[columns.auto_start] = tunnel.info.auto_start;
+            row[columns.state] = describe_state(tunnel);
+            row[columns.channels] = std::to_string(tunnel.channels.size()) + " / " + std::to_string(tunnel.total_channels);
+            row[columns.sent] = format_bytes(tunnel.bytes_sent);
+            row[columns.received] = format_bytes(tunnel.bytes_received);
+        }
+    }
+
+    void on_auto_start_toggled(const Glib::ustring& path) {
+        Gtk::TreeModel::iterator iter = store->get_iter(path);
+        if (!iter) return;
+        bool auto_start = (*iter)[columns.auto_start];
+        update_definition((*iter)[columns.key], [auto_start](ConnectionInfo& conn, size_t index) {
+            conn.tunnels[index].auto_start = auto_start;
+        });
+        reload();
+    }
+
+    void on_start_stop(bool start) {
+        auto it = tunnels.find(selected_key());
+        if (it == tunnels.end()) return;
+        if (start) {
+            start_tunnel(*it->second);
+        } else {
+            stop_tunnel(*it->second);
+        }
+        refresh();
+    }
+
+    void on_remove() {
+        std::string key = selected_key();
+        auto it = tunnels.find(key);
+        if (it == tunnels.end()) return;
+        stop_tunnel(*it->second);
+        update_definition(key, [](ConnectionInfo& conn, size_t index) {
+            conn.tunnels.erase(conn.tunnels.begin() + index);
+        });
+        reload();
+    }
+
+    void on_add() {
+        Gtk::Dialog dialog("Add Tunnel", *this, true);
+        dialog.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+        dialog.add_button("_Add", Gtk::RESPONSE_OK);
+
+        Gtk::Grid grid;
+        grid.set_border_width(10);
+        grid.set_row_spacing(6);
+        grid.set_column_spacing(12);
+
+        Gtk::Label connection_label("Connection:", Gtk::ALIGN_START);
+        Gtk::ComboBoxText connection_combo;
+        connection_combo.set_hexpand(true);
+        for (const auto& conn : ConnectionManager::load_connections()) {
+            if (conn.connection_type == "SSH") {
+                connection_combo.append(conn.id, conn.name);
+            }
+        }
+        connection_combo.set_active(0);
+
+        Gtk::Label type_label("Type:", Gtk::ALIGN_START);
+        Gtk::ComboBoxText type_combo;
+        type_combo.append("Local", "Local (forward a port to a destination)");
+        type_combo.append("Dynamic", "Dynamic (SOCKS proxy)");
+        type_combo.set_active_id("Local");
+
+        Gtk::Label bind_label("Listen Address:", Gtk::ALIGN_START);
+        Gtk::Entry bind_entry;
+        bind_entry.set_text("127.0.0.1");
+
+        Gtk::Label listen_port_label("Listen Port:", Gtk::ALIGN_START);
+        Gtk::SpinButton listen_port_spin;
+        listen_port_spin.set_range(1, 65535);
+        listen_port_spin.set_increments(1, 100);
+        listen_port_spin.set_value(8080);
+
+        Gtk::Label target_host_label("Destination Host:", Gtk::ALIGN_START);
+        Gtk::Entry target_host_entry;
+        target_host_entry.set_placeholder_text("localhost");
+        target_host_entry.set_tooltip_text("Host name or address as seen from the SSH server");
+
+        Gtk::Label target_port_label("Destination Port:", Gtk::ALIGN_START);
+        Gtk::SpinButton target_port_spin;
+        target_port_spin.set_range(1, 65535);
+        target_port_spin.set_increments(1, 100);
+        target_port_spin.set_value(80);
+
+        Gtk::CheckButton auto_start_check("Start with ngTerm");
+
+        int row = 0;
+        for (auto pair : std::vector<std::pair<Gtk::Widget*, Gtk::Widget*>>{
+                 {&connection_label, &connection_combo}, {&type_label, &type_combo}, {&bind_label, &bind_entry},
+                 {&listen_port_label, &listen_port_spin}, {&target_host_label, &target_host_entry},
+                 {&target_port_label, &target_port_spin}}) {
+            grid.attach(*pair.first, 0, row, 1, 1);
+            grid.attach(*pair.second, 1, row, 1, 1);
+            row++;
+        }
+        grid.attach(auto_start_check, 1, row, 1, 1);
+        dialog.get_content_area()->pack_start(grid, Gtk::PACK_EXPAND_WIDGET);
+
+        auto update_type = [&]() {
+            bool local = type_combo.get_active_id() == "Local";
+            target_host_label.set_visible(local);
+            target_host_entry.set_visible(local);
+            target_port_label.set_visible(local);
+            target_port_spin.set_visible(local);
+        };
+        type_combo.signal_changed().connect(update_type);
+        dialog.show_all();
+        update_type();
+
+        while (dialog.run() == Gtk::RESPONSE_OK) {
+            TunnelInfo info;
+            info.type = type_combo.get_active_id();
+            info.bind_address = bind_entry.get_text().empty() ? Glib::ustring("127.0.0.1") : bind_entry.get_text();
+            info.listen_port = listen_port_spin.get_value_as_int();
+            if (info.type == "Local") {
+                info.target_host = target_host_entry.get_text().empty() ? Glib::ustring("localhost") : target_host_entry.get_text();
+                info.target_port = target_port_spin.get_value_as_int();
+            }
+            info.auto_start = auto_start_check.get_active();
+
+            Glib::ustring error;
+            ConnectionInfo conn = ConnectionManager::get_connection_by_id(connection_combo.get_active_id());
+            if (conn.id.empty()) {
+                error = "Choose an SSH connection for the tunnel.";
+            }
+            for (const auto& item : tunnels) {
+                if (item.second->info.bind_address == info.bind_address && item.second->info.listen_port == info.listen_port) {
+                    error = "Another tunnel already listens on " + info.bind_address + ":" + std::to_string(info.listen_port) + ".";
+                }
+            }
+            if (!error.empty()) {
+                Gtk::MessageDialog error_dialog(dialog, "Cannot Add Tunnel", false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
+                error_dialog.set_secondary_text(error);
+                error_dialog.run();
+                continue;
+            }
+
+            conn.tunnels.push_back(info);
+            ConnectionManager::save_connection(conn);
+            reload();
+            auto it = tunnels.find(tunnel_key(conn.id, info));
+            if (it != tunnels.end()) {
+                start_tunnel(*it->second);
+                refresh();
+            }
+            break;
+        }
+    }
+
+    Gtk::Box box;
+    Gtk::Box button_box;
+    Gtk::ScrolledWindow scrolled;
+    Gtk::TreeView view;
+    Gtk::Button add_button;
+    Gtk::Button remove_button;
+    Gtk::Button start_button;
+    Gtk::Button stop_button;
+    TunnelColumns columns;
+    Glib::RefPtr<Gtk::ListStore> store;
+    sigc::connection refresh_timer;
+};
+
+TunnelWindow* tunnel_window = nullptr;
+
+} // namespace
+
+void start_auto() {
+    reload_definitions();
+    for (auto& item : tunnels) {
+        if (item.second->info.auto_start) {
+            start_tunnel(*item.second);
+        }
+    }
+}
+
+void show_window(Gtk::Window& parent) {
+    if (!tunnel_window) {
+        tunnel_window = new TunnelWindow(parent);
+    }
+    tunnel_window->reload();
+    tunnel_window->present();
+}
+
+void shutdown() {
+    for (auto& item : tunnels) {
+        stop_tunnel(*item.second);
+    }
+    for (auto& item : masters) {
+        stop_master_process(*item.second);
+    }
+    remove_source(tick_source);
+    remove_source(cleanup_source);
+}
+
+} // namespace Tunnels
@@ -0,0 +1,21 @@
+#ifndef TUNNELS_H
+#define TUNNELS_H
+
+#include <gtkmm/window.h>
+
+namespace Tunnels {
+
+// Start the tunnels marked to start together with ngTerm
+void start_auto();
+
+// Show the tunnel manager. Port forwards are defined per SSH connection and run without
+// a terminal tab: ngTerm listens locally and carries each accepted connection over an
+// "ssh -W" channel multiplexed on a shared master, which is restarted when it drops.
+void show_window(Gtk::Window& parent);
+
+// Stop all tunnels and their masters; call before exiting
+void shutdown();
+
+} // namespace Tunnels
+
+#endif // TUNNELS_H
@@ -1,6 +1,30 @@
 #include "main.h"
 #include "icondata.h"
 #include "Rdp.h"
+#include "Broadcast.h"
+#include "Sessions.h"
+#include "Restore.h"
+#include "Scrollback.h"
+#include "Reconnect.h"
+#include "PtyRelay.h"
+#include "Recording.h"
+#include "Replay.h"
+#include "Search.h"
+#include "Triggers.h"
+#include "Monitor.h"
+#include "Paste.h"
+#include "LocalEcho.h"
+#include "Tmux.h"
+#include "PtyHelper.h"
+#include "Tunnels.h"
+#include "Sftp.h"
+#include "Push.h"
+#include "Exec.h"
+#include "HostKeys.h"
+#include "Agent.h"
+#include "Tools.h"
+#include "NetworkProfiles.h"
+#include "LinkHealth.h"
 
 // Global variables (definition)
 Gtk::TreeView* connections_treeview = nullptr;
@@ -15,6 +39,9 @@ Gtk::Grid* info_grid = nullptr;
 Gtk::Label* host_value_label = nullptr;
 Gtk::Label* type_value_label = nullptr;
 Gtk::Label* port_value_label = nullptr;
+Gtk::Label* network_value_label = nullptr;
+Gtk::Label* link_value_label = nullptr;
+Gtk::Label* last_seen_value_label = nullptr;
 
 // Global MenuItems for Edit functionality
 Gtk::MenuItem* edit_folder_menu_item = nullptr;
@@ -30,15 +57,6 @@ Gtk::ToolButton* delete_connection_menu_item_toolbar = nullptr;
 Gtk::ToolButton* add_folder_menu_item_toolbar = nullptr;
 Gtk::ToolButton* add_connection_menu_item_toolbar = nullptr;
 
-// Track open connections and their tab indices
-std::map<std::string, int> open_connections; // Maps connection ID to tab index
-
-// Define the TerminalData struct
-struct TerminalData {
-    Gtk::Notebook* notebook;
-    int page_num;
-};
-
 // Helper function to create a Pixbuf from embedded PNG data
 Glib::RefPtr<Gdk::Pixbuf> create_pixbuf_from_data(const unsigned char* data, unsigned int len) {
     Glib::RefPtr<Gdk::PixbufLoader> loader = Gdk::PixbufLoader::create("png");
@@ -47,13 +65,35 @@ Glib::RefPtr<Gdk::Pixbuf> create_pixbuf_from_data(const unsigned char* data, uns
     return loader->get_pixbuf();
 }
 
+// Link health of the selected connection's open tab: the current tab when it belongs to the
+// connection, else its first one
+void update_link_info() {
+    if (!connections_treeview || !link_value_label || !last_seen_value_label) return;
+
+    LinkHealth::Status status;
+    Gtk::TreeModel::iterator iter = connections_treeview->get_selection()->get_selected();
+    if (iter && (*iter)[connection_columns.is_connection]) {
+        std::string id = static_cast<Glib::ustring>((*iter)[connection_columns.id]);
+        Session* session = SessionRegistry::current();
+        if (!session || session->connection_id != id) {
+            session = SessionRegistry::find_first_by_connection(id);
+        }
+        if (session) {
+            status = LinkHealth::get_status(*session);
+        }
+    }
+    link_value_label->set_text(LinkHealth::describe(status));
+    last_seen_value_label->set_text(LinkHealth::describe_last_seen(status));
+}
+
 // Function to handle selection changes in the TreeView
 void on_connection_selection_changed() {
-    if (!connections_treeview || !host_value_label || !type_value_label || !port_value_label) return; // Guard against null pointers
+    if (!connections_treeview || !host_value_label || !type_value_label || !port_value_label || !network_value_label) return; // Guard against null pointers
 
     Glib::RefPtr<Gtk::TreeSelection> selection = connections_treeview->get_selection();
     bool is_folder_selected = false;
     bool is_connection_selected = false;
+    Glib::ustring network_text;
 
     if (selection) {
         Gtk::TreeModel::iterator iter = selection->get_selected();
@@ -68,11 +108,25 @@ void on_connection_selection_changed() {
                 int port = row[connection_columns.port];
                 port_value_label->set_text(port > 0 ? std::to_string(port) : "");
                 is_connection_selected = true;
+
+                // Network profile in effect, and whether it comes from a folder
+                ConnectionInfo conn = ConnectionManager::get_connection_by_id(static_cast<Glib::ustring>(row[connection_columns.id]));
+                if (conn.connection_type == "SSH" || conn.connection_type == "Mosh") {
+                    std::string profile = NetworkProfiles::resolve(conn);
+                    network_text = profile.empty() ? "Default" : profile;
+                    if (!profile.empty() && conn.network_profile.empty()) {
+                        network_text += " (from folder)";
+                    }
+                }
             } else if (is_folder) {
                 host_value_label->set_text("Folder Selected");
                 type_value_label->set_text("");
                 port_value_label->set_text("");
                 is_folder_selected = true;
+
+                Glib::ustring profile = ConnectionManager::resolve_folder_setting(static_cast<Glib::ustring>(row[connection_columns.id]),
+                    [](const FolderInfo& folder) { return folder.network_profile; });
+                network_text = (profile.empty() || profile == "Default") ? "Default" : profile;
             } else {
                 host_value_label->set_text("");
                 type_value_label->set_text("");
@@ -88,6 +142,8 @@ void on_connection_selection_changed() {
         type_value_label->set_text("");
         port_value_label->set_text("");
     }
+    network_value_label->set_text(network_text);
+    update_link_info();
 
     // Update sensitivity of edit menu items
     if (edit_folder_menu_item) {
@@ -128,11 +184,28 @@ void update_connection_type_ui(
     Gtk::Entry& password_entry,
     Gtk::Label& domain_label,
     Gtk::Entry& domain_entry,
+    Gtk::Label& scrollback_label,
+    Gtk::SpinButton& scrollback_spin,
+    Gtk::Label& reconnect_label,
+    Gtk::ComboBoxText& reconnect_combo,
+    Gtk::Label& jump_host_label,
+    Gtk::ComboBoxText& jump_host_combo,
+    Gtk::Label& network_profile_label,
+    Gtk::ComboBoxText& network_profile_combo,
+    Gtk::CheckButton& record_check,
+    Gtk::CheckButton& local_echo_check,
+    Gtk::Label& mosh_port_label,
+    Gtk::Entry& mosh_port_entry,
+    Gtk::Label& mosh_server_label,
+    Gtk::Entry& mosh_server_entry,
+    Gtk::Label& tmux_label,
+    Gtk::Entry& tmux_entry,
     bool new_connection_flag
 )
 {
     const std::string conn_type = type_combo.get_active_text();
-    const bool is_ssh = (conn_type == "SSH");
+    const bool is_mosh = (conn_type == "Mosh");
+    const bool is_ssh = (conn_type == "SSH") || is_mosh; // Mosh logs in over SSH first
     const bool is_rdp = (conn_type == "RDP");
     auth_method_label.set_visible(is_ssh);
     auth_method_combo.set_visible(is_ssh);
@@ -161,6 +234,22 @@ void update_connection_type_ui(
     password_entry.set_visible(is_rdp || (is_ssh && auth_method_combo.get_active_text() == "Password"));
     domain_label.set_visible(is_rdp);
     domain_entry.set_visible(is_rdp);
+    scrollback_label.set_visible(!is_rdp);
+    scrollback_spin.set_visible(!is_rdp);
+    reconnect_label.set_visible(is_ssh);
+    reconnect_combo.set_visible(is_ssh);
+    jump_host_label.set_visible(is_ssh);
+    jump_host_combo.set_visible(is_ssh);
+    network_profile_label.set_visible(is_ssh);
+    network_profile_combo.set_visible(is_ssh);
+    record_check.set_visible(!is_rdp);
+    local_echo_check.set_visible(conn_type == "SSH"); // mosh has its own prediction
+    mosh_port_label.set_visible(is_mosh);
+    mosh_port_entry.set_visible(is_mosh);
+    mosh_server_label.set_visible(is_mosh);
+    mosh_server_entry.set_visible(is_mosh);
+    tmux_label.set_visible(conn_type == "SSH");
+    tmux_entry.set_visible(conn_type == "SSH");
 }
 
 // Function to handle adding, editing, or duplicating a connection
@@ -233,6 +322,7 @@ void process_connection_dialog(Gtk::Notebook& notebook, DialogPurpose purpose, c
     Gtk::ComboBoxText type_combo;
     type_combo.set_hexpand(true);
     type_combo.append("SSH", "SSH");
+    type_combo.append("Mosh", "Mosh");
     type_combo.append("Telnet", "Telnet");
     type_combo.append("VNC", "VNC");
     type_combo.append("RDP", "RDP");
@@ -389,6 +479,93 @@ void process_connection_dialog(Gtk::Notebook& notebook, DialogPurpose purpose, c
         ssh_key_passphrase_entry.set_text("");
     }
 
+    // Scrollback override (0 uses the global default from Preferences)
+    Gtk::Label scrollback_label("Scrollback Lines:", Gtk::ALIGN_START);
+    Gtk::SpinButton scrollback_spin;
+    scrollback_spin.set_range(0, 1000000);
+    scrollback_spin.set_increments(1000, 10000);
+    scrollback_spin.set_hexpand(true);
+    scrollback_spin.set_tooltip_text("Scrollback lines for this connection. 0 uses the default from Preferences.");
+    scrollback_spin.set_value(existing_connection ? existing_connection->scrollback_lines : 0);
+
+    // Auto Reconnect policy (empty ID inherits from the folder)
+    Gtk::Label reconnect_label("Auto Reconnect:", Gtk::ALIGN_START);
+    Gtk::ComboBoxText reconnect_combo;
+    reconnect_combo.set_hexpand(true);
+    reconnect_combo.append("", "Inherit from Folder");
+    reconnect_combo.append("Always", "Always");
+    reconnect_combo.append("Never", "Never");
+    reconnect_combo.set_active_id(existing_connection ? existing_connection->reconnect_policy : "");
+
+    // Jump host (ProxyJump) through another saved SSH connection (empty ID inherits from the folder)
+    Gtk::Label jump_host_label("Jump Host:", Gtk::ALIGN_START);
+    Gtk::ComboBoxText jump_host_combo;
+    jump_host_combo.set_hexpand(true);
+    jump_host_combo.set_tooltip_text("Reach this host through another saved SSH connection. "
+                                     "Sessions behind the same jump host share one connection to it.");
+    jump_host_combo.append("", "Inherit from Folder");
+    jump_host_combo.append("None", "None (Direct)");
+    for (const auto& candidate : ConnectionManager::load_connections()) {
+        if (candidate.connection_type != "SSH") continue;
+        if (existing_connection && purpose == DialogPurpose::EDIT && candidate.id == existing_connection->id) continue;
+        jump_host_combo.append(candidate.id, candidate.name);
+    }
+    jump_host_combo.set_active_id(existing_connection ? existing_connection->jump_host_id : "");
+
+    // Network profile tuning ssh for the link to the host (empty ID inherits from the folder)
+    Gtk::Label network_profile_label("Network Profile:", Gtk::ALIGN_START);
+    Gtk::ComboBoxText network_profile_combo;
+    network_profile_combo.set_hexpand(true);
+    network_profile_combo.append("", "Inherit from Folder");
+    network_profile_combo.append("Default", "Default (ssh settings)");
+    std::string network_profile_help = "Compression, ciphers, QoS and keepalives for the link to this host. "
+                                       "Options in SSH Flags take precedence.";
+    for (const auto& profile : NetworkProfiles::get_all()) {
+        network_profile_combo.append(profile.name, profile.name);
+        network_profile_help += "\n" + profile.name + ": " + profile.description;
+    }
+    network_profile_combo.set_tooltip_text(network_profile_help);
+    network_profile_combo.set_active_id(existing_connection ? existing_connection->network_profile : "");
+
+    // Record the terminal output of sessions opened from this connection
+    Gtk::CheckButton record_check("Record Sessions");
+    record_check.set_active(existing_connection && existing_connection->record_session);
+
+    // Speculative local echo for typing over slow links
+    Gtk::CheckButton local_echo_check("Predictive Local Echo");
+    local_echo_check.set_tooltip_text("Show typed characters underlined right away, before the remote host echoes them. "
+                                      "Turns itself off at password prompts and in full-screen applications.");
+    local_echo_check.set_active(existing_connection && existing_connection->local_echo);
+
+    // Mosh settings, both optional
+    Gtk::Label mosh_port_label("Mosh UDP Port:", Gtk::ALIGN_START);
+    Gtk::Entry mosh_port_entry;
+    mosh_port_entry.set_hexpand(true);
+    mosh_port_entry.set_placeholder_text("60000:61000");
+    mosh_port_entry.set_tooltip_text("UDP port or port range for mosh-server. Leave empty to let mosh-server choose.");
+    if (existing_connection) {
+        mosh_port_entry.set_text(existing_connection->mosh_port);
+    }
+
+    Gtk::Label mosh_server_label("Mosh Server:", Gtk::ALIGN_START);
+    Gtk::Entry mosh_server_entry;
+    mosh_server_entry.set_hexpand(true);
+    mosh_server_entry.set_placeholder_text("mosh-server");
+    mosh_server_entry.set_tooltip_text("Command that starts mosh-server on the remote host, e.g. when it is not in PATH.");
+    if (existing_connection) {
+        mosh_server_entry.set_text(existing_connection->mosh_server);
+    }
+
+    // tmux control mode: each window of the remote session opens in its own tab
+    Gtk::Label tmux_label("tmux Session:", Gtk::ALIGN_START);
+    Gtk::Entry tmux_entry;
+    tmux_entry.set_hexpand(true);
+    tmux_entry.set_placeholder_text("None (plain shell)");
+    tmux_entry.set_tooltip_text("Attach or create this tmux session in control mode (tmux -CC) and show its windows as tabs.");
+    if (existing_connection) {
+        tmux_entry.set_text(existing_connection->tmux_session);
+    }
+
     // Configure the grid layout
     grid->set_margin_start(12);
     grid->set_margin_end(12);
@@ -441,6 +618,31 @@ void process_connection_dialog(Gtk::Notebook& notebook, DialogPurpose purpose, c
     grid->attach(ssh_flags_label, 0, row, 1, 1);
     grid->attach(ssh_flags_entry, 1, row, 2, 1);
     row++;
+    grid->attach(mosh_port_label, 0, row, 1, 1);
+    grid->attach(mosh_port_entry, 1, row, 2, 1);
+    row++;
+    grid->attach(mosh_server_label, 0, row, 1, 1);
+    grid->attach(mosh_server_entry, 1, row, 2, 1);
+    row++;
+    grid->attach(tmux_label, 0, row, 1, 1);
+    grid->attach(tmux_entry, 1, row, 2, 1);
+    row++;
+    grid->attach(scrollback_label, 0, row, 1, 1);
+    grid->attach(scrollback_spin, 1, row, 2, 1);
+    row++;
+    grid->attach(reconnect_label, 0, row, 1, 1);
+    grid->attach(reconnect_combo, 1, row, 2, 1);
+    row++;
+    grid->attach(jump_host_label, 0, row, 1, 1);
+    grid->attach(jump_host_combo, 1, row, 2, 1);
+    row++;
+    grid->attach(network_profile_label, 0, row, 1, 1);
+    grid->attach(network_profile_combo, 1, row, 2, 1);
+    row++;
+    grid->attach(record_check, 1, row, 2, 1);
+    row++;
+    grid->attach(local_echo_check, 1, row, 2, 1);
+    row++;
 
     // Connect signals
     type_combo.signal_changed().connect([&]() {
@@ -459,6 +661,22 @@ void process_connection_dialog(Gtk::Notebook& notebook, DialogPurpose purpose, c
             password_entry,
             domain_label,
             domain_entry,
+            scrollback_label,
+            scrollback_spin,
+            reconnect_label,
+            reconnect_combo,
+            jump_host_label,
+            jump_host_combo,
+            network_profile_label,
+            network_profile_combo,
+            record_check,
+            local_echo_check,
+            mosh_port_label,
+            mosh_port_entry,
+            mosh_server_label,
+            mosh_server_entry,
+            tmux_label,
+            tmux_entry,
             new_connection_flag
         );
     });
@@ -479,6 +697,22 @@ void process_connection_dialog(Gtk::Notebook& notebook, DialogPurpose purpose, c
             password_entry,
             domain_label,
             domain_entry,
+            scrollback_label,
+            scrollback_spin,
+            reconnect_label,
+            reconnect_combo,
+            jump_host_label,
+            jump_host_combo,
+            network_profile_label,
+            network_profile_combo,
+            record_check,
+            local_echo_check,
+            mosh_port_label,
+            mosh_port_entry,
+            mosh_server_label,
+            mosh_server_entry,
+            tmux_label,
+            tmux_entry,
             new_connection_flag
         );
     });
@@ -502,6 +736,22 @@ void process_connection_dialog(Gtk::Notebook& notebook, DialogPurpose purpose, c
         password_entry,
         domain_label,
         domain_entry,
+        scrollback_label,
+        scrollback_spin,
+        reconnect_label,
+        reconnect_combo,
+        jump_host_label,
+        jump_host_combo,
+        network_profile_label,
+        network_profile_combo,
+        record_check,
+        local_echo_check,
+        mosh_port_label,
+        mosh_port_entry,
+        mosh_server_label,
+        mosh_server_entry,
+        tmux_label,
+        tmux_entry,
         new_connection_flag
     );
 
@@ -527,11 +777,18 @@ void process_connection_dialog(Gtk::Notebook& notebook, DialogPurpose purpose, c
         new_connection.username = user_entry.get_text();
         new_connection.connection_type = type_combo.get_active_text();
         new_connection.folder_id = folder_combo.get_active_id();
+        new_connection.scrollback_lines = (new_connection.connection_type == "RDP") ? 0 : scrollback_spin.get_value_as_int();
+        new_connection.record_session = (new_connection.connection_type != "RDP") && record_check.get_active();
+        new_connection.local_echo = (new_connection.connection_type == "SSH") && local_echo_check.get_active();
+        new_connection.tmux_session = (new_connection.connection_type == "SSH") ? tmux_entry.get_text() : "";
 
         // Set auth method and credentials based on connection type
-        if (new_connection.connection_type == "SSH") {
+        if (new_connection.connection_type == "SSH" || new_connection.connection_type == "Mosh") {
             new_connection.auth_method = auth_method_combo.get_active_text();
             new_connection.additional_ssh_options = ssh_flags_entry.get_text();
+            new_connection.reconnect_policy = reconnect_combo.get_active_id();
+            new_connection.jump_host_id = jump_host_combo.get_active_id();
+            new_connection.network_profile = network_profile_combo.get_active_id();
 
             if (new_connection.auth_method == "Password") {
                 new_connection.password = password_entry.get_text();
@@ -543,6 +800,13 @@ void process_connection_dialog(Gtk::Notebook& notebook, DialogPurpose purpose, c
                 new_connection.ssh_key_passphrase = ssh_key_passphrase_entry.get_text();
             }
             new_connection.domain = ""; // Clear domain for non-RDP
+            if (new_connection.connection_type == "Mosh") {
+                new_connection.mosh_port = mosh_port_entry.get_text();
+                new_connection.mosh_server = mosh_server_entry.get_text();
+            } else {
+                new_connection.mosh_port = "";
+                new_connection.mosh_server = "";
+            }
         } else if (new_connection.connection_type == "RDP") {
             // For RDP, save password and domain, clear SSH specific fields
             new_connection.password = password_entry.get_text();
@@ -551,6 +815,11 @@ void process_connection_dialog(Gtk::Notebook& notebook, DialogPurpose purpose, c
             new_connection.auth_method = "";
             new_connection.ssh_key_path = "";
             new_connection.ssh_key_passphrase = "";
+            new_connection.reconnect_policy = "";
+            new_connection.jump_host_id = "";
+            new_connection.network_profile = "";
+            new_connection.mosh_port = "";
+            new_connection.mosh_server = "";
         } else {
             // Clear all SSH specific fields for other connection types
             new_connection.additional_ssh_options = "";
@@ -559,6 +828,11 @@ void process_connection_dialog(Gtk::Notebook& notebook, DialogPurpose purpose, c
             new_connection.ssh_key_path = "";
             new_connection.ssh_key_passphrase = "";
             new_connection.domain = "";
+            new_connection.reconnect_policy = "";
+            new_connection.jump_host_id = "";
+            new_connection.network_profile = "";
+            new_connection.mosh_port = "";
+            new_connection.mosh_server = "";
         }
 
         if (new_connection.name.empty() || new_connection.host.empty() || new_connection.connection_type.empty()) {
@@ -684,8 +958,8 @@ void add_connection_dialog(Gtk::Notebook& notebook) {
     process_connection_dialog(notebook, DialogPurpose::ADD);
 }
 
-// Function to launch an RDP session
-void launch_rdp_session(Gtk::Notebook& notebook, const std::string& server, const std::string& username, const std::string& password, const std::string& domain) {
+// Function to launch an RDP session inside an existing session page
+void launch_rdp_session(Gtk::Notebook& notebook, Session& session, const std::string& server, const std::string& username, const std::string& password, const std::string& domain, bool foreground) {
     // Get the notebook's allocation for dimensions
     auto allocation = notebook.get_allocation();
     int width = allocation.get_width();
@@ -697,8 +971,8 @@ void launch_rdp_session(Gtk::Notebook& notebook, const std::string& server, cons
     if (width < 800) width = 1024;
     if (height < 600) height = 768;
 
-    // Create a new tab for the RDP session
-    Gtk::Box* rdp_box = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_VERTICAL));
+    // The session page hosts the RDP socket
+    Gtk::Box* rdp_box = session.page;
 
     // Create the RDP session with domain if provided
     Gtk::Socket* rdp_socket = nullptr;
@@ -716,33 +990,196 @@ void launch_rdp_session(Gtk::Notebook& notebook, const std::string& server, cons
         std::cout << "Password provided (length: " << password.length() << ")" << std::endl;
     }
 
-    rdp_socket = Rdp::create_rdp_session(*rdp_box, server, effective_username, password, width, height);
+    // Record the viewer PID on the session so its exit closes only this tab.
+    // Look the session up again by page, it may have been closed before the viewer started.
+    GtkWidget* page_widget = GTK_WIDGET(rdp_box->gobj());
+    rdp_socket = Rdp::create_rdp_session(*rdp_box, server, effective_username, password, width, height,
+        [page_widget](GPid pid) {
+            if (Session* started = SessionRegistry::find_by_widget(page_widget)) {
+                started->pid = pid;
+            }
+        });
 
     if (rdp_socket) {
-        // Add the socket to the box
+        // Add the socket to the session page
         rdp_box->pack_start(*rdp_socket, Gtk::PACK_EXPAND_WIDGET);
-
-        // Add to notebook and get the page number
-        int page_num = notebook.append_page(*rdp_box, "RDP: " + server);
-        notebook.set_current_page(page_num);
-
-        // Connect to the RDP process exit signal using the singleton
-        Rdp::instance()->signal_process_exit().connect([&notebook, rdp_box, page_num]() {
-            // Use idle to ensure we're in the main thread
-            Glib::signal_idle().connect_once([&notebook, rdp_box, page_num]() {
-                // Find the page number again in case tabs were reordered
-                int current_page = notebook.page_num(*rdp_box);
-                if (current_page != -1) {
-                    notebook.remove_page(current_page);
-                }
-            });
-        });
+        if (foreground) {
+            SessionRegistry::present(session);
+        }
 
         // Show all widgets
         rdp_box->show_all();
     }
 }
 
+// Open a saved connection in a new tab and register it as a session
+Session* open_connection(Gtk::Notebook& notebook, const ConnectionInfo& conn) {
+    Session* session = SessionRegistry::create(conn.id.raw(), conn.name, conn.connection_type);
+    if (!session) return nullptr;
+
+    start_session(notebook, *session, conn, true);
+    return session;
+}
+
+// Fill an empty session page with the terminal or RDP viewer for the connection and start it.
+// Background starts (session restore) leave the current tab and focus alone.
+void start_session(Gtk::Notebook& notebook, Session& session, const ConnectionInfo& conn, bool foreground) {
+    if (conn.connection_type == "RDP") {
+        // Launch the RDP session with domain if available
+        launch_rdp_session(notebook, session, conn.host, conn.username, conn.password, conn.domain, foreground);
+        return;
+    }
+
+    // Create new terminal for the connection
+    GtkWidget* terminal = vte_terminal_new();
+
+    // Add terminal to the session page
+    Gtk::Widget* term_widget = Gtk::manage(Glib::wrap(terminal));
+    session.page->pack_start(*term_widget, Gtk::PACK_EXPAND_WIDGET);
+    SessionRegistry::set_terminal(session, VTE_TERMINAL(terminal));
+    term_widget->show();
+
+    // Scrollback size is governed by the global budget
+    Scrollback::attach(session, conn.scrollback_lines, foreground);
+
+    if (foreground) {
+        // Force UI update
+        while (Gtk::Main::events_pending()) {
+            Gtk::Main::iteration();
+        }
+
+        // Make sure the new tab is visible and selected, and the terminal has focus
+        SessionRegistry::present(session);
+    }
+
+    // Child output passes through the relay so it can be observed (recording etc.)
+    PtyRelay* relay = PtyRelay::attach(VTE_TERMINAL(terminal));
+    relay->signal_child_exited().connect([terminal](int status) {
+        on_terminal_child_exited(terminal, status, nullptr);
+    });
+
+    if (conn.record_session || Config::get_record_sessions()) {
+        Recording::start(session);
+    }
+    Triggers::attach(session);
+    Paste::attach(session);
+    LocalEcho::attach(session, conn.connection_type == "SSH" && conn.local_echo);
+    if (!conn.tmux_session.empty()) {
+        Tmux::attach(session);
+    }
+
+    // Allow this terminal to take part in input broadcasting
+    Broadcast::attach_terminal(VTE_TERMINAL(terminal));
+
+    // Handle different connection types
+    if (conn.connection_type == "SSH") {
+        if (!Tools::is_available("ssh")) {
+            const char* message = "\033[1;31mssh is not installed.\033[0m Install the OpenSSH client to use SSH connections.\r\n";
+            vte_terminal_feed(VTE_TERMINAL(terminal), message, strlen(message));
+            on_terminal_child_exited(terminal, W_EXITCODE(127, 0), nullptr);
+            return;
+        }
+        session.argv = Ssh::generate_ssh_command_args(conn);
+        session.auto_reconnect = ConnectionManager::get_auto_reconnect(conn);
+        if (!session.argv.empty()) {
+            spawn_session_command(session);
+        } else {
+            std::cerr << "Error: Empty command args for SSH connection" << std::endl;
+        }
+    } else if (conn.connection_type == "Mosh") {
+        if (!Ssh::is_mosh_available()) {
+            const char* message = "\033[1;31mmosh is not installed.\033[0m Install the mosh package to use Mosh connections.\r\n";
+            vte_terminal_feed(VTE_TERMINAL(terminal), message, strlen(message));
+            on_terminal_child_exited(terminal, W_EXITCODE(127, 0), nullptr);
+            return;
+        }
+        // mosh roams and rides out outages by itself; reconnect only restarts a failed bootstrap
+        session.argv = Ssh::generate_mosh_command_args(conn);
+        session.auto_reconnect = ConnectionManager::get_auto_reconnect(conn);
+        spawn_session_command(session);
+    } else if (conn.connection_type == "tmux") {
+        // Local tmux in control mode, not a saved connection type
+        session.argv = Tmux::local_command_args(conn.tmux_session);
+        spawn_session_command(session);
+    }
+}
+
+// Attach the session to one the PTY helper kept running for the same connection
+bool adopt_surviving_session(Session& session, PtyRelay& relay) {
+    if (session.connection_id.empty() || !PtyHelper::is_enabled()) return false;
+
+    for (const auto& survivor : PtyHelper::get_survivors()) {
+        if (survivor.connection_id != session.connection_id || !PtyHelper::claim(survivor.id)) continue;
+
+        const char* notice = survivor.running
+            ? "\033[2m[ngTerm] Reattached to the running session\033[0m\r\n"
+            : "\033[2m[ngTerm] This session ended while ngTerm was closed\033[0m\r\n";
+        vte_terminal_feed(session.terminal, notice, strlen(notice));
+        relay.adopt(survivor.id);
+        return true;
+    }
+    return false;
+}
+
+// Open tabs for sessions the PTY helper kept running that no restored tab takes over
+void open_surviving_sessions(Gtk::Notebook& notebook) {
+    if (!PtyHelper::is_enabled()) return;
+
+    // Placeholder tabs claim a survivor of their connection once they are started
+    std::unordered_map<std::string, size_t> waiting_tabs;
+    for (const auto& survivor : PtyHelper::get_survivors()) {
+        if (survivor.connection_id.empty()) continue;
+        if (!waiting_tabs.count(survivor.connection_id)) {
+            size_t placeholders = 0;
+            for (Session* session : SessionRegistry::find_by_connection(survivor.connection_id)) {
+                if (session->placeholder) ++placeholders;
+            }
+            waiting_tabs[survivor.connection_id] = placeholders;
+        }
+        size_t& waiting = waiting_tabs[survivor.connection_id];
+        if (waiting > 0) {
+            --waiting;
+            continue;
+        }
+
+        ConnectionInfo conn = ConnectionManager::get_connection_by_id(survivor.connection_id);
+        if (conn.id.empty()) {
+            // The connection was deleted meanwhile; there is nothing to reattach it to
+            if (PtyHelper::claim(survivor.id)) {
+                PtyHelper::hangup(survivor.id);
+            }
+            continue;
+        }
+        Session* session = SessionRegistry::create(conn.id.raw(), conn.name, conn.connection_type);
+        if (session) {
+            start_session(notebook, *session, conn, false);
+        }
+    }
+}
+
+// Spawn the session's command in its terminal. Used for the first start and for
+// reconnects, so the same terminal and its scrollback are reused.
+void spawn_session_command(Session& session) {
+    if (!session.terminal || session.argv.empty()) return;
+
+    session.child_exited = false;
+    session.spawned_at = g_get_monotonic_time();
+
+    PtyRelay* relay = PtyRelay::get(session.terminal);
+    if (relay && adopt_surviving_session(session, *relay)) return;
+
+    // Tabs of saved connections can outlive ngTerm in the PTY helper. tmux control
+    // mode sessions are left out, tmux keeps its sessions alive by itself.
+    std::string tag;
+    if (!session.connection_id.empty() && session.connection_type != "tmux") {
+        tag = PtyHelper::make_tag(session.connection_id, session.title);
+    }
+    if (!relay || !relay->spawn(session.argv, tag)) {
+        std::cerr << "Error: Could not start the session command" << std::endl;
+        on_terminal_child_exited(GTK_WIDGET(session.terminal), W_EXITCODE(127, 0), nullptr);
+    }
+}
+
 // Function to handle deleting a connection
 void delete_connection_dialog(Gtk::Notebook& notebook, const Glib::ustring& conn_id, const Glib::ustring& conn_name) {
     Gtk::Window* parent_window = dynamic_cast<Gtk::Window*>(notebook.get_toplevel());
@@ -784,7 +1221,30 @@ void build_menu(Gtk::Window& parent_window, Gtk::MenuBar& menubar, Gtk::Notebook
     Gtk::MenuItem* duplicate_connection_item = Gtk::manage(new Gtk::MenuItem("Duplicate Connection"));
     Gtk::MenuItem* delete_connection_item = Gtk::manage(new Gtk::MenuItem("Delete Connection"));
     Gtk::MenuItem* preferences_item = Gtk::manage(new Gtk::MenuItem("Preferences"));
+    Gtk::MenuItem* triggers_item = Gtk::manage(new Gtk::MenuItem("Output Triggers..."));
+    Gtk::MenuItem* tunnels_item = Gtk::manage(new Gtk::MenuItem("Tunnels..."));
     Gtk::MenuItem* exit_item = Gtk::manage(new Gtk::MenuItem("_Exit", true));
+    Gtk::Menu* broadcast_submenu = Gtk::manage(new Gtk::Menu());
+    Gtk::MenuItem* broadcast_menu_item = Gtk::manage(new Gtk::MenuItem("Broadcast"));
+    Gtk::MenuItem* broadcast_toggle_item = Gtk::manage(new Gtk::MenuItem("Toggle Broadcast for Current Tab"));
+    Gtk::MenuItem* broadcast_all_item = Gtk::manage(new Gtk::MenuItem("Broadcast to All Open Terminals"));
+    Gtk::MenuItem* broadcast_clear_item = Gtk::manage(new Gtk::MenuItem("Stop Broadcasting"));
+    Gtk::Menu* session_submenu = Gtk::manage(new Gtk::Menu());
+    Gtk::MenuItem* session_menu_item = Gtk::manage(new Gtk::MenuItem("Session"));
+    Gtk::MenuItem* record_start_item = Gtk::manage(new Gtk::MenuItem("Start Recording Current Tab"));
+    Gtk::MenuItem* record_stop_item = Gtk::manage(new Gtk::MenuItem("Stop Recording Current Tab"));
+    Gtk::MenuItem* replay_item = Gtk::manage(new Gtk::MenuItem("Replay Recording..."));
+    Gtk::MenuItem* search_all_item = Gtk::manage(new Gtk::MenuItem("Search All Tabs..."));
+    Gtk::MenuItem* monitor_activity_item = Gtk::manage(new Gtk::MenuItem("Toggle Activity Monitor for Current Tab"));
+    Gtk::MenuItem* monitor_silence_item = Gtk::manage(new Gtk::MenuItem("Toggle Silence Monitor for Current Tab"));
+    Gtk::MenuItem* local_echo_item = Gtk::manage(new Gtk::MenuItem("Toggle Local Echo for Current Tab"));
+    Gtk::MenuItem* tmux_local_item = Gtk::manage(new Gtk::MenuItem("Attach Local tmux Session"));
+    Gtk::MenuItem* sftp_item = Gtk::manage(new Gtk::MenuItem("Browse Files (SFTP)"));
+    Gtk::Menu* fleet_submenu = Gtk::manage(new Gtk::Menu());
+    Gtk::MenuItem* fleet_menu_item = Gtk::manage(new Gtk::MenuItem("Fleet"));
+    Gtk::MenuItem* push_item = Gtk::manage(new Gtk::MenuItem("Push Files to Selection..."));
+    Gtk::MenuItem* exec_item = Gtk::manage(new Gtk::MenuItem("Run Command on Selection..."));
+    Gtk::MenuItem* host_keys_item = Gtk::manage(new Gtk::MenuItem("Fetch Host Keys..."));
     Gtk::MenuItem* help_menu_item = Gtk::manage(new Gtk::MenuItem("Help"));
     Gtk::MenuItem* about_item = Gtk::manage(new Gtk::MenuItem("About"));
     Gtk::SeparatorMenuItem* separator1 = Gtk::manage(new Gtk::SeparatorMenuItem());
@@ -808,18 +1268,159 @@ void build_menu(Gtk::Window& parent_window, Gtk::MenuBar& menubar, Gtk::Notebook
     options_submenu->append(*delete_connection_item);
     options_submenu->append(*separator1);
     options_submenu->append(*preferences_item);
+    options_submenu->append(*triggers_item);
+    options_submenu->append(*tunnels_item);
     options_submenu->append(*separator2);
     exit_item->signal_activate().connect([](){
         gtk_main_quit();
     });
     options_submenu->append(*exit_item);
 
+    broadcast_menu_item->set_submenu(*broadcast_submenu);
+    broadcast_submenu->append(*broadcast_toggle_item);
+    broadcast_submenu->append(*broadcast_all_item);
+    broadcast_submenu->append(*broadcast_clear_item);
+
+    session_menu_item->set_submenu(*session_submenu);
+    session_submenu->append(*record_start_item);
+    session_submenu->append(*record_stop_item);
+    session_submenu->append(*replay_item);
+    session_submenu->append(*search_all_item);
+    session_submenu->append(*monitor_activity_item);
+    session_submenu->append(*monitor_silence_item);
+    session_submenu->append(*local_echo_item);
+    session_submenu->append(*tmux_local_item);
+    session_submenu->append(*sftp_item);
+
+    fleet_menu_item->set_submenu(*fleet_submenu);
+    fleet_submenu->append(*push_item);
+    fleet_submenu->append(*exec_item);
+    fleet_submenu->append(*host_keys_item);
+
     help_menu_item->set_submenu(*help_submenu);
     help_submenu->append(*about_item);
 
     menubar.append(*options_menu_item);
+    menubar.append(*broadcast_menu_item);
+    menubar.append(*session_menu_item);
+    menubar.append(*fleet_menu_item);
     menubar.append(*help_menu_item);
 
+    // Broadcast handlers: only VTE pages can join the group (RDP pages are skipped)
+    broadcast_toggle_item->signal_activate().connect([]() {
+        Session* session = SessionRegistry::current();
+        if (session && session->terminal) {
+            Broadcast::toggle_target(session->terminal);
+        }
+    });
+
+    broadcast_all_item->signal_activate().connect([]() {
+        for (Session* session : SessionRegistry::all()) {
+            if (session->terminal) {
+                Broadcast::add_target(session->terminal);
+            }
+        }
+    });
+
+    broadcast_clear_item->signal_activate().connect([]() {
+        Broadcast::clear();
+    });
+
+    // Recording handlers: only terminal pages have an output stream to record
+    record_start_item->signal_activate().connect([]() {
+        Session* session = SessionRegistry::current();
+        if (session && session->terminal) {
+            Recording::start(*session);
+        }
+    });
+
+    record_stop_item->signal_activate().connect([]() {
+        Session* session = SessionRegistry::current();
+        if (session) {
+            Recording::stop(*session);
+        }
+    });
+
+    replay_item->signal_activate().connect([&parent_window]() {
+        Replay::choose_and_open(parent_window);
+    });
+
+    search_all_item->signal_activate().connect([&parent_window]() {
+        Search::show_window(parent_window);
+    });
+
+    triggers_item->signal_activate().connect([&parent_window]() {
+        Triggers::show_dialog(parent_window);
+    });
+
+    tunnels_item->signal_activate().connect([&parent_window]() {
+        Tunnels::show_window(parent_window);
+    });
+
+    monitor_activity_item->signal_activate().connect([]() {
+        Session* session = SessionRegistry::current();
+        if (session && session->terminal) {
+            Monitor::toggle_activity(*session);
+        }
+    });
+
+    monitor_silence_item->signal_activate().connect([]() {
+        Session* session = SessionRegistry::current();
+        if (session && session->terminal) {
+            Monitor::toggle_silence(*session);
+        }
+    });
+
+    local_echo_item->signal_activate().connect([]() {
+        Session* session = SessionRegistry::current();
+        if (session && session->terminal) {
+            LocalEcho::toggle(*session);
+        }
+    });
+
+    tmux_local_item->signal_activate().connect([&notebook]() {
+        ConnectionInfo conn;
+        conn.name = "tmux (local)";
+        conn.connection_type = "tmux";
+        conn.tmux_session = "ngterm";
+        Session* session = SessionRegistry::create("", conn.name, conn.connection_type);
+        if (session) {
+            start_session(notebook, *session, conn, true);
+        }
+    });
+
+    // Fleet actions work on the SSH hosts of the tree selection
+    push_item->signal_activate().connect([&parent_window]() {
+        Push::show_window(parent_window);
+    });
+    exec_item->signal_activate().connect([&parent_window]() {
+        Exec::show_window(parent_window);
+    });
+    host_keys_item->signal_activate().connect([&parent_window]() {
+        HostKeys::show_window(parent_window);
+    });
+
+    // SFTP browser for the connection selected in the tree
+    sftp_item->signal_activate().connect([&parent_window]() {
+        if (!connections_treeview) return;
+        Gtk::TreeModel::iterator iter = connections_treeview->get_selection()->get_selected();
+        Glib::ustring error;
+        if (!iter || (*iter)[connection_columns.is_folder]) {
+            error = "Please select an SSH connection to browse.";
+        } else {
+            ConnectionInfo conn = ConnectionManager::get_connection_by_id((*iter)[connection_columns.id]);
+            std::string open_error;
+            if (!Sftp::open(conn, open_error)) {
+                error = open_error;
+            }
+        }
+        if (!error.empty()) {
+            Gtk::MessageDialog error_dialog(parent_window, "Cannot Browse Files", false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
+            error_dialog.set_secondary_text(error);
+            error_dialog.run();
+        }
+    });
+
     add_folder_item->signal_activate().connect([&parent_window, &connections_treeview_ref, &liststore_ref, &columns_ref]() {
         FolderOps::add_folder(parent_window, connections_treeview_ref, liststore_ref, columns_ref);
     });
@@ -848,7 +1449,9 @@ void build_menu(Gtk::Window& parent_window, Gtk::MenuBar& menubar, Gtk::Notebook
     );
 
     preferences_item->signal_activate().connect([&parent_window]() {
-        Config::show_preferences_dialog(parent_window);
+        if (Config::show_preferences_dialog(parent_window)) {
+            Scrollback::rebalance();
+        }
     });
 
     // Connect About handler
@@ -1054,48 +1657,34 @@ void populate_connections_treeview(Glib::RefPtr<Gtk::TreeStore>& liststore, Conn
 
 // C-style callback for key press event
 gboolean on_terminal_key_press(GtkWidget* widget, GdkEventKey* event, gpointer user_data) {
-    TerminalData* td = static_cast<TerminalData*>(user_data);
-
-    // Schedule cleanup for the next idle moment
+    // Schedule cleanup for the next idle moment; look the session up again by widget
+    // since it may already be gone when the idle callback runs
     g_idle_add([](gpointer data) -> gboolean {
-        TerminalData* td = static_cast<TerminalData*>(data);
-        if (td->notebook && td->notebook->get_n_pages() > td->page_num) {
-            Gtk::Widget* page_widget = td->notebook->get_nth_page(td->page_num);
-            if (page_widget) {
-                // Remove the connection from our tracking map
-                for (auto it = open_connections.begin(); it != open_connections.end(); ) {
-                    if (it->second == td->page_num) {
-                        it = open_connections.erase(it);
-                    } else {
-                        // Update indices for tabs that come after this one
-                        if (it->second > td->page_num) {
-                            it->second--;
-                        }
-                        ++it;
-                    }
-                }
-                td->notebook->remove_page(td->page_num);
-            }
+        if (Session* session = SessionRegistry::find_by_widget(static_cast<GtkWidget*>(data))) {
+            SessionRegistry::close(*session);
         }
-        delete td;
         return G_SOURCE_REMOVE;
-    }, td);
+    }, widget);
 
     return TRUE; // Stop event propagation
 }
 
 // Callback function for VTE's "child-exited" signal
 void on_terminal_child_exited(GtkWidget* widget, gint status, gpointer user_data) {
-    TerminalData* term_data = static_cast<TerminalData*>(user_data);
-    if (!term_data) return;
-
-    // Display a message in the terminal
-    VteTerminal* terminal = VTE_TERMINAL(widget);
-    const char* exit_message = "\r\n\033[1;31mProcess completed.\033[0m Press any key to close this terminal...\r\n";
-    vte_terminal_feed(terminal, exit_message, strlen(exit_message));
+    Session* session = SessionRegistry::find_by_widget(widget);
+    if (!session || session->child_exited) return;
+    session->child_exited = true;
+
+    // Reconnect prints its own progress message when it schedules a respawn
+    if (!Reconnect::schedule(*session, status)) {
+        // Display a message in the terminal
+        VteTerminal* terminal = VTE_TERMINAL(widget);
+        const char* exit_message = "\r\n\033[1;31mProcess completed.\033[0m Press any key to close this terminal...\r\n";
+        vte_terminal_feed(terminal, exit_message, strlen(exit_message));
+    }
 
     // Connect a key press event to close the terminal when any key is pressed
-    g_signal_connect(widget, "key-press-event", G_CALLBACK(on_terminal_key_press), term_data);
+    session->close_key_handler = g_signal_connect(widget, "key-press-event", G_CALLBACK(on_terminal_key_press), nullptr);
 
     // Ensure focus is on the terminal so it can receive key events
     gtk_widget_grab_focus(widget);
@@ -1125,11 +1714,24 @@ void save_frame_width(Gtk::Window& window) {
 }
 
 int main(int argc, char* argv[]) {
+    // ngTerm is its own askpass helper when it loads a key into the agent
+    if (Agent::answer_askpass(argc, argv)) {
+        return 0;
+    }
+
     // Initialize the GTK+ application
     Gtk::Main kit(argc, argv);
 
+    // Writes to an ssh that exited (tunnels, SFTP) must fail with EPIPE instead of ending ngTerm
+    signal(SIGPIPE, SIG_IGN);
+
     // Initialize configuration
     Config::init();
+    Agent::start();
+
+    // Find ssh, sshpass, mosh, tmux and FreeRDP in the background; connecting only waits
+    // for the PATH lookup, never for a shell
+    Tools::start();
 
     // Create the main window
     Gtk::Window window;
@@ -1167,6 +1769,15 @@ int main(int argc, char* argv[]) {
     type_value_label->set_hexpand(true);
     type_value_label->set_xalign(0.0f);
 
+    network_value_label = new Gtk::Label("", Gtk::ALIGN_START);
+    network_value_label->set_xalign(0.0f);
+
+    link_value_label = new Gtk::Label("", Gtk::ALIGN_START);
+    link_value_label->set_xalign(0.0f);
+
+    last_seen_value_label = new Gtk::Label("", Gtk::ALIGN_START);
+    last_seen_value_label->set_xalign(0.0f);
+
     port_value_label = new Gtk::Label("", Gtk::ALIGN_START);
     port_value_label->set_line_wrap(true);
     port_value_label->set_line_wrap_mode(Pango::WRAP_WORD_CHAR);
@@ -1181,8 +1792,20 @@ int main(int argc, char* argv[]) {
     // Create MenuBar
     Gtk::MenuBar menubar;
 
-    // Create notebook
+    // Create notebook and bind the session registry to it
     Gtk::Notebook notebook;
+    SessionRegistry::init(notebook);
+    SessionRestore::track(notebook);
+    Scrollback::track(notebook);
+    Recording::track(notebook);
+    Replay::track(notebook);
+    Sftp::track(notebook);
+    Triggers::track(notebook);
+    Monitor::track(notebook);
+    LinkHealth::track(notebook);
+    Paste::track(notebook);
+    LocalEcho::track(notebook);
+    Tmux::track(notebook);
 
     // Create TreeView references
     Glib::RefPtr<Gtk::TreeStore> connections_liststore;
@@ -1404,6 +2027,25 @@ int main(int argc, char* argv[]) {
     info_grid->attach(port_label, 0, 2, 1, 1);
     info_grid->attach(*port_value_label, 1, 2, 1, 1);
 
+    Gtk::Label network_label("Network", Gtk::ALIGN_START, Gtk::ALIGN_START);
+    network_label.set_markup("<b>Network:</b>");
+    info_grid->attach(network_label, 0, 3, 1, 1);
+    info_grid->attach(*network_value_label, 1, 3, 1, 1);
+
+    Gtk::Label link_label("Link", Gtk::ALIGN_START, Gtk::ALIGN_START);
+    link_label.set_markup("<b>Link:</b>");
+    info_grid->attach(link_label, 0, 4, 1, 1);
+    info_grid->attach(*link_value_label, 1, 4, 1, 1);
+
+    Gtk::Label last_seen_label("Last Seen", Gtk::ALIGN_START, Gtk::ALIGN_START);
+    last_seen_label.set_markup("<b>Last Seen:</b>");
+    info_grid->attach(last_seen_label, 0, 5, 1, 1);
+    info_grid->attach(*last_seen_value_label, 1, 5, 1, 1);
+
+    // Probe results and tab switches change which numbers apply
+    LinkHealth::signal_updated().connect(sigc::ptr_fun(&update_link_info));
+    notebook.signal_switch_page().connect([](Gtk::Widget*, guint) { update_link_info(); });
+
     // Add vertical spacing between rows
     info_grid->set_row_spacing(10); // 10 pixels between rows
     info_grid->set_column_spacing(10); // 10 pixels between columns
@@ -1450,122 +2092,35 @@ int main(int argc, char* argv[]) {
 
             if (is_connection) {
                 Glib::ustring conn_id = row[connection_columns.id];
-                Glib::ustring conn_name = row[connection_columns.name];
 
                 // Check if this connection is already open
                 if (!Config::get_always_new_connection()) {
-                    // Try to find an existing tab for this connection
-                    for (int i = 0; i < notebook.get_n_pages(); ++i) {
-                        Gtk::Widget* page = notebook.get_nth_page(i);
-                        Glib::ustring tab_text = notebook.get_tab_label_text(*page);
-
-                        // If we find a matching tab, switch to it and return
-                        if (tab_text == conn_name) {
-                            notebook.set_current_page(i);
-                            // Get the terminal widget and focus it
-                            if (Gtk::Widget* page = notebook.get_nth_page(i)) {
-                                if (GtkWidget* terminal = GTK_WIDGET(VTE_TERMINAL(page->gobj()))) {
-                                    gtk_widget_grab_focus(terminal);
-                                }
-                            }
-                            return;
-                        }
+                    if (Session* existing = SessionRegistry::find_first_by_connection(conn_id.raw())) {
+                        SessionRegistry::present(*existing);
+                        return;
                     }
                 }
-                // Create new terminal for the connection
-                GtkWidget* terminal = vte_terminal_new();
-                vte_terminal_set_scrollback_lines(VTE_TERMINAL(terminal), 10000);
 
                 // Load the full saved connection details
-                std::vector<ConnectionInfo> saved_connections = ConnectionManager::load_connections();
-                auto conn_it = std::find_if(saved_connections.begin(), saved_connections.end(),
-                    [&conn_id](const ConnectionInfo& ci) { return ci.id == conn_id; });
-
-                if (conn_it == saved_connections.end()) {
+                ConnectionInfo conn_info = ConnectionManager::get_connection_by_id(conn_id);
+                if (conn_info.id.empty()) {
                     std::cerr << "Error: Could not find connection details for ID: " << conn_id << std::endl;
                     return;
                 }
 
-                // Create tab label with connection name
-                Gtk::Label* label = Gtk::manage(new Gtk::Label(conn_name, Gtk::ALIGN_START));
-                // Create terminal data for cleanup
-                TerminalData* term_data = new TerminalData();
-                term_data->notebook = &notebook;
-
-                // Add terminal to notebook in new tab
-                Gtk::Widget* term_widget = Gtk::manage(Glib::wrap(terminal));
-                int page_num = notebook.append_page(*term_widget, *label);
-                term_data->page_num = page_num;
-
-                // Show all widgets
-                notebook.show_all();
-                term_widget->show();
-
-                // Force UI update
-                while (Gtk::Main::events_pending()) {
-                    Gtk::Main::iteration();
-                }
-
-                // Make sure the new tab is visible and selected
-                notebook.set_current_page(page_num);
-
-                // Ensure the terminal has focus
-                gtk_widget_grab_focus(terminal);
-
-                // Store the connection in our tracking map
-                open_connections[conn_id.raw()] = page_num;
-
-                // Connect to child-exited signal to handle cleanup
-                g_signal_connect(terminal, "child-exited", G_CALLBACK(on_terminal_child_exited), term_data);
-
-                // Handle different connection types
-                if (conn_it->connection_type == "SSH") {
-                    std::vector<std::string> command_args = Ssh::generate_ssh_command_args(*conn_it);
-                    if (!command_args.empty()) {
-                        std::vector<char*> argv;
-                        for (const auto& arg : command_args) {
-                            argv.push_back(const_cast<char*>(arg.c_str()));
-                        }
-                        argv.push_back(nullptr);
-
-                        // Set up the terminal
-                        char** env = g_get_environ();
-                        vte_terminal_spawn_async(
-                            VTE_TERMINAL(terminal),
-                            VTE_PTY_DEFAULT,
-                            nullptr,     // working directory
-                            argv.data(), // command
-                            env,         // environment
-                            G_SPAWN_SEARCH_PATH,
-                            nullptr, nullptr, nullptr, // child setup
-                            -1,         // timeout
-                            nullptr,    // cancellable
-                            nullptr,    // callback
-                            nullptr     // user_data
-                        );
-                        g_strfreev(env);
-                    } else {
-                        std::cerr << "Error: Empty command args for SSH connection" << std::endl;
-                    }
-                } else if (conn_it->connection_type == "RDP") {
-                    // For RDP connections, launch the RDP session
-                    // First, remove the terminal tab we just created
-                    notebook.remove_page(page_num);
-
-                    // Launch the RDP session with domain if available
-                    launch_rdp_session(notebook,
-                                     conn_it->host,
-                                     conn_it->username,
-                                     conn_it->password,
-                                     conn_it->domain);
-                }
+                open_connection(notebook, conn_info);
             }
         }
     );
 
-    // Add cleanup when tab is closed
-    notebook.signal_page_removed().connect([](Gtk::Widget* page, guint page_num) {
-        // Cleanup will be handled by child-exited signal
+    // Close RDP session pages when their viewer process exits
+    Rdp::instance()->signal_process_exit().connect([](GPid pid) {
+        // Use idle to ensure we're in the main thread
+        Glib::signal_idle().connect_once([pid]() {
+            if (Session* session = SessionRegistry::find_by_pid(pid)) {
+                SessionRegistry::close(*session);
+            }
+        });
     });
 
     // Add resize event handler to save window dimensions and log sizes
@@ -1626,6 +2181,7 @@ int main(int argc, char* argv[]) {
     // Connect the delete event
     window.signal_delete_event().connect([&window](GdkEventAny*) {
         save_frame_width(window);
+        SessionRestore::save();
         // Explicitly close all windows
         gtk_main_quit();
         return false;  // Propagate the event
@@ -1635,8 +2191,31 @@ int main(int argc, char* argv[]) {
     window.show_all_children();
     window.show();
 
+    // Reopen the tabs from the previous run as placeholders
+    SessionRestore::restore(notebook);
+    open_surviving_sessions(notebook);
+    Tunnels::start_auto();
+
     // Start the GTK main loop
     Gtk::Main::run(window);
 
+    Tunnels::shutdown();
+
+    // Leave the helper's sessions running for the next start
+    PtyHelper::shutdown();
+
+    // Close the shared jump host connections, unless helper sessions still run behind them
+    if (!Config::get_pty_helper()) {
+        Ssh::stop_bastion_masters();
+    }
+    Ssh::shutdown();
+    Agent::shutdown();
+
+    // Flush and close recordings before the terminals go away
+    Recording::shutdown();
+    Search::shutdown();
+    Scrollback::shutdown();
+    Tools::shutdown();
+
     return 0;
 }
\ No newline at end of file
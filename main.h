@@ -18,7 +18,9 @@
 #include "Folders.h"
 #include "Ssh.h"
 #include "Config.h"
+#include "Sessions.h"
 #include <sys/wait.h>
+#include <csignal>
 #include <map>
 #include <gdkmm/pixbufloader.h>
 
@@ -31,23 +33,20 @@ enum class DialogPurpose {
     DUPLICATE
 };
 
-// Forward declarations
-struct TerminalData;
-
 // Global variables (declaration only)
 extern Gtk::TreeView* connections_treeview;
 extern Glib::RefPtr<Gtk::TreeStore> connections_liststore;
 extern ConnectionColumns connection_columns;
 
-// Track open connections and their tab indices
-extern std::map<std::string, int> open_connections; // Maps connection ID to tab index
-
 // Global UI elements for Info Panel
 extern Gtk::Frame* info_frame;
 extern Gtk::Grid* info_grid;
 extern Gtk::Label* host_value_label;
 extern Gtk::Label* type_value_label;
 extern Gtk::Label* port_value_label;
+extern Gtk::Label* network_value_label;
+extern Gtk::Label* link_value_label;
+extern Gtk::Label* last_seen_value_label;
 
 // Global MenuItems for Edit functionality
 extern Gtk::MenuItem* edit_folder_menu_item;
@@ -65,12 +64,17 @@ extern Gtk::ToolButton* add_connection_menu_item_toolbar;
 
 // Function declarations
 void on_connection_selection_changed();
+void update_link_info();
 void process_connection_dialog(Gtk::Notebook& notebook, DialogPurpose purpose, const ConnectionInfo* existing_connection);
 void duplicate_connection_dialog(Gtk::Notebook& notebook);
 void edit_connection_dialog(Gtk::Notebook& notebook);
 void add_connection_dialog(Gtk::Notebook& notebook);
 void delete_connection_dialog(Gtk::Notebook& notebook, const Glib::ustring& conn_id, const Glib::ustring& conn_name);
-void launch_rdp_session(Gtk::Notebook& notebook, const std::string& server, const std::string& username, const std::string& password, const std::string& domain = "");
+void launch_rdp_session(Gtk::Notebook& notebook, Session& session, const std::string& server, const std::string& username, const std::string& password, const std::string& domain = "", bool foreground = true);
+Session* open_connection(Gtk::Notebook& notebook, const ConnectionInfo& conn);
+void start_session(Gtk::Notebook& notebook, Session& session, const ConnectionInfo& conn, bool foreground);
+void spawn_session_command(Session& session);
+void open_surviving_sessions(Gtk::Notebook& notebook);
 void build_menu(Gtk::Window& parent_window, Gtk::MenuBar& menubar, Gtk::Notebook& notebook, Gtk::TreeView& connections_treeview_ref,
                 Glib::RefPtr<Gtk::TreeStore>& liststore_ref, ConnectionColumns& columns_ref);
 void build_leftFrame(Gtk::Window& parent_window, Gtk::Frame& left_frame, Gtk::ScrolledWindow& left_scrolled_window,
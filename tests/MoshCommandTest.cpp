@@ -0,0 +1,233 @@
+// Checks the mosh command built for a connection: the argv layout and the --ssh= value, which
+// mosh splits with shell rules again. Runs in a scratch HOME with stand-in ssh, sshpass and
+// mosh on PATH, so the result does not depend on what this machine has installed.
+#include "Ssh.h"
+#include "NetworkProfiles.h"
+#include "Tools.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        fprintf(stderr, "FAIL: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+std::string join(const std::vector<std::string>& words) {
+    std::string text;
+    for (const auto& word : words) {
+        text += (text.empty() ? "[" : "] [") + word;
+    }
+    return text + "]";
+}
+
+void check_words(const std::vector<std::string>& actual, const std::vector<std::string>& expected,
+                 const std::string& what) {
+    if (actual != expected) {
+        fprintf(stderr, "FAIL: %s\n  got      %s\n  expected %s\n", what.c_str(),
+                join(actual).c_str(), join(expected).c_str());
+        failures++;
+    }
+}
+
+// The --ssh= argument of a mosh command, split the way mosh splits it
+std::vector<std::string> ssh_words(const std::vector<std::string>& args) {
+    auto it = std::find_if(args.begin(), args.end(),
+                           [](const std::string& arg) { return arg.compare(0, 6, "--ssh=") == 0; });
+    if (it == args.end()) return {};
+    gchar** argv = nullptr;
+    GError* error = nullptr;
+    std::vector<std::string> words;
+    if (!g_shell_parse_argv(it->c_str() + 6, nullptr, &argv, &error)) {
+        fprintf(stderr, "FAIL: --ssh= does not parse: %s\n", error->message);
+        failures++;
+        g_error_free(error);
+        return words;
+    }
+    for (gchar** word = argv; *word; ++word) {
+        words.push_back(*word);
+    }
+    g_strfreev(argv);
+    return words;
+}
+
+// A saved password must never be part of a command line; other users can read those
+void check_no_password(const std::vector<std::string>& args, const std::string& password,
+                       const std::string& what) {
+    for (const auto& arg : args) {
+        check(arg.find(password) == std::string::npos, what + ": password in argv word " + arg);
+    }
+}
+
+// sshpass gets the password from a file only this user can read. Returns the file.
+std::string check_password_file(const std::vector<std::string>& args, const std::string& password,
+                                const std::string& what) {
+    check_no_password(args, password, what);
+    auto it = std::find(args.begin(), args.end(), "-f");
+    if (it == args.end() || it + 1 == args.end()) {
+        check(false, what + ": no sshpass -f in " + join(args));
+        return "";
+    }
+    std::string path = *(it + 1);
+    gchar* contents = nullptr;
+    gsize length = 0;
+    check(g_file_get_contents(path.c_str(), &contents, &length, nullptr) &&
+          std::string(contents, length) == password, what + ": password file " + path);
+    g_free(contents);
+    struct stat info;
+    check(stat(path.c_str(), &info) == 0 && (info.st_mode & 0777) == 0600, what + ": password file mode");
+    return path;
+}
+
+void write_tool(const std::string& dir, const std::string& name, const std::string& script) {
+    std::string path = dir + "/" + name;
+    std::string text = "#!/bin/sh\n" + script + "\n";
+    g_file_set_contents(path.c_str(), text.c_str(), -1, nullptr);
+    g_chmod(path.c_str(), 0755);
+}
+
+ConnectionInfo mosh_connection() {
+    ConnectionInfo conn;
+    conn.id = "target";
+    conn.name = "target";
+    conn.connection_type = "Mosh";
+    conn.host = "mosh.example.com";
+    conn.port = 22;
+    conn.username = "alice";
+    conn.jump_host_id = "None";
+    conn.network_profile = "Default";
+    return conn;
+}
+
+} // namespace
+
+int main() {
+    gchar* scratch = g_dir_make_tmp("ngterm-mosh-XXXXXX", nullptr);
+    if (!scratch) {
+        fprintf(stderr, "could not create a scratch directory\n");
+        return 1;
+    }
+    std::string home = scratch;
+    std::string bin = home + "/bin";
+    g_mkdir_with_parents(bin.c_str(), 0700);
+    write_tool(bin, "ssh", "echo OpenSSH_9.6p1 >&2");
+    write_tool(bin, "sshpass", "echo sshpass 1.09");
+    write_tool(bin, "mosh", "echo mosh 1.4.0");
+    g_setenv("HOME", home.c_str(), TRUE);
+    g_setenv("XDG_RUNTIME_DIR", home.c_str(), TRUE);
+    g_setenv("PATH", bin.c_str(), TRUE);
+
+    // The version probe runs in the background; the first command built must not miss the
+    // options it enables
+    Tools::start();
+
+    // A network profile adds its options as single words after the user's
+    {
+        ConnectionInfo conn = mosh_connection();
+        conn.network_profile = "Satellite";
+        std::vector<std::string> words = ssh_words(Ssh::generate_mosh_command_args(conn));
+        std::vector<std::string> options = NetworkProfiles::get_ssh_options("Satellite");
+        check(std::any_of(words.begin(), words.end(),
+                          [](const std::string& word) { return word.compare(0, 9, "Ciphers=^") == 0; }),
+              "profile algorithm options with ssh 9.6");
+        std::vector<std::string> expected = {"ssh"};
+        expected.insert(expected.end(), options.begin(), options.end());
+        check_words(words, expected, "profile --ssh= words");
+    }
+
+    // Password: sshpass answers the bootstrap ssh, the default port is left out
+    {
+        ConnectionInfo conn = mosh_connection();
+        conn.auth_method = "Password";
+        conn.password = "pass word's";
+        std::vector<std::string> args = Ssh::generate_mosh_command_args(conn);
+        check(args.size() == 6, "password connection argv: " + join(args));
+        if (args.size() == 6) {
+            check_words(args, {"sshpass", "-f", args[2], "mosh", "--ssh=ssh", "alice@mosh.example.com"},
+                        "password connection argv");
+        }
+        std::string path = check_password_file(args, "pass word's", "password connection");
+        Ssh::shutdown();
+        check(!path.empty() && !g_file_test(path.c_str(), G_FILE_TEST_EXISTS), "password file removed at shutdown");
+    }
+
+    // Key path, port and the user's own flags go to ssh; UDP port and server go to mosh
+    {
+        ConnectionInfo conn = mosh_connection();
+        conn.auth_method = "SSHKey";
+        conn.ssh_key_path = "/keys/my key's \"id\"";
+        conn.port = 2222;
+        conn.additional_ssh_options = "-o 'SetEnv=GREETING=hello world' -v";
+        conn.mosh_port = "60001:60010";
+        conn.mosh_server = "/opt/mosh/bin/mosh-server";
+        conn.username = "";
+        std::vector<std::string> args = Ssh::generate_mosh_command_args(conn);
+        check(args.size() == 5 && args[0] == "mosh" && args[2] == "--port=60001:60010" &&
+              args[3] == "--server=/opt/mosh/bin/mosh-server" && args[4] == "mosh.example.com",
+              "key connection argv: " + join(args));
+        check_words(ssh_words(args),
+                    {"ssh", "-i", "/keys/my key's \"id\"", "-p", "2222", "-o", "SetEnv=GREETING=hello world", "-v"},
+                    "key connection --ssh= words");
+    }
+
+    // A jump host becomes one ProxyCommand word, however much quoting it carries inside
+    {
+        ConnectionInfo bastion;
+        bastion.id = "bastion";
+        bastion.name = "bastion";
+        bastion.connection_type = "SSH";
+        bastion.host = "bastion.example.com";
+        bastion.port = 2200;
+        bastion.username = "jump user";
+        bastion.auth_method = "Password";
+        bastion.password = "it's secret";
+        bastion.jump_host_id = "None";
+        check(ConnectionManager::save_connection(bastion), "bastion saved");
+
+        ConnectionInfo conn = mosh_connection();
+        conn.jump_host_id = "bastion";
+        std::string proxy_command = Ssh::generate_jump_proxy_command(conn);
+        check(proxy_command.find("-W %h:%p") != std::string::npos, "proxy command: " + proxy_command);
+        std::vector<std::string> args = Ssh::generate_mosh_command_args(conn);
+        check_words(ssh_words(args), {"ssh", "-o", "ProxyCommand=" + proxy_command}, "jump host --ssh= words");
+
+        // The bastion's password is read from a file, in the ProxyCommand as well
+        gchar** proxy_words = nullptr;
+        std::vector<std::string> words;
+        if (g_shell_parse_argv(proxy_command.c_str(), nullptr, &proxy_words, nullptr)) {
+            for (gchar** word = proxy_words; *word; ++word) {
+                words.push_back(*word);
+            }
+            g_strfreev(proxy_words);
+        }
+        check(!words.empty() && words[0] == "sshpass", "bastion sshpass: " + proxy_command);
+        check_password_file(words, "it's secret", "bastion");
+        check_no_password(args, "it's secret", "jump host mosh argv");
+    }
+
+    Ssh::shutdown();
+    Tools::shutdown();
+    std::string remove = "rm -rf '" + home + "'";
+    if (system(remove.c_str()) != 0) {
+        fprintf(stderr, "could not remove %s\n", home.c_str());
+    }
+    g_free(scratch);
+
+    if (failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("mosh command: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,163 @@
+// Runs the mosh command ngTerm builds for a connection against a real server and checks that
+// a command typed into the session comes back. tests/mosh_sshd_test.sh starts the throwaway
+// sshd it logs in through and passes its port and client key.
+// Usage: mosh_session_test <scratch dir> <port> <client key> <mosh-server>
+#include "Ssh.h"
+#include "Tools.h"
+#include <glib.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <pty.h>
+#include <pwd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        fprintf(stderr, "FAIL: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+class Session {
+public:
+    explicit Session(const std::vector<std::string>& args) {
+        struct winsize size = {24, 80, 0, 0};
+        pid = forkpty(&fd, nullptr, nullptr, &size);
+        if (pid == 0) {
+            std::vector<char*> argv;
+            for (const auto& arg : args) {
+                argv.push_back(const_cast<char*>(arg.c_str()));
+            }
+            argv.push_back(nullptr);
+            execvp(argv[0], argv.data());
+            _exit(127);
+        }
+    }
+
+    ~Session() {
+        if (pid > 0) {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+        if (fd >= 0) close(fd);
+    }
+
+    bool running() const { return pid > 0 && fd >= 0; }
+
+    void send(const std::string& text) {
+        if (write(fd, text.data(), text.size()) < 0) perror("write");
+    }
+
+    // Read until the output contains text, the session ends or the time is up
+    bool wait_for(const std::string& text, int seconds) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+        while (output.find(text) == std::string::npos) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            if (left <= 0) return false;
+            struct pollfd item = {fd, POLLIN, 0};
+            if (poll(&item, 1, static_cast<int>(left)) <= 0) continue;
+            char buffer[4096];
+            ssize_t length = read(fd, buffer, sizeof(buffer));
+            if (length <= 0) return false;
+            output.append(buffer, length);
+        }
+        return true;
+    }
+
+    // Wait for mosh to exit; true when it did so by itself with status 0
+    bool wait_exit(int seconds) {
+        for (int i = 0; i < seconds * 10; ++i) {
+            int status = 0;
+            if (waitpid(pid, &status, WNOHANG) == pid) {
+                pid = 0;
+                return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+            }
+            char buffer[4096];
+            struct pollfd item = {fd, POLLIN, 0};
+            if (poll(&item, 1, 100) > 0 && read(fd, buffer, sizeof(buffer)) > 0) continue;
+        }
+        return false;
+    }
+
+    std::string output;
+
+private:
+    pid_t pid = -1;
+    int fd = -1;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 5) {
+        fprintf(stderr, "usage: %s <scratch dir> <port> <client key> <mosh-server>\n", argv[0]);
+        return 2;
+    }
+    std::string scratch = argv[1];
+    g_setenv("HOME", scratch.c_str(), TRUE);
+    g_setenv("XDG_RUNTIME_DIR", scratch.c_str(), TRUE);
+    g_setenv("TERM", "xterm", TRUE);
+    g_setenv("LANG", "C.UTF-8", TRUE);
+    g_setenv("LC_ALL", "C.UTF-8", TRUE);
+    g_setenv("SHELL", "/bin/sh", TRUE);
+    Tools::start();
+
+    ConnectionInfo conn;
+    conn.id = "mosh-session";
+    conn.name = "mosh-session";
+    conn.connection_type = "Mosh";
+    conn.host = "127.0.0.1";
+    conn.port = atoi(argv[2]);
+    struct passwd* user = getpwuid(getuid());
+    conn.username = user ? user->pw_name : "";
+    conn.auth_method = "SSHKey";
+    conn.ssh_key_path = argv[3];
+    conn.additional_ssh_options = "-F /dev/null -o BatchMode=yes -o IdentitiesOnly=yes "
+                                  "-o StrictHostKeyChecking=no -o UserKnownHostsFile=/dev/null -o LogLevel=ERROR";
+    conn.mosh_server = argv[4];
+    conn.jump_host_id = "None";
+    conn.network_profile = "Default";
+    std::vector<std::string> args = Ssh::generate_mosh_command_args(conn);
+
+    {
+        Session session(args);
+        check(session.running(), "mosh started");
+        if (session.running()) {
+            // mosh-client switches to the alternate screen once the bootstrap is done; keys typed
+            // before that could go to ssh instead, so the command is repeated until it shows up.
+            // The quotes keep the echoed command line from matching, only the shell's output does.
+            bool answered = false;
+            if (session.wait_for("\033[?1049h", 30)) {
+                for (int attempt = 0; attempt < 10 && !answered; ++attempt) {
+                    session.send("echo round''trip-$((6 * 7))\r");
+                    answered = session.wait_for("roundtrip-42", 3);
+                }
+            }
+            check(answered, "command output came back through the session");
+            if (answered) {
+                session.send("exit\r");
+                check(session.wait_exit(15), "mosh exits with the remote shell");
+            } else {
+                fprintf(stderr, "session output:\n%s\n", session.output.c_str());
+            }
+        }
+    }
+
+    Ssh::shutdown();
+    Tools::shutdown();
+    if (failures == 0) {
+        printf("mosh session: all checks passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
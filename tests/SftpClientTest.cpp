@@ -0,0 +1,233 @@
+// Drives Sftp::Client through a real SFTP server: handshake, REALPATH, a directory listing
+// long enough to need several READDIR rounds, pipelined WRITE and READ of a file larger
+// than the request size, and the status codes of failing requests. The server is reached
+// with the command given after the directory, which tests/sftp_sshd_test.sh points at a
+// throwaway sshd on localhost.
+//
+//   sftp_client_test <scratch dir> <command...>
+#include "SftpClient.h"
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+const uint32_t CHUNK = 32 * 1024;
+const int LISTED_FILES = 300; // OpenSSH answers READDIR with at most 100 names
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        fprintf(stderr, "FAIL: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+// Run the main loop until done() holds. Callbacks still pending would outlive the state
+// they point to, so a server that stops answering ends the test.
+void run_until(const std::function<bool()>& done, const std::string& what) {
+    gint64 deadline = g_get_monotonic_time() + 10 * G_USEC_PER_SEC;
+    guint tick = g_timeout_add(100, [](gpointer) { return G_SOURCE_CONTINUE; }, nullptr);
+    while (!done() && g_get_monotonic_time() < deadline) {
+        g_main_context_iteration(nullptr, TRUE);
+    }
+    g_source_remove(tick);
+    if (!done()) {
+        fprintf(stderr, "FAIL: no answer in time: %s\n", what.c_str());
+        exit(1);
+    }
+}
+
+// Send one request and wait for its reply
+Sftp::Reply call(const std::function<void(Sftp::Client::Callback)>& send) {
+    Sftp::Reply result;
+    bool answered = false;
+    send([&](const Sftp::Reply& reply) {
+        result = reply;
+        answered = true;
+    });
+    run_until([&]() { return answered; }, "request");
+    return result;
+}
+
+std::string make_data(size_t size) {
+    std::string data(size, '\0');
+    guint32 state = 2463534242u;
+    for (auto& byte : data) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        byte = static_cast<char>(state);
+    }
+    return data;
+}
+
+void test_listing(Sftp::Client& client, const std::string& directory) {
+    std::string listed_dir = directory + "/listed";
+    g_mkdir(listed_dir.c_str(), 0700);
+    for (int i = 0; i < LISTED_FILES; ++i) {
+        std::string path = listed_dir + "/file-" + std::to_string(i);
+        g_file_set_contents(path.c_str(), std::string(i, 'x').c_str(), i, nullptr);
+    }
+
+    Sftp::Reply opened = call([&](Sftp::Client::Callback done) { client.opendir(listed_dir, done); });
+    check(!opened.handle.empty(), "OPENDIR returns a handle: " + opened.message);
+    if (opened.handle.empty()) return;
+
+    std::map<std::string, Sftp::Attributes> names;
+    int rounds = 0;
+    while (true) {
+        Sftp::Reply batch = call([&](Sftp::Client::Callback done) { client.readdir(opened.handle, done); });
+        if (batch.type == Sftp::FXP_STATUS) {
+            check(batch.status == Sftp::FX_EOF, "READDIR ends with EOF, not: " + batch.message);
+            break;
+        }
+        check(batch.type == Sftp::FXP_NAME && !batch.entries.empty(), "READDIR returns names");
+        if (batch.entries.empty() || ++rounds > 100) break;
+        for (const auto& entry : batch.entries) {
+            names[entry.name] = entry.attrs;
+        }
+    }
+    Sftp::Reply closed = call([&](Sftp::Client::Callback done) { client.close_handle(opened.handle, done); });
+    check(!closed.failed(), "CLOSE of the directory handle");
+
+    check(rounds > 1, "listing took several READDIR rounds");
+    check(names.size() == LISTED_FILES + 2, "every name listed once, with . and ..: " + std::to_string(names.size()));
+    auto sample = names.find("file-123");
+    check(sample != names.end() && (sample->second.flags & Sftp::ATTR_SIZE) && sample->second.size == 123,
+          "attributes of a listed file");
+}
+
+void test_transfer(Sftp::Client& client, const std::string& directory) {
+    std::string path = directory + "/transfer.bin";
+    std::string data = make_data(33 * CHUNK + 123);
+
+    // All chunks in flight at once, as the browser's transfers do
+    Sftp::Reply opened = call([&](Sftp::Client::Callback done) {
+        client.open(path, Sftp::FXF_WRITE | Sftp::FXF_CREAT | Sftp::FXF_TRUNC, done);
+    });
+    check(!opened.handle.empty(), "OPEN for writing: " + opened.message);
+    if (opened.handle.empty()) return;
+    size_t written = 0;
+    size_t write_failures = 0;
+    size_t chunks = 0;
+    for (size_t offset = 0; offset < data.size(); offset += CHUNK, ++chunks) {
+        client.write(opened.handle, offset, data.substr(offset, CHUNK), [&](const Sftp::Reply& reply) {
+            written++;
+            if (reply.failed()) write_failures++;
+        });
+    }
+    run_until([&]() { return written == chunks; }, "pipelined WRITEs");
+    check(write_failures == 0, "pipelined WRITEs succeed");
+    call([&](Sftp::Client::Callback done) { client.close_handle(opened.handle, done); });
+
+    gchar* contents = nullptr;
+    gsize length = 0;
+    check(g_file_get_contents(path.c_str(), &contents, &length, nullptr) &&
+          std::string(contents, length) == data, "written file matches");
+    g_free(contents);
+
+    // Reads answered in any order are put back by offset; the one past the end gets EOF
+    opened = call([&](Sftp::Client::Callback done) { client.open(path, Sftp::FXF_READ, done); });
+    check(!opened.handle.empty(), "OPEN for reading: " + opened.message);
+    if (opened.handle.empty()) return;
+    std::map<guint64, std::string> pieces;
+    size_t answered = 0;
+    bool eof_seen = false;
+    size_t requests = 0;
+    for (guint64 offset = 0; offset <= data.size(); offset += CHUNK, ++requests) {
+        client.read(opened.handle, offset, CHUNK, [&, offset](const Sftp::Reply& reply) {
+            answered++;
+            if (reply.type == Sftp::FXP_DATA) {
+                pieces[offset] = reply.data;
+            } else if (reply.type == Sftp::FXP_STATUS && reply.status == Sftp::FX_EOF) {
+                eof_seen = true;
+            }
+        });
+    }
+    run_until([&]() { return answered == requests; }, "pipelined READs");
+    check(eof_seen, "READ past the end returns EOF");
+    std::string read_back;
+    for (const auto& piece : pieces) {
+        check(piece.first == read_back.size(), "READs return whole chunks");
+        read_back += piece.second;
+    }
+    check(read_back == data, "pipelined READs return the file");
+    call([&](Sftp::Client::Callback done) { client.close_handle(opened.handle, done); });
+}
+
+void test_errors(Sftp::Client& client, const std::string& directory) {
+    std::string missing = directory + "/missing";
+    Sftp::Reply stat = call([&](Sftp::Client::Callback done) { client.stat(missing, done); });
+    check(stat.failed() && stat.status == Sftp::FX_NO_SUCH_FILE, "STAT of a missing file is NO_SUCH_FILE");
+
+    Sftp::Reply open = call([&](Sftp::Client::Callback done) { client.open(missing, Sftp::FXF_READ, done); });
+    check(open.failed() && open.handle.empty(), "OPEN of a missing file fails");
+
+    Sftp::Reply remove = call([&](Sftp::Client::Callback done) { client.remove(missing, done); });
+    check(remove.failed(), "REMOVE of a missing file fails");
+
+    std::string made = directory + "/made";
+    Sftp::Reply mkdir = call([&](Sftp::Client::Callback done) { client.mkdir(made, done); });
+    check(!mkdir.failed() && g_file_test(made.c_str(), G_FILE_TEST_IS_DIR), "MKDIR");
+    Sftp::Reply again = call([&](Sftp::Client::Callback done) { client.mkdir(made, done); });
+    check(again.failed(), "MKDIR of an existing directory fails");
+    Sftp::Reply rmdir = call([&](Sftp::Client::Callback done) { client.rmdir(made, done); });
+    check(!rmdir.failed() && !g_file_test(made.c_str(), G_FILE_TEST_EXISTS), "RMDIR");
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <scratch dir> <command...>\n", argv[0]);
+        return 2;
+    }
+    std::string directory = argv[1];
+    std::vector<std::string> command(argv + 2, argv + argc);
+
+    Sftp::Client client;
+    bool ready = false;
+    std::string closed_reason;
+    client.on_ready = [&]() { ready = true; };
+    client.on_closed = [&](const std::string& reason) { closed_reason = reason; };
+
+    std::string error;
+    if (!client.start(command, error)) {
+        fprintf(stderr, "FAIL: cannot start %s: %s\n", command[0].c_str(), error.c_str());
+        return 1;
+    }
+    run_until([&]() { return ready || !closed_reason.empty(); }, "VERSION");
+    if (!ready) {
+        fprintf(stderr, "FAIL: no VERSION from the server: %s\n", closed_reason.c_str());
+        return 1;
+    }
+
+    Sftp::Reply resolved = call([&](Sftp::Client::Callback done) { client.realpath(directory, done); });
+    gchar* canonical = realpath(directory.c_str(), nullptr);
+    check(resolved.type == Sftp::FXP_NAME && resolved.entries.size() == 1 && canonical &&
+          resolved.entries.front().name == canonical, "REALPATH of the scratch directory");
+    if (canonical) {
+        directory = canonical;
+        free(canonical);
+    }
+
+    test_listing(client, directory);
+    test_transfer(client, directory);
+    test_errors(client, directory);
+    check(closed_reason.empty(), "connection stayed up: " + closed_reason);
+    client.stop();
+
+    if (failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("sftp client: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,165 @@
+// Runs TmuxProtocol::Parser against a real tmux -CC on a private server socket: command
+// response blocks, %output decoding, and the DCS start and ST end of control mode arriving
+// split over several reads. Skipped when tmux is not installed.
+#include "TmuxProtocol.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        fprintf(stderr, "FAIL: %s\n", what.c_str());
+        failures++;
+    }
+}
+
+struct Transcript {
+    std::string plain;
+    int starts = 0;
+    std::vector<std::pair<bool, std::vector<std::string>>> blocks;
+    std::string pane_output;
+    std::vector<std::string> notifications;
+    bool exited = false;
+};
+
+class Session {
+public:
+    Session(size_t read_size, Transcript& transcript) : read_size(read_size) {
+        parser.on_plain = [&transcript](const char* data, size_t length) { transcript.plain.append(data, length); };
+        parser.on_start = [&transcript]() { transcript.starts++; };
+        parser.on_block = [&transcript](bool ok, const std::vector<std::string>& lines) {
+            transcript.blocks.emplace_back(ok, lines);
+        };
+        parser.on_output = [&transcript](const std::string&, const std::string& data) { transcript.pane_output += data; };
+        parser.on_notification = [&transcript](const std::string& line) { transcript.notifications.push_back(line); };
+        parser.on_exit = [&transcript](const std::string&) { transcript.exited = true; };
+
+        std::string socket = "ngterm-test-" + std::to_string(getpid()) + "-" + std::to_string(read_size);
+        struct winsize size = {24, 80, 0, 0};
+        pid = forkpty(&fd, nullptr, nullptr, &size);
+        if (pid == 0) {
+            setenv("SHELL", "/bin/sh", 1);
+            setenv("TERM", "xterm", 1);
+            std::string script = "echo before-control; tmux -L " + socket +
+                                 " -f /dev/null -CC new-session; echo after-control";
+            execlp("sh", "sh", "-c", script.c_str(), static_cast<char*>(nullptr));
+            _exit(127);
+        }
+    }
+
+    ~Session() {
+        if (pid > 0) {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+        if (fd >= 0) close(fd);
+    }
+
+    bool running() const { return pid > 0 && fd >= 0; }
+
+    void send(const std::string& command) {
+        std::string line = command + "\n";
+        if (write(fd, line.data(), line.size()) < 0) perror("write");
+    }
+
+    // Read, read_size bytes at a time, until done() holds or five seconds pass
+    bool pump(const std::function<bool()>& done) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        std::vector<char> buffer(read_size);
+        while (!done()) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0) return false;
+            struct pollfd item = {fd, POLLIN, 0};
+            if (poll(&item, 1, static_cast<int>(left.count())) <= 0) continue;
+            ssize_t length = read(fd, buffer.data(), buffer.size());
+            if (length <= 0) return done();
+            if (!parser.feed(buffer.data(), length)) {
+                parser.on_plain(buffer.data(), length);
+            }
+        }
+        return true;
+    }
+
+private:
+    size_t read_size;
+    TmuxProtocol::Parser parser;
+    pid_t pid = -1;
+    int fd = -1;
+};
+
+void run(size_t read_size) {
+    std::string label = "read size " + std::to_string(read_size) + ": ";
+    Transcript transcript;
+    Session session(read_size, transcript);
+    if (!session.running()) {
+        check(false, label + "could not start tmux");
+        return;
+    }
+
+    // The first block answers the command tmux was started with
+    check(session.pump([&]() { return !transcript.blocks.empty(); }), label + "control mode started");
+    check(transcript.starts == 1, label + "one DCS start");
+    check(transcript.plain.find("before-control") != std::string::npos, label + "plain output before the DCS");
+    check(transcript.plain.find("\033P") == std::string::npos, label + "no DCS in plain output");
+
+    session.send("display-message -p 'one two'");
+    check(session.pump([&]() { return transcript.blocks.size() >= 2; }), label + "display-message answered");
+    if (transcript.blocks.size() >= 2) {
+        check(transcript.blocks[1].first, label + "display-message succeeded");
+        check(transcript.blocks[1].second == std::vector<std::string>{"one two"}, label + "display-message output");
+    }
+
+    session.send("no-such-command");
+    check(session.pump([&]() { return transcript.blocks.size() >= 3; }), label + "unknown command answered");
+    if (transcript.blocks.size() >= 3) {
+        check(!transcript.blocks[2].first, label + "unknown command is an %error block");
+    }
+
+    // Tab, ^A and backslash come escaped as \011, \001 and \134
+    session.send("send-keys -t %0 \"printf 'mark<\\\\t\\\\001\\\\\\\\>\\\\n'\" Enter");
+    const std::string expected = "mark<\t\001\\>";
+    check(session.pump([&]() { return transcript.pane_output.find(expected) != std::string::npos; }),
+          label + "%output decoded");
+
+    session.send("kill-server");
+    check(session.pump([&]() { return transcript.plain.find("after-control") != std::string::npos; }),
+          label + "plain output after the ST");
+    check(transcript.exited, label + "%exit seen");
+    check(transcript.plain.find("\033\\") == std::string::npos, label + "no ST in plain output");
+    check(transcript.starts == 1, label + "no second start");
+}
+
+} // namespace
+
+int main() {
+    if (system("tmux -V > /dev/null 2>&1") != 0) {
+        printf("tmux not found, skipped\n");
+        return 0;
+    }
+
+    check(TmuxProtocol::decode_output("a\\033[0m\\134\\") == "a\033[0m\\\\", "decode_output");
+
+    // One byte per read splits the DCS start and the ST end; the larger sizes cut lines anywhere
+    for (size_t read_size : {1, 7, 4096}) {
+        run(read_size);
+    }
+
+    if (failures > 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("tmux protocol: all checks passed\n");
+    return 0;
+}
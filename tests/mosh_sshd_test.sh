@@ -0,0 +1,47 @@
+#!/bin/sh
+# Runs tests/mosh_session_test through a throwaway sshd on localhost: its own host key,
+# client key, port and config, so nothing of this machine's ssh setup is used or changed.
+# mosh starts the installed mosh-server through it. Skipped when sshd, mosh or mosh-server
+# is not installed.
+set -e
+
+SSHD=$(command -v sshd || true)
+[ -z "$SSHD" ] && [ -x /usr/sbin/sshd ] && SSHD=/usr/sbin/sshd
+MOSH_SERVER=$(command -v mosh-server || true)
+if [ -z "$SSHD" ] || [ -z "$MOSH_SERVER" ] || ! command -v mosh > /dev/null; then
+    echo "sshd, mosh or mosh-server not found, mosh session check skipped"
+    exit 0
+fi
+
+dir=$(mktemp -d)
+sshd_pid=
+trap '[ -n "$sshd_pid" ] && kill "$sshd_pid" 2>/dev/null; rm -rf "$dir"' EXIT
+
+ssh-keygen -q -t ed25519 -N '' -f "$dir/host_key"
+ssh-keygen -q -t ed25519 -N '' -f "$dir/client_key"
+cp "$dir/client_key.pub" "$dir/authorized_keys"
+port=$((20000 + ($$ + 1) % 20000))
+
+cat > "$dir/sshd_config" <<CONFIG
+ListenAddress 127.0.0.1
+Port $port
+HostKey $dir/host_key
+AuthorizedKeysFile $dir/authorized_keys
+PidFile none
+UsePAM no
+PasswordAuthentication no
+KbdInteractiveAuthentication no
+StrictModes no
+CONFIG
+
+# sshd re-executes itself, so it needs its absolute path
+"$SSHD" -D -e -f "$dir/sshd_config" 2> "$dir/sshd.log" &
+sshd_pid=$!
+for i in $(seq 50); do
+    grep -q "Server listening" "$dir/sshd.log" && break
+    sleep 0.1
+done
+
+mkdir "$dir/home"
+./tests/mosh_session_test "$dir/home" "$port" "$dir/client_key" "$MOSH_SERVER" ||
+    { cat "$dir/sshd.log" >&2; exit 1; }
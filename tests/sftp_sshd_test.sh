@@ -0,0 +1,49 @@
+#!/bin/sh
+# Runs tests/sftp_client_test through a throwaway sshd on localhost: its own host key,
+# client key, port and config, so nothing of this machine's ssh setup is used or changed.
+# Skipped when sshd is not installed.
+set -e
+
+SSHD=$(command -v sshd || true)
+[ -z "$SSHD" ] && [ -x /usr/sbin/sshd ] && SSHD=/usr/sbin/sshd
+if [ -z "$SSHD" ]; then
+    echo "sshd not found, sftp client check skipped"
+    exit 0
+fi
+
+dir=$(mktemp -d)
+sshd_pid=
+trap '[ -n "$sshd_pid" ] && kill "$sshd_pid" 2>/dev/null; rm -rf "$dir"' EXIT
+
+ssh-keygen -q -t ed25519 -N '' -f "$dir/host_key"
+ssh-keygen -q -t ed25519 -N '' -f "$dir/client_key"
+cp "$dir/client_key.pub" "$dir/authorized_keys"
+port=$((20000 + $$ % 20000))
+
+cat > "$dir/sshd_config" <<CONFIG
+ListenAddress 127.0.0.1
+Port $port
+HostKey $dir/host_key
+AuthorizedKeysFile $dir/authorized_keys
+PidFile none
+UsePAM no
+PasswordAuthentication no
+KbdInteractiveAuthentication no
+StrictModes no
+Subsystem sftp internal-sftp
+CONFIG
+
+# sshd re-executes itself, so it needs its absolute path
+"$SSHD" -D -e -f "$dir/sshd_config" 2> "$dir/sshd.log" &
+sshd_pid=$!
+for i in $(seq 50); do
+    grep -q "Server listening" "$dir/sshd.log" && break
+    sleep 0.1
+done
+
+mkdir "$dir/files"
+./tests/sftp_client_test "$dir/files" \
+    ssh -F /dev/null -i "$dir/client_key" -p "$port" \
+    -o BatchMode=yes -o IdentitiesOnly=yes -o StrictHostKeyChecking=no \
+    -o UserKnownHostsFile=/dev/null -o LogLevel=ERROR \
+    -s "$(id -un)@127.0.0.1" sftp || { cat "$dir/sshd.log" >&2; exit 1; }